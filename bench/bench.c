@@ -0,0 +1,554 @@
+/** Micro-benchmarks for the parsing and distribution kernels.
+ *
+ * Run with `make bench`, which benchmarks every CSV file in bench/fixtures. Each fixture is a
+ * site file in the same format as the archive, the site id is taken from the file name.
+ *
+ * The results are written to stdout as one JSON object per line, with the benchmark and fixture
+ * names, the number of timed iterations, the median nanoseconds per operation, the allocations
+ * and allocated bytes per operation, and the throughput in items per second. What an item is
+ * depends on the benchmark and is given in the \c item field, e.g. bytes of CSV or CDFs.
+ *
+ * Before the benchmarks of each fixture, the fast kernels are checked against slow reference
+ * versions, and the program fails if they don't agree. `make check` runs only these checks.
+ *
+ * Allocations are counted with alloc_stats.h, the makefile builds the benchmarks with
+ * NBM_ALLOC_STATS for that. It only works with glibc and without the sanitizers, otherwise the
+ * allocation fields are \c null.
+ */
+#include <math.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "alloc_stats.h"
+#include "arena.h"
+#include "distributions.h"
+#include "nbm_data.h"
+#include "raw_nbm_data.h"
+#include "table.h"
+#include "time_series.h"
+#include "utils.h"
+
+/*-------------------------------------------------------------------------------------------------
+ *                                          The Runner
+ *-----------------------------------------------------------------------------------------------*/
+/** Do one operation and return the number of items it processed. */
+typedef size_t (*BenchOp)(void *state);
+
+/** How long to run each sample for, and how many samples to take the median of. */
+#define BENCH_SAMPLE_NS 100000000
+#define BENCH_NUM_SAMPLES 5
+
+static int64_t
+now_ns(void)
+{
+    struct timespec ts = {0};
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+static int
+double_compare(void const *a, void const *b)
+{
+    double da = *(double const *)a;
+    double db = *(double const *)b;
+    return (da > db) - (da < db);
+}
+
+/** Time \a op and write a JSON line with the results.
+ *
+ * The number of iterations is found by doubling it until a sample takes long enough, so every
+ * sample runs the same number of iterations.
+ */
+static void
+run_benchmark(char const *name, char const *fixture, char const *item, BenchOp op, void *state)
+{
+    size_t items_per_op = op(state); // Warm up.
+
+    size_t iterations = 1;
+    while (true) {
+        int64_t start = now_ns();
+        for (size_t i = 0; i < iterations; i++) {
+            op(state);
+        }
+        int64_t elapsed = now_ns() - start;
+
+        if (elapsed >= BENCH_SAMPLE_NS / 10) {
+            iterations = ceil(iterations * (double)BENCH_SAMPLE_NS / elapsed);
+            break;
+        }
+        iterations *= 2;
+    }
+
+    double ns_per_op[BENCH_NUM_SAMPLES] = {0};
+    struct AllocCounts const counts_start = alloc_stats_thread();
+
+    for (int s = 0; s < BENCH_NUM_SAMPLES; s++) {
+        int64_t start = now_ns();
+        for (size_t i = 0; i < iterations; i++) {
+            op(state);
+        }
+        ns_per_op[s] = (double)(now_ns() - start) / iterations;
+    }
+
+    double const total_ops = (double)iterations * BENCH_NUM_SAMPLES;
+    struct AllocCounts const counts_end = alloc_stats_thread();
+    double allocs_per_op = (counts_end.allocs - counts_start.allocs) / total_ops;
+    double bytes_per_op = (counts_end.alloc_bytes - counts_start.alloc_bytes) / total_ops;
+
+    qsort(ns_per_op, BENCH_NUM_SAMPLES, sizeof(double), double_compare);
+    double median = ns_per_op[BENCH_NUM_SAMPLES / 2];
+
+    printf("{\"benchmark\":\"%s\",\"fixture\":\"%s\",\"iterations\":%zu,\"ns_per_op\":%.1lf,"
+           "\"min_ns_per_op\":%.1lf,\"max_ns_per_op\":%.1lf,",
+           name, fixture, iterations, median, ns_per_op[0], ns_per_op[BENCH_NUM_SAMPLES - 1]);
+    if (alloc_stats_available()) {
+        printf("\"allocs_per_op\":%.1lf,\"alloc_bytes_per_op\":%.0lf,", allocs_per_op,
+               bytes_per_op);
+    } else {
+        printf("\"allocs_per_op\":null,\"alloc_bytes_per_op\":null,");
+    }
+    printf("\"item\":\"%s\",\"items_per_op\":%zu,\"items_per_s\":%.1lf}\n", item, items_per_op,
+           items_per_op / (median * 1.0e-9));
+    fflush(stdout);
+}
+
+/*-------------------------------------------------------------------------------------------------
+ *                                          Benchmarks
+ *-----------------------------------------------------------------------------------------------*/
+/** Everything the benchmarks for one fixture need, built once before timing. */
+struct Fixture {
+    RawNbmData *raw;
+    NBMData *nbm;
+    Arena *arena;
+    TimeSeries *cdfs;
+    TimeSeries *pdfs;
+    double *pdf_widths; // From the lower edge of the first bin to the upper edge of the last.
+    Table *table;
+    FILE *null_out;
+};
+
+/** The same columns as the 24 hour precipitation summary. */
+#define NUM_PRECIP_EXC_VALS 10
+static char const *precip_exc_vals[NUM_PRECIP_EXC_VALS] = {
+    "0.254", "2.54", "6.35", "12.7", "25.4", "50.8", "101.6", "76.2", "127", "152.4",
+};
+
+static TimeSeries *
+extract_precip_cdfs(Arena *arena, NBMData const *nbm)
+{
+    return extract_cdfs(arena, nbm, "APCP24hr_surface_%d%% level", "APCP24hr_surface",
+                        "APCP24hr_surface_prob >%s", NUM_PRECIP_EXC_VALS, precip_exc_vals,
+                        mm_to_in);
+}
+
+static size_t
+bench_parse(void *state)
+{
+    struct Fixture *fx = state;
+
+    NBMData *nbm = parse_raw_nbm_data(fx->raw);
+    nbm_data_free(&nbm);
+
+    return raw_nbm_data_text_len(fx->raw);
+}
+
+static size_t
+bench_rows(void *state)
+{
+    struct Fixture *fx = state;
+
+    size_t num_rows = 0;
+    NBMDataRowIterator *it = nbm_data_rows(fx->nbm, "WDIR_10 m above ground");
+    for (struct NBMDataRowIteratorValueView view = nbm_data_row_iterator_next(it); view.value;
+         view = nbm_data_row_iterator_next(it)) {
+        num_rows++;
+    }
+    nbm_data_row_iterator_free(&it);
+
+    return num_rows;
+}
+
+static size_t
+bench_extract_cdfs(void *state)
+{
+    struct Fixture *fx = state;
+
+    Arena *arena = arena_new();
+    TimeSeries *cdfs = extract_precip_cdfs(arena, fx->nbm);
+    size_t num_cdfs = time_series_len(cdfs);
+    time_series_free(&cdfs);
+    arena_free(&arena);
+
+    return num_cdfs;
+}
+
+static size_t
+bench_percentile_value(void *state)
+{
+    struct Fixture *fx = state;
+    static double const pcts[] = {10.0, 25.0, 50.0, 75.0, 90.0};
+    size_t const num_pcts = sizeof(pcts) / sizeof(pcts[0]);
+
+    // Sum the values so the calls can't be optimized away.
+    double volatile sum = 0.0;
+    for (size_t i = 0; i < time_series_len(fx->cdfs); i++) {
+        CumulativeDistribution const *cdf = time_series_value(fx->cdfs, i);
+        for (size_t j = 0; j < num_pcts; j++) {
+            sum += cumulative_dist_percentile_value(cdf, pcts[j]);
+        }
+    }
+
+    return time_series_len(fx->cdfs) * num_pcts;
+}
+
+static size_t
+bench_pdf_calc(void *state)
+{
+    struct Fixture *fx = state;
+
+    Arena *arena = arena_new();
+    for (size_t i = 0; i < time_series_len(fx->cdfs); i++) {
+        probability_dist_calc(arena, time_series_value(fx->cdfs, i));
+    }
+    arena_free(&arena);
+
+    return time_series_len(fx->cdfs);
+}
+
+static size_t
+bench_find_scenarios(void *state)
+{
+    struct Fixture *fx = state;
+
+    // Finding the scenarios smooths the PDF in place, so each one is copied first.
+    Arena *arena = arena_new();
+    for (size_t i = 0; i < time_series_len(fx->pdfs); i++) {
+        ProbabilityDistribution *pdf = probability_dist_copy(arena, time_series_value(fx->pdfs, i));
+        find_scenarios(arena, pdf, 0.01, 0.02);
+    }
+    arena_free(&arena);
+
+    return time_series_len(fx->pdfs);
+}
+
+/** Smooth every PDF at \a radius times its width, see run_smooth_benchmarks(). */
+struct SmoothBench {
+    struct Fixture *fx;
+    double radius;
+};
+
+static size_t
+bench_smooth(void *state)
+{
+    struct SmoothBench *sb = state;
+    struct Fixture *fx = sb->fx;
+
+    Arena *arena = arena_new();
+    for (size_t i = 0; i < time_series_len(fx->pdfs); i++) {
+        ProbabilityDistribution const *pdf = time_series_value(fx->pdfs, i);
+        if (fx->pdf_widths[i] > 0.0) {
+            probability_dist_smooth(arena, pdf, sb->radius * fx->pdf_widths[i]);
+        }
+    }
+    arena_free(&arena);
+
+    return time_series_len(fx->pdfs);
+}
+
+/** Benchmark smoothing at radii that use each of its kernels.
+ *
+ * Narrow radii sum over a window of neighbors. Once a radius reaches 1/8 of the width of the PDF,
+ * the window covers every point. Wider radii switch to a series once it gets shorter than twice
+ * the number of points. The radii are picked for PDFs the size the NBM percentiles give, 15 to 20
+ * points. For much bigger PDFs the middle one would use the series too.
+ */
+static void
+run_smooth_benchmarks(char const *fixture, struct Fixture *fx)
+{
+    static struct {
+        char const *name;
+        double radius;
+    } const radii[] = {
+        {"probability_dist_smooth_window", 0.02},
+        {"probability_dist_smooth_all_pairs", 0.15},
+        {"probability_dist_smooth_series", 1.0},
+    };
+
+    for (size_t i = 0; i < sizeof(radii) / sizeof(radii[0]); i++) {
+        struct SmoothBench sb = {.fx = fx, .radius = radii[i].radius};
+        run_benchmark(radii[i].name, fixture, "pdfs", bench_smooth, &sb);
+    }
+}
+
+static size_t
+bench_table_display(void *state)
+{
+    struct Fixture *fx = state;
+
+    table_display(fx->table, fx->null_out);
+
+    return nbm_data_num_rows(fx->nbm);
+}
+
+/** A table like the hourly one, with a row for every valid time. */
+static Table *
+build_table(NBMData const *nbm)
+{
+    static struct {
+        char const *name;
+        char const *label;
+    } const cols[] = {
+        {"TMP_2 m above ground", "T"},        {"DPT_2 m above ground", "Td"},
+        {"RH_2 m above ground", "RH"},        {"WIND_10 m above ground", "Wind"},
+        {"GUST_10 m above ground", "Gust"},   {"TCDC_surface", "Sky"},
+    };
+    int const num_cols = sizeof(cols) / sizeof(cols[0]);
+    int const num_rows = nbm_data_num_rows(nbm);
+
+    Table *tbl = table_new(num_cols + 1, num_rows);
+    table_add_title(tbl, 9, "Benchmark");
+    table_add_column(tbl, 0, Table_ColumnType_TEXT, "Valid Time", "%s", 16);
+
+    for (int c = 0; c < num_cols; c++) {
+        table_add_column(tbl, c + 1, Table_ColumnType_VALUE, cols[c].label, " %6.1lf ", 8);
+        int col_num = nbm_data_column_index(nbm, cols[c].name);
+
+        for (int r = 0; r < num_rows; r++) {
+            if (c == 0) {
+                char buf[32] = {0};
+                time_t vt = nbm_data_valid_time(nbm, r);
+                struct tm vt_tm = {0};
+                int len = strftime(buf, sizeof(buf), "%a %m/%d %H", gmtime_r(&vt, &vt_tm));
+                table_set_string_value(tbl, 0, r, len, buf);
+            }
+
+            if (col_num >= 0) {
+                table_set_value(tbl, c + 1, r, nbm_data_row_values(nbm, r)[col_num]);
+            }
+        }
+    }
+
+    return tbl;
+}
+
+/** Load a fixture and build everything the benchmarks need from it. */
+static bool
+fixture_load(char const *path, struct Fixture *fx)
+{
+    FILE *f = fopen(path, "rb");
+    Stopif(!f, return false, "Unable to open %s", path);
+
+    fseek(f, 0, SEEK_END);
+    long size = ftell(f);
+    rewind(f);
+
+    char *text = calloc(size + 1, 1);
+    Stopif(!text, exit(EXIT_FAILURE), "out of memory");
+    size_t num_read = fread(text, 1, size, f);
+    fclose(f);
+    Stopif(num_read != size, free(text); return false, "Unable to read %s", path);
+
+    // The site id is the file name without the extension.
+    char const *base = strrchr(path, '/');
+    base = base ? base + 1 : path;
+    char *site = strndup(base, strcspn(base, "."));
+    char *name = strdup(site);
+
+    fx->raw = raw_nbm_data_new(0, site, name, text, size);
+    fx->nbm = parse_raw_nbm_data(fx->raw);
+    fx->arena = arena_new();
+    fx->cdfs = extract_precip_cdfs(fx->arena, fx->nbm);
+    Stopif(!fx->cdfs, return false, "No precipitation CDFs in %s", path);
+    fx->pdfs = create_pdfs_from_cdfs(fx->arena, fx->cdfs);
+
+    fx->pdf_widths = calloc(time_series_len(fx->pdfs), sizeof(double));
+    Stopif(!fx->pdf_widths, exit(EXIT_FAILURE), "out of memory");
+    for (size_t i = 0; i < time_series_len(fx->pdfs); i++) {
+        ProbabilityDistribution const *pdf = time_series_value(fx->pdfs, i);
+        size_t const len = probability_dist_packed_len(pdf);
+        double *packed = calloc(len, sizeof(double));
+        Stopif(!packed, exit(EXIT_FAILURE), "out of memory");
+
+        probability_dist_pack(pdf, len, packed);
+        fx->pdf_widths[i] = packed[len - 2] - packed[0];
+        free(packed);
+    }
+
+    fx->table = build_table(fx->nbm);
+    fx->null_out = fopen("/dev/null", "w");
+    Stopif(!fx->null_out, return false, "Unable to open /dev/null");
+
+    return true;
+}
+
+static void
+fixture_free(struct Fixture *fx)
+{
+    if (fx->null_out) {
+        fclose(fx->null_out);
+    }
+    table_free(&fx->table);
+    free(fx->pdf_widths);
+    time_series_free(&fx->pdfs);
+    time_series_free(&fx->cdfs);
+    arena_free(&fx->arena);
+    nbm_data_free(&fx->nbm);
+    raw_nbm_data_free(&fx->raw);
+}
+
+/*-------------------------------------------------------------------------------------------------
+ *                                        Accuracy Checks
+ *-----------------------------------------------------------------------------------------------*/
+/** How far a smoothed density may be from the reference, as a fraction of the peak density. */
+#define SMOOTH_CHECK_TOLERANCE 1.0e-9
+
+/** The smallest and largest smoothing radii checked, as fractions of the width of the PDF. */
+#define SMOOTH_CHECK_MIN_RADIUS 0.005
+#define SMOOTH_CHECK_MAX_RADIUS 10.0
+
+/** Smooth a packed PDF the slow way, with every pair of points, then normalize it.
+ *
+ * This is the kernel probability_dist_smooth() started out as. It is kept here to check the
+ * faster versions against.
+ *
+ * \param num_pnts is the number of bins in the packed PDF.
+ * \param packed is from probability_dist_pack().
+ * \param smooth_radius is the scale of the Gaussian kernel.
+ * \param smoothed is where to put the smoothed density of each bin.
+ */
+static void
+reference_smooth(size_t num_pnts, double const packed[static 1 + 2 * num_pnts],
+                 double smooth_radius, double smoothed[num_pnts])
+{
+    double total_area = 0.0;
+    for (size_t i = 0; i < num_pnts; i++) {
+        double const min_i = i == 0 ? packed[0] : packed[2 * i - 1];
+        double const center_i = (min_i + packed[2 * i + 1]) / 2.0;
+
+        double numerator = 0.0;
+        double denom = 0.0;
+        for (size_t j = 0; j < num_pnts; j++) {
+            double const min_j = j == 0 ? packed[0] : packed[2 * j - 1];
+            double const center_j = (min_j + packed[2 * j + 1]) / 2.0;
+
+            double dist = center_i - center_j;
+            double k = exp(-(dist * dist) / (2.0 * smooth_radius * smooth_radius));
+            numerator += packed[2 * j + 2] * k;
+            denom += k;
+        }
+
+        smoothed[i] = denom > 0.0 ? numerator / denom : 0.0;
+        total_area += (packed[2 * i + 1] - min_i) * smoothed[i];
+    }
+
+    for (size_t i = 0; i < num_pnts; i++) {
+        smoothed[i] /= total_area;
+    }
+}
+
+/** Compare probability_dist_smooth() to the reference kernel for every PDF of a fixture.
+ *
+ * The radii go from a small fraction of the width of each PDF, where only a few neighbors count,
+ * to many times its width, where the whole PDF is averaged. That covers every path through the
+ * smoother. The result is written as a JSON line like the benchmarks.
+ *
+ * \returns \c true if every density was within \ref SMOOTH_CHECK_TOLERANCE.
+ */
+static bool
+check_smoothing(char const *fixture, struct Fixture *fx)
+{
+    double max_error = 0.0;
+    size_t num_checked = 0;
+
+    Arena *arena = arena_new();
+    for (size_t p = 0; p < time_series_len(fx->pdfs); p++) {
+        ProbabilityDistribution const *pdf = time_series_value(fx->pdfs, p);
+
+        size_t const len = probability_dist_packed_len(pdf);
+        size_t const num_pnts = (len - 1) / 2;
+        double *packed = calloc(len, sizeof(double));
+        double *smoothed = calloc(len, sizeof(double));
+        double *reference = calloc(num_pnts, sizeof(double));
+        Stopif(!packed || !smoothed || !reference, exit(EXIT_FAILURE), "out of memory");
+
+        probability_dist_pack(pdf, len, packed);
+        double const width = packed[len - 2] - packed[0];
+
+        for (double frac = SMOOTH_CHECK_MIN_RADIUS; width > 0.0 && frac <= SMOOTH_CHECK_MAX_RADIUS;
+             frac *= 1.25) {
+            double const radius = frac * width;
+
+            reference_smooth(num_pnts, packed, radius, reference);
+            probability_dist_pack(probability_dist_smooth(arena, pdf, radius), len, smoothed);
+
+            double peak = 0.0;
+            double error = 0.0;
+            for (size_t i = 0; i < num_pnts; i++) {
+                peak = fmax(peak, reference[i]);
+                error = fmax(error, fabs(smoothed[2 * i + 2] - reference[i]));
+            }
+
+            max_error = fmax(max_error, error / peak);
+            num_checked++;
+        }
+
+        free(reference);
+        free(smoothed);
+        free(packed);
+    }
+    arena_free(&arena);
+
+    bool const ok = max_error <= SMOOTH_CHECK_TOLERANCE;
+    printf("{\"check\":\"probability_dist_smooth\",\"fixture\":\"%s\",\"smooths\":%zu,"
+           "\"max_error\":%.3g,\"tolerance\":%.3g,\"ok\":%s}\n",
+           fixture, num_checked, max_error, SMOOTH_CHECK_TOLERANCE, ok ? "true" : "false");
+    fflush(stdout);
+
+    return ok;
+}
+
+int
+main(int argc, char *argv[argc + 1])
+{
+    // With --check, only the accuracy checks are run.
+    bool const check_only = argc > 1 && strcmp(argv[1], "--check") == 0;
+    int const first_fixture = check_only ? 2 : 1;
+    Stopif(argc <= first_fixture, return EXIT_FAILURE, "usage: %s [--check] FIXTURE.csv...",
+           argv[0]);
+
+    alloc_stats_start();
+
+    for (int i = first_fixture; i < argc; i++) {
+        struct Fixture fx = {0};
+        bool loaded = fixture_load(argv[i], &fx);
+        Stopif(!loaded, fixture_free(&fx); return EXIT_FAILURE, "Error loading %s", argv[i]);
+
+        char const *fixture = strrchr(argv[i], '/') ? strrchr(argv[i], '/') + 1 : argv[i];
+
+        bool const accurate = check_smoothing(fixture, &fx);
+        Stopif(!accurate, fixture_free(&fx); return EXIT_FAILURE,
+               "probability_dist_smooth() doesn't match the reference for %s", fixture);
+        if (check_only) {
+            fixture_free(&fx);
+            continue;
+        }
+
+        // clang-format off
+        run_benchmark("parse_raw_nbm_data",              fixture, "bytes", bench_parse,            &fx);
+        run_benchmark("nbm_data_rows",                   fixture, "rows",  bench_rows,             &fx);
+        run_benchmark("extract_cdfs",                    fixture, "cdfs",  bench_extract_cdfs,     &fx);
+        run_benchmark("cumulative_dist_percentile_value", fixture, "calls", bench_percentile_value, &fx);
+        run_benchmark("probability_dist_calc",           fixture, "pdfs",  bench_pdf_calc,         &fx);
+        run_smooth_benchmarks(fixture, &fx);
+        run_benchmark("find_scenarios",                  fixture, "pdfs",  bench_find_scenarios,   &fx);
+        run_benchmark("table_display",                   fixture, "rows",  bench_table_display,    &fx);
+        // clang-format on
+
+        fixture_free(&fx);
+    }
+
+    return EXIT_SUCCESS;
+}
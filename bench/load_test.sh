@@ -0,0 +1,130 @@
+#!/bin/sh
+#
+# End to end load test of nbm against the mock archive server.
+#
+# Usage: bench/load_test.sh [mock-archive options]
+#
+#   e.g. bench/load_test.sh --latency-ms=50 --bandwidth-kbps=2000 --not-found-rate=0.05
+#
+# Writes a synthetic archive with build/nbm-synth, serves it with build/mock-archive using the
+# given options, and times these runs of build/nbm against it:
+#
+#   single_cold     one report with an empty download cache,
+#   single_warm     the same report again, from the cache,
+#   reports_cold    a report for every site, JOBS at a time, with an empty cache,
+#   reports_warm    the same reports again,
+#   prefetch_cold   --prefetch --once of every site with an empty cache, which uses concurrent
+#                   downloads,
+#   prefetch_warm   the same again.
+#
+# Each run is written to stdout as a JSON line, followed by the server's counts. These environment
+# variables change the defaults:
+#
+#   SITES=20  JOBS=4  HOURS=264  REQUEST_TIME=(today)-14  NBM_ARGS="-t -r -a 24"
+#   BUILD=build  WORK=(a new temporary directory, removed when done unless KEEP=1)
+#
+# Run `make all synth mock-archive` first, or use `make load-test LOAD_ARGS="..."`.
+
+set -eu
+
+BUILD=${BUILD:-build}
+SITES=${SITES:-20}
+JOBS=${JOBS:-4}
+HOURS=${HOURS:-264}
+REQUEST_TIME=${REQUEST_TIME:-$(date -u +%Y-%m-%d)-14}
+NBM_ARGS=${NBM_ARGS:--t -r -a 24}
+
+NBM=$BUILD/nbm
+SYNTH=$BUILD/nbm-synth
+MOCK=$BUILD/mock-archive
+
+for prog in "$NBM" "$SYNTH" "$MOCK"; do
+    if [ ! -x "$prog" ]; then
+        echo "Missing $prog, run: make all synth mock-archive" >&2
+        exit 1
+    fi
+done
+
+WORK=${WORK:-$(mktemp -d "${TMPDIR:-/tmp}/nbm-load.XXXXXX")}
+SERVER_PID=
+
+clean_up() {
+    if [ -n "$SERVER_PID" ]; then
+        kill "$SERVER_PID" 2>/dev/null || true
+        wait "$SERVER_PID" 2>/dev/null || true
+    fi
+    if [ "${KEEP:-0}" != 1 ]; then
+        rm -rf "$WORK"
+    fi
+}
+trap clean_up EXIT INT TERM
+
+# The synthetic archive and a watch list with all of its sites.
+"$SYNTH" --sites="$SITES" --hours="$HOURS" --init-time="${REQUEST_TIME%-*}-13" \
+    "$WORK/archive" >/dev/null
+i=1
+: >"$WORK/watchlist"
+while [ "$i" -le "$SITES" ]; do
+    printf 'S%05d\n' "$i" >>"$WORK/watchlist"
+    i=$((i + 1))
+done
+
+# Start the server and wait for it to print its URL.
+"$MOCK" "$@" "$WORK/archive" >"$WORK/server.out" 2>"$WORK/server.err" &
+SERVER_PID=$!
+tries=0
+while [ ! -s "$WORK/server.out" ]; do
+    tries=$((tries + 1))
+    if [ "$tries" -gt 100 ] || ! kill -0 "$SERVER_PID" 2>/dev/null; then
+        echo "The mock archive server didn't start:" >&2
+        cat "$WORK/server.err" >&2
+        exit 1
+    fi
+    sleep 0.1
+done
+URL=$(head -n 1 "$WORK/server.out")
+
+now() {
+    date +%s.%N
+}
+
+# Time a command and write a JSON line with how long it took and its exit status.
+run() {
+    name=$1
+    shift
+    start=$(now)
+    status=0
+    "$@" >"$WORK/$name.out" 2>&1 || status=$?
+    end=$(now)
+    printf '{"run":"%s","sites":%d,"jobs":%d,"seconds":%.3f,"exit":%d}\n' \
+        "$name" "$SITES" "$JOBS" "$(awk "BEGIN { print $end - $start }")" "$status"
+}
+
+# Every run gets its own home directory so it has its own download cache.
+report() {
+    HOME=$WORK/$1 "$NBM" "$2" --mirror-url="$URL" --request-time="$REQUEST_TIME" $NBM_ARGS
+}
+
+reports() {
+    HOME=$WORK/$1 xargs -P "$JOBS" -I SITE "$NBM" SITE --mirror-url="$URL" \
+        --request-time="$REQUEST_TIME" $NBM_ARGS <"$WORK/watchlist"
+}
+
+prefetch() {
+    HOME=$WORK/$1 "$NBM" --prefetch="$WORK/watchlist" --once --mirror-url="$URL" \
+        --request-time="$REQUEST_TIME"
+}
+
+mkdir -p "$WORK/home_single" "$WORK/home_reports" "$WORK/home_prefetch"
+
+run single_cold report home_single S00001
+run single_warm report home_single S00001
+run reports_cold reports home_reports
+run reports_warm reports home_reports
+run prefetch_cold prefetch home_prefetch
+run prefetch_warm prefetch home_prefetch
+
+kill "$SERVER_PID"
+wait "$SERVER_PID" || true
+SERVER_PID=
+cat "$WORK/server.err"
@@ -0,0 +1,468 @@
+/** A local HTTP server with the layout of the NBM archive, for end to end load tests.
+ *
+ * It serves the files in a directory, like one written by nbm-synth, so nbm can be pointed at it
+ * with --mirror-url. Slow or unreliable archives are imitated with these options:
+ *
+ *   --latency-ms      wait before answering each request,
+ *   --bandwidth-kbps  limit how fast each response body is sent,
+ *   --not-found-rate  answer this fraction of the files with a 404 as if not posted yet,
+ *   --stall-rate      pause this fraction of the responses halfway through the body,
+ *   --stall-ms        for this long.
+ *
+ * Which files get a 404 or a stall depends only on the path and --seed, not on the order of the
+ * requests, so a run can be repeated exactly.
+ *
+ * The server prints its URL on stdout once it is listening, and a JSON line with the counts of
+ * requests and bytes sent on stderr when it gets SIGINT or SIGTERM. See bench/load_test.sh.
+ *
+ * Build with `make mock-archive`.
+ */
+#include <errno.h>
+#include <netinet/in.h>
+#include <poll.h>
+#include <signal.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <glib.h>
+
+#include "utils.h"
+
+/** The largest request header that is accepted. */
+#define MAX_REQUEST_BYTES 8192
+
+/** Close connections that have been idle this long. */
+#define IDLE_TIMEOUT_MS 30000
+
+/** The most connections handled at the same time. */
+#define MAX_CONNECTIONS 64
+
+/*-------------------------------------------------------------------------------------------------
+ *                                      Configuration
+ *-----------------------------------------------------------------------------------------------*/
+static int port = 0;
+static int latency_ms = 0;
+static int bandwidth_kbps = 0;
+static double not_found_rate = 0.0;
+static double stall_rate = 0.0;
+static int stall_ms = 5000;
+static gint64 seed = 1;
+static gboolean verbose = false;
+
+static char const *root = 0;
+
+static GOptionEntry entries[] = {
+    {"port", 'p', 0, G_OPTION_ARG_INT, &port, "Port to listen on, default 0 picks a free one.",
+     "PORT"},
+    {"latency-ms", 'l', 0, G_OPTION_ARG_INT, &latency_ms, "Delay before each response.", "MS"},
+    {"bandwidth-kbps", 'b', 0, G_OPTION_ARG_INT, &bandwidth_kbps,
+     "Limit each response body to this many kilobytes per second, default no limit.", "KBPS"},
+    {"not-found-rate", 'n', 0, G_OPTION_ARG_DOUBLE, &not_found_rate,
+     "Fraction of the files to answer with 404 Not Found.", "RATE"},
+    {"stall-rate", 's', 0, G_OPTION_ARG_DOUBLE, &stall_rate,
+     "Fraction of the responses to pause halfway through.", "RATE"},
+    {"stall-ms", 0, 0, G_OPTION_ARG_INT, &stall_ms, "How long a stall lasts, default 5000.", "MS"},
+    {"seed", 0, 0, G_OPTION_ARG_INT64, &seed, "Seed for choosing the 404s and stalls.", "SEED"},
+    {"verbose", 'v', 0, G_OPTION_ARG_NONE, &verbose, "Log every request to stdout.", 0},
+    {0},
+};
+
+/*-------------------------------------------------------------------------------------------------
+ *                                         Statistics
+ *-----------------------------------------------------------------------------------------------*/
+static struct {
+    atomic_size_t requests;
+    atomic_size_t ok;
+    atomic_size_t not_found;
+    atomic_size_t injected_not_found;
+    atomic_size_t stalls;
+    atomic_size_t bytes;
+    atomic_size_t connections;
+} stats = {0};
+
+/*-------------------------------------------------------------------------------------------------
+ *                                          Helpers
+ *-----------------------------------------------------------------------------------------------*/
+static int64_t
+now_ns(void)
+{
+    struct timespec ts = {0};
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+static void
+sleep_ns(int64_t ns)
+{
+    if (ns <= 0) {
+        return;
+    }
+
+    struct timespec ts = {.tv_sec = ns / 1000000000, .tv_nsec = ns % 1000000000};
+    while (nanosleep(&ts, &ts) != 0 && errno == EINTR) {
+    }
+}
+
+/** A number in [0, 1) that depends only on the path, the seed, and which decision it is for. */
+static double
+path_fate(char const *path, uint64_t salt)
+{
+    uint64_t hash = 0xcbf29ce484222325; // FNV-1a
+    for (char const *c = path; *c; c++) {
+        hash = (hash ^ (unsigned char)*c) * 0x100000001b3;
+    }
+
+    // Mix in the seed with the splitmix64 finalizer so nearby seeds give unrelated results.
+    uint64_t z = hash ^ ((uint64_t)seed * 0x9E3779B97F4A7C15 + salt);
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EB;
+    z ^= z >> 31;
+
+    return (z >> 11) * 0x1.0p-53;
+}
+
+static bool
+write_all(int fd, size_t num_bytes, char const data[num_bytes])
+{
+    while (num_bytes > 0) {
+        ssize_t num_written = send(fd, data, num_bytes, MSG_NOSIGNAL);
+        if (num_written < 0 && errno == EINTR) {
+            continue;
+        }
+        if (num_written < 0) {
+            return false; // The client went away, that's its business.
+        }
+
+        data += num_written;
+        num_bytes -= num_written;
+    }
+
+    return true;
+}
+
+/** Send a response body, at the limited bandwidth and with a stall halfway through if asked. */
+static bool
+send_body(int fd, size_t num_bytes, char const data[num_bytes], bool stall)
+{
+    size_t const chunk = bandwidth_kbps > 0 ? bandwidth_kbps * 1024 / 20 + 1 : num_bytes;
+    size_t const stall_at = num_bytes / 2;
+    int64_t const start = now_ns();
+
+    size_t sent = 0;
+    while (sent < num_bytes) {
+        size_t n = num_bytes - sent < chunk ? num_bytes - sent : chunk;
+        if (stall && sent <= stall_at && sent + n > stall_at) {
+            n = stall_at - sent;
+            if (n == 0) {
+                sleep_ns((int64_t)stall_ms * 1000000);
+                stall = false;
+                continue;
+            }
+        }
+
+        if (!write_all(fd, n, data + sent)) {
+            return false;
+        }
+        sent += n;
+        atomic_fetch_add(&stats.bytes, n);
+
+        if (bandwidth_kbps > 0) {
+            // Sleep until the time this many bytes should have taken.
+            int64_t due = start + (int64_t)(sent * 1.0e9 / (bandwidth_kbps * 1024.0));
+            sleep_ns(due - now_ns());
+        }
+    }
+
+    return true;
+}
+
+/** Decode %XX escapes in place. */
+static void
+url_decode(char *str)
+{
+    char *out = str;
+    for (char *c = str; *c; c++) {
+        unsigned int value = 0;
+        if (c[0] == '%' && c[1] && c[2] && sscanf(c + 1, "%2x", &value) == 1) {
+            *out++ = (char)value;
+            c += 2;
+        } else {
+            *out++ = *c;
+        }
+    }
+    *out = '\0';
+}
+
+/** Read a whole file into memory.
+ *
+ * \returns \c NULL if it doesn't exist or isn't a regular file.
+ */
+static char *
+read_file(char const *path, size_t *size)
+{
+    struct stat st = {0};
+    if (stat(path, &st) != 0 || !S_ISREG(st.st_mode)) {
+        return 0;
+    }
+
+    FILE *f = fopen(path, "rb");
+    if (!f) {
+        return 0;
+    }
+
+    char *data = malloc(st.st_size + 1);
+    Stopif(!data, exit(EXIT_FAILURE), "out of memory");
+    *size = fread(data, 1, st.st_size, f);
+    fclose(f);
+
+    return data;
+}
+
+/*-------------------------------------------------------------------------------------------------
+ *                                     Handling Requests
+ *-----------------------------------------------------------------------------------------------*/
+/** Read the header of the next request on a connection, the body (if any) is ignored.
+ *
+ * \returns the length of the header, or 0 if the connection was closed, timed out, or the
+ * request was too large.
+ */
+static size_t
+read_request(int fd, char buf[MAX_REQUEST_BYTES])
+{
+    size_t len = 0;
+    while (len < MAX_REQUEST_BYTES - 1) {
+        struct pollfd pfd = {.fd = fd, .events = POLLIN};
+        if (poll(&pfd, 1, IDLE_TIMEOUT_MS) <= 0) {
+            return 0;
+        }
+
+        ssize_t num_read = recv(fd, buf + len, MAX_REQUEST_BYTES - 1 - len, 0);
+        if (num_read < 0 && errno == EINTR) {
+            continue;
+        }
+        if (num_read <= 0) {
+            return 0;
+        }
+
+        len += num_read;
+        buf[len] = '\0';
+        if (strstr(buf, "\r\n\r\n")) {
+            return len;
+        }
+    }
+
+    return 0;
+}
+
+/** Answer one request.
+ *
+ * \returns \c true if the connection should be kept open for another.
+ */
+static bool
+answer_request(int fd, char *request)
+{
+    int64_t const start = now_ns();
+
+    char method[16] = {0};
+    char target[1024] = {0};
+    char version[16] = {0};
+    if (sscanf(request, "%15s %1023s %15s", method, target, version) != 3) {
+        char const bad[] = "HTTP/1.1 400 Bad Request\r\nContent-Length: 0\r\n"
+                           "Connection: close\r\n\r\n";
+        write_all(fd, sizeof(bad) - 1, bad);
+        return false;
+    }
+
+    atomic_fetch_add(&stats.requests, 1);
+
+    bool keep_alive = strcmp(version, "HTTP/1.1") == 0;
+    for (char *line = strstr(request, "\r\n"); line; line = strstr(line + 2, "\r\n")) {
+        if (strncasecmp(line + 2, "Connection:", 11) == 0) {
+            keep_alive = strncasecmp(line + 13 + strspn(line + 13, " "), "close", 5) != 0;
+        }
+    }
+
+    char *query = strchr(target, '?');
+    if (query) {
+        *query = '\0';
+    }
+    url_decode(target);
+
+    sleep_ns((int64_t)latency_ms * 1000000);
+
+    int status = 404;
+    size_t size = 0;
+    char *body = 0;
+    bool const injected_404 = path_fate(target, 0) < not_found_rate;
+    bool const stall = path_fate(target, 1) < stall_rate;
+
+    if (strcmp(method, "GET") != 0 && strcmp(method, "HEAD") != 0) {
+        status = 405;
+    } else if (injected_404) {
+        atomic_fetch_add(&stats.injected_not_found, 1);
+    } else if (target[0] == '/' && !strstr(target, "..")) {
+        char path[2048] = {0};
+        snprintf(path, sizeof(path), "%s%s", root, target);
+        body = read_file(path, &size);
+        status = body ? 200 : 404;
+    }
+
+    char header[256] = {0};
+    char const *reason = status == 200 ? "OK" : status == 404 ? "Not Found" : "Method Not Allowed";
+    int header_len = snprintf(header, sizeof(header),
+                              "HTTP/1.1 %d %s\r\nContent-Length: %zu\r\nContent-Type: text/plain"
+                              "\r\nConnection: %s\r\n\r\n",
+                              status, reason, status == 200 ? size : 0,
+                              keep_alive ? "keep-alive" : "close");
+
+    bool ok = write_all(fd, header_len, header);
+    if (ok && status == 200 && strcmp(method, "GET") == 0) {
+        if (stall) {
+            atomic_fetch_add(&stats.stalls, 1);
+        }
+        ok = send_body(fd, size, body, stall);
+    }
+    free(body);
+
+    atomic_fetch_add(status == 200 ? &stats.ok : &stats.not_found, 1);
+
+    if (verbose) {
+        printf("%s %s %d %zu %.1lf ms%s%s\n", method, target, status, status == 200 ? size : 0,
+               (now_ns() - start) / 1.0e6, injected_404 ? " injected" : "",
+               stall && status == 200 ? " stalled" : "");
+        fflush(stdout);
+    }
+
+    return ok && keep_alive;
+}
+
+/** Thread pool function to handle all the requests on a connection.
+ *
+ * \param data is the connected socket plus one, because the pool doesn't take \c NULL tasks.
+ */
+static void
+handle_connection(void *data, void *unused)
+{
+    int fd = GPOINTER_TO_INT(data) - 1;
+    char request[MAX_REQUEST_BYTES] = {0};
+
+    atomic_fetch_add(&stats.connections, 1);
+
+    while (read_request(fd, request) > 0 && answer_request(fd, request)) {
+    }
+
+    close(fd);
+}
+
+/*-------------------------------------------------------------------------------------------------
+ *                                          Program
+ *-----------------------------------------------------------------------------------------------*/
+/** Set when it is time to shut down. */
+static volatile sig_atomic_t stop_requested = 0;
+
+static void
+handle_stop_signal(int signum)
+{
+    stop_requested = 1;
+}
+
+int
+main(int argc, char *argv[argc + 1])
+{
+    int result = EXIT_FAILURE;
+    int listen_fd = -1;
+    GThreadPool *pool = 0;
+
+    GOptionContext *context = g_option_context_new("ARCHIVE_DIR - serve a mock NBM archive");
+    GOptionGroup *group = g_option_group_new("mock", "Mock archive options", "", 0, 0);
+    g_option_group_add_entries(group, entries);
+    g_option_context_set_main_group(context, group);
+
+    GError *err = 0;
+    bool parsed = g_option_context_parse(context, &argc, &argv, &err);
+    Stopif(!parsed, goto EXIT, "%s", err->message);
+    Stopif(argc != 2, goto EXIT, "Exactly one archive directory is required, see --help");
+    root = argv[1];
+
+    listen_fd = socket(AF_INET, SOCK_STREAM, 0);
+    Stopif(listen_fd < 0, goto EXIT, "Unable to create socket: %s", strerror(errno));
+
+    int reuse = 1;
+    setsockopt(listen_fd, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse));
+
+    struct sockaddr_in addr = {.sin_family = AF_INET,
+                               .sin_port = htons(port),
+                               .sin_addr.s_addr = htonl(INADDR_LOOPBACK)};
+    int res = bind(listen_fd, (struct sockaddr *)&addr, sizeof(addr));
+    Stopif(res != 0, goto EXIT, "Unable to bind port %d: %s", port, strerror(errno));
+
+    res = listen(listen_fd, SOMAXCONN);
+    Stopif(res != 0, goto EXIT, "Unable to listen: %s", strerror(errno));
+
+    socklen_t addr_len = sizeof(addr);
+    getsockname(listen_fd, (struct sockaddr *)&addr, &addr_len);
+
+    pool = g_thread_pool_new(handle_connection, 0, MAX_CONNECTIONS, false, 0);
+    Stopif(!pool, goto EXIT, "Unable to create thread pool.");
+
+    struct sigaction action = {.sa_handler = handle_stop_signal};
+    sigemptyset(&action.sa_mask);
+    sigaction(SIGINT, &action, 0);
+    sigaction(SIGTERM, &action, 0);
+
+    printf("http://127.0.0.1:%d/\n", ntohs(addr.sin_port));
+    fflush(stdout);
+
+    while (!stop_requested) {
+        // Wake up now and then to check if it's time to stop.
+        struct pollfd pfd = {.fd = listen_fd, .events = POLLIN};
+        if (poll(&pfd, 1, 250) <= 0) {
+            continue;
+        }
+
+        int fd = accept(listen_fd, 0, 0);
+        if (fd < 0) {
+            Stopif(errno != EINTR && errno != ECONNABORTED, break, "Error accepting connection: %s",
+                   strerror(errno));
+            continue;
+        }
+
+        g_thread_pool_push(pool, GINT_TO_POINTER(fd + 1), 0);
+    }
+
+    // Don't wait for idle keep alive connections to time out.
+    g_thread_pool_free(pool, true, false);
+    pool = 0;
+
+    fprintf(stderr,
+            "{\"connections\":%zu,\"requests\":%zu,\"ok\":%zu,\"not_found\":%zu,"
+            "\"injected_not_found\":%zu,\"stalls\":%zu,\"bytes\":%zu}\n",
+            atomic_load(&stats.connections), atomic_load(&stats.requests), atomic_load(&stats.ok),
+            atomic_load(&stats.not_found), atomic_load(&stats.injected_not_found),
+            atomic_load(&stats.stalls), atomic_load(&stats.bytes));
+
+    result = EXIT_SUCCESS;
+
+EXIT:
+    if (pool) {
+        g_thread_pool_free(pool, true, false);
+    }
+    if (listen_fd >= 0) {
+        close(listen_fd);
+    }
+    if (err) {
+        g_error_free(err);
+    }
+    g_option_context_free(context);
+
+    return result;
+}
@@ -0,0 +1,597 @@
+/** Generate a synthetic NBM archive for load and scaling tests.
+ *
+ * Writes a locations.csv and one site file for each of N sites, laid out like the online archive
+ * under an output directory, so it can be used with --archive-dir. The site files have every
+ * column the summaries use, named exactly as in the real files, with values every 1, 3, or 6 hours
+ * like the real thing and 9.999e+20 where a column has no value at a valid time.
+ *
+ * The distributions are mixtures of logistic distributions, so they have the multiple modes that
+ * make finding scenarios interesting. The percentiles and the probabilities of exceedence are
+ * computed from the same mixture, so they agree with each other. Everything comes from a seeded
+ * random number generator, so the same options always give the same files.
+ *
+ * Build with `make synth` and see `build/nbm-synth --help`.
+ */
+#include <assert.h>
+#include <errno.h>
+#include <math.h>
+#include <stdarg.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <time.h>
+
+#include <glib.h>
+
+#include "data_source.h"
+#include "utils.h"
+
+#define HOURSEC (60 * 60)
+
+/*-------------------------------------------------------------------------------------------------
+ *                                     Random Numbers
+ *-----------------------------------------------------------------------------------------------*/
+/** A splitmix64 generator, it is fast, small, and gives the same numbers on every platform. */
+typedef struct Rng {
+    uint64_t state;
+} Rng;
+
+static uint64_t
+rng_next(Rng *rng)
+{
+    uint64_t z = (rng->state += 0x9E3779B97F4A7C15);
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EB;
+    return z ^ (z >> 31);
+}
+
+/** A number in [0, 1). */
+static double
+rng_uniform(Rng *rng)
+{
+    return (rng_next(rng) >> 11) * 0x1.0p-53;
+}
+
+/** A number in [lo, hi). */
+static double
+rng_range(Rng *rng, double lo, double hi)
+{
+    return lo + (hi - lo) * rng_uniform(rng);
+}
+
+/*-------------------------------------------------------------------------------------------------
+ *                                     Mixture Distributions
+ *-----------------------------------------------------------------------------------------------*/
+#define MAX_COMPONENTS 3
+
+/** A weighted sum of logistic distributions, the weights must add up to 1. */
+struct Mixture {
+    int num;
+    double weight[MAX_COMPONENTS];
+    double mean[MAX_COMPONENTS];
+    double scale[MAX_COMPONENTS];
+};
+
+static double
+mixture_cdf(struct Mixture const *mix, double x)
+{
+    double cdf = 0.0;
+    for (int i = 0; i < mix->num; i++) {
+        cdf += mix->weight[i] / (1.0 + exp(-(x - mix->mean[i]) / mix->scale[i]));
+    }
+
+    return cdf;
+}
+
+/** Find the value at a probability in [0, 1] by bisection, the CDF has no closed form inverse. */
+static double
+mixture_quantile(struct Mixture const *mix, double prob)
+{
+    double lo = HUGE_VAL;
+    double hi = -HUGE_VAL;
+    for (int i = 0; i < mix->num; i++) {
+        lo = fmin(lo, mix->mean[i] - 20.0 * mix->scale[i]);
+        hi = fmax(hi, mix->mean[i] + 20.0 * mix->scale[i]);
+    }
+
+    for (int i = 0; i < 48; i++) {
+        double mid = 0.5 * (lo + hi);
+        if (mixture_cdf(mix, mid) < prob) {
+            lo = mid;
+        } else {
+            hi = mid;
+        }
+    }
+
+    return 0.5 * (lo + hi);
+}
+
+/*-------------------------------------------------------------------------------------------------
+ *                                      Writing Columns
+ *-----------------------------------------------------------------------------------------------*/
+/** The value written for missing data in the NBM files. */
+#define MISSING_TEXT "9.999e+20"
+
+/** Writes a header or a row of a site file.
+ *
+ * The header and the rows are written by the same code, so they can't get out of step. In
+ * header mode the column names are written and the values are ignored.
+ */
+struct Writer {
+    FILE *out;
+    bool header;
+};
+
+static void column(struct Writer *w, double value, char const *name_format, ...)
+    __attribute__((format(printf, 3, 4)));
+
+/** Write a column name or a value, a \c NAN value is written as missing. */
+static void
+column(struct Writer *w, double value, char const *name_format, ...)
+{
+    fputc(',', w->out);
+
+    if (w->header) {
+        va_list args;
+        va_start(args, name_format);
+        vfprintf(w->out, name_format, args);
+        va_end(args);
+    } else if (isnan(value)) {
+        fputs(MISSING_TEXT, w->out);
+    } else {
+        fprintf(w->out, "%.4f", value);
+    }
+}
+
+/*-------------------------------------------------------------------------------------------------
+ *                                     The Synthetic Weather
+ *-----------------------------------------------------------------------------------------------*/
+/** The percentiles in the real files. */
+static int const standard_percentiles[] = {1,  5,  10, 15, 20, 25, 30, 35, 40, 45, 50,
+                                           55, 60, 65, 70, 75, 80, 85, 90, 95, 99};
+#define NUM_STANDARD_PERCENTILES (sizeof(standard_percentiles) / sizeof(standard_percentiles[0]))
+
+/** The accumulation periods of the precipitation, snow, and ice columns. */
+static int const accum_hours[] = {6, 12, 24, 48, 72};
+#define NUM_ACCUM_HOURS (sizeof(accum_hours) / sizeof(accum_hours[0]))
+
+/** An accumulated element and the thresholds of its probability of exceedence columns. */
+struct AccumElement {
+    char const *name;
+    double units_per_mm; // Convert mm of liquid to the units of the element.
+    int num_thresholds;
+    char const *thresholds[10];
+};
+
+// clang-format off
+static struct AccumElement const accum_elements[] = {
+    {.name = "APCP", .units_per_mm = 1.0, .num_thresholds = 10,
+     .thresholds = {"0.254", "2.54", "6.35", "12.7", "25.4", "50.8", "101.6", "76.2", "127",
+                    "152.4"}},
+    {.name = "ASNOW", .units_per_mm = 0.01, .num_thresholds = 10,
+     .thresholds = {"0.00254", "0.0254", "0.0508", "0.1016", "0.1524", "0.2032", "0.3048",
+                    "0.4572", "0.6096", "0.762"}},
+    {.name = "FICEAC", .units_per_mm = 0.3, .num_thresholds = 5,
+     .thresholds = {"0.254", "2.54", "6.35", "12.7", "25.4"}},
+};
+// clang-format on
+#define NUM_ACCUM_ELEMENTS (sizeof(accum_elements) / sizeof(accum_elements[0]))
+
+static char const *const wind_thresholds[] = {"5", "8", "11", "17", "24", "32"};
+static char const *const gust_thresholds[] = {"11", "17", "21", "24", "28", "32"};
+#define NUM_WIND_THRESHOLDS 6
+
+/** A site and the slowly changing weather at it. */
+struct Site {
+    char id[16];
+    double lat;
+    double lon;
+    Rng rng;
+
+    double temp_k;   // Daily mean temperature.
+    double wetness;  // Chance of precipitation, 0 to 1.
+    double storm_mm; // Typical 24 hour precipitation when it is wet.
+    double wind_ms;  // Typical wind speed.
+};
+
+struct Generator {
+    int const *percentiles;
+    int num_percentiles;
+};
+
+/** Write the percentile, deterministic, and exceedence columns of one distribution.
+ *
+ * \param name is the column name up to the percentile or probability part.
+ * \param mix is the distribution, or \c NULL if there is no value at this time.
+ * \param floor is the smallest possible value, use \c -HUGE_VAL for none.
+ */
+static void
+distribution_columns(struct Writer *w, struct Generator const *gen, char const *name,
+                     struct Mixture const *mix, double floor, int num_thresholds,
+                     char const *const thresholds[])
+{
+    for (int i = 0; i < gen->num_percentiles; i++) {
+        double value = mix ? fmax(floor, mixture_quantile(mix, gen->percentiles[i] / 100.0)) : NAN;
+        column(w, value, "%s_%d%% level", name, gen->percentiles[i]);
+    }
+
+    column(w, mix ? fmax(floor, mixture_quantile(mix, 0.5)) : NAN, "%s", name);
+
+    for (int i = 0; i < num_thresholds; i++) {
+        double value = mix ? 100.0 * (1.0 - mixture_cdf(mix, strtod(thresholds[i], 0))) : NAN;
+        column(w, value, "%s_prob >%s", name, thresholds[i]);
+    }
+}
+
+/** A precipitation-like distribution with a chance of none and two modes when it is wet.
+ *
+ * Values from the dry component are mostly below zero, which become zero when they are clipped
+ * at the floor, so the probability of exceeding any threshold still comes from the same CDF.
+ */
+static struct Mixture
+accumulation_mixture(double wetness, double amount)
+{
+    amount = fmax(amount, 1.0e-4);
+    return (struct Mixture){
+        .num = 3,
+        .weight = {1.0 - wetness, 0.6 * wetness, 0.4 * wetness},
+        .mean = {-amount, 0.6 * amount, 1.8 * amount},
+        .scale = {0.3 * amount, 0.25 * amount, 0.4 * amount},
+    };
+}
+
+/** Two modes, like when the models disagree about the timing of a front. */
+static struct Mixture
+bimodal_mixture(Rng *rng, double center, double spread)
+{
+    double split = rng_range(rng, 0.5, 2.0) * spread;
+    double weight = rng_range(rng, 0.3, 0.7);
+    return (struct Mixture){
+        .num = 2,
+        .weight = {weight, 1.0 - weight},
+        .mean = {center - split, center + split},
+        .scale = {0.4 * spread, 0.5 * spread},
+    };
+}
+
+/** Let the weather drift a little over \a hours. */
+static void
+site_step(struct Site *site, double hours)
+{
+    double step = sqrt(hours / 24.0);
+    Rng *rng = &site->rng;
+
+    site->temp_k += step * rng_range(rng, -2.0, 2.0);
+    site->wetness = fmin(0.95, fmax(0.0, site->wetness + step * rng_range(rng, -0.2, 0.2)));
+    site->storm_mm = fmax(0.5, site->storm_mm + step * rng_range(rng, -3.0, 3.0));
+    site->wind_ms = fmax(1.0, site->wind_ms + step * rng_range(rng, -1.5, 1.5));
+}
+
+/** Write the header if \a w is in header mode, otherwise the row for one valid time. */
+static void
+write_row(struct Writer *w, struct Generator const *gen, struct Site *site, time_t valid_time,
+          int lead_hours)
+{
+    struct tm valid = {0};
+    gmtime_r(&valid_time, &valid);
+    int const hour = valid.tm_hour;
+    bool const row = !w->header;
+    Rng *rng = &site->rng;
+
+    if (w->header) {
+        fputs("validtime", w->out);
+    } else {
+        fprintf(w->out, "%04d%02d%02d%02d", valid.tm_year + 1900, valid.tm_mon + 1, valid.tm_mday,
+                hour);
+    }
+
+    // Hourly values, the one hour accumulations only exist while the output is hourly.
+    double const solar_hour = fmod(hour + site->lon / 15.0 + 48.0, 24.0);
+    double const diurnal = -cos((solar_hour - 3.0) / 24.0 * 2.0 * M_PI);
+    double const temp = site->temp_k + 6.0 * diurnal;
+    double const dew = fmin(temp, site->temp_k - 6.0 + 8.0 * site->wetness);
+    double const rh = 100.0 * exp(17.625 * (dew - temp) / (dew - 30.1));
+    double const pop = 100.0 * site->wetness * rng_uniform(rng);
+    bool const is_hourly = lead_hours <= 36;
+    double const snow_frac = temp < 271.0 ? 1.0 : temp < 275.0 ? (275.0 - temp) / 4.0 : 0.0;
+    double const qpf_1hr = pop > 30.0 ? rng_range(rng, 0.0, site->storm_mm / 12.0) : 0.0;
+    double const wind = site->wind_ms * rng_range(rng, 0.7, 1.3);
+
+    column(w, temp, "TMP_2 m above ground");
+    column(w, rng_range(rng, 0.5, 3.0), "TMP_2 m above ground_ens std dev");
+    column(w, dew, "DPT_2 m above ground");
+    column(w, rng_range(rng, 0.5, 3.0), "DPT_2 m above ground_ens std dev");
+    column(w, rh, "RH_2 m above ground");
+    column(w, fmin(100.0, 100.0 * site->wetness + rng_range(rng, 0.0, 30.0)), "TCDC_surface");
+    column(w, is_hourly ? round(pop / 10.0) * 10.0 : NAN, "APCP1hr_surface_prob >0.254");
+    column(w, is_hourly ? qpf_1hr : NAN, "APCP1hr_surface");
+    column(w, is_hourly ? round(fmax(0.0, pop * diurnal) / 20.0) * 10.0 : NAN,
+           "TSTM1hr_surface_probability forecast");
+    column(w, fmax(0.0, 600.0 * diurnal * site->wetness), "CAPE_surface");
+    column(w, 10.0 + 10.0 * snow_frac, "SNOWLR_surface");
+    column(w, is_hourly ? qpf_1hr * snow_frac * 0.01 : NAN, "ASNOW1hr_surface");
+    column(w, wind, "WIND_10 m above ground");
+    column(w, rng_range(rng, 0.3, 2.5), "WIND_10 m above ground_ens std dev");
+    column(w, wind * rng_range(rng, 1.3, 1.8), "GUST_10 m above ground");
+    column(w, rng_range(rng, 0.5, 3.5), "GUST_10 m above ground_ens std dev");
+    column(w, rng_range(rng, 180.0, 300.0), "WDIR_10 m above ground");
+
+    // Twelve hour values, the maximum is for the day ending at 00Z and the minimum the night
+    // ending at 12Z.
+    bool const is_00z = hour == 0;
+    bool const is_12z = hour == 12;
+    double const max_t = site->temp_k + 6.0;
+    double const min_t = site->temp_k - 6.0;
+    column(w, is_00z ? max_t : NAN, "TMAX12hr_2 m above ground");
+    column(w, is_00z ? rng_range(rng, 1.0, 3.0) : NAN, "TMAX12hr_2 m above ground_ens std dev");
+    column(w, is_12z ? min_t : NAN, "TMIN12hr_2 m above ground");
+    column(w, is_12z ? rng_range(rng, 1.0, 3.0) : NAN, "TMIN12hr_2 m above ground_ens std dev");
+    column(w, is_00z ? fmax(5.0, rh - 30.0) : NAN, "MINRH12hr_2 m above ground");
+    column(w, is_12z ? fmin(100.0, rh + 30.0) : NAN, "MAXRH12hr_2 m above ground");
+    column(w, is_00z || is_12z ? 100.0 * site->wetness * rng_uniform(rng) : NAN,
+           "TSTM12hr_surface_probability forecast");
+
+    // Temperature distributions.
+    struct Mixture temp_mix = {0};
+    if (row && is_00z) {
+        temp_mix = bimodal_mixture(rng, max_t, 2.0 + lead_hours / 48.0);
+    }
+    distribution_columns(w, gen, "TMP_Max_2 m above ground", row && is_00z ? &temp_mix : 0,
+                         -HUGE_VAL, 0, 0);
+
+    if (row && is_12z) {
+        temp_mix = bimodal_mixture(rng, min_t, 2.0 + lead_hours / 48.0);
+    }
+    distribution_columns(w, gen, "TMP_Min_2 m above ground", row && is_12z ? &temp_mix : 0,
+                         -HUGE_VAL, 0, 0);
+
+    // Accumulations, the 6 hour ones every 6 hours and the rest at 00Z and 12Z.
+    for (size_t h = 0; h < NUM_ACCUM_HOURS; h++) {
+        int const hours = accum_hours[h];
+        bool const valid_now = row && (is_00z || is_12z || (hours == 6 && hour % 6 == 0));
+
+        // More hours are more likely to have some precipitation, and more of it.
+        double const wetness = 1.0 - pow(1.0 - site->wetness, hours / 24.0);
+        double const amount_mm = site->storm_mm * pow(hours / 24.0, 0.7);
+        double const ice_frac = 0.3 * snow_frac * (1.0 - snow_frac);
+        double const fractions[NUM_ACCUM_ELEMENTS] = {1.0, snow_frac, ice_frac};
+
+        for (size_t e = 0; e < NUM_ACCUM_ELEMENTS; e++) {
+            struct AccumElement const *element = &accum_elements[e];
+
+            char name[64] = {0};
+            sprintf(name, "%s%dhr_surface", element->name, hours);
+
+            struct Mixture accum_mix = {0};
+            if (valid_now) {
+                double amount = amount_mm * element->units_per_mm * fractions[e];
+                double elem_wetness = fractions[e] > 0.0 ? wetness : 0.0;
+                accum_mix = accumulation_mixture(elem_wetness, amount);
+            }
+            distribution_columns(w, gen, name, valid_now ? &accum_mix : 0, 0.0,
+                                 element->num_thresholds, element->thresholds);
+        }
+    }
+
+    // Daily maximum wind and gust, for the 24 hours ending at 12Z.
+    struct Mixture wind_mix = {0};
+    if (row && is_12z) {
+        wind_mix = bimodal_mixture(rng, 1.5 * site->wind_ms, 0.3 * site->wind_ms + 1.0);
+    }
+    distribution_columns(w, gen, "WIND24hr_10 m above ground", row && is_12z ? &wind_mix : 0, 0.0,
+                         NUM_WIND_THRESHOLDS, wind_thresholds);
+
+    if (row && is_12z) {
+        wind_mix = bimodal_mixture(rng, 2.3 * site->wind_ms, 0.4 * site->wind_ms + 2.0);
+    }
+    distribution_columns(w, gen, "GUST24hr_10 m above ground", row && is_12z ? &wind_mix : 0, 0.0,
+                         NUM_WIND_THRESHOLDS, gust_thresholds);
+
+    fputc('\n', w->out);
+}
+
+/** The output is hourly to 36 hours, 3 hourly to 192 hours, and 6 hourly after that. */
+static int
+next_lead_hours(int lead_hours)
+{
+    if (lead_hours < 36) {
+        return lead_hours + 1;
+    } else if (lead_hours < 192) {
+        return lead_hours + 3;
+    }
+
+    return lead_hours + 6;
+}
+
+/*-------------------------------------------------------------------------------------------------
+ *                                       Writing Files
+ *-----------------------------------------------------------------------------------------------*/
+/** Make a directory and any of its parents that are missing. */
+static bool
+make_dirs(char const *path)
+{
+    char buf[1024] = {0};
+    Stopif(strlen(path) >= sizeof(buf), return false, "Path too long: %s", path);
+    strcpy(buf, path);
+
+    for (char *c = buf + 1; *c; c++) {
+        if (*c == '/') {
+            *c = '\0';
+            Stopif(mkdir(buf, 0775) && errno != EEXIST, return false, "Unable to make %s: %s",
+                   buf, strerror(errno));
+            *c = '/';
+        }
+    }
+
+    Stopif(mkdir(buf, 0775) && errno != EEXIST, return false, "Unable to make %s: %s", buf,
+           strerror(errno));
+
+    return true;
+}
+
+static bool
+write_site_file(char const *path, struct Generator const *gen, struct Site *site,
+                time_t init_time, int max_lead_hours)
+{
+    FILE *out = fopen(path, "w");
+    Stopif(!out, return false, "Unable to open %s: %s", path, strerror(errno));
+    setvbuf(out, 0, _IOFBF, 1 << 20);
+
+    struct Writer w = {.out = out, .header = true};
+    write_row(&w, gen, site, init_time, 0);
+    w.header = false;
+
+    int prev_lead = 0;
+    for (int lead = 1; lead <= max_lead_hours; lead = next_lead_hours(lead)) {
+        site_step(site, lead - prev_lead);
+        write_row(&w, gen, site, init_time + lead * HOURSEC, lead);
+        prev_lead = lead;
+    }
+
+    bool ok = !ferror(out);
+    ok = fclose(out) == 0 && ok;
+    Stopif(!ok, return false, "Error writing %s", path);
+
+    return true;
+}
+
+/** Put the sites on a rough grid over the western United States. */
+static struct Site
+site_new(int index, int num_sites, uint64_t seed)
+{
+    struct Site site = {.rng = {.state = seed ^ (0xA24BAED4963EE407 * (index + 1))}};
+    Rng *rng = &site.rng;
+
+    int const per_row = (int)ceil(sqrt(num_sites));
+    site.lat = 32.0 + 16.0 * ((index / per_row) + rng_uniform(rng)) / per_row;
+    site.lon = -124.0 + 22.0 * ((index % per_row) + rng_uniform(rng)) / per_row;
+    sprintf(site.id, "S%05d", index + 1);
+
+    site.temp_k = 295.0 - 0.9 * (site.lat - 32.0) + rng_range(rng, -4.0, 4.0);
+    site.wetness = rng_range(rng, 0.0, 0.6);
+    site.storm_mm = rng_range(rng, 2.0, 20.0);
+    site.wind_ms = rng_range(rng, 2.0, 8.0);
+
+    return site;
+}
+
+/*-------------------------------------------------------------------------------------------------
+ *                                          Program
+ *-----------------------------------------------------------------------------------------------*/
+static int num_sites = 10;
+static int max_lead_hours = 264;
+static char *init_time_str = 0;
+static gint64 seed = 1;
+static gboolean all_percentiles = false;
+
+static GOptionEntry entries[] = {
+    {"sites", 'n', 0, G_OPTION_ARG_INT, &num_sites, "Number of sites, default 10.", "N"},
+    {"hours", 'l', 0, G_OPTION_ARG_INT, &max_lead_hours, "Lead hours, default 264.", "L"},
+    {"init-time", 'i', 0, G_OPTION_ARG_STRING, &init_time_str,
+     "Model initialization time, default 2024-10-01-13.", "YYYY-MM-DD-HH"},
+    {"seed", 's', 0, G_OPTION_ARG_INT64, &seed, "Seed for the random numbers, default 1.", "S"},
+    {"all-percentiles", 'a', 0, G_OPTION_ARG_NONE, &all_percentiles,
+     "Write every percentile from 1 to 99 instead of the 21 in the real files.", 0},
+    {0},
+};
+
+static time_t
+parse_init_time(char const *str)
+{
+    struct tm init = {0};
+    int year = 0, month = 0, day = 0, hour = 0;
+    int num = sscanf(str, "%d-%d-%d-%d", &year, &month, &day, &hour);
+    Stopif(num != 4, return -1, "Invalid init time %s, use YYYY-MM-DD-HH", str);
+    Stopif(hour != 1 && hour != 7 && hour != 13 && hour != 19, return -1,
+           "The init hour must be one of 01, 07, 13, or 19 UTC");
+
+    init.tm_year = year - 1900;
+    init.tm_mon = month - 1;
+    init.tm_mday = day;
+    init.tm_hour = hour;
+
+    return timegm(&init);
+}
+
+int
+main(int argc, char *argv[argc + 1])
+{
+    int result = EXIT_FAILURE;
+    int *percentiles = 0;
+    FILE *locations = 0;
+    char *root = 0;
+
+    GOptionContext *context = g_option_context_new("OUTDIR - write a synthetic NBM archive");
+    GOptionGroup *group = g_option_group_new("synth", "Synthetic archive options", "", 0, 0);
+    g_option_group_add_entries(group, entries);
+    g_option_context_set_main_group(context, group);
+
+    GError *err = 0;
+    bool parsed = g_option_context_parse(context, &argc, &argv, &err);
+    Stopif(!parsed, goto EXIT, "%s", err->message);
+    Stopif(argc != 2, goto EXIT, "Exactly one output directory is required, see --help");
+    Stopif(num_sites < 1 || num_sites > 99999, goto EXIT, "--sites must be from 1 to 99999");
+    Stopif(max_lead_hours < 1, goto EXIT, "--hours must be at least 1");
+    root = argv[1];
+
+    time_t init_time = parse_init_time(init_time_str ? init_time_str : "2024-10-01-13");
+    Stopif(init_time < 0, goto EXIT, "Unable to set the init time");
+
+    struct Generator gen = {.percentiles = standard_percentiles,
+                            .num_percentiles = NUM_STANDARD_PERCENTILES};
+    if (all_percentiles) {
+        percentiles = calloc(99, sizeof(int));
+        assert(percentiles);
+        for (int i = 0; i < 99; i++) {
+            percentiles[i] = i + 1;
+        }
+        gen = (struct Generator){.percentiles = percentiles, .num_percentiles = 99};
+    }
+
+    char rel_path[512] = {0};
+    char dir[1024] = {0};
+    int len = data_source_archive_path(sizeof(rel_path), rel_path, "locations.csv", init_time);
+    Stopif(len < 0, goto EXIT, "Archive path too long");
+    len = snprintf(dir, sizeof(dir), "%s/%s", root, rel_path);
+    Stopif(len >= sizeof(dir), goto EXIT, "Output directory name too long");
+    *strrchr(dir, '/') = '\0';
+    Stopif(!make_dirs(dir), goto EXIT, "Unable to make the output directory");
+
+    char path[1200] = {0};
+    sprintf(path, "%s/locations.csv", dir);
+    locations = fopen(path, "w");
+    Stopif(!locations, goto EXIT, "Unable to open %s: %s", path, strerror(errno));
+
+    for (int i = 0; i < num_sites; i++) {
+        struct Site site = site_new(i, num_sites, seed);
+        fprintf(locations, "%s,Synthetic Site %d,ZZ,%.4f,%.4f\n", site.id, i + 1, site.lat,
+                site.lon);
+
+        sprintf(path, "%s/%s.csv", dir, site.id);
+        Stopif(!write_site_file(path, &gen, &site, init_time, max_lead_hours), goto EXIT,
+               "Unable to write site %s", site.id);
+    }
+
+    int close_result = fclose(locations);
+    locations = 0;
+    Stopif(close_result != 0, goto EXIT, "Error writing locations.csv");
+
+    printf("Wrote %d sites to %s\n", num_sites, dir);
+    result = EXIT_SUCCESS;
+
+EXIT:
+    if (locations) {
+        fclose(locations);
+    }
+    if (err) {
+        g_error_free(err);
+    }
+    free(percentiles);
+    g_free(init_time_str);
+    g_option_context_free(context);
+
+    return result;
+}
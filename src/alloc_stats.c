@@ -0,0 +1,213 @@
+#include "alloc_stats.h"
+
+#include <stddef.h>
+#include <sys/resource.h>
+
+#if defined(__has_feature)
+#if __has_feature(address_sanitizer) || __has_feature(thread_sanitizer) ||                         \
+    __has_feature(memory_sanitizer)
+#define ALLOC_STATS_SANITIZED 1
+#endif
+#endif
+
+#if defined(__SANITIZE_ADDRESS__) || defined(__SANITIZE_THREAD__)
+#define ALLOC_STATS_SANITIZED 1
+#endif
+
+#if defined(NBM_ALLOC_STATS) && defined(__GLIBC__) && !defined(ALLOC_STATS_SANITIZED)
+#define ALLOC_STATS_ENABLED 1
+#else
+#define ALLOC_STATS_ENABLED 0
+#endif
+
+#if ALLOC_STATS_ENABLED
+#include <errno.h>
+#include <malloc.h>
+#include <stdatomic.h>
+#include <unistd.h>
+
+/* glibc's own allocator, which the replacements below forward to. */
+extern void *__libc_malloc(size_t size);
+extern void *__libc_calloc(size_t num, size_t size);
+extern void *__libc_realloc(void *ptr, size_t size);
+extern void *__libc_memalign(size_t alignment, size_t size);
+extern void *__libc_valloc(size_t size);
+extern void *__libc_pvalloc(size_t size);
+extern void __libc_free(void *ptr);
+
+/** Set once when counting starts, before any threads that matter are running. */
+static atomic_bool counting = false;
+
+/** Each thread only updates its own counts, so no atomics are needed for them. */
+static _Thread_local struct AllocCounts thread_counts = {0};
+
+static inline bool
+is_counting(void)
+{
+    return atomic_load_explicit(&counting, memory_order_relaxed);
+}
+
+static inline void *
+count_alloc(void *ptr)
+{
+    if (ptr && is_counting()) {
+        thread_counts.allocs++;
+        thread_counts.alloc_bytes += malloc_usable_size(ptr);
+    }
+
+    return ptr;
+}
+
+static inline void
+count_free(void *ptr)
+{
+    if (ptr && is_counting()) {
+        thread_counts.frees++;
+        thread_counts.freed_bytes += malloc_usable_size(ptr);
+    }
+}
+
+void *
+malloc(size_t size)
+{
+    return count_alloc(__libc_malloc(size));
+}
+
+void *
+calloc(size_t num, size_t size)
+{
+    return count_alloc(__libc_calloc(num, size));
+}
+
+void *
+realloc(void *ptr, size_t size)
+{
+    // A realloc is counted as freeing the old block and allocating a new one, even if it was
+    // resized in place, that's the only way the byte counts stay comparable.
+    count_free(ptr);
+    return count_alloc(__libc_realloc(ptr, size));
+}
+
+void *
+reallocarray(void *ptr, size_t num, size_t size)
+{
+    // glibc's version calls its own realloc(), not the one above.
+    size_t bytes = 0;
+    if (__builtin_mul_overflow(num, size, &bytes)) {
+        errno = ENOMEM;
+        return 0;
+    }
+
+    return realloc(ptr, bytes);
+}
+
+void
+free(void *ptr)
+{
+    count_free(ptr);
+    __libc_free(ptr);
+}
+
+void *
+memalign(size_t alignment, size_t size)
+{
+    return count_alloc(__libc_memalign(alignment, size));
+}
+
+void *
+aligned_alloc(size_t alignment, size_t size)
+{
+    return count_alloc(__libc_memalign(alignment, size));
+}
+
+void *
+valloc(size_t size)
+{
+    return count_alloc(__libc_valloc(size));
+}
+
+void *
+pvalloc(size_t size)
+{
+    return count_alloc(__libc_pvalloc(size));
+}
+
+int
+posix_memalign(void **ptr, size_t alignment, size_t size)
+{
+    if (alignment % sizeof(void *) != 0 || (alignment & (alignment - 1)) != 0) {
+        return EINVAL;
+    }
+
+    void *block = count_alloc(__libc_memalign(alignment, size));
+    if (!block) {
+        return ENOMEM;
+    }
+
+    *ptr = block;
+    return 0;
+}
+
+bool
+alloc_stats_available(void)
+{
+    return true;
+}
+
+void
+alloc_stats_start(void)
+{
+    atomic_store(&counting, true);
+}
+
+struct AllocCounts
+alloc_stats_thread(void)
+{
+    return thread_counts;
+}
+
+void
+alloc_stats_add(struct AllocCounts counts)
+{
+    thread_counts.allocs += counts.allocs;
+    thread_counts.alloc_bytes += counts.alloc_bytes;
+    thread_counts.frees += counts.frees;
+    thread_counts.freed_bytes += counts.freed_bytes;
+}
+
+#else
+
+bool
+alloc_stats_available(void)
+{
+    return false;
+}
+
+void
+alloc_stats_start(void)
+{
+}
+
+struct AllocCounts
+alloc_stats_thread(void)
+{
+    return (struct AllocCounts){0};
+}
+
+void
+alloc_stats_add(struct AllocCounts counts)
+{
+}
+
+#endif
+
+long
+alloc_stats_peak_rss_kb(void)
+{
+    struct rusage usage = {0};
+    if (getrusage(RUSAGE_SELF, &usage) != 0) {
+        return 0;
+    }
+
+    return usage.ru_maxrss; // Kilobytes on Linux.
+}
@@ -0,0 +1,47 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/*-------------------------------------------------------------------------------------------------
+ *                                    Counting Allocations
+ *-----------------------------------------------------------------------------------------------*/
+/* In builds that count allocations, malloc() and friends are replaced with versions that count
+ * what each thread allocates and frees, so memory use can be attributed to the phases timed by the
+ * profiler. Replacing them catches everything, including the allocations glib, SQLite, and cURL
+ * make on our behalf, like the nodes of a GTree.
+ *
+ * Sizes are the usable size of each block as reported by the C library, so the bytes allocated
+ * and freed can be compared. Until counting is started the only cost is a branch per call.
+ *
+ * Counting is only built in when NBM_ALLOC_STATS is defined, which the makefile does for the
+ * benchmarks and for `make profile`, a regular nbm keeps the C library's malloc(). It also only
+ * works with glibc, and not with the sanitizers since they replace malloc() themselves.
+ */
+
+/** The allocations and frees made by one thread since counting started. */
+struct AllocCounts {
+    uint64_t allocs;
+    uint64_t alloc_bytes;
+    uint64_t frees;
+    uint64_t freed_bytes;
+};
+
+/** Can allocations be counted in this build? */
+bool alloc_stats_available(void);
+
+/** Start counting allocations, on all threads. */
+void alloc_stats_start(void);
+
+/** Get the counts for the calling thread. They are all zero if counting isn't available. */
+struct AllocCounts alloc_stats_thread(void);
+
+/** Add counts to those of the calling thread.
+ *
+ * This is how work done on other threads on behalf of this one, like the workers of a
+ * parallel_for(), is charged to the spans open on this thread.
+ */
+void alloc_stats_add(struct AllocCounts counts);
+
+/** Get the largest resident set size of the process so far, in kilobytes. */
+long alloc_stats_peak_rss_kb(void);
@@ -0,0 +1,116 @@
+#include "arena.h"
+
+#include <assert.h>
+#include <stdalign.h>
+#include <stdlib.h>
+
+/*-------------------------------------------------------------------------------------------------
+ *                                            Arena
+ *-----------------------------------------------------------------------------------------------*/
+/** The usual size of a block, big enough for all the CDFs of a typical element. */
+#define ARENA_BLOCK_SIZE (32 * 1024)
+
+/** A chunk of memory allocations are carved out of. */
+struct ArenaBlock {
+    struct ArenaBlock *next;
+    size_t size;
+    size_t used;
+    alignas(max_align_t) unsigned char data[];
+};
+
+/** Internal implementation of \ref Arena. */
+struct Arena {
+    struct ArenaBlock *blocks; // The one being allocated from is first.
+    size_t total_bytes;
+};
+
+static struct ArenaBlock *
+arena_block_new(size_t size)
+{
+    struct ArenaBlock *block = malloc(sizeof(struct ArenaBlock) + size);
+    assert(block);
+
+    *block = (struct ArenaBlock){.next = 0, .size = size, .used = 0};
+
+    return block;
+}
+
+Arena *
+arena_new(void)
+{
+    struct Arena *arena = malloc(sizeof(struct Arena));
+    assert(arena);
+
+    *arena = (struct Arena){.blocks = 0, .total_bytes = 0};
+
+    return arena;
+}
+
+void
+arena_free(Arena **ptrptr)
+{
+    struct Arena *arena = *ptrptr;
+
+    if (arena) {
+        struct ArenaBlock *block = arena->blocks;
+        while (block) {
+            struct ArenaBlock *next = block->next;
+            free(block);
+            block = next;
+        }
+
+        free(arena);
+    }
+
+    *ptrptr = 0;
+}
+
+void *
+arena_alloc(Arena *arena, size_t size)
+{
+    assert(arena);
+
+    size_t const align = alignof(max_align_t);
+    size = (size + align - 1) & ~(align - 1);
+
+    struct ArenaBlock *block = arena->blocks;
+    if (!block || block->size - block->used < size) {
+
+        if (size > ARENA_BLOCK_SIZE / 4) {
+            // Give big requests their own block, and keep using the current one.
+            struct ArenaBlock *big = arena_block_new(size);
+            arena->total_bytes += sizeof(struct ArenaBlock) + size;
+
+            if (block) {
+                big->next = block->next;
+                block->next = big;
+            } else {
+                arena->blocks = big;
+            }
+
+            big->used = size;
+            return big->data;
+        }
+
+        block = arena_block_new(ARENA_BLOCK_SIZE);
+        arena->total_bytes += sizeof(struct ArenaBlock) + ARENA_BLOCK_SIZE;
+
+        block->next = arena->blocks;
+        arena->blocks = block;
+    }
+
+    void *ptr = &block->data[block->used];
+    block->used += size;
+
+    return ptr;
+}
+
+size_t
+arena_memory_bytes(Arena const *arena)
+{
+    if (!arena) {
+        return 0;
+    }
+
+    return sizeof(*arena) + arena->total_bytes;
+}
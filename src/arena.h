@@ -0,0 +1,32 @@
+#pragma once
+
+#include <stddef.h>
+
+/*-------------------------------------------------------------------------------------------------
+ *                                            Arena
+ *-----------------------------------------------------------------------------------------------*/
+/** A region of memory that many small objects are allocated from and then freed all at once.
+ *
+ * Allocating is just bumping a pointer into a large block, and there is no way to free a single
+ * object. This suits the distributions and scenarios in a summary, which are all created while
+ * building the summary and all released when it is freed.
+ *
+ * An arena is not safe to use from more than one thread at a time.
+ */
+typedef struct Arena Arena;
+
+/** Create a new, empty arena. */
+Arena *arena_new(void);
+
+/** Free all the memory allocated from an arena, and nullify the pointer. */
+void arena_free(Arena **arena);
+
+/** Allocate memory from an arena.
+ *
+ * The memory is not initialized, and it is aligned suitably for any type. It is valid until the
+ * arena is freed.
+ */
+void *arena_alloc(Arena *arena, size_t size);
+
+/** Get the number of bytes of memory the arena has reserved from the system. */
+size_t arena_memory_bytes(Arena const *arena);
@@ -1,4 +1,5 @@
 #include "cache.h"
+#include "profile.h"
 
 #include <sys/stat.h>
 #include <zlib.h>
@@ -10,6 +11,8 @@ compress_text_buffer(struct TextBuffer const in_text[static 1])
 {
     assert(in_text);
 
+    ProfileSpan span = profile_begin("cache_deflate", 0);
+
     struct ByteBuffer out_buf = byte_buffer_with_capacity(in_text->size + 2);
 
     int z_ret = Z_OK;
@@ -38,6 +41,8 @@ compress_text_buffer(struct TextBuffer const in_text[static 1])
 
     deflateEnd(&strm);
 
+    profile_end(&span);
+
     return out_buf;
 }
 
@@ -46,6 +51,8 @@ uncompress_text(int in_size, unsigned char in[in_size])
 {
     assert(in);
 
+    ProfileSpan span = profile_begin("cache_inflate", 0);
+
     struct TextBuffer out_buf = text_buffer_with_capacity(in_size * 10);
 
     int z_ret = Z_OK;
@@ -82,17 +89,23 @@ uncompress_text(int in_size, unsigned char in[in_size])
 
     inflateEnd(&strm);
 
+    profile_end(&span);
+
     return out_buf;
 }
 
 static const char *
 get_or_create_cache_path()
 {
-    static char path[64] = {0};
+    static char path[1024] = {0};
 
     char const *home = getenv("HOME");
     Stopif(!home, exit(EXIT_FAILURE), "could not find user's home directory.");
 
+    // The longest path is the last one, so if it fits they all do.
+    int len = snprintf(path, sizeof(path), "%s/.local/share/nbm-report/cache41.sqlite", home);
+    Stopif(len >= sizeof(path), exit(EXIT_FAILURE), "home directory path too long: %s", home);
+
     sprintf(path, "%s/.local/", home);
 
     struct stat st = {0};
@@ -122,9 +135,14 @@ void
 cache_initialize()
 {
     char const *path = get_or_create_cache_path();
-    int result = sqlite3_open(path, &cache);
+    // The cache may be used from several threads in server mode.
+    int result = sqlite3_open_v2(
+        path, &cache, SQLITE_OPEN_READWRITE | SQLITE_OPEN_CREATE | SQLITE_OPEN_FULLMUTEX, 0);
     Stopif(result != SQLITE_OK, exit(EXIT_FAILURE), "unable to open download cache.");
 
+    // Wait on other processes using the cache, like a prefetcher or a server, instead of failing.
+    sqlite3_busy_timeout(cache, 5000);
+
     char *sql = "CREATE TABLE IF NOT EXISTS nbm (   \n"
                 "  site      TEXT    NOT NULL,      \n"
                 "  init_time INTEGER NOT NULL,      \n"
@@ -142,15 +160,31 @@ cache_initialize()
 
     rc = sqlite3_finalize(statement);
     Stopif(rc != SQLITE_OK, exit(EXIT_FAILURE), "error finalizing cache initialization sql.");
+
+    sql = "CREATE TABLE IF NOT EXISTS reports (           \n"
+          "  site      TEXT    NOT NULL,                  \n"
+          "  init_time INTEGER NOT NULL,                  \n"
+          "  options   TEXT    NOT NULL,                  \n"
+          "  data      BLOB,                              \n"
+          "  PRIMARY KEY (site, init_time, options));     \n";
+
+    rc = sqlite3_prepare_v2(cache, sql, -1, &statement, 0);
+    Stopif(rc != SQLITE_OK, exit(EXIT_FAILURE), "error preparing report cache sql: %s",
+           sqlite3_errstr(rc));
+
+    rc = sqlite3_step(statement);
+    Stopif(rc != SQLITE_DONE, exit(EXIT_FAILURE), "error executing report cache sql.");
+
+    rc = sqlite3_finalize(statement);
+    Stopif(rc != SQLITE_OK, exit(EXIT_FAILURE), "error finalizing report cache sql.");
 }
 
-void
-cache_finalize()
+/** Delete entries from \a table with an init_time older than \a too_old. */
+static void
+delete_old_entries(char const *table, time_t too_old)
 {
-    time_t now = time(0);
-    time_t too_old = now - 60 * 60 * 24 * 555; // About 555 days. That's over 1.5 years!
-
-    char *sql = "DELETE FROM nbm WHERE init_time < ?";
+    char sql[64] = {0};
+    snprintf(sql, sizeof(sql), "DELETE FROM %s WHERE init_time < ?", table);
 
     sqlite3_stmt *statement = 0;
     int rc = sqlite3_prepare_v2(cache, sql, -1, &statement, 0);
@@ -166,6 +200,16 @@ cache_finalize()
 
     rc = sqlite3_finalize(statement);
     Stopif(rc != SQLITE_OK, exit(EXIT_FAILURE), "error finalizing delete statement");
+}
+
+void
+cache_finalize()
+{
+    time_t now = time(0);
+    time_t too_old = now - 60 * 60 * 24 * 555; // About 555 days. That's over 1.5 years!
+
+    delete_old_entries("nbm", too_old);
+    delete_old_entries("reports", too_old);
 
     int result = sqlite3_close(cache);
 
@@ -267,3 +311,100 @@ ERR_RETURN:
 
     return -1;
 }
+
+struct TextBuffer
+cache_retrieve_report(char const site[static 1], time_t init_time, char const options[static 1])
+{
+    assert(site);
+    assert(options);
+
+    struct TextBuffer out_buf = text_buffer_with_capacity(0);
+
+    char const *sql = "SELECT data FROM reports WHERE site = ? AND init_time = ? AND options = ?";
+
+    sqlite3_stmt *statement = 0;
+    int rc = sqlite3_prepare_v2(cache, sql, -1, &statement, 0);
+    Stopif(rc != SQLITE_OK, goto ERR_RETURN, "error preparing report select statement: %s",
+           sqlite3_errstr(rc));
+
+    rc = sqlite3_bind_text(statement, 1, site, -1, 0);
+    Stopif(rc != SQLITE_OK, goto ERR_RETURN, "error binding site in report select.");
+
+    rc = sqlite3_bind_int64(statement, 2, init_time);
+    Stopif(rc != SQLITE_OK, goto ERR_RETURN, "error binding init_time in report select.");
+
+    rc = sqlite3_bind_text(statement, 3, options, -1, 0);
+    Stopif(rc != SQLITE_OK, goto ERR_RETURN, "error binding options in report select.");
+
+    rc = sqlite3_step(statement);
+    Stopif(rc != SQLITE_ROW && rc != SQLITE_DONE, goto ERR_RETURN,
+           "error executing report select sql: %s", sqlite3_errstr(rc));
+
+    if (rc == SQLITE_DONE) { // nothing retrieved
+        goto ERR_RETURN;     // not really an error, but the cleanup at this point is the same.
+    }
+
+    int col_type = sqlite3_column_type(statement, 0);
+    Stopif(col_type != SQLITE_BLOB, goto ERR_RETURN, "invalid data type in report cache");
+
+    unsigned char const *blob_data = sqlite3_column_blob(statement, 0);
+    int blob_size = sqlite3_column_bytes(statement, 0);
+
+    out_buf = uncompress_text(blob_size, (unsigned char *)blob_data);
+
+ERR_RETURN:
+
+    rc = sqlite3_finalize(statement);
+    Stopif(rc != SQLITE_OK, exit(EXIT_FAILURE), "error finalizing report select statement");
+
+    return out_buf;
+}
+
+int
+cache_add_report(char const site[static 1], time_t init_time, char const options[static 1],
+                 struct TextBuffer const buf[static 1])
+{
+    assert(site);
+    assert(options);
+    assert(buf);
+
+    struct ByteBuffer compressed_buf = compress_text_buffer(buf);
+
+    char const *sql =
+        "INSERT OR REPLACE INTO reports (site, init_time, options, data) VALUES (?, ?, ?, ?)";
+
+    sqlite3_stmt *statement = 0;
+    int rc = sqlite3_prepare_v2(cache, sql, -1, &statement, 0);
+    Stopif(rc != SQLITE_OK, exit(EXIT_FAILURE), "error preparing report insert statement: %s",
+           sqlite3_errstr(rc));
+
+    rc = sqlite3_bind_text(statement, 1, site, -1, 0);
+    Stopif(rc != SQLITE_OK, goto ERR_RETURN, "error binding site.");
+
+    rc = sqlite3_bind_int64(statement, 2, init_time);
+    Stopif(rc != SQLITE_OK, goto ERR_RETURN, "error binding init_time.");
+
+    rc = sqlite3_bind_text(statement, 3, options, -1, 0);
+    Stopif(rc != SQLITE_OK, goto ERR_RETURN, "error binding options.");
+
+    rc = sqlite3_bind_blob(statement, 4, compressed_buf.data, compressed_buf.size, 0);
+    Stopif(rc != SQLITE_OK, goto ERR_RETURN, "error binding compressed report.");
+
+    rc = sqlite3_step(statement);
+    Stopif(rc != SQLITE_DONE, goto ERR_RETURN, "error executing report insert sql");
+
+    byte_buffer_clear(&compressed_buf);
+
+    rc = sqlite3_finalize(statement);
+    Stopif(rc != SQLITE_OK, exit(EXIT_FAILURE), "error finalizing report insert statement");
+
+    return 0;
+
+ERR_RETURN:
+    rc = sqlite3_finalize(statement);
+    Stopif(rc != SQLITE_OK, exit(EXIT_FAILURE), "error finalizing report insert sql.");
+
+    byte_buffer_clear(&compressed_buf);
+
+    return -1;
+}
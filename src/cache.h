@@ -33,3 +33,25 @@ struct TextBuffer cache_retrieve(char const *file, time_t init_time);
  * \returns 0 on success.
  */
 int cache_add(char const *site, time_t init_time, struct TextBuffer const buf[static 1]);
+
+/** Retrieve a rendered report from the cache.
+ *
+ * \param site is the site id the report is for.
+ * \param init_time is the model initialization time.
+ * \param options is a string that identifies the options used to make the report.
+ *
+ * \returns a TextBuffer with the report, or an empty one if it isn't in the cache.
+ */
+struct TextBuffer cache_retrieve_report(char const *site, time_t init_time, char const *options);
+
+/** Add a rendered report to the cache.
+ *
+ * \param site is the site id the report is for.
+ * \param init_time is the model initialization time.
+ * \param options is a string that identifies the options used to make the report.
+ * \param buf is the text of the report.
+ *
+ * \returns 0 on success.
+ */
+int cache_add_report(char const *site, time_t init_time, char const *options,
+                     struct TextBuffer const buf[static 1]);
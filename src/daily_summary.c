@@ -146,98 +146,140 @@ daily_summary_access_max_t(void *sm)
     return &sum->max_t_f;
 }
 
-// Most values can be considered in isolation, or one column at a time, winds are the exception. So
-// winds get their own extractor function.
-static void
-extract_max_winds_to_summary(GTree *sums, NBMData const *nbm)
-{
-    NBMDataRowIteratorWind *it = nbm_data_rows_wind(nbm);
-    Stopif(!it, exit(EXIT_FAILURE), "error creating wind iterator.");
+/** A column of the NBM and how to reduce it to a single value per day. */
+struct DailyColumn {
+    char const *name;
+    KeepFilter filter;
+    Converter convert;
+    Accumulator accumulate;
+    Extractor extract;
+};
 
-    struct NBMDataRowIteratorWindValueView view = nbm_data_row_wind_iterator_next(it);
-    while (view.valid_time) { // If valid time is good, assume everything is.
+static struct DailyColumn const daily_columns[] = {
+    {"TMAX12hr_2 m above ground", keep_all, kelvin_to_fahrenheit, accum_last,
+     daily_summary_access_max_t},
+    {"TMAX12hr_2 m above ground_ens std dev", keep_all, change_in_kelvin_to_change_in_fahrenheit,
+     accum_last, daily_summary_access_max_t_std},
+    {"TMIN12hr_2 m above ground", keep_all, kelvin_to_fahrenheit, accum_last,
+     daily_summary_access_min_t},
+    {"TMIN12hr_2 m above ground_ens std dev", keep_all, change_in_kelvin_to_change_in_fahrenheit,
+     accum_last, daily_summary_access_min_t_std},
+    {"MINRH12hr_2 m above ground", keep_all, id_func, accum_last, daily_summary_access_min_rh},
+    {"MAXRH12hr_2 m above ground", keep_all, id_func, accum_last, daily_summary_access_max_rh},
+    {"APCP24hr_surface", keep_all, mm_to_in, accum_last, daily_summary_access_precip},
+    {"ASNOW6hr_surface", keep_all, m_to_in, accum_sum, daily_summary_access_snow},
+    {"TSTM12hr_surface_probability forecast", keep_all, id_func, accum_max,
+     daily_summary_access_prob_ltg},
+    {"TCDC_surface", keep_mrn, id_func, accum_max, daily_summary_access_mrn_sky},
+    {"TCDC_surface", keep_aft, id_func, accum_max, daily_summary_access_aft_sky},
+};
 
-        time_t date = summary_date_06z(view.valid_time);
+#define NUM_DAILY_COLUMNS (sizeof(daily_columns) / sizeof(daily_columns[0]))
 
-        struct DailySummary *sum = g_tree_lookup(sums, &date);
-        if (!sum) {
-            time_t *key = malloc(sizeof(time_t));
-            *key = date;
-            sum = (struct DailySummary *)daily_summary_new();
-            g_tree_insert(sums, key, sum);
-        }
-        double max_wind_mph = mps_to_mph(*view.wspd);
-        double max_wind_std = mps_to_mph(*view.wspd_std);
-        double max_wind_gust = mps_to_mph(*view.gust);
-        double max_wind_gust_std = mps_to_mph(*view.gust_std);
-        double max_wind_dir = *view.wdir;
-
-        if (isnan(sum->max_wind_mph) || max_wind_mph > sum->max_wind_mph) {
-            sum->max_wind_mph = max_wind_mph;
-            sum->max_wind_std = max_wind_std;
-            sum->max_wind_dir = max_wind_dir;
-        }
+/** Most values can be considered in isolation, winds are the exception. They are only used when
+ * all of these are available, and they come after the daily columns.
+ */
+enum WindColumn { WIND_SPD, WIND_SPD_STD, WIND_GUST, WIND_GUST_STD, WIND_DIR, NUM_WIND_COLUMNS };
 
-        if (isnan(sum->max_wind_gust) || max_wind_gust > sum->max_wind_gust) {
-            sum->max_wind_gust = max_wind_gust;
-            sum->max_wind_gust_std = max_wind_gust_std;
-        }
+static char const *const wind_columns[NUM_WIND_COLUMNS] = {
+    [WIND_SPD] = "WIND_10 m above ground",
+    [WIND_SPD_STD] = "WIND_10 m above ground_ens std dev",
+    [WIND_GUST] = "GUST_10 m above ground",
+    [WIND_GUST_STD] = "GUST_10 m above ground_ens std dev",
+    [WIND_DIR] = "WDIR_10 m above ground",
+};
 
-        view = nbm_data_row_wind_iterator_next(it);
+static struct DailySummary *
+daily_summary_for_date(TimeSeries *sums, time_t date)
+{
+    struct DailySummary *sum = time_series_lookup(sums, date);
+    if (!sum) {
+        sum = daily_summary_new();
+        time_series_insert(sums, date, sum);
     }
 
-    nbm_data_row_wind_iterator_free(&it);
+    return sum;
 }
 
-/** Build a sorted list (\c Tree) of daily summaries from an \c NBMData object. */
-static GTree *
-build_daily_summaries(NBMData const *nbm)
+static void
+add_max_winds_to_summary(struct DailySummary *sum, double const wind[NUM_WIND_COLUMNS])
 {
-    GTree *sums = g_tree_new_full(time_t_compare_func, 0, free, free);
-
-    extract_daily_summary_for_column(sums, nbm, "TMAX12hr_2 m above ground", keep_all,
-                                     summary_date_06z, kelvin_to_fahrenheit, accum_last,
-                                     daily_summary_new, daily_summary_access_max_t);
+    double max_wind_mph = mps_to_mph(wind[WIND_SPD]);
+    double max_wind_std = mps_to_mph(wind[WIND_SPD_STD]);
+    double max_wind_gust = mps_to_mph(wind[WIND_GUST]);
+    double max_wind_gust_std = mps_to_mph(wind[WIND_GUST_STD]);
+    double max_wind_dir = wind[WIND_DIR];
+
+    if (isnan(sum->max_wind_mph) || max_wind_mph > sum->max_wind_mph) {
+        sum->max_wind_mph = max_wind_mph;
+        sum->max_wind_std = max_wind_std;
+        sum->max_wind_dir = max_wind_dir;
+    }
 
-    extract_daily_summary_for_column(sums, nbm, "TMAX12hr_2 m above ground_ens std dev", keep_all,
-                                     summary_date_06z, change_in_kelvin_to_change_in_fahrenheit,
-                                     accum_last, daily_summary_new, daily_summary_access_max_t_std);
+    if (isnan(sum->max_wind_gust) || max_wind_gust > sum->max_wind_gust) {
+        sum->max_wind_gust = max_wind_gust;
+        sum->max_wind_gust_std = max_wind_gust_std;
+    }
+}
 
-    extract_daily_summary_for_column(sums, nbm, "TMIN12hr_2 m above ground", keep_all,
-                                     summary_date_06z, kelvin_to_fahrenheit, accum_last,
-                                     daily_summary_new, daily_summary_access_min_t);
+/** Build a sorted list (\c TimeSeries) of daily summaries from an \c NBMData object.
+ *
+ * All the columns are read in a single pass over the rows.
+ */
+static TimeSeries *
+build_daily_summaries(NBMData const *nbm)
+{
+    struct NBMDataCursorColumn cols[NUM_DAILY_COLUMNS + NUM_WIND_COLUMNS] = {0};
+    for (size_t i = 0; i < NUM_DAILY_COLUMNS; i++) {
+        cols[i] = (struct NBMDataCursorColumn){daily_columns[i].name, NBM_DATA_COLUMN_OPTIONAL};
+    }
+    for (size_t i = 0; i < NUM_WIND_COLUMNS; i++) {
+        cols[NUM_DAILY_COLUMNS + i] =
+            (struct NBMDataCursorColumn){wind_columns[i], NBM_DATA_COLUMN_OPTIONAL};
+    }
 
-    extract_daily_summary_for_column(sums, nbm, "TMIN12hr_2 m above ground_ens std dev", keep_all,
-                                     summary_date_06z, change_in_kelvin_to_change_in_fahrenheit,
-                                     accum_last, daily_summary_new, daily_summary_access_min_t_std);
+    size_t const num_cols = NUM_DAILY_COLUMNS + NUM_WIND_COLUMNS;
+    NBMDataRowCursor *cur = nbm_data_row_cursor_new(nbm, num_cols, cols);
+    Stopif(!cur, exit(EXIT_FAILURE), "error creating cursor for daily summaries");
 
-    extract_daily_summary_for_column(sums, nbm, "MINRH12hr_2 m above ground", keep_all,
-                                     summary_date_06z, id_func, accum_last, daily_summary_new,
-                                     daily_summary_access_min_rh);
+    TimeSeries *sums = time_series_new(16, free);
 
-    extract_daily_summary_for_column(sums, nbm, "MAXRH12hr_2 m above ground", keep_all,
-                                     summary_date_06z, id_func, accum_last, daily_summary_new,
-                                     daily_summary_access_max_rh);
+    while (nbm_data_row_cursor_next(cur)) {
+        time_t valid_time = nbm_data_row_cursor_valid_time(cur);
+        time_t date = summary_date_06z(&valid_time);
 
-    extract_daily_summary_for_column(sums, nbm, "APCP24hr_surface", keep_all, summary_date_06z,
-                                     mm_to_in, accum_last, daily_summary_new,
-                                     daily_summary_access_precip);
+        struct DailySummary *sum = 0;
+        for (size_t i = 0; i < NUM_DAILY_COLUMNS; i++) {
+            struct DailyColumn const *col = &daily_columns[i];
 
-    extract_daily_summary_for_column(sums, nbm, "ASNOW6hr_surface", keep_all, summary_date_06z,
-                                     m_to_in, accum_sum, daily_summary_new,
-                                     daily_summary_access_snow);
+            double val = nbm_data_row_cursor_value(cur, i);
+            if (isnan(val) || !col->filter(&valid_time)) {
+                continue;
+            }
 
-    extract_daily_summary_for_column(sums, nbm, "TSTM12hr_surface_probability forecast", keep_all,
-                                     summary_date_06z, id_func, accum_max, daily_summary_new,
-                                     daily_summary_access_prob_ltg);
+            if (!sum) {
+                sum = daily_summary_for_date(sums, date);
+            }
+            double *sum_val = col->extract(sum);
+            *sum_val = col->accumulate(*sum_val, col->convert(val));
+        }
 
-    extract_daily_summary_for_column(sums, nbm, "TCDC_surface", keep_mrn, summary_date_06z, id_func,
-                                     accum_max, daily_summary_new, daily_summary_access_mrn_sky);
+        double wind[NUM_WIND_COLUMNS] = {0};
+        bool has_wind = true;
+        for (size_t i = 0; i < NUM_WIND_COLUMNS; i++) {
+            wind[i] = nbm_data_row_cursor_value(cur, NUM_DAILY_COLUMNS + i);
+            has_wind &= !isnan(wind[i]);
+        }
 
-    extract_daily_summary_for_column(sums, nbm, "TCDC_surface", keep_aft, summary_date_06z, id_func,
-                                     accum_max, daily_summary_new, daily_summary_access_aft_sky);
+        if (has_wind) {
+            if (!sum) {
+                sum = daily_summary_for_date(sums, date);
+            }
+            add_max_winds_to_summary(sum, wind);
+        }
+    }
 
-    extract_max_winds_to_summary(sums, nbm);
+    nbm_data_row_cursor_free(&cur);
 
     return sums;
 }
@@ -250,7 +292,8 @@ build_title(NBMData const *nbm, Table *tbl)
 {
     char title_buf[256] = {0};
     time_t init_time = nbm_data_init_time(nbm);
-    struct tm init = *gmtime(&init_time);
+    struct tm init = {0};
+    gmtime_r(&init_time, &init);
     sprintf(title_buf, "Daily Summary for %s (%s) - ", nbm_data_site_name(nbm),
             nbm_data_site_id(nbm));
     int len = strlen(title_buf);
@@ -272,7 +315,8 @@ add_row_to_table(void *key, void *value, void *state)
         return false;
 
     char datebuf[64] = {0};
-    strftime(datebuf, sizeof(datebuf), " %a, %Y-%m-%d ", gmtime(vt));
+    struct tm vt_tm = {0};
+    strftime(datebuf, sizeof(datebuf), " %a, %Y-%m-%d ", gmtime_r(vt, &vt_tm));
 
     table_set_string_value(tbl, 0, row, strlen(datebuf), datebuf);
     table_set_avg_std(tbl, 1, row, sum->min_t_f, sum->min_t_std);
@@ -296,12 +340,12 @@ add_row_to_table(void *key, void *value, void *state)
  *                                    External API functions.
  *-----------------------------------------------------------------------------------------------*/
 void
-show_daily_summary(NBMData const *nbm)
+show_daily_summary(NBMData const *nbm, FILE *out)
 {
-    GTree *sums = build_daily_summaries(nbm);
+    TimeSeries *sums = build_daily_summaries(nbm);
 
     // --
-    Table *tbl = table_new(12, g_tree_nnodes(sums));
+    Table *tbl = table_new(12, time_series_len(sums));
 
     build_title(nbm, tbl);
 
@@ -325,11 +369,45 @@ show_daily_summary(NBMData const *nbm)
     table_set_blank_value(tbl, 11, 0.0);
 
     struct TableFillerState state = {.row = 0, .tbl = tbl};
-    g_tree_foreach(sums, add_row_to_table, &state);
+    time_series_foreach(sums, add_row_to_table, &state);
 
-    table_display(tbl, stdout);
+    table_display(tbl, out);
 
     table_free(&tbl);
 
-    g_tree_unref(sums);
+    time_series_free(&sums);
+}
+
+void
+daily_summary_write_records(NBMData const *nbm, RecordWriter *w)
+{
+    TimeSeries *sums = build_daily_summaries(nbm);
+
+    for (size_t i = 0; i < time_series_len(sums); i++) {
+        struct DailySummary const *sum = time_series_value(sums, i);
+        if (daily_summary_not_printable(sum)) {
+            continue;
+        }
+
+        record_begin(w, "daily", time_series_time(sums, i));
+        record_add_value(w, "min_t", sum->min_t_f);
+        record_add_value(w, "min_t_std", sum->min_t_std);
+        record_add_value(w, "max_t", sum->max_t_f);
+        record_add_value(w, "max_t_std", sum->max_t_std);
+        record_add_value(w, "max_rh", sum->max_rh);
+        record_add_value(w, "min_rh", sum->min_rh);
+        record_add_value(w, "max_wind_dir", sum->max_wind_dir);
+        record_add_value(w, "max_wind_spd", sum->max_wind_mph);
+        record_add_value(w, "max_wind_spd_std", sum->max_wind_std);
+        record_add_value(w, "max_wind_gust", sum->max_wind_gust);
+        record_add_value(w, "max_wind_gust_std", sum->max_wind_gust_std);
+        record_add_value(w, "morning_sky", sum->mrn_sky);
+        record_add_value(w, "afternoon_sky", sum->aft_sky);
+        record_add_value(w, "prob_ltg", sum->prob_ltg);
+        record_add_value(w, "precip", sum->precip);
+        record_add_value(w, "snow", sum->snow);
+        record_end(w);
+    }
+
+    time_series_free(&sums);
 }
@@ -1,8 +1,14 @@
 #pragma once
 
+#include <stdio.h>
+
 #include "nbm_data.h"
+#include "records.h"
 
 /**
  * Print a summary of the max/min temperatures, humidity, wind, clouds, precipitation, etc.
  */
-void show_daily_summary(NBMData const *);
+void show_daily_summary(NBMData const *, FILE *out);
+
+/** Write the same daily summary as \ref show_daily_summary() as machine readable records. */
+void daily_summary_write_records(NBMData const *nbm, RecordWriter *w);
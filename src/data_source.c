@@ -0,0 +1,822 @@
+#include "data_source.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <curl/curl.h>
+#include <glib.h>
+
+#include "metrics.h"
+
+#define URL_LENGTH 1024
+#define PATH_LENGTH 1024
+
+extern bool global_verbose;
+
+/*-------------------------------------------------------------------------------------------------
+ *                                    Archive Layout
+ *-----------------------------------------------------------------------------------------------*/
+/** The default location to get data from. */
+static char const *const archive_base_url = "https://hwp-viz.gsd.esrl.noaa.gov/wave1d/data/archive/";
+
+// clang-format off
+/** The directory each version of the NBM is stored under and when it started, newest first. */
+static struct NBMVersion {
+    int year;
+    int month;
+    int day;
+    int hour;
+    char const *dir;
+} const nbm_versions[] = {
+    {.year = 2024, .month = 5, .day = 15, .hour = 11, .dir = "NBM4.2"},
+    {.year = 2023, .month = 1, .day = 11, .hour =  0, .dir = "NBM4.1"},
+    {.year = 2020, .month = 9, .day = 23, .hour =  0, .dir = "NBM4.0"},
+};
+// clang-format on
+
+/** The directory used for anything before the first version listed in \c nbm_versions. */
+static char const *const nbm_original_version_dir = "NBM";
+
+static char const *
+nbm_version_dir(time_t init_time)
+{
+    for (size_t i = 0; i < sizeof(nbm_versions) / sizeof(nbm_versions[0]); i++) {
+        struct NBMVersion const *v = &nbm_versions[i];
+        struct tm starts_tm = {
+            .tm_year = v->year - 1900, .tm_mon = v->month - 1, .tm_mday = v->day, .tm_hour = v->hour};
+
+        if (init_time > timegm(&starts_tm)) {
+            return v->dir;
+        }
+    }
+
+    return nbm_original_version_dir;
+}
+
+int
+data_source_archive_path(size_t buf_len, char buf[buf_len], char const file_name[static 1],
+                         time_t init_time)
+{
+    assert(file_name);
+
+    struct tm init = {0};
+    gmtime_r(&init_time, &init);
+
+    int len = snprintf(buf, buf_len, "%4d/%02d/%02d/%s/%02d/%s", init.tm_year + 1900,
+                       init.tm_mon + 1, init.tm_mday, nbm_version_dir(init_time), init.tm_hour,
+                       file_name);
+
+    return len < buf_len ? len : -1;
+}
+
+/*-------------------------------------------------------------------------------------------------
+ *                                    Backend Interface
+ *-----------------------------------------------------------------------------------------------*/
+/** Retrieve a file given its path relative to the root of the archive. */
+typedef struct TextBuffer (*FetchFunc)(char const *root, char const *archive_path);
+
+/** Retrieve several files at once, given their paths relative to the root of the archive.
+ *
+ * Backends that can't do any better than one at a time leave this as \c 0.
+ */
+typedef void (*FetchManyFunc)(char const *root, size_t num_files,
+                              char const *const archive_paths[num_files],
+                              struct TextBuffer bufs[num_files]);
+
+static struct TextBuffer http_fetch(char const *root, char const *archive_path);
+static void http_fetch_many(char const *root, size_t num_files,
+                            char const *const archive_paths[num_files],
+                            struct TextBuffer bufs[num_files]);
+static struct TextBuffer local_fetch(char const *root, char const *archive_path);
+static struct TextBuffer replay_fetch(char const *root, char const *archive_path);
+static bool replay_load_index(char const *bundle_dir);
+static void record_result(char const *archive_path, struct TextBuffer const *buf);
+static bool recording_active(void);
+
+/** The currently selected backend. */
+static struct DataSource {
+    enum DataSourceType type;
+    char *root;
+    FetchFunc fetch;
+    FetchManyFunc fetch_many;
+} source = {
+    .type = DATA_SOURCE_ARCHIVE, .root = 0, .fetch = http_fetch, .fetch_many = http_fetch_many};
+
+void
+data_source_select(enum DataSourceType type, char const *root)
+{
+    assert(type == DATA_SOURCE_ARCHIVE || root);
+
+    free(source.root);
+    source.root = 0;
+
+    switch (type) {
+    case DATA_SOURCE_ARCHIVE:
+        source.fetch = http_fetch;
+        source.fetch_many = http_fetch_many;
+        break;
+    case DATA_SOURCE_MIRROR:
+        source.fetch = http_fetch;
+        source.fetch_many = http_fetch_many;
+        source.root = strdup(root);
+        break;
+    case DATA_SOURCE_LOCAL:
+        source.fetch = local_fetch;
+        source.fetch_many = 0;
+        source.root = strdup(root);
+        break;
+    case DATA_SOURCE_REPLAY:
+        Stopif(!replay_load_index(root), exit(EXIT_FAILURE), "Unable to load replay bundle %s",
+               root);
+        source.fetch = replay_fetch;
+        source.fetch_many = 0;
+        source.root = strdup(root);
+        break;
+    default:
+        assert(false);
+    }
+
+    source.type = type;
+}
+
+enum DataSourceType
+data_source_type(void)
+{
+    return source.type;
+}
+
+bool
+data_source_uses_cache(void)
+{
+    return source.type != DATA_SOURCE_LOCAL && source.type != DATA_SOURCE_REPLAY &&
+           !recording_active();
+}
+
+char const *
+data_source_description(void)
+{
+    return source.root ? source.root : archive_base_url;
+}
+
+struct TextBuffer
+data_source_fetch(char const file_name[static 1], time_t init_time)
+{
+    assert(file_name);
+
+    char archive_path[PATH_LENGTH] = {0};
+    int len = data_source_archive_path(sizeof(archive_path), archive_path, file_name, init_time);
+    Stopif(len < 0, return text_buffer_with_capacity(0), "Archive path too long for %s",
+           file_name);
+
+    struct TextBuffer buf = source.fetch(source.root, archive_path);
+    record_result(archive_path, &buf);
+
+    return buf;
+}
+
+void
+data_source_fetch_many(size_t num_files, char const *const file_names[num_files], time_t init_time,
+                       struct TextBuffer bufs[num_files])
+{
+    if (num_files == 0) {
+        return;
+    }
+
+    char(*paths)[PATH_LENGTH] = calloc(num_files, PATH_LENGTH);
+    char const **path_ptrs = calloc(num_files, sizeof(char const *));
+    assert(paths && path_ptrs);
+
+    for (size_t i = 0; i < num_files; i++) {
+        int len = data_source_archive_path(PATH_LENGTH, paths[i], file_names[i], init_time);
+        Stopif(len < 0, exit(EXIT_FAILURE), "Archive path too long for %s", file_names[i]);
+        path_ptrs[i] = paths[i];
+    }
+
+    if (source.fetch_many) {
+        source.fetch_many(source.root, num_files, path_ptrs, bufs);
+    } else {
+        for (size_t i = 0; i < num_files; i++) {
+            bufs[i] = source.fetch(source.root, path_ptrs[i]);
+        }
+    }
+
+    for (size_t i = 0; i < num_files; i++) {
+        record_result(path_ptrs[i], &bufs[i]);
+    }
+
+    free(path_ptrs);
+    free(paths);
+}
+
+/*-------------------------------------------------------------------------------------------------
+ *                                HTTP Backend (archive or mirror)
+ *-----------------------------------------------------------------------------------------------*/
+/** Format the archive path for use in a URL.
+ *
+ * If it contains a site name then the spaces need to be replaced with the "%20" string.
+ */
+static void
+format_path_for_url(int buf_len, char url_path[buf_len], char const archive_path[static 1])
+{
+    assert(archive_path);
+
+    // Copy into the new string exactly, except replace ' ' by "%20"
+    int j = 0;
+    for (int i = 0; archive_path[i]; i++) {
+        Stopif(j >= buf_len - 3, exit(EXIT_FAILURE), "URL Buffer overflow");
+        if (isspace(archive_path[i])) {
+            url_path[j] = '%';
+            url_path[j + 1] = '2';
+            url_path[j + 2] = '0';
+            j += 3;
+        } else {
+            url_path[j] = archive_path[i];
+            j += 1;
+        }
+    }
+    url_path[j] = '\0';
+}
+
+/** Build the full URL for a file in the archive.
+ *
+ * \returns \c false if it didn't fit in the buffer.
+ */
+static bool
+build_url(char const *root, char const archive_path[static 1], int buf_len, char url[buf_len])
+{
+    char const *base_url = root ? root : archive_base_url;
+    size_t base_len = strlen(base_url);
+    char const *separator = base_len > 0 && base_url[base_len - 1] == '/' ? "" : "/";
+
+    char url_path[PATH_LENGTH] = {0};
+    format_path_for_url(sizeof(url_path), url_path, archive_path);
+
+    int url_len = snprintf(url, buf_len, "%s%s%s", base_url, separator, url_path);
+    Stopif(url_len >= buf_len, return false, "URL too long: %s%s%s", base_url, separator,
+           url_path);
+
+    return true;
+}
+
+/** Write callback for cURL. */
+static size_t
+write_callback(void *contents, size_t size, size_t nmemb, void *userp)
+{
+    size_t realsize = size * nmemb;
+    struct TextBuffer *buf = userp;
+    char *text = contents;
+
+    text_buffer_append(buf, realsize, text);
+
+    return realsize;
+}
+
+/** How long to wait for a connection to the archive. */
+#define CONNECT_TIMEOUT_SECS 20
+
+/** A transfer slower than LOW_SPEED_BYTES per second for LOW_SPEED_SECS is given up on. */
+#define LOW_SPEED_BYTES 64
+#define LOW_SPEED_SECS 30
+
+/** Set the options common to all transfers on a cURL easy handle. */
+static CURLcode
+configure_easy_handle(CURL *handle)
+{
+    CURLcode res = curl_easy_setopt(handle, CURLOPT_FAILONERROR, true);
+    Stopif(res, return res, "curl_easy_setopt failed to set fail on error.");
+
+    res = curl_easy_setopt(handle, CURLOPT_WRITEFUNCTION, write_callback);
+    Stopif(res, return res, "curl_easy_setopt failed to set the write_callback.");
+
+    res = curl_easy_setopt(handle, CURLOPT_USERAGENT, "libcurl-agent/1.0");
+    Stopif(res, return res, "curl_easy_setopt failed to set the user agent.");
+
+    // A stalled archive shouldn't hang the thread waiting on it forever.
+    res = curl_easy_setopt(handle, CURLOPT_CONNECTTIMEOUT, (long)CONNECT_TIMEOUT_SECS);
+    Stopif(res, return res, "curl_easy_setopt failed to set the connect timeout.");
+
+    res = curl_easy_setopt(handle, CURLOPT_LOW_SPEED_LIMIT, (long)LOW_SPEED_BYTES);
+    Stopif(res, return res, "curl_easy_setopt failed to set the low speed limit.");
+
+    res = curl_easy_setopt(handle, CURLOPT_LOW_SPEED_TIME, (long)LOW_SPEED_SECS);
+    Stopif(res, return res, "curl_easy_setopt failed to set the low speed time.");
+
+    // Timeouts use signals otherwise, which isn't safe with several threads.
+    res = curl_easy_setopt(handle, CURLOPT_NOSIGNAL, 1L);
+    Stopif(res, return res, "curl_easy_setopt failed to turn off signals.");
+
+    return CURLE_OK;
+}
+
+/** Has curl_global_init() been called yet? */
+static bool curl_initialized = false;
+
+/** Serializes access to the global cURL state so requests can come from several threads. */
+static GMutex curl_lock;
+
+/** Call curl_global_init() if it hasn't been yet, only call this while holding \c curl_lock. */
+static bool
+initialize_curl_locked(void)
+{
+    if (!curl_initialized) {
+        CURLcode err = curl_global_init(CURL_GLOBAL_DEFAULT);
+        Stopif(err, return false, "Failed to initialize curl");
+        curl_initialized = true;
+    }
+
+    return true;
+}
+
+static bool
+initialize_curl(void)
+{
+    g_mutex_lock(&curl_lock);
+    bool success = initialize_curl_locked();
+    g_mutex_unlock(&curl_lock);
+
+    return success;
+}
+
+/** Global curl handle, only use it while holding \c curl_lock. */
+static CURL *curl = 0;
+
+static CURL *
+get_curl_handle(struct TextBuffer *buf)
+{
+    CURLcode res = 0;
+    if (!curl) {
+        Stopif(!initialize_curl_locked(), goto ERR_RETURN, "Error initializing cURL.");
+
+        curl = curl_easy_init();
+        Stopif(!curl, goto ERR_RETURN, "curl_easy_init failed.");
+
+        res = configure_easy_handle(curl);
+        Stopif(res, goto ERR_RETURN, "Error configuring cURL handle.");
+    }
+
+    res = curl_easy_setopt(curl, CURLOPT_WRITEDATA, buf);
+    Stopif(res, goto ERR_RETURN, "curl_easy_setopt failed to set the user data.");
+
+    return curl;
+
+ERR_RETURN:
+    return 0;
+}
+
+/** Record how long a finished transfer took and how much it got in the metrics. */
+static void
+record_transfer_metrics(CURL *handle, enum MetricsDownload result)
+{
+    curl_off_t total_us = 0;
+    curl_off_t num_bytes = 0;
+    curl_easy_getinfo(handle, CURLINFO_TOTAL_TIME_T, &total_us);
+    if (result == METRICS_DOWNLOAD_OK) {
+        curl_easy_getinfo(handle, CURLINFO_SIZE_DOWNLOAD_T, &num_bytes);
+    }
+
+    metrics_download(result, total_us / 1.0e6, num_bytes);
+}
+
+/** Check the result of a transfer, a 404 is not an error, the file just isn't there (yet).
+ *
+ * \returns \c true if the transfer succeeded or the file was not available.
+ */
+static bool
+check_transfer_result(CURL *handle, CURLcode res, char const *url)
+{
+    enum MetricsDownload result = res ? METRICS_DOWNLOAD_ERROR : METRICS_DOWNLOAD_OK;
+
+    if (res) {
+        long response_code = 0;
+        CURLcode res2 = curl_easy_getinfo(handle, CURLINFO_RESPONSE_CODE, &response_code);
+        Stopif(res2, record_transfer_metrics(handle, result); return false,
+               "curl_easy_getinfo failed: %s", curl_easy_strerror(res2));
+
+        if (response_code == 404) {
+            res = CURLE_OK; // 0
+            result = METRICS_DOWNLOAD_NOT_FOUND;
+            if (global_verbose) {
+                printf("file not available: %s\n", url);
+            }
+        }
+    }
+
+    record_transfer_metrics(handle, result);
+
+    Stopif(res, return false, "curl_easy_perform failed: %s \n%s", curl_easy_strerror(res), url);
+
+    return true;
+}
+
+static struct TextBuffer
+http_fetch(char const *root, char const *archive_path)
+{
+    struct TextBuffer buf = text_buffer_with_capacity(0);
+
+    char url[URL_LENGTH] = {0};
+    Stopif(!build_url(root, archive_path, sizeof(url), url), return buf, "Error building URL.");
+
+    g_mutex_lock(&curl_lock);
+
+    CURL *lcl_curl = get_curl_handle(&buf);
+    Stopif(!lcl_curl, goto ERR_RETURN, "Error setting up cURL.");
+
+    int res = curl_easy_setopt(lcl_curl, CURLOPT_URL, url);
+    Stopif(res, goto ERR_RETURN, "curl_easy_setopt failed to set the url.");
+    res = curl_easy_perform(lcl_curl);
+
+    Stopif(!check_transfer_result(lcl_curl, res, url), goto ERR_RETURN, "Error downloading.");
+
+    g_mutex_unlock(&curl_lock);
+
+    if (!text_buffer_is_empty(buf) && global_verbose) {
+        printf("Successfully downloaded: %s\n", url);
+    }
+
+    return buf;
+
+ERR_RETURN:
+    g_mutex_unlock(&curl_lock);
+    text_buffer_clear(&buf);
+    return buf;
+}
+
+/** The maximum number of simultaneous connections to the server for http_fetch_many(). */
+#define MAX_CONCURRENT_DOWNLOADS 8
+
+static void
+http_fetch_many(char const *root, size_t num_files, char const *const archive_paths[num_files],
+                struct TextBuffer bufs[num_files])
+{
+    CURLM *multi = 0;
+    CURL **handles = calloc(num_files, sizeof(CURL *));
+    char(*urls)[URL_LENGTH] = calloc(num_files, URL_LENGTH);
+    assert(handles && urls);
+
+    for (size_t i = 0; i < num_files; i++) {
+        bufs[i] = text_buffer_with_capacity(0);
+    }
+
+    Stopif(!initialize_curl(), goto CLEAN_UP, "Error initializing cURL.");
+
+    multi = curl_multi_init();
+    Stopif(!multi, goto CLEAN_UP, "curl_multi_init failed.");
+
+    CURLMcode mres = curl_multi_setopt(multi, CURLMOPT_MAX_TOTAL_CONNECTIONS,
+                                       (long)MAX_CONCURRENT_DOWNLOADS);
+    Stopif(mres, goto CLEAN_UP, "curl_multi_setopt failed: %s", curl_multi_strerror(mres));
+
+    for (size_t i = 0; i < num_files; i++) {
+        if (!build_url(root, archive_paths[i], URL_LENGTH, urls[i])) {
+            continue;
+        }
+
+        CURL *handle = curl_easy_init();
+        Stopif(!handle, goto CLEAN_UP, "curl_easy_init failed.");
+        handles[i] = handle;
+
+        Stopif(configure_easy_handle(handle), goto CLEAN_UP, "Error configuring cURL handle.");
+        Stopif(curl_easy_setopt(handle, CURLOPT_WRITEDATA, &bufs[i]), goto CLEAN_UP,
+               "curl_easy_setopt failed to set the user data.");
+        Stopif(curl_easy_setopt(handle, CURLOPT_URL, urls[i]), goto CLEAN_UP,
+               "curl_easy_setopt failed to set the url.");
+        Stopif(curl_easy_setopt(handle, CURLOPT_PRIVATE, (void *)i), goto CLEAN_UP,
+               "curl_easy_setopt failed to set the private data.");
+
+        mres = curl_multi_add_handle(multi, handle);
+        Stopif(mres, goto CLEAN_UP, "curl_multi_add_handle failed: %s", curl_multi_strerror(mres));
+    }
+
+    int still_running = 0;
+    do {
+        mres = curl_multi_perform(multi, &still_running);
+        Stopif(mres, goto CLEAN_UP, "curl_multi_perform failed: %s", curl_multi_strerror(mres));
+
+        if (still_running) {
+            mres = curl_multi_wait(multi, 0, 0, 1000, 0);
+            Stopif(mres, goto CLEAN_UP, "curl_multi_wait failed: %s", curl_multi_strerror(mres));
+        }
+
+        CURLMsg *msg = 0;
+        int msgs_left = 0;
+        while ((msg = curl_multi_info_read(multi, &msgs_left))) {
+            if (msg->msg != CURLMSG_DONE) {
+                continue;
+            }
+
+            void *private = 0;
+            curl_easy_getinfo(msg->easy_handle, CURLINFO_PRIVATE, &private);
+            size_t i = (size_t)private;
+
+            if (!check_transfer_result(msg->easy_handle, msg->data.result, urls[i])) {
+                text_buffer_clear(&bufs[i]);
+            } else if (!text_buffer_is_empty(bufs[i]) && global_verbose) {
+                printf("Successfully downloaded: %s\n", urls[i]);
+            }
+        }
+    } while (still_running);
+
+CLEAN_UP:
+    for (size_t i = 0; i < num_files; i++) {
+        if (handles[i]) {
+            if (multi) {
+                curl_multi_remove_handle(multi, handles[i]);
+            }
+            curl_easy_cleanup(handles[i]);
+        }
+    }
+
+    if (multi) {
+        curl_multi_cleanup(multi);
+    }
+
+    free(urls);
+    free(handles);
+}
+
+/*-------------------------------------------------------------------------------------------------
+ *                                Local Directory Mirror Backend
+ *-----------------------------------------------------------------------------------------------*/
+static struct TextBuffer
+local_fetch(char const *root, char const *archive_path)
+{
+    assert(root);
+
+    struct TextBuffer buf = text_buffer_with_capacity(0);
+    int fd = -1;
+    void *mapped = MAP_FAILED;
+    struct stat info = {0};
+
+    char path[PATH_LENGTH] = {0};
+    int path_len = snprintf(path, sizeof(path), "%s/%s", root, archive_path);
+    Stopif(path_len >= sizeof(path), goto ERR_RETURN, "Path too long: %s/%s", root, archive_path);
+
+    fd = open(path, O_RDONLY);
+    if (fd < 0 && errno == ENOENT) {
+        // Same as a 404, not an error, just not there.
+        if (global_verbose) {
+            printf("file not available: %s\n", path);
+        }
+        return buf;
+    }
+    Stopif(fd < 0, goto ERR_RETURN, "Error opening %s: %s", path, strerror(errno));
+
+    Stopif(fstat(fd, &info), goto ERR_RETURN, "Error reading file size %s: %s", path,
+           strerror(errno));
+
+    if (info.st_size > 0) {
+        size_t file_size = info.st_size;
+        mapped = mmap(0, file_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        Stopif(mapped == MAP_FAILED, goto ERR_RETURN, "Error mapping %s: %s", path,
+               strerror(errno));
+
+        // Read it straight out of the page cache into a right sized buffer, the rest of the
+        // program expects to own the text it parses.
+        buf = text_buffer_with_capacity(file_size + 1);
+        text_buffer_append(&buf, file_size, mapped);
+
+        munmap(mapped, file_size);
+    }
+
+    close(fd);
+
+    if (!text_buffer_is_empty(buf) && global_verbose) {
+        printf("Successfully read: %s\n", path);
+    }
+
+    return buf;
+
+ERR_RETURN:
+    if (fd >= 0) {
+        close(fd);
+    }
+    text_buffer_clear(&buf);
+    return buf;
+}
+
+/*-------------------------------------------------------------------------------------------------
+ *                                   Replay Bundle Backend
+ *-----------------------------------------------------------------------------------------------*/
+/* A replay bundle is a directory with an index and the bodies of the files that were retrieved.
+ *
+ * The index, index.tsv, has a line for each retrieval with the status, the number of bytes, the
+ * path relative to the root of the archive, and the URL or local path it came from, separated by
+ * tabs. Lines starting with '#' are comments. A status of 200 means the file was retrieved and its
+ * body is in files/ under its archive path, 404 means it wasn't available. Errors are recorded as
+ * 404s too, since they look the same to the rest of the program.
+ *
+ * If a path was retrieved more than once, the last line for it wins.
+ */
+#define REPLAY_INDEX_NAME "index.tsv"
+#define REPLAY_FILES_DIR "files"
+
+/** The status recorded for each archive path in the bundle being replayed. */
+static GHashTable *replay_index = 0;
+
+static bool
+replay_load_index(char const *bundle_dir)
+{
+    char path[PATH_LENGTH] = {0};
+    int path_len = snprintf(path, sizeof(path), "%s/" REPLAY_INDEX_NAME, bundle_dir);
+    Stopif(path_len >= sizeof(path), return false, "Path too long: %s", bundle_dir);
+
+    FILE *index = fopen(path, "r");
+    Stopif(!index, return false, "Unable to open %s: %s", path, strerror(errno));
+
+    if (replay_index) {
+        g_hash_table_destroy(replay_index);
+    }
+    replay_index = g_hash_table_new_full(g_str_hash, g_str_equal, free, 0);
+
+    char line[2 * PATH_LENGTH] = {0};
+    int line_num = 0;
+    while (fgets(line, sizeof(line), index)) {
+        line_num++;
+        if (line[0] == '#' || line[0] == '\n') {
+            continue;
+        }
+
+        int status = 0;
+        size_t num_bytes = 0;
+        int archive_path_start = 0;
+        int archive_path_end = 0;
+        int num = sscanf(line, "%d\t%zu\t%n%*[^\t]%n", &status, &num_bytes, &archive_path_start,
+                         &archive_path_end);
+        Stopif(num != 2 || archive_path_end == 0 || (status != 200 && status != 404),
+               goto ERR_RETURN, "Invalid line %d in %s", line_num, path);
+
+        line[archive_path_end] = '\0';
+        g_hash_table_replace(replay_index, strdup(&line[archive_path_start]),
+                             GINT_TO_POINTER(status));
+    }
+
+    fclose(index);
+    return true;
+
+ERR_RETURN:
+    fclose(index);
+    g_hash_table_destroy(replay_index);
+    replay_index = 0;
+    return false;
+}
+
+static struct TextBuffer
+replay_fetch(char const *root, char const *archive_path)
+{
+    assert(root && replay_index);
+
+    int status = GPOINTER_TO_INT(g_hash_table_lookup(replay_index, archive_path));
+
+    // The run being replayed never asked for this file, so the results can't be trusted.
+    Stopif(status == 0, exit(EXIT_FAILURE), "%s is not in the replay bundle %s", archive_path,
+           root);
+
+    if (status == 404) {
+        if (global_verbose) {
+            printf("file not available (replayed): %s\n", archive_path);
+        }
+        return text_buffer_with_capacity(0);
+    }
+
+    char files_root[PATH_LENGTH] = {0};
+    snprintf(files_root, sizeof(files_root), "%s/" REPLAY_FILES_DIR, root);
+
+    struct TextBuffer buf = local_fetch(files_root, archive_path);
+    Stopif(text_buffer_is_empty(buf), exit(EXIT_FAILURE), "%s is missing from the replay bundle %s",
+           archive_path, root);
+
+    return buf;
+}
+
+/*-------------------------------------------------------------------------------------------------
+ *                                  Recording Replay Bundles
+ *-----------------------------------------------------------------------------------------------*/
+/** The bundle being recorded, the lock is because files can be retrieved from several threads. */
+static struct {
+    GMutex lock;
+    char *dir;
+    FILE *index;
+} recording = {0};
+
+static bool
+recording_active(void)
+{
+    return recording.index != 0;
+}
+
+/** Make all the directories in a path up to the last '/', like mkdir -p. */
+static bool
+make_parent_dirs(char const path[static 1])
+{
+    char buf[PATH_LENGTH] = {0};
+    Stopif(strlen(path) >= sizeof(buf), return false, "Path too long: %s", path);
+    strcpy(buf, path);
+
+    for (char *c = strchr(buf + 1, '/'); c; c = strchr(c + 1, '/')) {
+        *c = '\0';
+        int res = mkdir(buf, 0774);
+        Stopif(res != 0 && errno != EEXIST, return false, "Unable to make directory %s: %s", buf,
+               strerror(errno));
+        *c = '/';
+    }
+
+    return true;
+}
+
+bool
+data_source_record(char const *bundle_dir)
+{
+    assert(bundle_dir);
+    assert(!recording.index);
+
+    char path[PATH_LENGTH] = {0};
+    int path_len = snprintf(path, sizeof(path), "%s/" REPLAY_INDEX_NAME, bundle_dir);
+    Stopif(path_len >= sizeof(path), return false, "Path too long: %s", bundle_dir);
+    Stopif(!make_parent_dirs(path), return false, "Unable to make %s", bundle_dir);
+
+    recording.index = fopen(path, "w");
+    Stopif(!recording.index, return false, "Unable to open %s: %s", path, strerror(errno));
+
+    fprintf(recording.index, "# status\tbytes\tarchive path\tsource\n");
+    fflush(recording.index);
+
+    recording.dir = strdup(bundle_dir);
+
+    return true;
+}
+
+/** Add the result of retrieving a file to the bundle being recorded, if there is one. */
+static void
+record_result(char const *archive_path, struct TextBuffer const *buf)
+{
+    if (!recording_active()) {
+        return;
+    }
+
+    char from[URL_LENGTH] = {0};
+    if (source.type == DATA_SOURCE_LOCAL) {
+        snprintf(from, sizeof(from), "%s/%s", source.root, archive_path);
+    } else if (!build_url(source.root, archive_path, sizeof(from), from)) {
+        strcpy(from, "-");
+    }
+
+    int status = text_buffer_is_empty(*buf) ? 404 : 200;
+
+    g_mutex_lock(&recording.lock);
+
+    if (status == 200) {
+        char path[PATH_LENGTH] = {0};
+        int path_len = snprintf(path, sizeof(path), "%s/" REPLAY_FILES_DIR "/%s", recording.dir,
+                                archive_path);
+        Stopif(path_len >= sizeof(path), goto UNLOCK, "Path too long: %s", archive_path);
+        Stopif(!make_parent_dirs(path), goto UNLOCK, "Unable to record %s", archive_path);
+
+        FILE *body = fopen(path, "wb");
+        Stopif(!body, goto UNLOCK, "Unable to open %s: %s", path, strerror(errno));
+        size_t num_written = fwrite(buf->byte_data, 1, buf->size, body);
+        int close_res = fclose(body);
+        Stopif(num_written != buf->size || close_res != 0, goto UNLOCK, "Error writing %s", path);
+    }
+
+    fprintf(recording.index, "%d\t%zu\t%s\t%s\n", status, status == 200 ? buf->size : 0,
+            archive_path, from);
+    fflush(recording.index);
+
+UNLOCK:
+    g_mutex_unlock(&recording.lock);
+}
+
+/*-------------------------------------------------------------------------------------------------
+ *                                         Shutdown
+ *-----------------------------------------------------------------------------------------------*/
+void
+data_source_finalize(void)
+{
+    if (curl) {
+        curl_easy_cleanup(curl);
+        curl = 0;
+    }
+
+    if (curl_initialized) {
+        curl_global_cleanup();
+        curl_initialized = false;
+    }
+
+    if (recording.index) {
+        fclose(recording.index);
+        recording.index = 0;
+    }
+    free(recording.dir);
+    recording.dir = 0;
+
+    if (replay_index) {
+        g_hash_table_destroy(replay_index);
+        replay_index = 0;
+    }
+
+    free(source.root);
+    source.root = 0;
+}
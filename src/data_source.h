@@ -0,0 +1,101 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <time.h>
+
+#include "utils.h"
+
+/*-------------------------------------------------------------------------------------------------
+ *                                     Data Source Backends
+ *-----------------------------------------------------------------------------------------------*/
+/** The kinds of places the NBM 1D viewer files can be retrieved from.
+ *
+ * All of them are laid out the same way as the online archive, that is
+ * \c YYYY/MM/DD/NBMx.y/HH/file_name, so a mirror or a local copy of the archive can be swapped in
+ * for the real thing.
+ */
+enum DataSourceType {
+    DATA_SOURCE_ARCHIVE, /**< The NOAA online archive over HTTPS, the default. */
+    DATA_SOURCE_MIRROR,  /**< An alternate HTTP(S) server with the same layout as the archive. */
+    DATA_SOURCE_LOCAL,   /**< A directory on the local file system with the archive layout. */
+    DATA_SOURCE_REPLAY,  /**< A bundle recorded with data_source_record(), nothing else is used. */
+};
+
+/** Select the backend used by data_source_fetch().
+ *
+ * \param type is the kind of backend to use.
+ * \param root is the base URL for a mirror, the root directory of a local copy of the archive, or
+ * the directory of a replay bundle. It is ignored for \c DATA_SOURCE_ARCHIVE and may be \c 0 in
+ * that case. The string is copied.
+ *
+ * Replaying a bundle that can't be loaded is a fatal error. While replaying, asking for a file
+ * the recorded run didn't ask for is also fatal, since the results would not be comparable.
+ */
+void data_source_select(enum DataSourceType type, char const *root);
+
+/** Get the type of the currently selected backend. */
+enum DataSourceType data_source_type(void);
+
+/** Record every file retrieved from now on into a replay bundle.
+ *
+ * The bundle is a directory with an index of the archive paths retrieved, whether they were
+ * available or not, and the contents of those that were. It is replayed by selecting the
+ * \c DATA_SOURCE_REPLAY backend with the same directory.
+ *
+ * \param bundle_dir is the directory to record into, it is created if needed.
+ *
+ * \returns \c false if the bundle couldn't be created.
+ */
+bool data_source_record(char const *bundle_dir);
+
+/** Should the files from the current backend be kept in the download cache?
+ *
+ * Local directories and replay bundles are already on disk, and while recording every file has to
+ * be retrieved from the backend so it ends up in the bundle.
+ */
+bool data_source_uses_cache(void);
+
+/** Get a short description of the currently selected backend, suitable for messages. */
+char const *data_source_description(void);
+
+/** Build the path of a file relative to the root of the archive.
+ *
+ * This accounts for which version of the NBM was running at \a init_time, since each version
+ * lives in its own directory.
+ *
+ * \param buf_len is the size of \a buf.
+ * \param buf is where the path is written.
+ * \param file_name is the name of the file with no directory components.
+ * \param init_time is the NBM initialization time.
+ *
+ * \returns the length of the path or a negative number if it did not fit into the buffer.
+ */
+int data_source_archive_path(size_t buf_len, char buf[buf_len], char const file_name[static 1],
+                             time_t init_time);
+
+/** Retrieve a file from the currently selected backend.
+ *
+ * \param file_name is the name of the file in the archive.
+ * \param init_time is the NBM initialization time, used to find the file in the archive.
+ *
+ * \returns a \c TextBuffer. If the file was not available or there was an error, the buffer will
+ * be empty.
+ */
+struct TextBuffer data_source_fetch(char const file_name[static 1], time_t init_time);
+
+/** Retrieve several files for the same NBM initialization time from the current backend.
+ *
+ * The network backends download the files concurrently.
+ *
+ * \param num_files is the number of files to retrieve.
+ * \param file_names are the names of the files in the archive.
+ * \param init_time is the NBM initialization time, used to find the files in the archive.
+ * \param bufs is where the results are stored, one for each file in \a file_names. If a file was
+ * not available or there was an error, the corresponding buffer will be empty.
+ */
+void data_source_fetch_many(size_t num_files, char const *const file_names[num_files],
+                            time_t init_time, struct TextBuffer bufs[num_files]);
+
+/** Release any resources held by the backends, e.g. cURL handles. */
+void data_source_finalize(void);
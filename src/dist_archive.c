@@ -0,0 +1,462 @@
+#include "dist_archive.h"
+#include "distributions.h"
+#include "utils.h"
+
+#include <assert.h>
+#include <math.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+/*-------------------------------------------------------------------------------------------------
+ *                                         File Layout
+ *-----------------------------------------------------------------------------------------------*/
+#define DIST_ARCHIVE_MAGIC "NBMDIST"
+#define DIST_ARCHIVE_VERSION 1
+#define DIST_ARCHIVE_BYTE_ORDER 0x01020304u
+
+/** The start of the file.
+ *
+ * The sizes of this, the element names, and the index entries are all multiples of 8, so the
+ * data that follows them is aligned.
+ */
+struct FileHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t byte_order;
+    int64_t init_time;
+    char site[16];
+    uint32_t num_elements;
+    uint32_t num_entries;
+    uint64_t num_values;
+};
+
+/** An element name, the table of them follows the header. */
+struct FileElement {
+    char name[DIST_ARCHIVE_ELEMENT_LEN];
+};
+
+/** An entry in the index, which follows the element names. */
+struct FileIndexEntry {
+    int64_t valid_time;
+    uint32_t offset; // In values from the start of the data.
+    uint32_t num_values;
+    uint16_t element;
+    uint16_t kind;
+    uint32_t padding;
+};
+
+static int
+index_entry_compare(void const *a, void const *b)
+{
+    struct FileIndexEntry const *ea = a;
+    struct FileIndexEntry const *eb = b;
+
+    if (ea->element != eb->element)
+        return ea->element < eb->element ? -1 : 1;
+
+    if (ea->kind != eb->kind)
+        return ea->kind < eb->kind ? -1 : 1;
+
+    if (ea->valid_time != eb->valid_time)
+        return ea->valid_time < eb->valid_time ? -1 : 1;
+
+    return 0;
+}
+
+/*-------------------------------------------------------------------------------------------------
+ *                                           Writing
+ *-----------------------------------------------------------------------------------------------*/
+struct DistArchiveWriter {
+    struct FileHeader header;
+
+    struct FileElement *elements;
+    size_t num_elements;
+    size_t elements_capacity;
+
+    struct FileIndexEntry *entries;
+    size_t num_entries;
+    size_t entries_capacity;
+
+    float *values;
+    size_t num_values;
+    size_t values_capacity;
+
+    double *scratch;
+    size_t scratch_capacity;
+};
+
+DistArchiveWriter *
+dist_archive_writer_new(char const *site, time_t init_time)
+{
+    struct DistArchiveWriter *new = calloc(1, sizeof(struct DistArchiveWriter));
+    assert(new);
+
+    memcpy(new->header.magic, DIST_ARCHIVE_MAGIC, sizeof(DIST_ARCHIVE_MAGIC));
+    new->header.version = DIST_ARCHIVE_VERSION;
+    new->header.byte_order = DIST_ARCHIVE_BYTE_ORDER;
+    new->header.init_time = init_time;
+    strncpy(new->header.site, site, sizeof(new->header.site) - 1);
+
+    return new;
+}
+
+/** Grow an array so it can hold at least \a needed items. */
+static void *
+grow_array(void *array, size_t *capacity, size_t needed, size_t item_size)
+{
+    if (needed <= *capacity) {
+        return array;
+    }
+
+    size_t new_cap = *capacity ? *capacity : 64;
+    while (new_cap < needed) {
+        new_cap *= 2;
+    }
+
+    array = realloc(array, new_cap * item_size);
+    Stopif(!array, exit(EXIT_FAILURE), "out of memory");
+    *capacity = new_cap;
+
+    return array;
+}
+
+/** Get a buffer big enough for \a len values to pack a distribution into. */
+static double *
+writer_scratch(struct DistArchiveWriter *writer, size_t len)
+{
+    writer->scratch =
+        grow_array(writer->scratch, &writer->scratch_capacity, len, sizeof(*writer->scratch));
+    return writer->scratch;
+}
+
+/** Add an index entry for the values in the scratch buffer and copy them to the data. */
+static void
+writer_add_entry(struct DistArchiveWriter *writer, uint16_t element, enum DistArchiveKind kind,
+                 time_t valid_time, size_t num_values)
+{
+    Stopif(writer->num_values + num_values > UINT32_MAX, exit(EXIT_FAILURE),
+           "Too much data for a distribution archive.");
+
+    writer->entries = grow_array(writer->entries, &writer->entries_capacity,
+                                 writer->num_entries + 1, sizeof(*writer->entries));
+    writer->values = grow_array(writer->values, &writer->values_capacity,
+                                writer->num_values + num_values, sizeof(*writer->values));
+
+    writer->entries[writer->num_entries] = (struct FileIndexEntry){
+        .valid_time = valid_time,
+        .offset = writer->num_values,
+        .num_values = num_values,
+        .element = element,
+        .kind = kind,
+    };
+    writer->num_entries++;
+
+    for (size_t i = 0; i < num_values; i++) {
+        writer->values[writer->num_values + i] = writer->scratch[i];
+    }
+    writer->num_values += num_values;
+}
+
+void
+dist_archive_add(DistArchiveWriter *writer, char const *element, TimeSeries const *cdfs,
+                 TimeSeries const *pdfs, TimeSeries const *scenarios)
+{
+    assert(writer && element);
+    assert(strlen(element) < DIST_ARCHIVE_ELEMENT_LEN);
+    assert(writer->num_elements < UINT16_MAX);
+
+    writer->elements = grow_array(writer->elements, &writer->elements_capacity,
+                                  writer->num_elements + 1, sizeof(*writer->elements));
+
+    uint16_t el = writer->num_elements;
+    writer->elements[el] = (struct FileElement){{0}};
+    strncpy(writer->elements[el].name, element, DIST_ARCHIVE_ELEMENT_LEN - 1);
+    writer->num_elements++;
+
+    for (size_t i = 0; i < time_series_len(cdfs); i++) {
+        CumulativeDistribution const *cdf = time_series_value(cdfs, i);
+        size_t len = cumulative_dist_packed_len(cdf);
+        cumulative_dist_pack(cdf, len, writer_scratch(writer, len));
+        writer_add_entry(writer, el, DIST_ARCHIVE_CDF, time_series_time(cdfs, i), len);
+    }
+
+    for (size_t i = 0; i < time_series_len(pdfs); i++) {
+        ProbabilityDistribution const *pdf = time_series_value(pdfs, i);
+        size_t len = probability_dist_packed_len(pdf);
+        probability_dist_pack(pdf, len, writer_scratch(writer, len));
+        writer_add_entry(writer, el, DIST_ARCHIVE_PDF, time_series_time(pdfs, i), len);
+    }
+
+    for (size_t i = 0; i < time_series_len(scenarios); i++) {
+        ScenarioList const *list = time_series_value(scenarios, i);
+        size_t len = scenario_list_packed_len(list);
+        scenario_list_pack(list, len, writer_scratch(writer, len));
+        writer_add_entry(writer, el, DIST_ARCHIVE_SCENARIOS, time_series_time(scenarios, i), len);
+    }
+}
+
+bool
+dist_archive_writer_close(DistArchiveWriter **writer_ptr, char const *path)
+{
+    struct DistArchiveWriter *writer = *writer_ptr;
+    bool success = false;
+
+    // The data stays where it is, only the index is sorted.
+    qsort(writer->entries, writer->num_entries, sizeof(struct FileIndexEntry),
+          index_entry_compare);
+
+    writer->header.num_elements = writer->num_elements;
+    writer->header.num_entries = writer->num_entries;
+    writer->header.num_values = writer->num_values;
+
+    FILE *f = fopen(path, "wb");
+    Stopif(!f, goto EXIT, "Unable to open %s", path);
+
+    size_t num_written = fwrite(&writer->header, sizeof(writer->header), 1, f);
+    num_written += fwrite(writer->elements, sizeof(struct FileElement), writer->num_elements, f);
+    num_written += fwrite(writer->entries, sizeof(struct FileIndexEntry), writer->num_entries, f);
+    num_written += fwrite(writer->values, sizeof(float), writer->num_values, f);
+
+    size_t const expected = 1 + writer->num_elements + writer->num_entries + writer->num_values;
+    success = fclose(f) == 0 && num_written == expected;
+    Stopif(!success, goto EXIT, "Error writing %s", path);
+
+EXIT:
+    free(writer->elements);
+    free(writer->entries);
+    free(writer->values);
+    free(writer->scratch);
+    free(writer);
+    *writer_ptr = 0;
+
+    return success;
+}
+
+/*-------------------------------------------------------------------------------------------------
+ *                                           Reading
+ *-----------------------------------------------------------------------------------------------*/
+struct DistArchive {
+    char *data; // The whole file.
+    struct FileHeader const *header;
+    struct FileElement const *elements;
+    struct FileIndexEntry const *entries;
+    float const *values;
+};
+
+/** Check that the header and index describe a file of \a size bytes and point into its parts.
+ */
+static bool
+archive_map(struct DistArchive *archive, size_t size)
+{
+    struct FileHeader const *header = (struct FileHeader const *)archive->data;
+
+    Stopif(memcmp(header->magic, DIST_ARCHIVE_MAGIC, sizeof(DIST_ARCHIVE_MAGIC)) != 0,
+           return false, "Not a distribution archive.");
+    Stopif(header->byte_order != DIST_ARCHIVE_BYTE_ORDER, return false,
+           "Distribution archive was written on a machine with a different byte order.");
+    Stopif(header->version != DIST_ARCHIVE_VERSION, return false,
+           "Unsupported distribution archive version: %u", header->version);
+    Stopif(header->site[sizeof(header->site) - 1] != '\0', return false, "Corrupt site id.");
+
+    // The counts are checked one at a time so a corrupt header can't overflow the sum.
+    size_t available = size - sizeof(struct FileHeader);
+    Stopif(header->num_elements > available / sizeof(struct FileElement), return false,
+           "Truncated distribution archive.");
+    available -= header->num_elements * sizeof(struct FileElement);
+    Stopif(header->num_entries > available / sizeof(struct FileIndexEntry), return false,
+           "Truncated distribution archive.");
+    available -= header->num_entries * sizeof(struct FileIndexEntry);
+    Stopif(available % sizeof(float) != 0 || header->num_values != available / sizeof(float),
+           return false, "Distribution archive is the wrong size.");
+
+    archive->header = header;
+    archive->elements = (struct FileElement const *)(header + 1);
+    archive->entries = (struct FileIndexEntry const *)(archive->elements + header->num_elements);
+    archive->values = (float const *)(archive->entries + header->num_entries);
+
+    for (size_t i = 0; i < header->num_elements; i++) {
+        Stopif(archive->elements[i].name[DIST_ARCHIVE_ELEMENT_LEN - 1] != '\0', return false,
+               "Corrupt distribution archive element %zu.", i);
+    }
+
+    for (size_t i = 0; i < header->num_entries; i++) {
+        struct FileIndexEntry const *entry = &archive->entries[i];
+        Stopif(entry->element >= header->num_elements || entry->kind > DIST_ARCHIVE_SCENARIOS ||
+                   entry->offset > header->num_values ||
+                   entry->num_values > header->num_values - entry->offset,
+               return false, "Corrupt distribution archive index entry %zu.", i);
+    }
+
+    return true;
+}
+
+DistArchive *
+dist_archive_open(char const *path)
+{
+    struct DistArchive *archive = calloc(1, sizeof(struct DistArchive));
+    assert(archive);
+
+    FILE *f = fopen(path, "rb");
+    Stopif(!f, goto ERR_RETURN, "Unable to open %s", path);
+
+    Stopif(fseek(f, 0, SEEK_END) != 0, goto ERR_RETURN, "Unable to read %s", path);
+    long size = ftell(f);
+    Stopif(size < (long)sizeof(struct FileHeader), goto ERR_RETURN, "Too small: %s", path);
+    rewind(f);
+
+    // Memory from malloc is aligned for any type, and so is each part of the file.
+    archive->data = malloc(size);
+    Stopif(!archive->data, exit(EXIT_FAILURE), "out of memory");
+    Stopif(fread(archive->data, 1, size, f) != size, goto ERR_RETURN, "Unable to read %s", path);
+
+    fclose(f);
+    f = 0;
+
+    Stopif(!archive_map(archive, size), goto ERR_RETURN, "Invalid archive: %s", path);
+
+    return archive;
+
+ERR_RETURN:
+    if (f) {
+        fclose(f);
+    }
+    dist_archive_free(&archive);
+    return 0;
+}
+
+void
+dist_archive_free(DistArchive **archive_ptr)
+{
+    struct DistArchive *archive = *archive_ptr;
+
+    if (archive) {
+        free(archive->data);
+        free(archive);
+    }
+
+    *archive_ptr = 0;
+}
+
+char const *
+dist_archive_site(DistArchive const *archive)
+{
+    return archive->header->site;
+}
+
+time_t
+dist_archive_init_time(DistArchive const *archive)
+{
+    return archive->header->init_time;
+}
+
+size_t
+dist_archive_len(DistArchive const *archive)
+{
+    return archive->header->num_entries;
+}
+
+static struct DistArchiveEntry
+entry_from_index(DistArchive const *archive, struct FileIndexEntry const *entry)
+{
+    return (struct DistArchiveEntry){.element = archive->elements[entry->element].name,
+                                     .kind = entry->kind,
+                                     .valid_time = entry->valid_time,
+                                     .num_values = entry->num_values,
+                                     .values = &archive->values[entry->offset]};
+}
+
+struct DistArchiveEntry
+dist_archive_entry(DistArchive const *archive, size_t index)
+{
+    assert(index < archive->header->num_entries);
+    return entry_from_index(archive, &archive->entries[index]);
+}
+
+bool
+dist_archive_find(DistArchive const *archive, char const *element, enum DistArchiveKind kind,
+                  time_t valid_time, struct DistArchiveEntry *entry)
+{
+    // There are only a handful of elements, so they aren't sorted.
+    size_t el = 0;
+    while (el < archive->header->num_elements && strcmp(archive->elements[el].name, element)) {
+        el++;
+    }
+    if (el == archive->header->num_elements) {
+        return false;
+    }
+
+    struct FileIndexEntry key = {.valid_time = valid_time, .element = el, .kind = kind};
+    struct FileIndexEntry const *found =
+        bsearch(&key, archive->entries, archive->header->num_entries,
+                sizeof(struct FileIndexEntry), index_entry_compare);
+    if (!found) {
+        return false;
+    }
+
+    *entry = entry_from_index(archive, found);
+    return true;
+}
+
+/*-------------------------------------------------------------------------------------------------
+ *                                           Dumping
+ *-----------------------------------------------------------------------------------------------*/
+static char const *
+kind_name(enum DistArchiveKind kind)
+{
+    switch (kind) {
+    case DIST_ARCHIVE_CDF:
+        return "cdf";
+    case DIST_ARCHIVE_PDF:
+        return "pdf";
+    case DIST_ARCHIVE_SCENARIOS:
+        return "scenarios";
+    }
+
+    return "unknown";
+}
+
+void
+dist_archive_dump(DistArchive const *archive, FILE *out)
+{
+    char timebuf[64] = {0};
+    struct tm t_tm = {0};
+    time_t init_time = dist_archive_init_time(archive);
+    strftime(timebuf, sizeof(timebuf), "%Y-%m-%d %HZ", gmtime_r(&init_time, &t_tm));
+
+    fprintf(out, "\"Site: %s Init: %s Entries: %zu\"\n", dist_archive_site(archive), timebuf,
+            dist_archive_len(archive));
+
+    for (size_t i = 0; i < dist_archive_len(archive); i++) {
+        struct DistArchiveEntry entry = dist_archive_entry(archive, i);
+        float const *v = entry.values;
+        size_t n = entry.num_values;
+
+        strftime(timebuf, sizeof(timebuf), "%a, %Y-%m-%d %HZ", gmtime_r(&entry.valid_time, &t_tm));
+        fprintf(out, "\n\n\"%s %s: %s\"\n", entry.element, kind_name(entry.kind), timebuf);
+
+        switch (entry.kind) {
+        case DIST_ARCHIVE_CDF:
+            fprintf(out, "# PM: %lf\n", n > 0 ? v[0] : NAN);
+            for (size_t j = 1; j + 1 < n; j += 2) {
+                fprintf(out, "%8lf %8lf\n", v[j], v[j + 1]);
+            }
+            break;
+
+        case DIST_ARCHIVE_PDF:
+            // Print the center of each bin like probability_dist_write(), each bin starts at the
+            // upper edge of the one before it.
+            for (size_t j = 1; j + 1 < n; j += 2) {
+                double lower = j == 1 ? v[0] : v[j - 2];
+                fprintf(out, "%8lf %8lf\n", (lower + v[j]) / 2.0, v[j + 1]);
+            }
+            break;
+
+        case DIST_ARCHIVE_SCENARIOS:
+            for (size_t j = 0; j + 3 < n; j += 4) {
+                fprintf(out, "%8lf %8lf %8lf %8lf\n", v[j], v[j + 1], v[j + 2], v[j + 3]);
+            }
+            break;
+        }
+    }
+}
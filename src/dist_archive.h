@@ -0,0 +1,107 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stdio.h>
+#include <time.h>
+
+#include "time_series.h"
+
+/*-------------------------------------------------------------------------------------------------
+ *                                  Distribution Archive Files
+ *-----------------------------------------------------------------------------------------------*/
+/* A binary file with the CDFs, PDFs, and scenarios of every summary for one site and model run.
+ *
+ * The file is a header, a table of element names, an index, and then the data. The index has one
+ * entry for each element, kind, and valid time, sorted in that order, with the offset and number
+ * of values of the entry in the data. The data is only an array of single precision floats, laid
+ * out as described by cumulative_dist_pack(), probability_dist_pack(), and scenario_list_pack().
+ *
+ * Everything is in the byte order of the machine that wrote it, files from a machine with a
+ * different byte order are rejected.
+ */
+
+/** What an entry in a distribution archive holds. */
+enum DistArchiveKind {
+    DIST_ARCHIVE_CDF,
+    DIST_ARCHIVE_PDF,
+    DIST_ARCHIVE_SCENARIOS,
+};
+
+/** The longest element name that can be stored, including the terminating null character. */
+#define DIST_ARCHIVE_ELEMENT_LEN 32
+
+/** Collects distributions and writes them to an archive file. */
+typedef struct DistArchiveWriter DistArchiveWriter;
+
+/** Start a new archive.
+ *
+ * Nothing is written until dist_archive_writer_close().
+ *
+ * \param site is the site identifier.
+ * \param init_time is the model initialization time of the data.
+ */
+DistArchiveWriter *dist_archive_writer_new(char const *site, time_t init_time);
+
+/** Add all the distributions of an element.
+ *
+ * \param writer is the archive to add to.
+ * \param element names what was summarized, e.g. \c precip_24h. It must be shorter than
+ * \ref DIST_ARCHIVE_ELEMENT_LEN and not be used for more than one call.
+ * \param cdfs is a \c TimeSeries of \c CumulativeDistribution objects.
+ * \param pdfs is a \c TimeSeries of \c ProbabilityDistribution objects.
+ * \param scenarios is a \c TimeSeries of \c ScenarioList objects.
+ */
+void dist_archive_add(DistArchiveWriter *writer, char const *element, TimeSeries const *cdfs,
+                      TimeSeries const *pdfs, TimeSeries const *scenarios);
+
+/** Write the archive to a file and free the writer.
+ *
+ * \returns \c true on success. The writer is freed either way and the pointer is zeroed.
+ */
+bool dist_archive_writer_close(DistArchiveWriter **writer, char const *path);
+
+/** An archive loaded from a file. */
+typedef struct DistArchive DistArchive;
+
+/** One set of values from an archive, the memory belongs to the archive. */
+struct DistArchiveEntry {
+    char const *element;
+    enum DistArchiveKind kind;
+    time_t valid_time;
+    size_t num_values;
+    float const *values;
+};
+
+/** Load an archive, it is read into memory in one step.
+ *
+ * \returns \c NULL if the file can't be read or isn't a valid archive.
+ */
+DistArchive *dist_archive_open(char const *path);
+
+/** Free an archive and zero the pointer. */
+void dist_archive_free(DistArchive **archive);
+
+/** Get the site the archive was written for. */
+char const *dist_archive_site(DistArchive const *archive);
+
+/** Get the model initialization time of the data in the archive. */
+time_t dist_archive_init_time(DistArchive const *archive);
+
+/** Get the number of entries in the archive. */
+size_t dist_archive_len(DistArchive const *archive);
+
+/** Get an entry by its position in the index. */
+struct DistArchiveEntry dist_archive_entry(DistArchive const *archive, size_t index);
+
+/** Find an entry with a binary search of the index.
+ *
+ * \returns \c true if it was found, and then \a entry is filled in.
+ */
+bool dist_archive_find(DistArchive const *archive, char const *element, enum DistArchiveKind kind,
+                       time_t valid_time, struct DistArchiveEntry *entry);
+
+/** Print the contents of an archive as text.
+ *
+ * The values are printed in the same columns as the \c .dat files saved with \c --save-dir.
+ */
+void dist_archive_dump(DistArchive const *archive, FILE *out);
@@ -1,4 +1,7 @@
 #include "distributions.h"
+#include "arena.h"
+#include "parallel.h"
+#include "profile.h"
 #include "utils.h"
 
 #include <assert.h>
@@ -35,145 +38,204 @@ percentile_compare(void const *a, void const *b)
     return 0;
 }
 
-/** Internal implementation of Cumulative distribution. */
+/** Internal implementation of Cumulative distribution.
+ *
+ * The points are stored in the same allocation as the rest of the structure. They are sorted and
+ * cleaned up as the CDF is built, so it never changes after that.
+ */
 struct CumulativeDistribution {
     double quantile_mapped_value;
-    struct Percentile *percentiles;
     int size;
-    int capacity;
-    bool sorted;
+    struct Percentile percentiles[];
 };
 
 static struct CumulativeDistribution *
-cumulative_dist_new()
+cumulative_dist_new(Arena *arena, int capacity)
 {
-    static size_t const initial_size = 13;
-
-    struct CumulativeDistribution *new = calloc(1, sizeof(struct CumulativeDistribution));
-    assert(new);
+    size_t bytes = sizeof(struct CumulativeDistribution) + capacity * sizeof(struct Percentile);
+    struct CumulativeDistribution *new = arena_alloc(arena, bytes);
 
-    new->percentiles = calloc(initial_size, sizeof(struct Percentile));
-    assert(new->percentiles);
-    new->capacity = initial_size;
     new->quantile_mapped_value = NAN;
-    new->sorted = false;
+    new->size = 0;
 
     return new;
 }
 
-static bool
-cumulative_dist_append_pair(struct CumulativeDistribution *dist, double percentile, double value)
+/** A column that holds one point of the CDFs for an element. */
+struct CDFColumn {
+    int col_num;
+    bool is_exceedance;
+    double pct; // For percentile columns, the percentile the column holds.
+    double val; // For exceedance columns, the converted threshold the column holds.
+};
+
+/** Find the percentile and exceedance columns for an element.
+ *
+ * \returns the number of columns found, or -1 on error.
+ */
+static int
+find_cdf_columns(NBMData const *nbm, char const *cdf_col_name_format,
+                 char const *exc_col_name_format, size_t num_exc_vals,
+                 char const *const exc_vals[num_exc_vals], Converter convert,
+                 struct CDFColumn cols[])
 {
-    if (dist->capacity == dist->size) {
-        size_t const new_capacity = 2 * dist->capacity;
+    int num_cols = 0;
+    char col_name[256] = {0};
+
+    for (int i = 1; i <= 99; i++) {
+        int num_chars = snprintf(col_name, sizeof(col_name), cdf_col_name_format, i);
+        Stopif(num_chars >= sizeof(col_name), return -1, "error with snprintf, buffer too small.");
 
-        dist->percentiles = realloc(dist->percentiles, new_capacity * sizeof(struct Percentile));
-        assert(dist->percentiles);
-        dist->capacity = new_capacity;
+        int col_num = nbm_data_column_index(nbm, col_name);
+        if (col_num >= 0) {
+            cols[num_cols++] = (struct CDFColumn){.col_num = col_num, .pct = i + 0.0};
+        }
     }
 
-    dist->sorted = false;
-    dist->percentiles[dist->size] = (struct Percentile){.pct = percentile, .val = value};
-    dist->size++;
+    for (size_t i = 0; i < num_exc_vals; i++) {
+        int num_chars = snprintf(col_name, sizeof(col_name), exc_col_name_format, exc_vals[i]);
+        Stopif(num_chars >= sizeof(col_name), return -1, "error with snprintf, buffer too small.");
 
-    return true;
+        int col_num = nbm_data_column_index(nbm, col_name);
+        if (col_num >= 0) {
+            cols[num_cols++] = (struct CDFColumn){
+                .col_num = col_num, .is_exceedance = true, .val = convert(strtod(exc_vals[i], 0))};
+        }
+    }
+
+    return num_cols;
 }
 
-GTree *
-extract_cdfs(NBMData const *nbm, char const *cdf_col_name_format, char const *pm_col_name,
-             Converter convert)
+/** Add a point to an array sorted by percentile and then value. */
+static void
+percentile_insert_sorted(int *num_pnts, struct Percentile pnts[], struct Percentile pnt)
 {
-    GTree *cdfs = g_tree_new_full(time_t_compare_func, 0, free, cumulative_dist_free);
+    int i = *num_pnts;
+    while (i > 0 && percentile_compare(&pnts[i - 1], &pnt) > 0) {
+        pnts[i] = pnts[i - 1];
+        i--;
+    }
 
-    char col_name[256] = {0};
-    for (int i = 1; i <= 99; i++) {
-        int num_chars = snprintf(col_name, sizeof(col_name), cdf_col_name_format, i);
-        Stopif(num_chars >= sizeof(col_name), goto ERR_RETURN,
-               "error with snprintf, buffer too small.");
+    pnts[i] = pnt;
+    (*num_pnts)++;
+}
 
-        // Create an iterator, if the pointer is 0, no such column, continue.
-        NBMDataRowIterator *it = nbm_data_rows(nbm, col_name);
-        if (!it) {
-            // This column doesn't exist, so skip it!
-            continue;
+/** Merge two sorted sets of points into a CDF.
+ *
+ * Both arrays must be sorted by percentile and then value. In the same pass this also cleans up
+ * the CDF so it is safe to sample.
+ */
+static void
+cumulative_dist_merge(struct CumulativeDistribution *cdf, int num_a,
+                      struct Percentile const a[num_a], int num_b, struct Percentile const b[num_b])
+{
+    int ia = 0;
+    int ib = 0;
+    int num_increasing = 0;
+    double last_val = NAN;
+
+    while (ia < num_a || ib < num_b) {
+        struct Percentile next = {0};
+        if (ib >= num_b || (ia < num_a && percentile_compare(&a[ia], &b[ib]) <= 0)) {
+            next = a[ia++];
+        } else {
+            next = b[ib++];
         }
 
-        struct NBMDataRowIteratorValueView view = nbm_data_row_iterator_next(it);
-        while (view.valid_time && view.value) {
-
-            struct CumulativeDistribution *cd = g_tree_lookup(cdfs, view.valid_time);
-            if (!cd) {
-                time_t *key = malloc(sizeof(time_t));
-                *key = *view.valid_time;
-                cd = cumulative_dist_new();
-                g_tree_insert(cdfs, key, cd);
-            }
-
-            cumulative_dist_append_pair(cd, i + 0.0, convert(*view.value));
-
-            view = nbm_data_row_iterator_next(it);
+        // Force the CDF to be an increasing function. Rounding and interpolation may cause a
+        // higher percentile to have a lower value when combining disparate sources. Remove the
+        // points that cause the CDF to be a decreasing function anywhere.
+        if (num_increasing > 0 && next.val < last_val) {
+            continue;
+        }
+        last_val = next.val;
+        num_increasing++;
+
+        // By combining disparate sources (e.g. quantile and probability of exceedance) we may end
+        // up with multiple entries for the same percentile, those should be eliminated. We'll keep
+        // the first one we encounter.
+        if (cdf->size == 0 || cdf->percentiles[cdf->size - 1].pct != next.pct) {
+            cdf->percentiles[cdf->size++] = next;
         }
 
-        nbm_data_row_iterator_free(&it);
+        // Anything over 100th percentile is redundant
+        if (num_increasing > 2 && next.pct >= 100.0) {
+            break;
+        }
     }
+}
 
-    // Get the probability matched info.
-    NBMDataRowIterator *it = nbm_data_rows(nbm, pm_col_name);
-    if (it) {
-        struct NBMDataRowIteratorValueView view = nbm_data_row_iterator_next(it);
-        while (view.valid_time && view.value) {
+TimeSeries *
+extract_cdfs(Arena *arena, NBMData const *nbm, char const *cdf_col_name_format,
+             char const *pm_col_name, char const *exc_col_name_format, size_t num_exc_vals,
+             char const *const exc_vals[num_exc_vals], Converter convert)
+{
+    ProfileSpan span = profile_begin("cdf_extraction", 0);
 
-            struct CumulativeDistribution *cd = g_tree_lookup(cdfs, view.valid_time);
-            // Skip times we don't have probability information for.
-            if (cd) {
-                cd->quantile_mapped_value = convert(*view.value);
-            }
+    TimeSeries *cdfs = time_series_new(nbm_data_num_rows(nbm), 0);
 
-            view = nbm_data_row_iterator_next(it);
-        }
+    struct CDFColumn *cols = calloc(99 + num_exc_vals, sizeof(struct CDFColumn));
+    struct Percentile *pct_pnts = calloc(99 + num_exc_vals, sizeof(struct Percentile));
+    assert(cols && pct_pnts);
+    struct Percentile *exc_pnts = &pct_pnts[99];
 
-        nbm_data_row_iterator_free(&it);
-    }
+    int num_cols = find_cdf_columns(nbm, cdf_col_name_format, exc_col_name_format, num_exc_vals,
+                                    exc_vals, convert, cols);
+    Stopif(num_cols < 0, goto ERR_RETURN, "error finding CDF columns.");
 
-    return cdfs;
+    int pm_col_num = nbm_data_column_index(nbm, pm_col_name);
 
-ERR_RETURN:
-    g_tree_unref(cdfs);
-    return 0;
-}
+    size_t num_rows = nbm_data_num_rows(nbm);
+    for (size_t row = 0; row < num_rows; row++) {
+        double const *vals = nbm_data_row_values(nbm, row);
 
-GTree *
-extract_exceedence_to_cdfs(GTree *tree, NBMData const *nbm, char const *col_name_format,
-                           size_t num_vals, char const *const vals[num_vals], Converter convert)
-{
-    char col_name[256] = {0};
-    for (size_t i = 0; i < num_vals; i++) {
-        int num_chars = snprintf(col_name, sizeof(col_name), col_name_format, vals[i]);
-        Stopif(num_chars >= sizeof col_name, return tree, "error with snprintf, buffer too small.");
+        // The percentile columns are already in order, the exceedance columns are few enough to
+        // sort as they are added.
+        int num_pct_pnts = 0;
+        int num_exc_pnts = 0;
+        for (int i = 0; i < num_cols; i++) {
+            double val = vals[cols[i].col_num];
+            if (isnan(val)) {
+                continue;
+            }
 
-        double value = convert(strtod(vals[i], 0));
+            if (cols[i].is_exceedance) {
+                struct Percentile pnt = {.pct = 100.0 - val, .val = cols[i].val};
+                percentile_insert_sorted(&num_exc_pnts, exc_pnts, pnt);
+            } else {
+                struct Percentile pnt = {.pct = cols[i].pct, .val = convert(val)};
+                pct_pnts[num_pct_pnts++] = pnt;
+            }
+        }
 
-        // Create an iterator, if the point is 0, no such column, so skip it and continue
-        NBMDataRowIterator *it = nbm_data_rows(nbm, col_name);
-        if (!it) {
+        // Only times with percentile information get a CDF, the exceedance and probability
+        // matched values only add to it.
+        if (num_pct_pnts == 0) {
             continue;
         }
 
-        struct NBMDataRowIteratorValueView view = nbm_data_row_iterator_next(it);
-        while (view.valid_time && view.value) {
-            struct CumulativeDistribution *cd = g_tree_lookup(tree, view.valid_time);
-            if (cd) {
-
-                double percentile = 100.0 - *view.value;
-                cumulative_dist_append_pair(cd, percentile, value);
-            }
+        struct CumulativeDistribution *cd = cumulative_dist_new(arena, num_pct_pnts + num_exc_pnts);
+        cumulative_dist_merge(cd, num_pct_pnts, pct_pnts, num_exc_pnts, exc_pnts);
 
-            view = nbm_data_row_iterator_next(it);
+        if (pm_col_num >= 0 && !isnan(vals[pm_col_num])) {
+            cd->quantile_mapped_value = convert(vals[pm_col_num]);
         }
-        nbm_data_row_iterator_free(&it);
+
+        time_series_insert(cdfs, nbm_data_valid_time(nbm, row), cd);
     }
 
-    return tree;
+    free(cols);
+    free(pct_pnts);
+    profile_end(&span);
+
+    return cdfs;
+
+ERR_RETURN:
+    free(cols);
+    free(pct_pnts);
+    time_series_free(&cdfs);
+    profile_end(&span);
+    return 0;
 }
 
 double
@@ -182,95 +244,64 @@ cumulative_dist_pm_value(struct CumulativeDistribution const *ptr)
     return ptr->quantile_mapped_value;
 }
 
-static void
-cumulative_dist_slide_left(struct CumulativeDistribution *ptr, size_t first_dup, size_t num_dups)
-{
-    size_t const offset = 1;
-    struct Percentile *dest = &ptr->percentiles[first_dup + offset];
-    struct Percentile *src = &ptr->percentiles[first_dup + num_dups + offset];
-    size_t stride = ptr->size - (first_dup + num_dups + offset);
-    memmove(dest, src, stride * sizeof(*src));
-    ptr->size -= num_dups;
-}
-
-static void
-cumulative_dist_cleanup(struct CumulativeDistribution *ptr)
+/** Find the first point in a CDF with a value greater than \a target_val.
+ *
+ * The values in a CDF never decrease, so this is a binary search. Returns the size of the CDF if
+ * there is no such point.
+ */
+static int
+cumulative_dist_upper_bound_val(struct CumulativeDistribution const *cdf, double target_val)
 {
-    assert(ptr->sorted);
-
-    for (size_t i = 0; i < ptr->size; i++) {
-        // Anything over 100th percentile is redundant
-        if (i > 1 && ptr->percentiles[i].pct >= 100.0) {
-            ptr->size = i + 1;
-            break;
-        }
-
-        // Force the CDF to be an increasing function. Rounding and interpolation may cause a
-        // higher percentile to have a lower value when combining disparate sources. Remove the
-        // points that cause the CDF to be a decreasing function anywhere.
-        size_t num_bad = 0;
-        size_t j = i + 1;
-
-        while (j < ptr->size && ptr->percentiles[i].val > ptr->percentiles[j].val) {
-            num_bad++;
-            j++;
-        }
+    int lo = 0;
+    int hi = cdf->size;
 
-        if (num_bad > 0) {
-            cumulative_dist_slide_left(ptr, i, num_bad);
+    while (lo < hi) {
+        int mid = lo + (hi - lo) / 2;
+        if (cdf->percentiles[mid].val > target_val) {
+            hi = mid;
+        } else {
+            lo = mid + 1;
         }
     }
 
-    // By combining disparate sources (e.g. quantile and probability of exceedance) we may end up
-    // with multiple entries for the same percentile, those should be eliminated. We'll keep the
-    // first one we encounter.
-    for (size_t i = 0; i < ptr->size; i++) {
-        size_t num_dups = 0;
-        size_t j = i + 1;
+    return lo;
+}
 
-        while (j < ptr->size && ptr->percentiles[i].pct == ptr->percentiles[j].pct) {
-            num_dups++;
-            j++;
-        }
+/** Find the first point in a CDF with a percentile greater than \a target_percentile.
+ *
+ * The percentiles in a CDF are strictly increasing, so this is a binary search. Returns the size
+ * of the CDF if there is no such point.
+ */
+static int
+cumulative_dist_upper_bound_pct(struct CumulativeDistribution const *cdf,
+                                double target_percentile)
+{
+    int lo = 0;
+    int hi = cdf->size;
 
-        if (num_dups > 0) {
-            cumulative_dist_slide_left(ptr, i, num_dups);
+    while (lo < hi) {
+        int mid = lo + (hi - lo) / 2;
+        if (cdf->percentiles[mid].pct > target_percentile) {
+            hi = mid;
+        } else {
+            lo = mid + 1;
         }
     }
-}
 
-static void
-cumulative_dist_sort(struct CumulativeDistribution *ptr)
-{
-    qsort(ptr->percentiles, ptr->size, sizeof(struct Percentile), percentile_compare);
-    ptr->sorted = true;
-    cumulative_dist_cleanup(ptr);
+    return lo;
 }
 
-double
-interpolate_prob_of_exceedance(struct CumulativeDistribution *cdf, double target_val)
+/** Interpolate the probability of exceedance given the first point with a value above it. */
+static double
+interpolate_prob_of_exceedance_at(struct CumulativeDistribution const *cdf, int right,
+                                  double target_val)
 {
-    if (!cdf->sorted) {
-        cumulative_dist_sort(cdf);
-    }
-
-    struct Percentile *ps = cdf->percentiles;
-    int sz = cdf->size;
-
-    // Bracket the target value
-    int left = 0, right = 0;
-    for (int i = 1; i < sz; i++) {
-        if (ps[i - 1].val <= target_val && ps[i].val > target_val) {
-            left = i - 1;
-            right = i;
-            break;
-        }
-    }
+    struct Percentile const *ps = cdf->percentiles;
 
     // If unable to bracket the target value, then 100% of data was below value and the probability
     // of exceedance is 0, or the first percentile marker we had was greater than the target value
     // and and the probability of exceedance is 100.0
-    if (left == right) {
+    if (right == 0 || right == cdf->size) {
         if (ps[0].val >= target_val) {
             return 100.0;
         } else {
@@ -278,6 +309,7 @@ interpolate_prob_of_exceedance(struct CumulativeDistribution *cdf, double target
         }
     }
 
+    int left = right - 1;
     double left_x = ps[left].val;
     double right_x = ps[right].val;
     double left_y = ps[left].pct;
@@ -295,33 +327,19 @@ interpolate_prob_of_exceedance(struct CumulativeDistribution *cdf, double target
     return prob_exc;
 }
 
-double
-cumulative_dist_percentile_value(struct CumulativeDistribution *cdf, double target_percentile)
+/** Interpolate the value at a percentile given the first point with a percentile above it. */
+static double
+cumulative_dist_percentile_value_at(struct CumulativeDistribution const *cdf, int right,
+                                    double target_percentile)
 {
-    if (!cdf->sorted) {
-        cumulative_dist_sort(cdf);
-    }
-    struct Percentile *ps = cdf->percentiles;
-    int sz = cdf->size;
-
-    assert(sz > 0);
-
-    // Bracket the target percentile
-    int left = 0, right = 0;
-    for (int i = 1; i < sz; i++) {
-        if (ps[i - 1].pct <= target_percentile && ps[i].pct > target_percentile) {
-            left = i - 1;
-            right = i;
-            break;
-        }
-    }
+    struct Percentile const *ps = cdf->percentiles;
 
     // If unable to bracket, see if we are below the lowest percentile. If that is the case, then
     // just return the lowest percentiles value. In most cases this will be 0.0 for snow and
     // precipitation. However, with temperatures this would be incorrect and NAN would be a better
     // value. Fortuneately we have a detailed temperature distribution, so this should not be an
     // issue.
-    if (left == 0 && right == 0) {
+    if (right == 0 || right == cdf->size) {
         if (ps[0].pct > target_percentile) {
             return ps[0].val;
         }
@@ -330,6 +348,7 @@ cumulative_dist_percentile_value(struct CumulativeDistribution *cdf, double targ
         return NAN;
     }
 
+    int left = right - 1;
     double left_pct = ps[left].pct;
     double right_pct = ps[right].pct;
     double left_val = ps[left].val;
@@ -344,7 +363,63 @@ cumulative_dist_percentile_value(struct CumulativeDistribution *cdf, double targ
 }
 
 double
-cumulative_dist_max_value(struct CumulativeDistribution *cdf)
+interpolate_prob_of_exceedance(struct CumulativeDistribution const *cdf, double target_val)
+{
+    int right = cumulative_dist_upper_bound_val(cdf, target_val);
+    return interpolate_prob_of_exceedance_at(cdf, right, target_val);
+}
+
+double
+cumulative_dist_percentile_value(struct CumulativeDistribution const *cdf, double target_percentile)
+{
+    assert(cdf->size > 0);
+
+    int right = cumulative_dist_upper_bound_pct(cdf, target_percentile);
+    return cumulative_dist_percentile_value_at(cdf, right, target_percentile);
+}
+
+void
+interpolate_probs_of_exceedance(struct CumulativeDistribution const *cdf, size_t num_vals,
+                                double const target_vals[num_vals], double probs[num_vals])
+{
+    struct Percentile const *ps = cdf->percentiles;
+
+    int right = 0;
+    for (size_t i = 0; i < num_vals; i++) {
+        assert(i == 0 || target_vals[i - 1] <= target_vals[i]);
+
+        // The targets are in ascending order, so pick up where the last one left off.
+        while (right < cdf->size && ps[right].val <= target_vals[i]) {
+            right++;
+        }
+
+        probs[i] = interpolate_prob_of_exceedance_at(cdf, right, target_vals[i]);
+    }
+}
+
+void
+cumulative_dist_percentile_values(struct CumulativeDistribution const *cdf, size_t num_pcts,
+                                  double const target_percentiles[num_pcts], double vals[num_pcts])
+{
+    assert(cdf->size > 0);
+
+    struct Percentile const *ps = cdf->percentiles;
+
+    int right = 0;
+    for (size_t i = 0; i < num_pcts; i++) {
+        assert(i == 0 || target_percentiles[i - 1] <= target_percentiles[i]);
+
+        // The targets are in ascending order, so pick up where the last one left off.
+        while (right < cdf->size && ps[right].pct <= target_percentiles[i]) {
+            right++;
+        }
+
+        vals[i] = cumulative_dist_percentile_value_at(cdf, right, target_percentiles[i]);
+    }
+}
+
+double
+cumulative_dist_max_value(struct CumulativeDistribution const *cdf)
 {
     assert(cdf);
 
@@ -352,7 +427,7 @@ cumulative_dist_max_value(struct CumulativeDistribution *cdf)
 }
 
 double
-cumulative_dist_min_value(struct CumulativeDistribution *cdf)
+cumulative_dist_min_value(struct CumulativeDistribution const *cdf)
 {
     assert(cdf);
 
@@ -360,18 +435,28 @@ cumulative_dist_min_value(struct CumulativeDistribution *cdf)
 }
 
 void
-cumulative_dist_free(void *void_cdf)
+cumulative_dist_write(struct CumulativeDistribution const *cdf, FILE *f)
+{
+    for (size_t i = 0; i < cdf->size; i++) {
+        fprintf(f, "%8lf %8lf\n", cdf->percentiles[i].val, cdf->percentiles[i].pct);
+    }
+}
+
+size_t
+cumulative_dist_packed_len(struct CumulativeDistribution const *cdf)
 {
-    struct CumulativeDistribution *cdf = void_cdf;
-    free(cdf->percentiles);
-    free(cdf);
+    return 1 + 2 * cdf->size;
 }
 
 void
-cumulative_dist_write(struct CumulativeDistribution *cdf, FILE *f)
+cumulative_dist_pack(struct CumulativeDistribution const *cdf, size_t len, double buf[len])
 {
-    for (size_t i = 0; i < cdf->size; i++) {
-        fprintf(f, "%8lf %8lf\n", cdf->percentiles[i].val, cdf->percentiles[i].pct);
+    assert(len == cumulative_dist_packed_len(cdf));
+
+    buf[0] = cdf->quantile_mapped_value;
+    for (int i = 0; i < cdf->size; i++) {
+        buf[1 + 2 * i] = cdf->percentiles[i].val;
+        buf[2 + 2 * i] = cdf->percentiles[i].pct;
     }
 }
 
@@ -415,13 +500,10 @@ struct ProbabilityDistribution {
 };
 
 static struct ProbabilityDistribution *
-probability_dist_new(int capacity)
+probability_dist_new(Arena *arena, int capacity)
 {
-    struct ProbabilityDistribution *pdf = calloc(1, sizeof(struct ProbabilityDistribution));
-    assert(pdf);
-
-    struct PDFPoint *pnts = calloc(capacity, sizeof(struct PDFPoint));
-    assert(pnts);
+    struct ProbabilityDistribution *pdf = arena_alloc(arena, sizeof(*pdf));
+    struct PDFPoint *pnts = arena_alloc(arena, capacity * sizeof(struct PDFPoint));
 
     *pdf = (struct ProbabilityDistribution){.size = capacity, .pnts = pnts};
 
@@ -460,23 +542,51 @@ probability_dist_normalize(struct ProbabilityDistribution *pdf)
     }
 }
 
-static struct ProbabilityDistribution *
-probability_dist_smooth(struct ProbabilityDistribution const *pdf, double smooth_radius)
+/** How far out to apply the smoothing kernel, in multiples of the smoothing radius.
+ *
+ * At this distance the Gaussian weight is about 1e-14 of the weight at the center, so leaving out
+ * points beyond it makes no visible difference to the smoothed PDF.
+ */
+#define SMOOTH_CUTOFF_RADII 8.0
+
+/** The most terms of the series used by smooth_series(). */
+#define SMOOTH_MAX_TERMS 64
+
+/** How much of any one weight smooth_series() may leave out, about what the cutoff leaves out. */
+#define SMOOTH_SERIES_TOLERANCE 1.0e-15
+
+/** Smooth a PDF by summing the kernel over a window of nearby points.
+ *
+ * The points of a PDF are sorted by their centers, so only a window of points within
+ * \ref SMOOTH_CUTOFF_RADII of each center is used. The window slides up the PDF along with the
+ * point being smoothed. This costs an exp() for every pair of points in a window.
+ */
+static void
+smooth_window(struct ProbabilityDistribution const *pdf, double smooth_radius,
+              struct PDFPoint new[pdf->size])
 {
-    struct ProbabilityDistribution *new_dist = probability_dist_new(pdf->size);
-    assert(new_dist);
-    struct PDFPoint *new = new_dist->pnts;
-    assert(new);
+    double const two_r_sq = 2.0 * smooth_radius * smooth_radius;
+    double const cutoff = SMOOTH_CUTOFF_RADII * smooth_radius;
 
-    // Smooth with a Gaussian Kernel Smoother
-    double radius = smooth_radius;
+    size_t lo = 0;
+    size_t hi = 0;
     for (size_t i = 0; i < pdf->size; i++) {
         double center = pdfpoint_center(pdf->pnts[i]);
+        assert(i == 0 || pdfpoint_center(pdf->pnts[i - 1]) < center);
+
+        while (center - pdfpoint_center(pdf->pnts[lo]) > cutoff) {
+            lo++;
+        }
+
+        while (hi < pdf->size && pdfpoint_center(pdf->pnts[hi]) - center <= cutoff) {
+            hi++;
+        }
+
         double numerator = 0.0;
         double denom = 0.0;
-        for (size_t j = 0; j < pdf->size; j++) {
-            double other_center = pdfpoint_center(pdf->pnts[j]);
-            double k = exp(-(pow(center - other_center, 2.0)) / (2.0 * radius * radius));
+        for (size_t j = lo; j < hi; j++) {
+            double dist = center - pdfpoint_center(pdf->pnts[j]);
+            double k = exp(-(dist * dist) / two_r_sq);
             double density = pdfpoint_density(pdf->pnts[j]);
 
             // We should have removed all these before getting here.
@@ -493,14 +603,130 @@ probability_dist_smooth(struct ProbabilityDistribution const *pdf, double smooth
             new[i].density = 0.0;
         }
     }
+}
+
+/** Count the terms smooth_series() needs, or 0 if it needs more than \ref SMOOTH_MAX_TERMS.
+ *
+ * Measure positions as u, the distance from the middle of the PDF in smoothing radii. The weight
+ * between two points is then exp(-u_i^2 / 2) exp(-u_j^2 / 2) exp(u_i u_j), and the last factor is
+ * expanded as a power series. Cutting the series off after n terms leaves out at most the chance
+ * that a Poisson variable with a mean of max(u)^2 is n or more, so terms are added until that
+ * chance is below \ref SMOOTH_SERIES_TOLERANCE.
+ *
+ * \param half_width is the distance from the middle of the PDF to its outermost centers.
+ * \param smooth_radius is the scale of the Gaussian kernel.
+ */
+static int
+smooth_series_terms(double half_width, double smooth_radius)
+{
+    double const max_u_sq = (half_width / smooth_radius) * (half_width / smooth_radius);
+
+    // The Poisson probabilities, and a geometric bound on the tail after the current one.
+    double prob = exp(-max_u_sq);
+    for (int n = 1; n <= SMOOTH_MAX_TERMS; n++) {
+        prob *= max_u_sq / n;
+        if (n + 1 > max_u_sq && prob * (n + 1) / (n + 1 - max_u_sq) <= SMOOTH_SERIES_TOLERANCE) {
+            return n;
+        }
+    }
+
+    return 0;
+}
+
+/** Smooth a PDF with a power series for the kernel.
+ *
+ * With the expansion described at smooth_series_terms(), the sums over the other points don't
+ * depend on the point being smoothed. They are moments of the PDF in u, found once, and then each
+ * smoothed density is a ratio of two polynomials in its own u. That is an exp() per point instead
+ * of one for every pair. The exp(-u_i^2 / 2) of the point being smoothed is in both sums, so it
+ * cancels out.
+ */
+static void
+smooth_series(struct ProbabilityDistribution const *pdf, double smooth_radius, int num_terms,
+              struct PDFPoint new[pdf->size])
+{
+    assert(num_terms > 0 && num_terms <= SMOOTH_MAX_TERMS);
+
+    double const middle =
+        (pdfpoint_center(pdf->pnts[0]) + pdfpoint_center(pdf->pnts[pdf->size - 1])) / 2.0;
+
+    // The moments, each divided by the factorial that goes with it in the series.
+    double num_moments[SMOOTH_MAX_TERMS] = {0};
+    double denom_moments[SMOOTH_MAX_TERMS] = {0};
+    for (size_t j = 0; j < pdf->size; j++) {
+        double u = (pdfpoint_center(pdf->pnts[j]) - middle) / smooth_radius;
+        double density = pdfpoint_density(pdf->pnts[j]);
+
+        // We should have removed all these before getting here.
+        assert(!isinf(density) && !isnan(density));
+
+        double k = exp(-u * u / 2.0);
+        for (int n = 0; n < num_terms; n++) {
+            num_moments[n] += density * k;
+            denom_moments[n] += k;
+            k *= u / (n + 1);
+        }
+    }
+
+    for (size_t i = 0; i < pdf->size; i++) {
+        double u = (pdfpoint_center(pdf->pnts[i]) - middle) / smooth_radius;
+
+        double numerator = 0.0;
+        double denom = 0.0;
+        for (int n = num_terms - 1; n >= 0; n--) {
+            numerator = numerator * u + num_moments[n];
+            denom = denom * u + denom_moments[n];
+        }
+
+        new[i] = pdf->pnts[i];
+        if (denom > 0.0) {
+            new[i].density = numerator / denom;
+        } else {
+            new[i].density = 0.0;
+        }
+    }
+}
+
+/** Smooth a PDF with a Gaussian kernel.
+ *
+ * Small radii use smooth_window(). Once the window covers the whole PDF every pair needs its own
+ * exp(), so smooth_series() is used instead when it's faster. That's when it needs fewer terms
+ * than twice the number of points.
+ *
+ * \param pdf is the PDF to smooth.
+ * \param smooth_radius is the scale of the Gaussian kernel.
+ * \param new is where to put the points of the smoothed PDF.
+ *
+ * \returns a PDF that uses \a new for its points.
+ */
+static struct ProbabilityDistribution
+probability_dist_smooth_into(struct ProbabilityDistribution const *pdf, double smooth_radius,
+                             struct PDFPoint new[pdf->size])
+{
+    struct ProbabilityDistribution new_dist = {.size = pdf->size, .pnts = new};
 
-    probability_dist_normalize(new_dist);
+    double const width =
+        pdfpoint_center(pdf->pnts[pdf->size - 1]) - pdfpoint_center(pdf->pnts[0]);
+
+    int num_terms = 0;
+    if (width <= SMOOTH_CUTOFF_RADII * smooth_radius) {
+        num_terms = smooth_series_terms(width / 2.0, smooth_radius);
+    }
+
+    // A term costs a few multiplies per point and a pair an exp(), they break even at about 2 to 1.
+    if (num_terms > 0 && num_terms < 2 * pdf->size) {
+        smooth_series(pdf, smooth_radius, num_terms, new);
+    } else {
+        smooth_window(pdf, smooth_radius, new);
+    }
+
+    probability_dist_normalize(&new_dist);
     return new_dist;
 }
 
 static void
 probability_dist_fill_in_dist(struct ProbabilityDistribution *pdf,
-                              struct CumulativeDistribution *cdf)
+                              struct CumulativeDistribution const *cdf)
 {
     size_t num_pnts_added = 0;
     struct Percentile left = cdf->percentiles[0];
@@ -538,37 +764,36 @@ probability_dist_fill_in_dist(struct ProbabilityDistribution *pdf,
 }
 
 struct ProbabilityDistribution *
-probability_dist_calc(struct CumulativeDistribution *cdf)
+probability_dist_calc(Arena *arena, struct CumulativeDistribution const *cdf)
 {
     assert(cdf);
 
-    if (!cdf->sorted) {
-        cumulative_dist_sort(cdf);
-    }
-
-    struct ProbabilityDistribution *pdf = probability_dist_new(cdf->size - 1);
+    struct ProbabilityDistribution *pdf = probability_dist_new(arena, cdf->size - 1);
 
     probability_dist_fill_in_dist(pdf, cdf);
 
     return pdf;
 }
 
-void
-probability_dist_free(void *ptr)
+struct ProbabilityDistribution *
+probability_dist_copy(Arena *arena, struct ProbabilityDistribution *src)
 {
-    struct ProbabilityDistribution *pdf = ptr;
+    struct ProbabilityDistribution *dest = probability_dist_new(arena, src->size);
+    memcpy(dest->pnts, src->pnts, src->size * sizeof(struct PDFPoint));
 
-    free(pdf->pnts);
-    free(pdf);
+    return dest;
 }
 
 struct ProbabilityDistribution *
-probability_dist_copy(struct ProbabilityDistribution *src)
+probability_dist_smooth(Arena *arena, struct ProbabilityDistribution const *pdf,
+                        double smooth_radius)
 {
-    struct ProbabilityDistribution *dest = probability_dist_new(src->size);
-    memcpy(dest->pnts, src->pnts, src->size * sizeof(struct PDFPoint));
+    assert(smooth_radius > 0.0);
 
-    return dest;
+    struct ProbabilityDistribution *smoothed = probability_dist_new(arena, pdf->size);
+    *smoothed = probability_dist_smooth_into(pdf, smooth_radius, smoothed->pnts);
+
+    return smoothed;
 }
 
 void
@@ -578,6 +803,28 @@ probability_dist_write(struct ProbabilityDistribution *pdf, FILE *f)
         fprintf(f, "%8lf %8lf\n", pdfpoint_center(pdf->pnts[i]), pdfpoint_density(pdf->pnts[i]));
     }
 }
+
+size_t
+probability_dist_packed_len(struct ProbabilityDistribution const *pdf)
+{
+    return 1 + 2 * pdf->size;
+}
+
+void
+probability_dist_pack(struct ProbabilityDistribution const *pdf, size_t len, double buf[len])
+{
+    assert(len == probability_dist_packed_len(pdf));
+
+    // The bins are built from consecutive percentiles, so each one starts where the last ended.
+    buf[0] = pdf->pnts[0].min;
+    for (int i = 0; i < pdf->size; i++) {
+        assert(i == 0 || pdf->pnts[i].min == pdf->pnts[i - 1].max);
+
+        buf[1 + 2 * i] = pdf->pnts[i].max;
+        buf[2 + 2 * i] = pdf->pnts[i].density;
+    }
+}
+
 /*-------------------------------------------------------------------------------------------------
  *                                  Scenario implementations.
  *-----------------------------------------------------------------------------------------------*/
@@ -589,21 +836,29 @@ struct Scenario {
     double prob;
 };
 
-static struct Scenario *
-scenario_allocate(void)
-{
-    struct Scenario *ptr = calloc(1, sizeof(struct Scenario));
-    assert(ptr);
+/** Internal implementation of a \ref ScenarioList. */
+struct ScenarioList {
+    int size;
+    struct Scenario scenarios[MAX_SCENARIOS];
+};
 
-    ptr->mode = NAN;
+static struct Scenario
+scenario_new(double min)
+{
+    return (struct Scenario){.min = min, .max = 0.0, .mode = NAN, .prob = 0.0};
+}
 
-    return ptr;
+int
+scenario_list_len(struct ScenarioList const *list)
+{
+    return list->size;
 }
 
-void
-scenario_free(void *ptr)
+struct Scenario const *
+scenario_list_get(struct ScenarioList const *list, int index)
 {
-    free(ptr);
+    assert(index >= 0 && index < list->size);
+    return &list->scenarios[index];
 }
 
 double
@@ -630,6 +885,26 @@ scenario_get_probability(struct Scenario const *sc)
     return sc->prob;
 }
 
+size_t
+scenario_list_packed_len(struct ScenarioList const *list)
+{
+    return 4 * list->size;
+}
+
+void
+scenario_list_pack(struct ScenarioList const *list, size_t len, double buf[len])
+{
+    assert(len == scenario_list_packed_len(list));
+
+    for (int i = 0; i < list->size; i++) {
+        struct Scenario const *sc = &list->scenarios[i];
+        buf[4 * i] = sc->min;
+        buf[4 * i + 1] = sc->mode;
+        buf[4 * i + 2] = sc->max;
+        buf[4 * i + 3] = sc->prob;
+    }
+}
+
 static int
 scenario_cmp_descending_prob(void const *a, void const *b)
 {
@@ -647,25 +922,89 @@ scenario_cmp_descending_prob(void const *a, void const *b)
     return 0;
 }
 
+/** Add a scenario to an array sorted by descending probability.
+ *
+ * It goes in front of any others with the same probability.
+ */
+static void
+scenario_insert_sorted(int *num_scenarios, struct Scenario scenarios[], struct Scenario sc)
+{
+    int i = 0;
+    while (i < *num_scenarios && scenario_cmp_descending_prob(&sc, &scenarios[i]) > 0) {
+        i++;
+    }
+
+    memmove(&scenarios[i + 1], &scenarios[i], (*num_scenarios - i) * sizeof(struct Scenario));
+    scenarios[i] = sc;
+    (*num_scenarios)++;
+}
+
 #define TRENDING_UP 1
 #define NO_TREND 0
 #define TRENDING_DOWN -1
 
-static GList *
-find_scenarios_inner(ProbabilityDistribution const *pdf)
+/** Count the scenarios in a PDF without building them.
+ *
+ * This follows the same rules as find_scenarios_inner(), and there is a scenario for every local
+ * minimum in the density plus one.
+ *
+ * \param pdf is the PDF to analyze.
+ * \param max_count is a limit to stop counting at, once the count is over this it is returned.
+ *
+ * \returns the number of scenarios, or a number greater than \a max_count.
+ */
+static int
+count_scenarios(ProbabilityDistribution const *pdf, int max_count)
 {
-    GList *scenarios = 0;
+    assert(pdf->size > 0);
 
-    struct Scenario *curr = scenario_allocate();
-    int trending0 = NO_TREND;
-    double prob_area = 0.0;
+    int num_scenarios = 1;
+    int trending0 = TRENDING_UP;
+    if (pdf->size == 1 || pdf->pnts[1].density < pdf->pnts[0].density) {
+        trending0 = TRENDING_DOWN;
+    }
+
+    double density0 = pdfpoint_density(pdf->pnts[0]);
+    for (size_t i = 1; i < pdf->size; i++) {
+        double density1 = pdfpoint_density(pdf->pnts[i]);
+        int trending1 = density1 < density0 ? TRENDING_DOWN : TRENDING_UP;
+
+        if (trending0 == TRENDING_DOWN && trending1 == TRENDING_UP) {
+            num_scenarios++;
+            if (num_scenarios > max_count) {
+                break;
+            }
+        }
+
+        density0 = density1;
+        trending0 = trending1;
+    }
+
+    return num_scenarios;
+}
+
+/** Find the scenarios in a PDF.
+ *
+ * \param pdf is the PDF to analyze, it must have no more than \ref MAX_SCENARIOS scenarios as
+ * counted by count_scenarios().
+ * \param scenarios is where to put the scenarios, sorted from highest to lowest probability.
+ *
+ * \returns the number of scenarios found.
+ */
+static int
+find_scenarios_inner(ProbabilityDistribution const *pdf, struct Scenario scenarios[MAX_SCENARIOS])
+{
+    int num_scenarios = 0;
 
     assert(pdf->size > 0);
 
-    curr->min = pdf->pnts[0].min;
+    struct Scenario curr = scenario_new(pdf->pnts[0].min);
+    int trending0 = NO_TREND;
+    double prob_area = 0.0;
+
     if (pdf->size == 1 || pdf->pnts[1].density < pdf->pnts[0].density) {
         // We are starting at a max
-        curr->mode = pdfpoint_center(pdf->pnts[0]);
+        curr.mode = pdfpoint_center(pdf->pnts[0]);
         trending0 = TRENDING_DOWN;
     } else {
         trending0 = TRENDING_UP;
@@ -679,16 +1018,15 @@ find_scenarios_inner(ProbabilityDistribution const *pdf)
 
         if (trending0 == TRENDING_UP && trending1 == TRENDING_DOWN) {
             // At a max
-            curr->mode = pdfpoint_center(pdf->pnts[i - 1]);
+            curr.mode = pdfpoint_center(pdf->pnts[i - 1]);
         } else if (trending0 == TRENDING_DOWN && trending1 == TRENDING_UP) {
             // At a min - start a new scenario
-            curr->max = pdf->pnts[i].min;
-            curr->prob = prob_area;
+            curr.max = pdf->pnts[i].min;
+            curr.prob = prob_area;
             prob_area = 0.0;
 
-            scenarios = g_list_insert_sorted(scenarios, curr, scenario_cmp_descending_prob);
-            curr = scenario_allocate();
-            curr->min = pdf->pnts[i].min;
+            scenario_insert_sorted(&num_scenarios, scenarios, curr);
+            curr = scenario_new(pdf->pnts[i].min);
         }
 
         prob_area += pdfpoint_probability_area(pdf->pnts[i]);
@@ -698,91 +1036,149 @@ find_scenarios_inner(ProbabilityDistribution const *pdf)
     }
 
     struct PDFPoint last = pdf->pnts[pdf->size - 1];
-    if (isnan(curr->mode)) {
-        curr->mode = pdfpoint_center(last);
+    if (isnan(curr.mode)) {
+        curr.mode = pdfpoint_center(last);
     }
-    curr->max = last.max;
-    curr->prob = prob_area;
-    scenarios = g_list_insert_sorted(scenarios, curr, scenario_cmp_descending_prob);
+    curr.max = last.max;
+    curr.prob = prob_area;
+    scenario_insert_sorted(&num_scenarios, scenarios, curr);
 
-    return scenarios;
+    return num_scenarios;
 }
 
-GList *
-find_scenarios(ProbabilityDistribution *pdf, double minimum_smooth_radius, double smooth_radius_inc)
+/** Find the scenarios in a PDF without allocating any memory.
+ *
+ * This is safe to run on several PDFs at once from different threads.
+ *
+ * \param scratch must have room for at least as many points as \a pdf.
+ * \param scenarios is where to put the scenarios.
+ */
+static void
+find_scenarios_into(ProbabilityDistribution *pdf, double minimum_smooth_radius,
+                    double smooth_radius_inc, struct PDFPoint scratch[pdf->size],
+                    struct ScenarioList *scenarios)
 {
     assert(minimum_smooth_radius > 0.0);
     assert(smooth_radius_inc > 0.0);
 
-    GList *scenarios = 0;
+    // Only count the scenarios while searching for a smooth radius, then build them once.
     double smooth_radius = minimum_smooth_radius;
+    struct ProbabilityDistribution smoothed_pdf = {0};
     do {
-        ProbabilityDistribution *smoothed_pdf = probability_dist_smooth(pdf, smooth_radius);
-        scenarios = find_scenarios_inner(smoothed_pdf);
-        if (g_list_length(scenarios) <= 4) {
-            // Swap the smoothed PDF into the PDF
-            ProbabilityDistribution temp = {0};
-            temp.size = pdf->size;
-            temp.pnts = pdf->pnts;
-            pdf->size = smoothed_pdf->size;
-            pdf->pnts = smoothed_pdf->pnts;
-            smoothed_pdf->size = temp.size;
-            smoothed_pdf->pnts = temp.pnts;
-
-            probability_dist_free(smoothed_pdf);
+        smoothed_pdf = probability_dist_smooth_into(pdf, smooth_radius, scratch);
+        if (count_scenarios(&smoothed_pdf, MAX_SCENARIOS) <= MAX_SCENARIOS) {
             break;
         }
-        probability_dist_free(smoothed_pdf);
         smooth_radius += smooth_radius_inc;
     } while (true);
 
+    scenarios->size = find_scenarios_inner(&smoothed_pdf, scenarios->scenarios);
+
+    // Keep the smoothed PDF.
+    memcpy(pdf->pnts, scratch, pdf->size * sizeof(struct PDFPoint));
+}
+
+ScenarioList *
+find_scenarios(Arena *arena, ProbabilityDistribution *pdf, double minimum_smooth_radius,
+               double smooth_radius_inc)
+{
+    struct PDFPoint *scratch = malloc(pdf->size * sizeof(struct PDFPoint));
+    assert(scratch);
+
+    struct ScenarioList *scenarios = arena_alloc(arena, sizeof(struct ScenarioList));
+    find_scenarios_into(pdf, minimum_smooth_radius, smooth_radius_inc, scratch, scenarios);
+
+    free(scratch);
+
     return scenarios;
 }
 
+TimeSeries *
+create_pdfs_from_cdfs(Arena *arena, TimeSeries *cdfs)
+{
+    ProfileSpan span = profile_begin("pdf_build", 0);
+
+    size_t num_cdfs = time_series_len(cdfs);
+    TimeSeries *pdfs = time_series_new(num_cdfs, 0);
+
+    for (size_t i = 0; i < num_cdfs; i++) {
+        ProbabilityDistribution *pdf = probability_dist_calc(arena, time_series_value(cdfs, i));
+        time_series_insert(pdfs, time_series_time(cdfs, i), pdf);
+    }
+
+    profile_end(&span);
+
+    return pdfs;
+}
+
 /** Used to keep track of state while mapping over a collection of PDFs to create a collection of
  * Scenarios.
  */
 struct PDFToScenarioData {
+    TimeSeries *pdfs;
     double minimum_smooth_radius;
     double smooth_radius_inc;
-    GTree *scenarios;
+    size_t scratch_size;
+    struct PDFPoint *scratch;       // scratch_size points for each worker.
+    struct ScenarioList *scenarios; // One for each PDF.
 };
 
-static int
-create_scenarios_mapping(void *key, void *val, void *user_data)
+static void
+create_scenarios_mapping(size_t index, int worker, void *user_data)
 {
-    time_t *valid_time = key;
-    ProbabilityDistribution *pdf = val;
     struct PDFToScenarioData *data = user_data;
 
-    GTree *scenarios = data->scenarios;
+    ProbabilityDistribution *pdf = time_series_value(data->pdfs, index);
+    struct PDFPoint *scratch = &data->scratch[worker * data->scratch_size];
 
-    GList *scs = find_scenarios(pdf, data->minimum_smooth_radius, data->smooth_radius_inc);
+    find_scenarios_into(pdf, data->minimum_smooth_radius, data->smooth_radius_inc, scratch,
+                        &data->scenarios[index]);
+}
 
-    time_t *new_key = calloc(1, sizeof(*valid_time));
-    *new_key = *valid_time;
+TimeSeries *
+create_scenarios_from_pdfs(Arena *arena, TimeSeries *pdfs, double minimum_smooth_radius,
+                           double smooth_radius_inc)
+{
+    size_t num_pdfs = time_series_len(pdfs);
+    TimeSeries *scenarios = time_series_new(num_pdfs, 0);
+    if (num_pdfs == 0) {
+        return scenarios;
+    }
 
-    g_tree_insert(scenarios, new_key, scs);
+    ProfileSpan span = profile_begin("scenario_search", 0);
 
-    return false;
-}
+    // Each worker gets its own scratch buffer for smoothing, big enough for the largest PDF.
+    size_t max_size = 1;
+    for (size_t i = 0; i < num_pdfs; i++) {
+        ProbabilityDistribution const *pdf = time_series_value(pdfs, i);
+        if (pdf->size > max_size) {
+            max_size = pdf->size;
+        }
+    }
 
-GTree *
-create_scenarios_from_pdfs(GTree *pdfs, double minimum_smooth_radius, double smooth_radius_inc)
-{
-    GTree *scenarios = g_tree_new_full(time_t_compare_func, 0, free, free_glist_of_scenarios);
-    struct PDFToScenarioData callback_data = {.minimum_smooth_radius = minimum_smooth_radius,
-                                              .smooth_radius_inc = smooth_radius_inc,
-                                              .scenarios = scenarios};
+    size_t num_workers = parallel_num_workers();
+    struct PDFPoint *scratch = malloc(num_workers * max_size * sizeof(struct PDFPoint));
+    assert(scratch);
 
-    g_tree_foreach(pdfs, create_scenarios_mapping, &callback_data);
+    // The arena isn't thread safe, so allocate all the results before starting.
+    struct ScenarioList *lists = arena_alloc(arena, num_pdfs * sizeof(struct ScenarioList));
 
-    return scenarios;
-}
+    struct PDFToScenarioData data = {.pdfs = pdfs,
+                                     .minimum_smooth_radius = minimum_smooth_radius,
+                                     .smooth_radius_inc = smooth_radius_inc,
+                                     .scratch_size = max_size,
+                                     .scratch = scratch,
+                                     .scenarios = lists};
 
-void
-free_glist_of_scenarios(void *ptr)
-{
-    GList *scs = ptr;
-    g_clear_list(&scs, scenario_free);
+    parallel_for(num_pdfs, create_scenarios_mapping, &data);
+
+    free(scratch);
+
+    for (size_t i = 0; i < num_pdfs; i++) {
+        time_series_insert(scenarios, time_series_time(pdfs, i), &lists[i]);
+    }
+
+    profile_end(&span);
+
+    return scenarios;
 }
@@ -2,7 +2,9 @@
 
 #include <glib.h>
 
+#include "arena.h"
 #include "nbm_data.h"
+#include "time_series.h"
 #include "utils.h"
 
 /*-------------------------------------------------------------------------------------------------
@@ -13,46 +15,33 @@ typedef struct CumulativeDistribution CumulativeDistribution;
 
 /** Extract CDF information from some \c NBMData.
  *
+ * All the columns for the element are looked up once and then the data is read a row at a time,
+ * so each CDF is built in a single step.
+ *
+ * \param arena is where to allocate the CDFs.
  * \param nbm is the source to extract the CDF from.
  * \param cdf_col_name_format is a \c printf style format string used to generate the column names
  * of the columns that contain the CDF information in the form of percentiles.
  * \param pm_col_name is the column name of the probability matched value.
+ * \param exc_col_name_format is a \c printf style format string used to generate the column names
+ * of the columns that contain the CDF information in the form of probability of exceedance. It
+ * may be \c NULL if \a num_exc_vals is 0.
+ * \param num_exc_vals is the number of values in the array pointed to by the next argument.
+ * \param exc_vals is an array of the values which you want to try and extract probability of
+ * exceedance for. Note these values are in the same units that the source NBM data file is in.
+ * They must also be strings that exactly match the number of decimal places as the column name in
+ * the NBM and be parseable by \c strtod().
  * \param convert is a simple mapping. It may do nothing or map units of mm to in or some other
  * relavent conversion.
  *
- * \returns a \c GTree* with \c time_t objects as keys and \c CumulativeDistribution
- * objects as values.
+ * \returns a \c TimeSeries of \c CumulativeDistribution objects. Only valid times with
+ * percentile information are included, the probabilities of exceedance only add points to those.
  *
  **/
-GTree *extract_cdfs(NBMData const *nbm, char const *cdf_col_name_format, char const *pm_col_name,
-                    Converter convert);
-
-/** Extract probability threshold data from the NBM.
- *
- * This is related to the extract_cdfs() function. That function uses percentiles information to
- * build the CDF. This function extracts the probability of exceedence columns from the NBM to add
- * data to the CDF. This function will take the GTree created by extract_cdfs() and add more points
- * to the CDF based on the probabilities of exceedence.
- *
- * \param tree is a GTree as returned by extract_cdfs().
- * \param nbm is the source to extract the CDF data from.
- * \param col_name_format is a \c printf style format string used to generate the column names
- * of the columns that contain the CDF information in the form of probability of exceedance.
- * \param num_vals is the number of values in the array pointed to by the next argument.
- * \param vals is an array of the values which you want to try and extract probability of exceedance
- * for. Note these values are in the same units that the source NBM data file is in. They must also
- * be strings that exactly match the number of decimal places as the column name in the NBM and be
- * parseable by \c strtod().
- * \param convert is a simple mapping. It may do nothing or map units of mm to in or some other
- * relavent conversion. It is used to map the values in \a vals into the units you want them to be
- * in before adding them to the CDF.
- *
- * \returns a \c GTree* with \c time_t objects as keys and \c CumulativeDistribution
- * objects as values. This is the same tree that was passed in as the \a tree argument.
- */
-GTree *extract_exceedence_to_cdfs(GTree *tree, NBMData const *nbm, char const *col_name_format,
-                                  size_t num_vals, char const *const vals[num_vals],
-                                  Converter convert);
+TimeSeries *extract_cdfs(Arena *arena, NBMData const *nbm, char const *cdf_col_name_format,
+                         char const *pm_col_name, char const *exc_col_name_format,
+                         size_t num_exc_vals, char const *const exc_vals[num_exc_vals],
+                         Converter convert);
 
 /** Get the probability matched (or quantile mapped) value associated with CDF.
  *
@@ -67,7 +56,7 @@ double cumulative_dist_pm_value(CumulativeDistribution const *);
  *
  * \returns the probability of matching or exceeding the \c target_val.
  */
-double interpolate_prob_of_exceedance(CumulativeDistribution *cdf, double target_val);
+double interpolate_prob_of_exceedance(CumulativeDistribution const *cdf, double target_val);
 
 /** Get the value from a CDF at specific percentile.
  *
@@ -76,27 +65,66 @@ double interpolate_prob_of_exceedance(CumulativeDistribution *cdf, double target
  *
  * \returns the value at the percentile, or NAN if it was out of the possible range.
  */
-double cumulative_dist_percentile_value(CumulativeDistribution *cdf, double target_percentile);
+double cumulative_dist_percentile_value(CumulativeDistribution const *cdf,
+                                        double target_percentile);
+
+/** Get probabilities of exceedence for several values at once.
+ *
+ * This is the same as calling \ref interpolate_prob_of_exceedance() for each value, but it only
+ * sweeps through the CDF once.
+ *
+ * \param cdf is the function you want to sample.
+ * \param num_vals is the number of values in \a target_vals and \a probs.
+ * \param target_vals are the values you want the probabilities for, in ascending order.
+ * \param probs is where the probabilities are written, in the same order as \a target_vals.
+ */
+void interpolate_probs_of_exceedance(CumulativeDistribution const *cdf, size_t num_vals,
+                                     double const target_vals[num_vals], double probs[num_vals]);
+
+/** Get the values from a CDF at several percentiles at once.
+ *
+ * This is the same as calling \ref cumulative_dist_percentile_value() for each percentile, but it
+ * only sweeps through the CDF once.
+ *
+ * \param cdf is the function you want to sample.
+ * \param num_pcts is the number of percentiles in \a target_percentiles and \a vals.
+ * \param target_percentiles are the percentiles you want the values for, in ascending order.
+ * \param vals is where the values are written, in the same order as \a target_percentiles.
+ */
+void cumulative_dist_percentile_values(CumulativeDistribution const *cdf, size_t num_pcts,
+                                       double const target_percentiles[num_pcts],
+                                       double vals[num_pcts]);
 
 /** Get the maximum value in the \c CumulativeDistribution.
  *
  * Note that this may not be 100th percentile if the data only went up to the 90th or 99th as is
  * the case with our data.
  */
-double cumulative_dist_max_value(CumulativeDistribution *cdf);
+double cumulative_dist_max_value(CumulativeDistribution const *cdf);
 
 /** Get the minimum value in the \c CumulativeDistribution.
  *
  * Note that this may not be 0th percentile if the data started at the 1st percentile, as is often
  * the case with our data.
  */
-double cumulative_dist_min_value(CumulativeDistribution *cdf);
-
-/** Free a CDF object. */
-void cumulative_dist_free(void *);
+double cumulative_dist_min_value(CumulativeDistribution const *cdf);
 
 /** Write a cumulative distribution to a file. */
-void cumulative_dist_write(CumulativeDistribution *cdf, FILE *f);
+void cumulative_dist_write(CumulativeDistribution const *cdf, FILE *f);
+
+/** Get the number of values cumulative_dist_pack() copies out of a CDF. */
+size_t cumulative_dist_packed_len(CumulativeDistribution const *cdf);
+
+/** Copy a CDF into an array of values for saving in a binary file.
+ *
+ * The first value is the probability matched value, it is followed by a value and percentile pair
+ * for each point.
+ *
+ * \param cdf is the distribution to copy.
+ * \param len must be the value returned by cumulative_dist_packed_len().
+ * \param buf is where to copy the values.
+ */
+void cumulative_dist_pack(CumulativeDistribution const *cdf, size_t len, double buf[len]);
 
 /*-------------------------------------------------------------------------------------------------
  *                                  Probability Distributions
@@ -106,27 +134,60 @@ typedef struct ProbabilityDistribution ProbabilityDistribution;
 
 /** Create a ProbabilityDistribution from a CumulativeDistribution.
  *
+ * \param arena is where to allocate the PDF.
  * \param cdf the CumulativeDistribution to use as the source of this PDF.
  */
-ProbabilityDistribution *probability_dist_calc(CumulativeDistribution *cdf);
+ProbabilityDistribution *probability_dist_calc(Arena *arena, CumulativeDistribution const *cdf);
 
-/** Create a copy of a PDF. */
-ProbabilityDistribution *probability_dist_copy(ProbabilityDistribution *src);
+/** Create a copy of a PDF in \a arena. */
+ProbabilityDistribution *probability_dist_copy(Arena *arena, ProbabilityDistribution *src);
 
-/** Free resources associated with a ProbabilityDistribution */
-void probability_dist_free(void *);
+/** Smooth a PDF with a Gaussian kernel, as find_scenarios() does for each radius it tries.
+ *
+ * \param arena is where to allocate the smoothed PDF.
+ * \param pdf is the PDF to smooth, it isn't changed.
+ * \param smooth_radius is the standard deviation of the kernel.
+ *
+ * \returns a new PDF with the same bins as \a pdf, normalized to an area of 1.
+ */
+ProbabilityDistribution *probability_dist_smooth(Arena *arena, ProbabilityDistribution const *pdf,
+                                                 double smooth_radius);
 
 /** Write a probability distribution to a file. */
 void probability_dist_write(ProbabilityDistribution *pdf, FILE *f);
 
+/** Get the number of values probability_dist_pack() copies out of a PDF. */
+size_t probability_dist_packed_len(ProbabilityDistribution const *pdf);
+
+/** Copy a PDF into an array of values for saving in a binary file.
+ *
+ * The first value is the lower edge of the first bin, it is followed by the upper edge and the
+ * density of each bin. The bins are contiguous, so the lower edge of a bin is the upper edge of
+ * the one before it.
+ *
+ * \param pdf is the distribution to copy.
+ * \param len must be the value returned by probability_dist_packed_len().
+ * \param buf is where to copy the values.
+ */
+void probability_dist_pack(ProbabilityDistribution const *pdf, size_t len, double buf[len]);
+
 /*-------------------------------------------------------------------------------------------------
  *                                          Scenarios
  *-----------------------------------------------------------------------------------------------*/
 /** A scenario */
 typedef struct Scenario Scenario;
 
-/** Free memory associated with a scenario. */
-void scenario_free(void *ptr);
+/** The most scenarios that will be found for a PDF. */
+#define MAX_SCENARIOS 4
+
+/** The scenarios found for a PDF, sorted from highest to lowest probability. */
+typedef struct ScenarioList ScenarioList;
+
+/** Get the number of scenarios in the list, at most \ref MAX_SCENARIOS. */
+int scenario_list_len(ScenarioList const *list);
+
+/** Get a scenario from the list, 0 is the most likely. */
+Scenario const *scenario_list_get(ScenarioList const *list, int index);
 
 /** Get the value with the highest probability density in this scenario. */
 double scenario_get_mode(Scenario const *sc);
@@ -140,8 +201,22 @@ double scenario_get_maximum(Scenario const *sc);
 /** Get the probability associated with this scenario. */
 double scenario_get_probability(Scenario const *sc);
 
+/** Get the number of values scenario_list_pack() copies out of a list. */
+size_t scenario_list_packed_len(ScenarioList const *list);
+
+/** Copy a list of scenarios into an array of values for saving in a binary file.
+ *
+ * Each scenario is stored as its minimum, mode, maximum, and probability.
+ *
+ * \param list is the list to copy.
+ * \param len must be the value returned by scenario_list_packed_len().
+ * \param buf is where to copy the values.
+ */
+void scenario_list_pack(ScenarioList const *list, size_t len, double buf[len]);
+
 /** Analyze a of probability distribution and provide a list of scenarios.
  *
+ * \param arena is where to allocate the list.
  * \param pdf the ProbabilityDistribution to operate on.
  * \param minimum_smooth_radius is a minimum size scale parameter for Guassian smoothing of the PDF
  * when calculating the scenarios.
@@ -149,15 +224,26 @@ double scenario_get_probability(Scenario const *sc);
  * many scenarios are found. This algorithm keeps increasing the smooth radius until at most 4
  * scenarios are found.
  *
- * \returns a GList of scenarios sorted from highest to lowest probability.
+ * \returns the scenarios.
+ */
+ScenarioList *find_scenarios(Arena *arena, ProbabilityDistribution *pdf,
+                             double minimum_smooth_radius, double smooth_radius_inc);
+
+/** Create a PDF from each CDF in a \c TimeSeries.
+ *
+ * \param arena is where to allocate the PDFs.
+ * \param cdfs is a series from extract_cdfs().
+ *
+ * \returns a \c TimeSeries of \c ProbabilityDistribution objects with the same valid times.
  */
-GList *find_scenarios(ProbabilityDistribution *pdf, double minimum_smooth_radius,
-                      double smooth_radius_inc);
+TimeSeries *create_pdfs_from_cdfs(Arena *arena, TimeSeries *cdfs);
 
 /** Analyze a collection of probability distributions and provide scenarios.
  *
- * Applies find_scenarios() to each value in a GTree to produce a GTree of scenario lists.
+ * Applies find_scenarios() to each value in a \c TimeSeries to produce a \c TimeSeries of
+ * scenario lists. The valid times are independent, so they are spread across several threads.
  *
+ * \param arena is where to allocate the scenario lists.
  * \param pdfs the ProbabilityDistribution objects to operate on.
  * \param minimum_smooth_radius is a minimum size scale parameter for Guassian smoothing of the PDF
  * when calculating the scenarios.
@@ -165,14 +251,7 @@ GList *find_scenarios(ProbabilityDistribution *pdf, double minimum_smooth_radius
  * many scenarios are found. This algorithm keeps increasing the smooth radius until at most 4
  * scenarios are found.
  *
- * \returns a GTree of scenario lists. Each list is sorted from highest to lowest probability. The
- * keys to the GTree are the valid time as \c time_t objects.
+ * \returns a \c TimeSeries of \c ScenarioList objects.
  */
-GTree *create_scenarios_from_pdfs(GTree *pdfs, double minimum_smooth_radius,
-                                  double smooth_radius_inc);
-
-/*-------------------------------------------------------------------------------------------------
- *                  Utility functions for working with collections of distributions
- *-----------------------------------------------------------------------------------------------*/
-/** Free a glist of scenarios. */
-void free_glist_of_scenarios(void *ptr);
+TimeSeries *create_scenarios_from_pdfs(Arena *arena, TimeSeries *pdfs,
+                                       double minimum_smooth_radius, double smooth_radius_inc);
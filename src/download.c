@@ -1,205 +1,105 @@
 #include "download.h"
 #include "cache.h"
-
-#include <curl/curl.h>
-
-#define URL_LENGTH 1024
+#include "data_source.h"
+#include "metrics.h"
+#include "profile.h"
 
 extern bool global_verbose;
 
-/** Format the file name for downloading.
- *
- * If it is a site name then the spaces need to be replaced with the "%20" string.
- */
-static void
-format_file_name_for_url(int buf_len, char url_file_name[buf_len], char const file_name[static 1])
-{
-    assert(file_name);
-
-    // Copy into the new string exactly, except replace ' ' by "%20"
-    int j = 0;
-    for (int i = 0; file_name[i]; i++) {
-        Stopif(j == buf_len - 1, exit(EXIT_FAILURE), "URL Buffer overflow");
-        if (isspace(file_name[i])) {
-            url_file_name[j] = '%';
-            url_file_name[j + 1] = '2';
-            url_file_name[j + 2] = '0';
-            j += 3;
-        } else {
-            url_file_name[j] = file_name[i];
-            j += 1;
-        }
-    }
-    url_file_name[j] = '\0';
-}
-
-/**
- * Build the URL to retrieve data from the web into a string.
- *
- * There is a maximum size limit of 255 characters for the URL.
- *
- * \param file_name is a name of the file to download.
- * \param init_time is the model initialization time desired for download.
- *
- * \returns a pointer to a static string that contains the URL. It is important to NOT free this
- * string since it points to static memory.
- */
-static char const *
-build_download_url(char const file_name[static 1], time_t data_init_time)
+struct TextBuffer
+download_file(char const file_name[static 1], time_t init_time)
 {
     assert(file_name);
 
-    static char const *base_url = "https://hwp-viz.gsd.esrl.noaa.gov/wave1d/data/archive/";
-    static char url[URL_LENGTH] = {0};
-    // Clear the memory before starting over
-    memset(url, 0, URL_LENGTH);
-
-    // Format the site for the url.
-    char url_file_name[64] = {0};
-    format_file_name_for_url(sizeof(url_file_name), url_file_name, file_name);
-
-    struct tm init_time = *gmtime(&data_init_time);
-
-    int year = init_time.tm_year + 1900;
-    int month = init_time.tm_mon + 1;
-    int day = init_time.tm_mday;
-    int hour = init_time.tm_hour;
-
-    // NBM 4.0 started on 9/23/2020
-    struct tm nbm_version_4_starts_tm = {.tm_year = 2020 - 1900, .tm_mon = 9 - 1, .tm_mday = 23};
-    time_t nbm_version_4_starts = timegm(&nbm_version_4_starts_tm);
-
-    // NBM 4.1 started on 1/11/2023
-    struct tm nbm_version_41_starts_tm = {.tm_year = 2023 - 1900, .tm_mon = 1 - 1, .tm_mday = 11};
-    time_t nbm_version_41_starts = timegm(&nbm_version_41_starts_tm);
-
-    // NBM 4.2 started on 5/15/2024
-    struct tm nbm_version_42_starts_tm = {.tm_year = 2024 - 1900, .tm_mon = 5 - 1, .tm_mday = 15, .tm_hour = 11};
-    time_t nbm_version_42_starts = timegm(&nbm_version_42_starts_tm);
-
-    if (data_init_time > nbm_version_42_starts) {
-        // NBM 4.2
-        sprintf(url, "%s%4d/%02d/%02d/NBM4.2/%02d/%s", base_url, year, month, day, hour,
-                url_file_name);
-    } else if (data_init_time > nbm_version_41_starts) {
-        // NBM 4.1
-        sprintf(url, "%s%4d/%02d/%02d/NBM4.1/%02d/%s", base_url, year, month, day, hour,
-                url_file_name);
-    } else if (data_init_time > nbm_version_4_starts) {
-        // NBM 4.0
-        sprintf(url, "%s%4d/%02d/%02d/NBM4.0/%02d/%s", base_url, year, month, day, hour,
-                url_file_name);
-    } else {
-        sprintf(url, "%s%4d/%02d/%02d/NBM/%02d/%s", base_url, year, month, day, hour,
-                url_file_name);
-    }
-
-    return url;
-}
-
-/** Write callback for cURL. */
-static size_t
-write_callback(void *contents, size_t size, size_t nmemb, void *userp)
-{
-    size_t realsize = size * nmemb;
-    struct TextBuffer *buf = userp;
-    char *text = contents;
-
-    text_buffer_append(buf, realsize, text);
+    struct TextBuffer buf = text_buffer_with_capacity(0);
 
-    return realsize;
-}
+    bool use_cache = data_source_uses_cache();
 
-/** Global curl handle. */
-static CURL *curl = 0;
+    if (use_cache) {
+        ProfileSpan span = profile_begin("cache_retrieve", 0);
+        buf = cache_retrieve(file_name, init_time);
+        profile_end(&span);
+        metrics_cache_lookup(METRICS_CACHE_FILES, !text_buffer_is_empty(buf), buf.size);
 
-static CURL *
-download_module_get_curl_handle(struct TextBuffer *buf)
-{
-    CURLcode res = 0;
-    if (!curl) {
-        CURLcode err = curl_global_init(CURL_GLOBAL_DEFAULT);
-        Stopif(err, goto ERR_RETURN, "Failed to initialize curl");
-
-        curl = curl_easy_init();
-        Stopif(!curl, goto ERR_RETURN, "curl_easy_init failed.");
+        if (!text_buffer_is_empty(buf)) {
+            if (global_verbose)
+                printf("Successfully retrieved from the cache: %s\n", file_name);
+            return buf;
+        }
+    }
 
-        res = curl_easy_setopt(curl, CURLOPT_FAILONERROR, true);
-        Stopif(res, goto ERR_RETURN, "curl_easy_setopt failed to set fail on error.");
+    ProfileSpan span = profile_begin("download", 0);
+    buf = data_source_fetch(file_name, init_time);
+    profile_end(&span);
 
-        res = curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, write_callback);
-        Stopif(res, goto ERR_RETURN, "curl_easy_setopt failed to set the write_callback.");
+    if (use_cache && !text_buffer_is_empty(buf)) {
+        span = profile_begin("cache_add", 0);
+        int cache_res = cache_add(file_name, init_time, &buf);
+        profile_end(&span);
 
-        res = curl_easy_setopt(curl, CURLOPT_USERAGENT, "libcurl-agent/1.0");
-        Stopif(res, goto ERR_RETURN, "curl_easy_setopt failed to set the user agent.");
+        if (cache_res) {
+            fprintf(stderr, "Error saving to cache: %s\n", file_name);
+        } else {
+            metrics_cache_store(METRICS_CACHE_FILES, buf.size);
+        }
     }
 
-    res = curl_easy_setopt(curl, CURLOPT_WRITEDATA, buf);
-    Stopif(res, goto ERR_RETURN, "curl_easy_setopt failed to set the user data.");
-
-    return curl;
-
-ERR_RETURN:
-    return 0;
+    return buf;
 }
 
-struct TextBuffer
-download_file(char const file_name[static 1], time_t init_time)
+size_t
+download_files_to_cache(size_t num_files, char const *const file_names[num_files],
+                        time_t init_time)
 {
-    assert(file_name);
+    // Without the cache there is nothing to do but check they're there.
+    bool use_cache = data_source_uses_cache();
 
-    struct TextBuffer buf = text_buffer_with_capacity(0);
-    CURL *lcl_curl = 0;
+    size_t num_available = 0;
+    size_t num_missing = 0;
+    char const **missing = calloc(num_files, sizeof(char const *));
+    struct TextBuffer *bufs = calloc(num_files, sizeof(struct TextBuffer));
+    assert(missing && bufs);
 
-    int res = 1;
-    char const *url = 0;
+    for (size_t i = 0; i < num_files; i++) {
+        struct TextBuffer buf =
+            use_cache ? cache_retrieve(file_names[i], init_time) : text_buffer_with_capacity(0);
 
-    buf = cache_retrieve(file_name, init_time);
-    if (!text_buffer_is_empty(buf)) {
-        if (global_verbose)
-            printf("Successfully retrieved from the cache: %s\n", file_name);
-        return buf;
-    }
+        if (use_cache) {
+            metrics_cache_lookup(METRICS_CACHE_FILES, !text_buffer_is_empty(buf), buf.size);
+        }
 
-    lcl_curl = download_module_get_curl_handle(&buf);
-    Stopif(!lcl_curl, goto ERR_RETURN, "Error setting up cURL.");
+        if (text_buffer_is_empty(buf)) {
+            missing[num_missing++] = file_names[i];
+        } else {
+            num_available++;
+        }
 
-    url = build_download_url(file_name, init_time);
-    assert(url);
+        text_buffer_clear(&buf);
+    }
 
-    res = curl_easy_setopt(lcl_curl, CURLOPT_URL, url);
-    Stopif(res, goto ERR_RETURN, "curl_easy_setopt failed to set the url.");
-    res = curl_easy_perform(lcl_curl);
+    ProfileSpan span = profile_begin("download", 0);
+    data_source_fetch_many(num_missing, missing, init_time, bufs);
+    profile_end(&span);
 
-    if (res) {
-        long response_code = 0;
-        int res2 = curl_easy_getinfo(lcl_curl, CURLINFO_RESPONSE_CODE, &response_code);
-        Stopif(res2, goto ERR_RETURN, "curl_easy_getinfo failed: %s", curl_easy_strerror(res2));
+    for (size_t i = 0; i < num_missing; i++) {
+        if (!text_buffer_is_empty(bufs[i])) {
+            num_available++;
 
-        if (response_code == 404) {
-            res = CURLE_OK; // 0
-            if (global_verbose) {
-                printf("file not available: %s\n", url);
+            if (use_cache && cache_add(missing[i], init_time, &bufs[i])) {
+                fprintf(stderr, "Error saving to cache: %s\n", missing[i]);
+                num_available--;
+            } else if (use_cache) {
+                metrics_cache_store(METRICS_CACHE_FILES, bufs[i].size);
             }
         }
-    }
-
-    Stopif(res, goto ERR_RETURN, "curl_easy_perform failed: %s \n%s", curl_easy_strerror(res), url);
 
-    if (!text_buffer_is_empty(buf)) {
-        if (global_verbose)
-            printf("Successfully downloaded: %s\n", url);
-        int cache_res = cache_add(file_name, init_time, &buf);
-        if (cache_res) {
-            fprintf(stderr, "Error saving to cache: %s\n", file_name);
-        }
+        text_buffer_clear(&bufs[i]);
     }
 
-    return buf;
+    free(bufs);
+    free(missing);
 
-ERR_RETURN:
-    text_buffer_clear(&buf);
-    return buf;
+    return num_available;
 }
 
 RawNbmData *
@@ -239,8 +139,5 @@ download_module_initialize()
 void
 download_module_finalize()
 {
-    if (curl) {
-        curl_easy_cleanup(curl);
-        curl_global_cleanup();
-    }
+    data_source_finalize();
 }
@@ -7,7 +7,9 @@
 
 /** Download a file from the online archive.
  *
- * This is used by other routines to download files from the archive server.
+ * This is used by other routines to download files from the archive server. The cache is checked
+ * first, and if the file isn't there it is retrieved from the backend selected with
+ * data_source_select(), which defaults to the online archive.
  *
  * \param file_name - the name of the file on the server.
  * \param init_time - the NBM initialization time, so the routine knows where to go to get the file.
@@ -16,6 +18,19 @@
  */
 struct TextBuffer download_file(char const file_name[static 1], time_t init_time);
 
+/** Make sure several files for the same NBM initialization time are in the download cache.
+ *
+ * Any files not already in the cache are downloaded concurrently and added to it.
+ *
+ * \param num_files is the number of files in \a file_names.
+ * \param file_names are the names of the files on the server.
+ * \param init_time is the NBM initialization time, so the routine knows where to go to get the files.
+ *
+ * \returns the number of files that are now available in the cache.
+ */
+size_t download_files_to_cache(size_t num_files, char const *const file_names[num_files],
+                               time_t init_time);
+
 /** Retrieve the CSV data for a site.
  *
  * \param site is the name of the site you want to download data for.
@@ -1,6 +1,11 @@
 #pragma once
 
+#include <stdbool.h>
+#include <stdio.h>
+
+#include "dist_archive.h"
 #include "nbm_data.h"
+#include "records.h"
 
 /** A Wind Gust Summary. */
 typedef struct GustSum GustSum;
@@ -12,10 +17,19 @@ typedef struct GustSum GustSum;
 GustSum *gust_sum_build(NBMData const *nbm);
 
 /** Print a probabilistic summary. */
-void show_gust_summary(GustSum const *gsum);
+void show_gust_summary(GustSum const *gsum, FILE *out);
 
 /** Print a summary of the wind gust scenarios. */
-void show_gust_scenarios(GustSum *gsum);
+void show_gust_scenarios(GustSum *gsum, FILE *out);
+
+/** Write the summary and/or the scenarios as machine readable records.
+ *
+ * \param gsum is the summary to write.
+ * \param summary is whether to write the probabilistic summary.
+ * \param scenarios is whether to write the wind gust scenarios.
+ * \param w is where to write the records.
+ */
+void gust_sum_write_records(GustSum *gsum, bool summary, bool scenarios, RecordWriter *w);
 
 /** Save two files with the CDF and PDF information in them.
  *
@@ -28,5 +42,23 @@ void show_gust_scenarios(GustSum *gsum);
  */
 void gust_sum_save(GustSum *gsum, char const *directory, char const *file_prefix);
 
+/** Add the CDFs, PDFs, and scenarios to a binary archive, building them if needed. */
+void gust_sum_archive(GustSum *gsum, DistArchiveWriter *writer);
+
+/** Build the PDFs and scenarios now instead of the first time they are used.
+ *
+ * Once they are built, showing, writing, saving, or archiving the summary only reads it, so it can
+ * be done from several threads at once.
+ *
+ * \param scenarios is whether the PDFs and scenarios will be needed.
+ */
+void gust_sum_prepare(GustSum *gsum, bool scenarios);
+
+/** Get the approximate number of bytes of memory used by a \c GustSum.
+ *
+ * This includes the CDFs, PDFs, and scenarios that have been built so far.
+ */
+size_t gust_sum_memory_bytes(GustSum const *gsum);
+
 /** Free the memory associated with a \c GustSum.*/
 void gust_sum_free(GustSum **gsum);
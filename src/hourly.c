@@ -156,133 +156,122 @@ hourly_access_rh(void *sm)
     return &hrly->rh;
 }
 
-static void
-extract_hourly_values_for_column(GTree *hrs, NBMData const *nbm, char const *col_name,
-                                 Converter convert, Creator create_new, Extractor extract)
-{
-    NBMDataRowIterator *it = nbm_data_rows(nbm, col_name);
-    Stopif(!it, exit(EXIT_FAILURE), "error creating iterator for %s", col_name);
+/** A column of the NBM with a single value for each hour. */
+struct HourlyColumn {
+    char const *name;
+    Converter convert;
+    Extractor extract;
+};
 
-    time_t init_time = nbm_data_init_time(nbm);
+static struct HourlyColumn const hourly_columns[] = {
+    {"TMP_2 m above ground", kelvin_to_fahrenheit, hourly_access_t},
+    {"TMP_2 m above ground_ens std dev", change_in_kelvin_to_change_in_fahrenheit,
+     hourly_access_t_std},
+    {"DPT_2 m above ground", kelvin_to_fahrenheit, hourly_access_dp},
+    {"DPT_2 m above ground_ens std dev", change_in_kelvin_to_change_in_fahrenheit,
+     hourly_access_dp_std},
+    {"RH_2 m above ground", id_func, hourly_access_rh},
+    {"TCDC_surface", id_func, hourly_access_sky},
+    {"APCP1hr_surface_prob >0.254", id_func, hourly_access_pop},
+    {"APCP1hr_surface", mm_to_in, hourly_access_qpf_1hr},
+    {"TSTM1hr_surface_probability forecast", id_func, hourly_access_prob_ltg},
+    {"CAPE_surface", id_func, hourly_access_cape},
+    {"SNOWLR_surface", id_func, hourly_access_slr},
+    {"ASNOW1hr_surface", m_to_in, hourly_access_snow},
+};
 
-    struct NBMDataRowIteratorValueView view = nbm_data_row_iterator_next(it);
-    double age = difftime(*view.valid_time, init_time) / 3600.0;
-    while (view.valid_time && view.value && age < MAX_LEAD_TIME_HRS) {
+#define NUM_HOURLY_COLUMNS (sizeof(hourly_columns) / sizeof(hourly_columns[0]))
 
-        if (age >= 0.0) {
+/** Winds are only used when all of these are available, they come after the hourly columns. */
+enum WindColumn { WIND_SPD, WIND_SPD_STD, WIND_GUST, WIND_GUST_STD, WIND_DIR, NUM_WIND_COLUMNS };
 
-            void *hrly = g_tree_lookup(hrs, view.valid_time);
-            if (!hrly) {
-                time_t *key = malloc(sizeof(time_t));
-                *key = *view.valid_time;
-                hrly = create_new();
-                g_tree_insert(hrs, key, hrly);
-            }
-            double *sum_val = extract(hrly);
-            *sum_val = convert(*view.value);
-        }
+static char const *const wind_columns[NUM_WIND_COLUMNS] = {
+    [WIND_SPD] = "WIND_10 m above ground",
+    [WIND_SPD_STD] = "WIND_10 m above ground_ens std dev",
+    [WIND_GUST] = "GUST_10 m above ground",
+    [WIND_GUST_STD] = "GUST_10 m above ground_ens std dev",
+    [WIND_DIR] = "WDIR_10 m above ground",
+};
 
-        // update loop variables
-        view = nbm_data_row_iterator_next(it);
-        if (view.valid_time) {
-            age = difftime(*view.valid_time, init_time) / 3600.0;
-        } else {
-            break;
-        }
+static struct Hourly *
+hourly_for_time(TimeSeries *hrs, time_t valid_time)
+{
+    struct Hourly *hrly = time_series_lookup(hrs, valid_time);
+    if (!hrly) {
+        hrly = hourly_new();
+        time_series_insert(hrs, valid_time, hrly);
     }
 
-    nbm_data_row_iterator_free(&it);
+    return hrly;
 }
 
-static void
-extract_max_winds_to_summary(GTree *hrs, NBMData const *nbm)
+/** Build a sorted list (\c TimeSeries) of hourly data from an \c NBMData object.
+ *
+ * All the columns are read in a single pass over the rows.
+ */
+static TimeSeries *
+build_hourlies(NBMData const *nbm)
 {
-    NBMDataRowIteratorWind *it = nbm_data_rows_wind(nbm);
-    Stopif(!it, exit(EXIT_FAILURE), "error creating wind iterator.");
+    struct NBMDataCursorColumn cols[NUM_HOURLY_COLUMNS + NUM_WIND_COLUMNS] = {0};
+    for (size_t i = 0; i < NUM_HOURLY_COLUMNS; i++) {
+        cols[i] = (struct NBMDataCursorColumn){hourly_columns[i].name, NBM_DATA_COLUMN_OPTIONAL};
+    }
+    for (size_t i = 0; i < NUM_WIND_COLUMNS; i++) {
+        cols[NUM_HOURLY_COLUMNS + i] =
+            (struct NBMDataCursorColumn){wind_columns[i], NBM_DATA_COLUMN_OPTIONAL};
+    }
 
+    size_t const num_cols = NUM_HOURLY_COLUMNS + NUM_WIND_COLUMNS;
+    NBMDataRowCursor *cur = nbm_data_row_cursor_new(nbm, num_cols, cols);
+    Stopif(!cur, exit(EXIT_FAILURE), "error creating cursor for hourly data");
+
+    TimeSeries *hrs = time_series_new(MAX_LEAD_TIME_HRS + 1, free);
     time_t init_time = nbm_data_init_time(nbm);
 
-    struct NBMDataRowIteratorWindValueView view = nbm_data_row_wind_iterator_next(it);
-    double age = difftime(*view.valid_time, init_time) / 3600.0;
-    while (view.valid_time && age < MAX_LEAD_TIME_HRS) {
+    while (nbm_data_row_cursor_next(cur)) {
+        time_t valid_time = nbm_data_row_cursor_valid_time(cur);
+        double age = difftime(valid_time, init_time) / 3600.0;
+        if (age >= MAX_LEAD_TIME_HRS) {
+            break;
+        }
+        if (age < 0.0) {
+            continue;
+        }
 
-        if (age >= 0.0) {
+        struct Hourly *hrly = 0;
+        for (size_t i = 0; i < NUM_HOURLY_COLUMNS; i++) {
+            double val = nbm_data_row_cursor_value(cur, i);
+            if (isnan(val)) {
+                continue;
+            }
 
-            struct Hourly *hrly = g_tree_lookup(hrs, view.valid_time);
             if (!hrly) {
-                time_t *key = malloc(sizeof(time_t));
-                *key = *view.valid_time;
-                hrly = (struct Hourly *)hourly_new();
-                g_tree_insert(hrs, key, hrly);
-            }
-            double wind_mph = mps_to_mph(*view.wspd);
-            double wind_std = mps_to_mph(*view.wspd_std);
-            double wind_gust = mps_to_mph(*view.gust);
-            double wind_gust_std = mps_to_mph(*view.gust_std);
-            double wind_dir = *view.wdir;
-
-            if (isnan(hrly->wind_spd)) {
-                hrly->wind_spd = wind_mph;
-                hrly->wind_spd_sd = wind_std;
-                hrly->wind_gust = wind_gust;
-                hrly->wind_gust_sd = wind_gust_std;
-                hrly->wind_dir = wind_dir;
+                hrly = hourly_for_time(hrs, valid_time);
             }
+            double *sum_val = hourly_columns[i].extract(hrly);
+            *sum_val = hourly_columns[i].convert(val);
         }
 
-        // update loop variables
-        view = nbm_data_row_wind_iterator_next(it);
-        age = difftime(*view.valid_time, init_time) / 3600.0;
-    }
-
-    nbm_data_row_wind_iterator_free(&it);
-}
-
-/** Build a sorted list (\c Tree) of hourly data from an \c NBMData object. */
-static GTree *
-build_hourlies(NBMData const *nbm)
-{
-    GTree *hrs = g_tree_new_full(time_t_compare_func, 0, free, free);
-
-    extract_hourly_values_for_column(hrs, nbm, "TMP_2 m above ground", kelvin_to_fahrenheit,
-                                     hourly_new, hourly_access_t);
-
-    extract_hourly_values_for_column(hrs, nbm, "TMP_2 m above ground_ens std dev",
-                                     change_in_kelvin_to_change_in_fahrenheit, hourly_new,
-                                     hourly_access_t_std);
-
-    extract_hourly_values_for_column(hrs, nbm, "DPT_2 m above ground", kelvin_to_fahrenheit,
-                                     hourly_new, hourly_access_dp);
-
-    extract_hourly_values_for_column(hrs, nbm, "DPT_2 m above ground_ens std dev",
-                                     change_in_kelvin_to_change_in_fahrenheit, hourly_new,
-                                     hourly_access_dp_std);
-
-    extract_hourly_values_for_column(hrs, nbm, "RH_2 m above ground", id_func, hourly_new,
-                                     hourly_access_rh);
-
-    extract_hourly_values_for_column(hrs, nbm, "TCDC_surface", id_func, hourly_new,
-                                     hourly_access_sky);
-
-    extract_hourly_values_for_column(hrs, nbm, "APCP1hr_surface_prob >0.254", id_func, hourly_new,
-                                     hourly_access_pop);
-
-    extract_hourly_values_for_column(hrs, nbm, "APCP1hr_surface", mm_to_in, hourly_new,
-                                     hourly_access_qpf_1hr);
-
-    extract_hourly_values_for_column(hrs, nbm, "TSTM1hr_surface_probability forecast", id_func,
-                                     hourly_new, hourly_access_prob_ltg);
-
-    extract_hourly_values_for_column(hrs, nbm, "CAPE_surface", id_func, hourly_new,
-                                     hourly_access_cape);
-
-    extract_hourly_values_for_column(hrs, nbm, "SNOWLR_surface", id_func, hourly_new,
-                                     hourly_access_slr);
+        double wind[NUM_WIND_COLUMNS] = {0};
+        bool has_wind = true;
+        for (size_t i = 0; i < NUM_WIND_COLUMNS; i++) {
+            wind[i] = nbm_data_row_cursor_value(cur, NUM_HOURLY_COLUMNS + i);
+            has_wind &= !isnan(wind[i]);
+        }
 
-    extract_hourly_values_for_column(hrs, nbm, "ASNOW1hr_surface", m_to_in, hourly_new,
-                                     hourly_access_snow);
+        if (has_wind) {
+            if (!hrly) {
+                hrly = hourly_for_time(hrs, valid_time);
+            }
+            hrly->wind_spd = mps_to_mph(wind[WIND_SPD]);
+            hrly->wind_spd_sd = mps_to_mph(wind[WIND_SPD_STD]);
+            hrly->wind_gust = mps_to_mph(wind[WIND_GUST]);
+            hrly->wind_gust_sd = mps_to_mph(wind[WIND_GUST_STD]);
+            hrly->wind_dir = wind[WIND_DIR];
+        }
+    }
 
-    extract_max_winds_to_summary(hrs, nbm);
+    nbm_data_row_cursor_free(&cur);
 
     return hrs;
 }
@@ -295,7 +284,8 @@ build_title(NBMData const *nbm, Table *tbl)
 {
     char title_buf[256] = {0};
     time_t init_time = nbm_data_init_time(nbm);
-    struct tm init = *gmtime(&init_time);
+    struct tm init = {0};
+    gmtime_r(&init_time, &init);
     sprintf(title_buf, "Hourly data for %s (%s) - ", nbm_data_site_name(nbm),
             nbm_data_site_id(nbm));
     int len = strlen(title_buf);
@@ -317,7 +307,8 @@ add_row_to_table(void *key, void *value, void *state)
         return false;
 
     char datebuf[64] = {0};
-    strftime(datebuf, sizeof(datebuf), " %a, %Y-%m-%d %H ", gmtime(vt));
+    struct tm vt_tm = {0};
+    strftime(datebuf, sizeof(datebuf), " %a, %Y-%m-%d %H ", gmtime_r(vt, &vt_tm));
 
     table_set_string_value(tbl, 0, row, strlen(datebuf), datebuf);
     table_set_avg_std(tbl, 1, row, hrly->t_f, hrly->t_std);
@@ -343,13 +334,13 @@ add_row_to_table(void *key, void *value, void *state)
  *                                    External API functions.
  *-----------------------------------------------------------------------------------------------*/
 void
-show_hourly(NBMData const *nbm)
+show_hourly(NBMData const *nbm, FILE *out)
 {
 
-    GTree *hrs = build_hourlies(nbm);
+    TimeSeries *hrs = build_hourlies(nbm);
 
     // --
-    Table *tbl = table_new(14, g_tree_nnodes(hrs));
+    Table *tbl = table_new(14, time_series_len(hrs));
 
     build_title(nbm, tbl);
 
@@ -384,11 +375,46 @@ show_hourly(NBMData const *nbm)
     table_set_blank_value(tbl, 13, 0.0);
 
     struct TableFillerState state = {.row = 0, .tbl = tbl};
-    g_tree_foreach(hrs, add_row_to_table, &state);
+    time_series_foreach(hrs, add_row_to_table, &state);
 
-    table_display(tbl, stdout);
+    table_display(tbl, out);
 
     table_free(&tbl);
 
-    g_tree_unref(hrs);
+    time_series_free(&hrs);
+}
+
+void
+hourly_write_records(NBMData const *nbm, RecordWriter *w)
+{
+    TimeSeries *hrs = build_hourlies(nbm);
+
+    for (size_t i = 0; i < time_series_len(hrs); i++) {
+        struct Hourly const *hrly = time_series_value(hrs, i);
+        if (hourly_not_printable(hrly)) {
+            continue;
+        }
+
+        record_begin(w, "hourly", time_series_time(hrs, i));
+        record_add_value(w, "t", hrly->t_f);
+        record_add_value(w, "t_std", hrly->t_std);
+        record_add_value(w, "dp", hrly->dp_f);
+        record_add_value(w, "dp_std", hrly->dp_std);
+        record_add_value(w, "rh", hrly->rh);
+        record_add_value(w, "wind_dir", hrly->wind_dir);
+        record_add_value(w, "wind_spd", hrly->wind_spd);
+        record_add_value(w, "wind_spd_std", hrly->wind_spd_sd);
+        record_add_value(w, "wind_gust", hrly->wind_gust);
+        record_add_value(w, "wind_gust_std", hrly->wind_gust_sd);
+        record_add_value(w, "sky", hrly->sky);
+        record_add_value(w, "pop", hrly->pop);
+        record_add_value(w, "qpf_1hr", hrly->qpf_1hr);
+        record_add_value(w, "cape", hrly->cape);
+        record_add_value(w, "prob_ltg", hrly->prob_ltg);
+        record_add_value(w, "slr", hrly->slr);
+        record_add_value(w, "snow_1hr", hrly->snow);
+        record_end(w);
+    }
+
+    time_series_free(&hrs);
 }
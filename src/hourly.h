@@ -1,8 +1,14 @@
 #pragma once
 
+#include <stdio.h>
+
 #include "nbm_data.h"
+#include "records.h"
 
 /**
  * Print hourly data for the first day or two.
  */
-void show_hourly(NBMData const *);
+void show_hourly(NBMData const *, FILE *out);
+
+/** Write the same hourly data as \ref show_hourly() as machine readable records. */
+void hourly_write_records(NBMData const *nbm, RecordWriter *w);
@@ -12,13 +12,42 @@
 
 #include <glib.h>
 
+#define NUM_PROB_EXC_VALS 5
+static char const *exc_vals[NUM_PROB_EXC_VALS] = {
+    "0.254", "2.54", "6.35", "12.7", "25.4",
+};
+
+/** The thresholds the probabilities of exceedance are shown for, in inches. */
+static double const summary_exc_vals[] = {0.01, 0.02, 0.05, 0.1, 0.25};
+#define NUM_SUMMARY_EXC_VALS (sizeof(summary_exc_vals) / sizeof(summary_exc_vals[0]))
+
+static TimeSeries *
+build_cdfs(Arena *arena, NBMData const *nbm, int hours)
+{
+    char percentile_format[32] = {0};
+    char deterministic_ice_key[32] = {0};
+
+    sprintf(percentile_format, "FICEAC%dhr_surface_%%d%%%% level", hours);
+    sprintf(deterministic_ice_key, "FICEAC%dhr_surface", hours);
+
+    char prob_exceedence_format[32] = {0};
+    sprintf(prob_exceedence_format, "FICEAC%dhr_surface_prob >%%s", hours);
+
+    TimeSeries *cdfs = extract_cdfs(arena, nbm, percentile_format, deterministic_ice_key,
+                                    prob_exceedence_format, NUM_PROB_EXC_VALS, exc_vals, mm_to_in);
+    Stopif(!cdfs, return 0, "Error extracting CDFs for Ice.");
+
+    return cdfs;
+}
+
 static void
 build_title_ice(NBMData const *nbm, Table *tbl, int hours)
 {
 
     char title_buf[256] = {0};
     time_t init_time = nbm_data_init_time(nbm);
-    struct tm init = *gmtime(&init_time);
+    struct tm init = {0};
+    gmtime_r(&init_time, &init);
     sprintf(title_buf, "%d Hr Probabilistic Ice for %s (%s) - ", hours, nbm_data_site_name(nbm),
             nbm_data_site_id(nbm));
     int len = strlen(title_buf);
@@ -38,20 +67,28 @@ add_row_prob_ice_exceedence_to_table(void *key, void *value, void *state)
 
     double pm_value = round(cumulative_dist_pm_value(dist) * 100.0) / 100.0;
 
-    double p10th = round(cumulative_dist_percentile_value(dist, 10.0) * 100.0) / 100.0;
-    double p25th = round(cumulative_dist_percentile_value(dist, 25.0) * 100.0) / 100.0;
-    double p50th = round(cumulative_dist_percentile_value(dist, 50.0) * 100.0) / 100.0;
-    double p75th = round(cumulative_dist_percentile_value(dist, 75.0) * 100.0) / 100.0;
-    double p90th = round(cumulative_dist_percentile_value(dist, 90.0) * 100.0) / 100.0;
+    static double const pcts[5] = {10.0, 25.0, 50.0, 75.0, 90.0};
+    double pct_vals[5] = {0};
+    cumulative_dist_percentile_values(dist, 5, pcts, pct_vals);
+
+    double p10th = round(pct_vals[0] * 100.0) / 100.0;
+    double p25th = round(pct_vals[1] * 100.0) / 100.0;
+    double p50th = round(pct_vals[2] * 100.0) / 100.0;
+    double p75th = round(pct_vals[3] * 100.0) / 100.0;
+    double p90th = round(pct_vals[4] * 100.0) / 100.0;
 
-    double prob_01 = round(interpolate_prob_of_exceedance(dist, 0.01));
-    double prob_02 = round(interpolate_prob_of_exceedance(dist, 0.02));
-    double prob_05 = round(interpolate_prob_of_exceedance(dist, 0.05));
-    double prob_10 = round(interpolate_prob_of_exceedance(dist, 0.1));
-    double prob_25 = round(interpolate_prob_of_exceedance(dist, 0.25));
+    double probs[NUM_SUMMARY_EXC_VALS] = {0};
+    interpolate_probs_of_exceedance(dist, NUM_SUMMARY_EXC_VALS, summary_exc_vals, probs);
+
+    double prob_01 = round(probs[0]);
+    double prob_02 = round(probs[1]);
+    double prob_05 = round(probs[2]);
+    double prob_10 = round(probs[3]);
+    double prob_25 = round(probs[4]);
 
     char datebuf[64] = {0};
-    strftime(datebuf, sizeof(datebuf), "%a, %Y-%m-%d %HZ", gmtime(vt));
+    struct tm vt_tm = {0};
+    strftime(datebuf, sizeof(datebuf), "%a, %Y-%m-%d %HZ", gmtime_r(vt, &vt_tm));
 
     table_set_string_value(tbl, 0, row, strlen(datebuf), datebuf);
 
@@ -74,35 +111,20 @@ add_row_prob_ice_exceedence_to_table(void *key, void *value, void *state)
     return false;
 }
 
-#define NUM_PROB_EXC_VALS 5
-static char const *exc_vals[NUM_PROB_EXC_VALS] = {
-    "0.254", "2.54", "6.35", "12.7", "25.4",
-};
-
 void
-show_ice_summary(NBMData const *nbm, int hours)
+show_ice_summary(NBMData const *nbm, int hours, FILE *out)
 {
-    char percentile_format[32] = {0};
-    char deterministic_ice_key[32] = {0};
     char left_col_title[32] = {0};
-
-    sprintf(percentile_format, "FICEAC%dhr_surface_%%d%%%% level", hours);
-    sprintf(deterministic_ice_key, "FICEAC%dhr_surface", hours);
     sprintf(left_col_title, "%d Hrs Ending / in.", hours);
 
-    GTree *cdfs = extract_cdfs(nbm, percentile_format, deterministic_ice_key, mm_to_in);
-    Stopif(!cdfs, return, "Error extracting CDFs for Ice.");
+    Arena *arena = arena_new();
+    TimeSeries *cdfs = build_cdfs(arena, nbm, hours);
+    Stopif(!cdfs, goto EXIT, "Error extracting CDFs for Ice.");
 
-    char prob_exceedence_format[32] = {0};
-    sprintf(prob_exceedence_format, "FICEAC%dhr_surface_prob >%%s", hours);
-
-    cdfs = extract_exceedence_to_cdfs(cdfs, nbm, prob_exceedence_format, NUM_PROB_EXC_VALS,
-                                      exc_vals, mm_to_in);
-
-    int num_rows = g_tree_nnodes(cdfs);
+    int num_rows = time_series_len(cdfs);
     if (num_rows == 0) {
-        printf("\n\n     ***** No ice summary for accumulation period %d. *****\n\n", hours);
-        return;
+        fprintf(out, "\n\n     ***** No ice summary for accumulation period %d. *****\n\n", hours);
+        goto EXIT;
     }
 
     Table *tbl = table_new(12, num_rows);
@@ -132,13 +154,31 @@ show_ice_summary(NBMData const *nbm, int hours)
     }
 
     struct TableFillerState state = {.row = 0, .tbl = tbl};
-    g_tree_foreach(cdfs, add_row_prob_ice_exceedence_to_table, &state);
-
-    table_display(tbl, stdout);
+    time_series_foreach(cdfs, add_row_prob_ice_exceedence_to_table, &state);
 
-    g_tree_unref(cdfs);
+    table_display(tbl, out);
 
     table_free(&tbl);
+
+EXIT:
+    time_series_free(&cdfs);
+    arena_free(&arena);
+}
+
+void
+ice_summary_write_records(NBMData const *nbm, int hours, RecordWriter *w)
+{
+    Arena *arena = arena_new();
+    TimeSeries *cdfs = build_cdfs(arena, nbm, hours);
+    Stopif(!cdfs, goto EXIT, "Error extracting CDFs for Ice.");
+
+    char element[32] = {0};
+    sprintf(element, "ice_%dh", hours);
+    records_write_cdfs(w, element, cdfs, NUM_SUMMARY_EXC_VALS, summary_exc_vals);
+
+EXIT:
+    time_series_free(&cdfs);
+    arena_free(&arena);
 }
 
 #undef NUM_PROB_EXC_VALS
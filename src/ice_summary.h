@@ -1,6 +1,9 @@
 #pragma once
 
+#include <stdio.h>
+
 #include "nbm_data.h"
+#include "records.h"
 
 /**
  * Print a summary of the probability of reaching certain ice amounts.
@@ -8,4 +11,7 @@
  * \param nbm the data to summarize.
  * \param hours is the accumulation period of the ice accumulation.
  */
-void show_ice_summary(NBMData const *nbm, int hours);
+void show_ice_summary(NBMData const *nbm, int hours, FILE *out);
+
+/** Write the same summary as \ref show_ice_summary() as machine readable records. */
+void ice_summary_write_records(NBMData const *nbm, int hours, RecordWriter *w);
@@ -1,23 +1,21 @@
 // standard lib
 #include <locale.h>
-#include <math.h>
 #include <stdio.h>
 
 #include <glib.h>
 
 // Program developed headers
 #include "cache.h"
-#include "daily_summary.h"
+#include "data_source.h"
+#include "dist_archive.h"
 #include "download.h"
-#include "gust_summary.h"
-#include "hourly.h"
-#include "ice_summary.h"
+#include "metrics.h"
 #include "options.h"
-#include "precip_summary.h"
-#include "snow_summary.h"
-#include "temp_summary.h"
+#include "prefetch.h"
+#include "profile.h"
+#include "report.h"
+#include "server.h"
 #include "utils.h"
-#include "wind_summary.h"
 
 /*-------------------------------------------------------------------------------------------------
  *                                    Program Setup and Teardown.
@@ -33,187 +31,110 @@ program_initialization()
 static void
 program_finalization()
 {
+    metrics_finish();
     download_module_finalize();
     cache_finalize();
 }
 
 /*-------------------------------------------------------------------------------------------------
- *                                    Quality checks/alerts.
- *-----------------------------------------------------------------------------------------------*/
-static void
-alert_age(NBMData const *nbm)
-{
-    double age_secs = nbm_data_age(nbm);
-    int age_hrs = (int)round(age_secs / 3600.0);
-
-    if (age_hrs >= 12) {
-        int age_days = age_hrs / 24;
-        age_hrs -= age_days * 24;
-
-        printf("     *\n");
-        printf("     * OLD NBM DATA - data is: ");
-        if (age_days > 1) {
-            printf("%d days and", age_days);
-        } else if (age_days > 0) {
-            printf("%d day and", age_days);
-        }
-        if (age_hrs > 1) {
-            printf(" %d hours old", age_hrs);
-        } else if (age_hrs > 0) {
-            printf(" %d hour old", age_hrs);
-        }
-        printf("\n");
-        printf("     *\n");
-    }
-}
-
-/*-------------------------------------------------------------------------------------------------
- *                                    Main Output
+ *                                    Main Program
  *-----------------------------------------------------------------------------------------------*/
-static void
-do_output(NBMData const *nbm, struct OptArgs opt_args)
+int
+main(int argc, char *argv[argc + 1])
 {
-    // Check the time we requested data for, if it is more than an hour ago, don't bother alerting
-    // for the age, since we are probably requesting an archived run and not the most recent. If
-    // it is more recent than an hour, we probably requested the most recent run and should be
-    // alerted if it is too old.
-    if (difftime(time(0), opt_args.request_time) < 3600.0) {
-        alert_age(nbm);
-    }
-
-    if (opt_args.show_summary)
-        show_daily_summary(nbm);
-
-    if (opt_args.show_hourly)
-        show_hourly(nbm);
-
-    if (opt_args.show_temperature || opt_args.show_temperature_scenarios) {
-        TempSum *tsum = temp_sum_build(nbm);
-
-        if (opt_args.show_temperature) {
-            show_temp_summary(tsum);
-        }
-        if (opt_args.show_temperature_scenarios) {
-            show_temp_scenarios(tsum);
-        }
+    int exit_code = EXIT_FAILURE;
 
-        if (opt_args.save_dir) {
-            temp_sum_save(tsum, opt_args.save_dir, opt_args.save_prefix);
-        }
+    // Variables that hold allocated memory.
+    SiteValidation *validation = 0;
+    NBMData *nbm_data = 0;
+    SiteData *site_data = 0;
 
-        temp_sum_free(&tsum);
+    // A client doesn't need anything else initialized, the server does all the work.
+    char *connect_socket = options_find_connect_socket(&argc, argv);
+    if (connect_socket) {
+        return server_send_request(connect_socket, argc, argv, stdout);
     }
 
-    for (int i = 0; i < sizeof(opt_args.accum_hours) && opt_args.accum_hours[i]; i++) {
-
-        if (opt_args.show_rain || opt_args.show_precip_scenarios) {
-
-            PrecipSum *psum = precip_sum_build(nbm, opt_args.accum_hours[i]);
-
-            if (opt_args.show_rain) {
-                show_precip_summary(psum);
-            }
-
-            if (opt_args.show_precip_scenarios) {
-                show_precip_scenarios(psum);
-            }
-
-            if (opt_args.save_dir) {
-                precip_sum_save(psum, opt_args.save_dir, opt_args.save_prefix);
-            }
-
-            precip_sum_free(&psum);
-        }
-
-        if (opt_args.show_snow || opt_args.show_snow_scenarios) {
-
-            SnowSum *ssum = snow_sum_build(nbm, opt_args.accum_hours[i]);
-
-            if (opt_args.show_snow) {
-                show_snow_summary(ssum);
-            }
-
-            if (opt_args.show_snow_scenarios) {
-                show_snow_scenarios(ssum);
-            }
-
-            if (opt_args.save_dir) {
-                snow_sum_save(ssum, opt_args.save_dir, opt_args.save_prefix);
-            }
+    program_initialization();
 
-            snow_sum_free(&ssum);
-        }
+    struct OptArgs opt_args = parse_cmd_line(argc, argv);
+    Stopif(opt_args.error_parsing_options, goto EXIT_ERR, "Error parsing command line.");
 
-        if (opt_args.show_ice) {
-            show_ice_summary(nbm, opt_args.accum_hours[i]);
-        }
+    if (opt_args.profile != PROFILE_OFF) {
+        profile_start(opt_args.profile);
     }
 
-    if (opt_args.show_wind || opt_args.show_wind_scenarios) {
-        WindSum *wsum = wind_sum_build(nbm);
-
-        if (opt_args.show_wind) {
-            show_wind_summary(wsum);
-        }
-        if (opt_args.show_wind_scenarios) {
-            show_wind_scenarios(wsum);
-        }
-
-        if (opt_args.save_dir) {
-            wind_sum_save(wsum, opt_args.save_dir, opt_args.save_prefix);
-        }
-
-        wind_sum_free(&wsum);
+    if (opt_args.metrics_file) {
+        metrics_start(opt_args.metrics_file);
     }
 
-    if (opt_args.show_gust || opt_args.show_gust_scenarios) {
-        GustSum *gsum = gust_sum_build(nbm);
+    if (opt_args.archive_dir) {
+        data_source_select(DATA_SOURCE_LOCAL, opt_args.archive_dir);
+    } else if (opt_args.mirror_url) {
+        data_source_select(DATA_SOURCE_MIRROR, opt_args.mirror_url);
+    } else if (opt_args.replay_dir) {
+        data_source_select(DATA_SOURCE_REPLAY, opt_args.replay_dir);
+    }
 
-        if (opt_args.show_gust) {
-            show_gust_summary(gsum);
-        }
-        if (opt_args.show_gust_scenarios) {
-            show_gust_scenarios(gsum);
-        }
+    if (opt_args.record_dir) {
+        Stopif(!data_source_record(opt_args.record_dir), goto EXIT_ERR,
+               "Unable to record to %s.", opt_args.record_dir);
+    }
 
-        if (opt_args.save_dir) {
-            gust_sum_save(gsum, opt_args.save_dir, opt_args.save_prefix);
-        }
+    if (opt_args.prefetch_watchlist) {
+        int prefetch_res = prefetch_run(opt_args.prefetch_watchlist, opt_args.request_time,
+                                        opt_args.prefetch_once, opt_args.poll_minutes);
+        exit_code = prefetch_res == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+        goto EXIT_ERR;
+    }
 
-        gust_sum_free(&gsum);
+    if (opt_args.serve_socket) {
+        int server_res = server_run(opt_args.serve_socket, opt_args.memory_limit_mb);
+        exit_code = server_res == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+        goto EXIT_ERR;
     }
-}
-/*-------------------------------------------------------------------------------------------------
- *                                    Main Program
- *-----------------------------------------------------------------------------------------------*/
-int
-main(int argc, char *argv[argc + 1])
-{
-    int exit_code = EXIT_FAILURE;
 
-    // Variables that hold allocated memory.
-    SiteValidation *validation = 0;
-    NBMData *nbm_data = 0;
+    if (opt_args.dump_dists) {
+        DistArchive *archive = dist_archive_open(opt_args.dump_dists);
+        Stopif(!archive, goto EXIT_ERR, "Error reading %s.", opt_args.dump_dists);
 
-    program_initialization();
+        dist_archive_dump(archive, stdout);
+        dist_archive_free(&archive);
 
-    struct OptArgs opt_args = parse_cmd_line(argc, argv);
-    Stopif(opt_args.error_parsing_options, goto EXIT_ERR, "Error parsing command line.");
+        exit_code = EXIT_SUCCESS;
+        goto EXIT_ERR;
+    }
 
+    ProfileSpan span = profile_begin("site_validation", opt_args.site);
     validation = site_validation_create(opt_args.site, opt_args.request_time);
+    profile_end(&span);
     if (site_validation_failed(validation)) {
-        site_validation_print_failure_message(validation);
+        site_validation_print_failure_message(validation, stdout);
         goto EXIT_ERR;
     }
 
+    if (report_write_cached(site_validation_site_id_alias(validation),
+                            site_validation_init_time(validation), opt_args, stdout)) {
+        exit_code = EXIT_SUCCESS;
+        goto EXIT_ERR;
+    }
+
+    span = profile_begin("retrieve_data", opt_args.site);
     nbm_data = retrieve_data(validation);
+    profile_end(&span);
     Stopif(!nbm_data, goto EXIT_ERR, "Error retrieving data for %s.", opt_args.site);
 
-    do_output(nbm_data, opt_args);
+    site_data = site_data_new(nbm_data);
+    nbm_data = 0; // site_data owns it now.
+
+    report_write(site_data, opt_args, stdout);
 
     exit_code = EXIT_SUCCESS;
 
 EXIT_ERR:
+    profile_finish(opt_args.site, opt_args.profile_file);
+
+    site_data_free(&site_data);
     nbm_data_free(&nbm_data);
     site_validation_free(&validation);
     program_finalization();
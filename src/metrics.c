@@ -0,0 +1,459 @@
+#include "metrics.h"
+#include "alloc_stats.h"
+#include "utils.h"
+
+#include <assert.h>
+#include <inttypes.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include <glib.h>
+
+/*-------------------------------------------------------------------------------------------------
+ *                                          Histograms
+ *-----------------------------------------------------------------------------------------------*/
+/** The most buckets a histogram has, not counting the +Inf bucket. */
+#define MAX_BUCKETS 12
+
+/** A histogram with fixed upper bounds, the counts are per bucket, not cumulative. */
+struct Histogram {
+    double const *bounds;
+    int num_bounds;
+    uint64_t counts[MAX_BUCKETS + 1];
+    uint64_t count;
+    double sum;
+};
+
+// clang-format off
+static double const download_bounds[] = {0.05, 0.1, 0.25, 0.5, 1.0, 2.5, 5.0, 10.0, 30.0, 60.0};
+static double const build_bounds[] = {0.0005, 0.001, 0.0025, 0.005, 0.01, 0.025, 0.05, 0.1, 0.25,
+                                      0.5, 1.0};
+static double const depth_bounds[] = {0, 1, 2, 3, 4, 6, 12, 24};
+// clang-format on
+
+#define NUM_BOUNDS(bounds) ((int)(sizeof(bounds) / sizeof(bounds[0])))
+
+static void
+histogram_observe(struct Histogram *hist, double value)
+{
+    assert(hist->num_bounds <= MAX_BUCKETS);
+
+    int i = 0;
+    while (i < hist->num_bounds && value > hist->bounds[i]) {
+        i++;
+    }
+
+    hist->counts[i]++;
+    hist->count++;
+    hist->sum += value;
+}
+
+/*-------------------------------------------------------------------------------------------------
+ *                                        Recorded Metrics
+ *-----------------------------------------------------------------------------------------------*/
+/** The most elements that get their own build time histogram, the rest are lumped together. */
+#define MAX_ELEMENTS 48
+
+/** The longest element name kept, including the terminating null character. */
+#define ELEMENT_NAME_LEN 32
+
+struct ElementBuild {
+    char name[ELEMENT_NAME_LEN];
+    struct Histogram seconds;
+};
+
+/** Only set before other threads start and after they are done, so it is read without a lock. */
+static bool metrics_on = false;
+
+/** Everything that is counted, it is copied out so the file is written without the lock held. */
+struct Counters {
+    uint64_t cache_hits[METRICS_NUM_CACHES];
+    uint64_t cache_misses[METRICS_NUM_CACHES];
+    uint64_t cache_hit_bytes[METRICS_NUM_CACHES];
+    uint64_t cache_stored_bytes[METRICS_NUM_CACHES];
+
+    uint64_t downloads[METRICS_NUM_DOWNLOAD_RESULTS];
+    uint64_t download_bytes;
+    struct Histogram download_seconds;
+
+    uint64_t locations_missing;
+    struct Histogram locations_depth;
+
+    struct Histogram parse_seconds;
+
+    struct ElementBuild elements[MAX_ELEMENTS];
+    int num_elements;
+};
+
+static struct {
+    GMutex lock;       // Guards changed and counts.
+    GMutex write_lock; // Keeps writers from sharing the temporary file.
+    char *path;
+    bool changed;
+    struct Counters counts;
+} metrics = {0};
+
+static char const *const cache_labels[METRICS_NUM_CACHES] = {"files", "reports"};
+static char const *const download_labels[METRICS_NUM_DOWNLOAD_RESULTS] = {"ok", "not_found",
+                                                                          "error"};
+
+void
+metrics_start(char const path[static 1])
+{
+    assert(!metrics_on);
+
+    metrics.path = strdup(path);
+    Stopif(!metrics.path, exit(EXIT_FAILURE), "out of memory");
+
+    metrics.counts.download_seconds =
+        (struct Histogram){.bounds = download_bounds, .num_bounds = NUM_BOUNDS(download_bounds)};
+    metrics.counts.locations_depth =
+        (struct Histogram){.bounds = depth_bounds, .num_bounds = NUM_BOUNDS(depth_bounds)};
+    metrics.counts.parse_seconds =
+        (struct Histogram){.bounds = build_bounds, .num_bounds = NUM_BOUNDS(build_bounds)};
+
+    metrics_on = true;
+}
+
+double
+metrics_now(void)
+{
+    struct timespec ts = {0};
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1.0e9;
+}
+
+void
+metrics_cache_lookup(enum MetricsCache cache, bool hit, size_t bytes)
+{
+    if (!metrics_on) {
+        return;
+    }
+
+    g_mutex_lock(&metrics.lock);
+    if (hit) {
+        metrics.counts.cache_hits[cache]++;
+        metrics.counts.cache_hit_bytes[cache] += bytes;
+    } else {
+        metrics.counts.cache_misses[cache]++;
+    }
+    metrics.changed = true;
+    g_mutex_unlock(&metrics.lock);
+}
+
+void
+metrics_cache_store(enum MetricsCache cache, size_t bytes)
+{
+    if (!metrics_on) {
+        return;
+    }
+
+    g_mutex_lock(&metrics.lock);
+    metrics.counts.cache_stored_bytes[cache] += bytes;
+    metrics.changed = true;
+    g_mutex_unlock(&metrics.lock);
+}
+
+void
+metrics_download(enum MetricsDownload result, double seconds, size_t bytes)
+{
+    if (!metrics_on) {
+        return;
+    }
+
+    g_mutex_lock(&metrics.lock);
+    metrics.counts.downloads[result]++;
+    metrics.counts.download_bytes += bytes;
+    histogram_observe(&metrics.counts.download_seconds, seconds);
+    metrics.changed = true;
+    g_mutex_unlock(&metrics.lock);
+}
+
+void
+metrics_locations_lookup(bool found, int depth)
+{
+    if (!metrics_on) {
+        return;
+    }
+
+    g_mutex_lock(&metrics.lock);
+    if (found) {
+        histogram_observe(&metrics.counts.locations_depth, depth);
+    } else {
+        metrics.counts.locations_missing++;
+    }
+    metrics.changed = true;
+    g_mutex_unlock(&metrics.lock);
+}
+
+void
+metrics_parse(double seconds)
+{
+    if (!metrics_on) {
+        return;
+    }
+
+    g_mutex_lock(&metrics.lock);
+    histogram_observe(&metrics.counts.parse_seconds, seconds);
+    metrics.changed = true;
+    g_mutex_unlock(&metrics.lock);
+}
+
+/** Find the build times of an element that already has a slot, the lock must be held. */
+static struct ElementBuild *
+find_element(char const *name)
+{
+    for (int i = 0; i < metrics.counts.num_elements; i++) {
+        if (strncmp(metrics.counts.elements[i].name, name, ELEMENT_NAME_LEN - 1) == 0) {
+            return &metrics.counts.elements[i];
+        }
+    }
+
+    return 0;
+}
+
+void
+metrics_element_build(char const element[static 1], double seconds)
+{
+    if (!metrics_on) {
+        return;
+    }
+
+    g_mutex_lock(&metrics.lock);
+
+    struct ElementBuild *build = find_element(element);
+
+    // Once all but the last slot are taken, new elements go in the last one.
+    if (!build && metrics.counts.num_elements >= MAX_ELEMENTS - 1) {
+        build = find_element("other");
+        element = "other";
+    }
+
+    if (!build) {
+        assert(metrics.counts.num_elements < MAX_ELEMENTS);
+        build = &metrics.counts.elements[metrics.counts.num_elements++];
+        strncpy(build->name, element, sizeof(build->name) - 1);
+        build->seconds =
+            (struct Histogram){.bounds = build_bounds, .num_bounds = NUM_BOUNDS(build_bounds)};
+    }
+
+    histogram_observe(&build->seconds, seconds);
+    metrics.changed = true;
+
+    g_mutex_unlock(&metrics.lock);
+}
+
+/*-------------------------------------------------------------------------------------------------
+ *                                 Prometheus Text Exposition
+ *-----------------------------------------------------------------------------------------------*/
+static void
+write_header(FILE *out, char const *name, char const *type, char const *help)
+{
+    fprintf(out, "# HELP %s %s\n# TYPE %s %s\n", name, help, name, type);
+}
+
+/** Write a label value, escaped as the exposition format requires. */
+static void
+write_label_value(FILE *out, char const *value)
+{
+    fputc('"', out);
+    for (char const *c = value; *c; c++) {
+        switch (*c) {
+        case '\\':
+            fputs("\\\\", out);
+            break;
+        case '"':
+            fputs("\\\"", out);
+            break;
+        case '\n':
+            fputs("\\n", out);
+            break;
+        default:
+            fputc(*c, out);
+        }
+    }
+    fputc('"', out);
+}
+
+/** Write the samples of a histogram, with one optional label.
+ *
+ * The header must already be written, since a histogram with labels has several sets of samples.
+ */
+static void
+write_histogram(FILE *out, char const *name, char const *label, char const *label_value,
+                struct Histogram const *hist)
+{
+    uint64_t cumulative = 0;
+    for (int i = 0; i <= hist->num_bounds; i++) {
+        cumulative += hist->counts[i];
+
+        fprintf(out, "%s_bucket{", name);
+        if (label) {
+            fprintf(out, "%s=", label);
+            write_label_value(out, label_value);
+            fputc(',', out);
+        }
+        if (i < hist->num_bounds) {
+            fprintf(out, "le=\"%g\"} %" PRIu64 "\n", hist->bounds[i], cumulative);
+        } else {
+            fprintf(out, "le=\"+Inf\"} %" PRIu64 "\n", cumulative);
+        }
+    }
+
+    char const *suffixes[] = {"_sum", "_count"};
+    for (int i = 0; i < 2; i++) {
+        fprintf(out, "%s%s", name, suffixes[i]);
+        if (label) {
+            fprintf(out, "{%s=", label);
+            write_label_value(out, label_value);
+            fputc('}', out);
+        }
+        if (i == 0) {
+            fprintf(out, " %.9g\n", hist->sum);
+        } else {
+            fprintf(out, " %" PRIu64 "\n", hist->count);
+        }
+    }
+}
+
+/** Write all the metrics from a copy of the counters. */
+static void
+write_metrics(FILE *out, struct Counters const *counts)
+{
+    write_header(out, "nbm_cache_lookups_total", "counter",
+                 "Lookups in the download and report caches.");
+    for (int c = 0; c < METRICS_NUM_CACHES; c++) {
+        fprintf(out, "nbm_cache_lookups_total{cache=\"%s\",result=\"hit\"} %" PRIu64 "\n",
+                cache_labels[c], counts->cache_hits[c]);
+        fprintf(out, "nbm_cache_lookups_total{cache=\"%s\",result=\"miss\"} %" PRIu64 "\n",
+                cache_labels[c], counts->cache_misses[c]);
+    }
+
+    write_header(out, "nbm_cache_hit_bytes_total", "counter", "Bytes found in the caches.");
+    for (int c = 0; c < METRICS_NUM_CACHES; c++) {
+        fprintf(out, "nbm_cache_hit_bytes_total{cache=\"%s\"} %" PRIu64 "\n", cache_labels[c],
+                counts->cache_hit_bytes[c]);
+    }
+
+    write_header(out, "nbm_cache_stored_bytes_total", "counter", "Bytes added to the caches.");
+    for (int c = 0; c < METRICS_NUM_CACHES; c++) {
+        fprintf(out, "nbm_cache_stored_bytes_total{cache=\"%s\"} %" PRIu64 "\n", cache_labels[c],
+                counts->cache_stored_bytes[c]);
+    }
+
+    write_header(out, "nbm_downloads_total", "counter",
+                 "Downloads from the archive, not_found is a 404.");
+    for (int r = 0; r < METRICS_NUM_DOWNLOAD_RESULTS; r++) {
+        fprintf(out, "nbm_downloads_total{result=\"%s\"} %" PRIu64 "\n", download_labels[r],
+                counts->downloads[r]);
+    }
+
+    write_header(out, "nbm_download_bytes_total", "counter", "Bytes downloaded from the archive.");
+    fprintf(out, "nbm_download_bytes_total %" PRIu64 "\n", counts->download_bytes);
+
+    write_header(out, "nbm_download_duration_seconds", "histogram",
+                 "Time to download a file from the archive, including 404s and errors.");
+    write_histogram(out, "nbm_download_duration_seconds", 0, 0, &counts->download_seconds);
+
+    write_header(out, "nbm_locations_fallback_depth", "histogram",
+                 "How many NBM runs back the locations file was found, 0 is the most recent.");
+    write_histogram(out, "nbm_locations_fallback_depth", 0, 0, &counts->locations_depth);
+
+    write_header(out, "nbm_locations_missing_total", "counter",
+                 "Times no recent locations file was found at all.");
+    fprintf(out, "nbm_locations_missing_total %" PRIu64 "\n", counts->locations_missing);
+
+    write_header(out, "nbm_csv_parse_duration_seconds", "histogram",
+                 "Time to parse the CSV file of a site.");
+    write_histogram(out, "nbm_csv_parse_duration_seconds", 0, 0, &counts->parse_seconds);
+
+    write_header(out, "nbm_element_build_duration_seconds", "histogram",
+                 "Time to build and write one element of a report.");
+    for (int i = 0; i < counts->num_elements; i++) {
+        write_histogram(out, "nbm_element_build_duration_seconds", "element",
+                        counts->elements[i].name, &counts->elements[i].seconds);
+    }
+
+    write_header(out, "nbm_peak_rss_bytes", "gauge", "Largest resident set size of the process.");
+    fprintf(out, "nbm_peak_rss_bytes %ld\n", alloc_stats_peak_rss_kb() * 1024);
+
+    write_header(out, "nbm_metrics_updated_timestamp_seconds", "gauge",
+                 "When these metrics were written.");
+    fprintf(out, "nbm_metrics_updated_timestamp_seconds %lld\n", (long long)time(0));
+}
+
+/** Copy the counters and write them to a temporary file, then move it into place.
+ *
+ * The lock is only held while copying, so the hooks don't wait on the file system.
+ */
+static bool
+write_metrics_file(void)
+{
+    char tmp_path[1024] = {0};
+    int len = snprintf(tmp_path, sizeof(tmp_path), "%s.tmp", metrics.path);
+    Stopif(len < 0 || len >= (int)sizeof(tmp_path), return false, "Metrics path too long: %s",
+           metrics.path);
+
+    g_mutex_lock(&metrics.write_lock);
+
+    g_mutex_lock(&metrics.lock);
+    struct Counters const counts = metrics.counts;
+    metrics.changed = false;
+    g_mutex_unlock(&metrics.lock);
+
+    FILE *out = fopen(tmp_path, "w");
+    Stopif(!out, goto ERR_RETURN, "Unable to open %s", tmp_path);
+
+    write_metrics(out, &counts);
+
+    bool write_error = ferror(out);
+    int close_res = fclose(out);
+    Stopif(write_error || close_res, goto ERR_REMOVE, "Error writing %s", tmp_path);
+
+    Stopif(rename(tmp_path, metrics.path), goto ERR_REMOVE, "Unable to replace %s", metrics.path);
+
+    g_mutex_unlock(&metrics.write_lock);
+    return true;
+
+ERR_REMOVE:
+    remove(tmp_path);
+ERR_RETURN:
+    // Try again on the next write.
+    g_mutex_lock(&metrics.lock);
+    metrics.changed = true;
+    g_mutex_unlock(&metrics.lock);
+
+    g_mutex_unlock(&metrics.write_lock);
+    return false;
+}
+
+bool
+metrics_write(void)
+{
+    if (!metrics_on) {
+        return true;
+    }
+
+    g_mutex_lock(&metrics.lock);
+    bool changed = metrics.changed;
+    g_mutex_unlock(&metrics.lock);
+
+    return changed ? write_metrics_file() : true;
+}
+
+void
+metrics_finish(void)
+{
+    if (!metrics_on) {
+        return;
+    }
+
+    write_metrics_file();
+
+    metrics_on = false;
+    free(metrics.path);
+    metrics.path = 0;
+}
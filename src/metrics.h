@@ -0,0 +1,82 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+
+/*-------------------------------------------------------------------------------------------------
+ *                                    Metrics for Monitoring
+ *-----------------------------------------------------------------------------------------------*/
+/* Counters and histograms for the things worth alerting on in scheduled runs: how well the caches
+ * are working, how long the archive takes to answer and how often a file isn't there, how far back
+ * the locations file had to be looked for, and how long parsing and building each element takes.
+ *
+ * They are written in the Prometheus text exposition format, for the textfile collector of the
+ * node exporter. The file is written when the program ends, and in daemon mode (--serve and
+ * --prefetch) whenever something has changed, so it can be scraped while the daemon runs. It is
+ * always replaced in one step with rename(), so a scrape never sees a partial file.
+ *
+ * Until metrics_start() is called, recording costs a single branch, so the calls are left in the
+ * code permanently.
+ */
+
+/** The caches whose hits and misses are counted. */
+enum MetricsCache {
+    METRICS_CACHE_FILES,   // Files downloaded from the archive.
+    METRICS_CACHE_REPORTS, // Finished reports.
+    METRICS_NUM_CACHES,
+};
+
+/** How a download from the archive turned out. */
+enum MetricsDownload {
+    METRICS_DOWNLOAD_OK,
+    METRICS_DOWNLOAD_NOT_FOUND, // The server answered with a 404.
+    METRICS_DOWNLOAD_ERROR,
+    METRICS_NUM_DOWNLOAD_RESULTS,
+};
+
+/** Start recording metrics, they'll be written to \a path.
+ *
+ * This must be called before any other threads are started, and only once. The path is copied.
+ */
+void metrics_start(char const path[static 1]);
+
+/** Get the time in seconds from an arbitrary starting point, for timing the things recorded. */
+double metrics_now(void);
+
+/** Record a lookup in a cache.
+ *
+ * \param hit is whether the item was found.
+ * \param bytes is the size of the item found, ignored for a miss.
+ */
+void metrics_cache_lookup(enum MetricsCache cache, bool hit, size_t bytes);
+
+/** Record an item of \a bytes added to a cache. */
+void metrics_cache_store(enum MetricsCache cache, size_t bytes);
+
+/** Record a download from the archive, or a mirror, that took \a seconds and got \a bytes. */
+void metrics_download(enum MetricsDownload result, double seconds, size_t bytes);
+
+/** Record looking for the locations file.
+ *
+ * \param found is whether any recent version of it was found.
+ * \param depth is how many NBM runs before the most recent one the file came from, 0 if the
+ * most recent one had it. Ignored if it wasn't found.
+ */
+void metrics_locations_lookup(bool found, int depth);
+
+/** Record parsing the CSV file of a site. */
+void metrics_parse(double seconds);
+
+/** Record building and writing one element of a report, like "temperature" or "precip_24h". */
+void metrics_element_build(char const element[static 1], double seconds);
+
+/** Write the metrics if anything changed since they were last written.
+ *
+ * For daemons to call now and then. Does nothing if metrics_start() wasn't called.
+ *
+ * \returns \c false if there was an error writing the file.
+ */
+bool metrics_write(void);
+
+/** Write the metrics and stop recording them. Does nothing if metrics_start() wasn't called. */
+void metrics_finish(void);
@@ -1,5 +1,7 @@
 #include "nbm_data.h"
 #include "download.h"
+#include "metrics.h"
+#include "profile.h"
 #include "utils.h"
 
 #include <math.h>
@@ -8,6 +10,7 @@
 #include <time.h>
 
 #include <csv.h>
+#include <glib.h>
 
 /*-------------------------------------------------------------------------------------------------
  *                                           NBMData
@@ -28,14 +31,27 @@ struct NBMData {
 
     time_t *valid_times;
     double *vals;
+
+    int ref_count;
 };
 
+NBMData *
+nbm_data_ref(NBMData *nbm)
+{
+    assert(nbm);
+    g_atomic_int_inc(&nbm->ref_count);
+    return nbm;
+}
+
 void
 nbm_data_free(struct NBMData **ptrptr)
 {
     struct NBMData *ptr = *ptrptr;
 
-    if (ptr) {
+    if (ptr && !g_atomic_int_dec_and_test(&ptr->ref_count)) {
+        // Somebody else still has a reference to it.
+        *ptrptr = 0;
+    } else if (ptr) {
 
         free(ptr->site_id);
         free(ptr->site_name);
@@ -78,6 +94,58 @@ nbm_data_init_time(struct NBMData const *ptr)
 {
     return ptr->init_time;
 }
+
+size_t
+nbm_data_memory_bytes(struct NBMData const *ptr)
+{
+    size_t total = sizeof(*ptr) + strlen(ptr->site_id) + strlen(ptr->site_name) + 2;
+
+    total += ptr->num_cols * sizeof(char *);
+    for (int i = 0; i < ptr->num_cols; i++) {
+        total += strlen(ptr->col_names[i]) + 1;
+    }
+
+    total += ptr->num_rows * sizeof(time_t);
+    total += ptr->num_rows * ptr->num_cols * sizeof(double);
+
+    return total;
+}
+
+/*-------------------------------------------------------------------------------------------------
+ *                                     Direct row access
+ *-----------------------------------------------------------------------------------------------*/
+int
+nbm_data_column_index(struct NBMData const *nbm, char const *col_name)
+{
+    for (int col_num = 0; col_num < nbm->num_cols; col_num++) {
+        if (strcmp(col_name, nbm->col_names[col_num]) == 0) {
+            return col_num;
+        }
+    }
+
+    return -1;
+}
+
+size_t
+nbm_data_num_rows(struct NBMData const *nbm)
+{
+    return nbm->num_rows;
+}
+
+time_t
+nbm_data_valid_time(struct NBMData const *nbm, size_t row)
+{
+    assert(row < nbm->num_rows);
+    return nbm->valid_times[row];
+}
+
+double const *
+nbm_data_row_values(struct NBMData const *nbm, size_t row)
+{
+    assert(row < nbm->num_rows);
+    return &nbm->vals[row * nbm->num_cols];
+}
+
 /*-------------------------------------------------------------------------------------------------
  *                                     NBMDataRowIterator
  *-----------------------------------------------------------------------------------------------*/
@@ -91,14 +159,7 @@ struct NBMDataRowIterator {
 struct NBMDataRowIterator *
 nbm_data_rows(struct NBMData const *nbm, char const *col_name)
 {
-    int found_col_num = -1;
-    for (int col_num = 0; col_num < nbm->num_cols; col_num++) {
-        if (strcmp(col_name, nbm->col_names[col_num]) == 0) {
-            found_col_num = col_num;
-            break;
-        }
-    }
-
+    int found_col_num = nbm_data_column_index(nbm, col_name);
     if (found_col_num < 0) {
         return 0;
     }
@@ -142,115 +203,106 @@ nbm_data_row_iterator_next(struct NBMDataRowIterator *it)
 }
 
 /*-------------------------------------------------------------------------------------------------
- *                                   NBMDataRowIteratorWind
+ *                                      NBMDataRowCursor
  *-----------------------------------------------------------------------------------------------*/
-/** Internal implementation of a row iterator for wind, which has direction and gusts plus speed.*/
-struct NBMDataRowIteratorWind {
-    int wspd_col_num;
-    int wspd_std_col_num;
-    int wgst_col_num;
-    int wgst_std_col_num;
-    int wdir_col_num;
-
-    size_t curr_row;
+/** Internal implementation of a cursor over several columns. */
+struct NBMDataRowCursor {
     struct NBMData const *src;
+    size_t curr_row; // One past the current row, 0 before the first call to next.
+
+    size_t num_cols;
+    int *col_nums;
+    bool *required;
 };
 
-struct NBMDataRowIteratorWind *
-nbm_data_rows_wind(struct NBMData const *nbm)
+struct NBMDataRowCursor *
+nbm_data_row_cursor_new(struct NBMData const *nbm, size_t num_cols,
+                        struct NBMDataCursorColumn const cols[num_cols])
 {
-    int found_wspd_col_num = -1;
-    int found_wspd_std_col_num = -1;
-    int found_wgst_col_num = -1;
-    int found_wgst_std_col_num = -1;
-    int found_wdir_col_num = -1;
-    for (int col_num = 0; col_num < nbm->num_cols; col_num++) {
-        if (strcmp("WIND_10 m above ground", nbm->col_names[col_num]) == 0) {
-            found_wspd_col_num = col_num;
-        }
+    struct NBMDataRowCursor *cur = malloc(sizeof(struct NBMDataRowCursor));
+    assert(cur);
 
-        if (strcmp("WIND_10 m above ground_ens std dev", nbm->col_names[col_num]) == 0) {
-            found_wspd_std_col_num = col_num;
-        }
+    *cur = (struct NBMDataRowCursor){.src = nbm,
+                                     .curr_row = 0,
+                                     .num_cols = num_cols,
+                                     .col_nums = calloc(num_cols, sizeof(int)),
+                                     .required = calloc(num_cols, sizeof(bool))};
+    assert(cur->col_nums && cur->required);
 
-        if (strcmp("GUST_10 m above ground", nbm->col_names[col_num]) == 0) {
-            found_wgst_col_num = col_num;
-        }
+    for (size_t i = 0; i < num_cols; i++) {
+        cur->col_nums[i] = nbm_data_column_index(nbm, cols[i].name);
+        Stopif(cur->col_nums[i] < 0, goto ERR_RETURN, "Missing column: %s", cols[i].name);
 
-        if (strcmp("GUST_10 m above ground_ens std dev", nbm->col_names[col_num]) == 0) {
-            found_wgst_std_col_num = col_num;
-        }
-
-        if (strcmp("WDIR_10 m above ground", nbm->col_names[col_num]) == 0) {
-            found_wdir_col_num = col_num;
-        }
+        cur->required[i] = cols[i].use == NBM_DATA_COLUMN_REQUIRED;
     }
-    Stopif(found_wdir_col_num < 0 || found_wspd_col_num < 0 || found_wgst_col_num < 0 ||
-               found_wspd_std_col_num < 0 || found_wgst_std_col_num < 0,
-           return 0, "Missing wind column.");
-
-    struct NBMDataRowIteratorWind *it = malloc(sizeof(struct NBMDataRowIteratorWind));
-    *it = (struct NBMDataRowIteratorWind){.curr_row = 0,
-                                          .src = nbm,
-                                          .wspd_col_num = found_wspd_col_num,
-                                          .wgst_col_num = found_wgst_col_num,
-                                          .wspd_std_col_num = found_wspd_std_col_num,
-                                          .wgst_std_col_num = found_wgst_std_col_num,
-                                          .wdir_col_num = found_wdir_col_num};
 
-    return it;
+    return cur;
+
+ERR_RETURN:
+    nbm_data_row_cursor_free(&cur);
+    return 0;
 }
 
 void
-nbm_data_row_wind_iterator_free(struct NBMDataRowIteratorWind **ptrptr)
+nbm_data_row_cursor_free(struct NBMDataRowCursor **ptrptr)
 {
-    free(*ptrptr);
+    struct NBMDataRowCursor *cur = *ptrptr;
+
+    if (cur) {
+        free(cur->col_nums);
+        free(cur->required);
+        free(cur);
+    }
+
     *ptrptr = 0;
 }
 
-struct NBMDataRowIteratorWindValueView
-nbm_data_row_wind_iterator_next(struct NBMDataRowIteratorWind *it)
+bool
+nbm_data_row_cursor_next(struct NBMDataRowCursor *cur)
 {
-    struct NBMDataRowIteratorWindValueView view = {0};
+    struct NBMData const *src = cur->src;
 
-    size_t next_row = it->curr_row;
-    double *vals = it->src->vals;
-    double *spd_val = 0;
-    double *spd_std_val = 0;
-    double *gst_val = 0;
-    double *gst_std_val = 0;
-    double *dir_val = 0;
-    while (next_row < it->src->num_rows) {
-        size_t row_offset = next_row * it->src->num_cols;
-        size_t index_spd = row_offset + it->wspd_col_num;
-        size_t index_spd_std = row_offset + it->wspd_std_col_num;
-        size_t index_gst = row_offset + it->wgst_col_num;
-        size_t index_gst_std = row_offset + it->wgst_std_col_num;
-        size_t index_dir = row_offset + it->wdir_col_num;
-        spd_val = &vals[index_spd];
-        spd_std_val = &vals[index_spd_std];
-        gst_val = &vals[index_gst];
-        gst_std_val = &vals[index_gst_std];
-        dir_val = &vals[index_dir];
-        if (!(isnan(*spd_val) || isnan(*spd_std_val) || isnan(*gst_val) || isnan(*gst_std_val) ||
-              isnan(*dir_val))) {
-            break;
+    while (cur->curr_row < src->num_rows) {
+        double const *vals = &src->vals[cur->curr_row * src->num_cols];
+        cur->curr_row++;
+
+        bool has_any = false;
+        bool has_required = true;
+        for (size_t i = 0; i < cur->num_cols; i++) {
+            bool missing = isnan(vals[cur->col_nums[i]]);
+            has_any |= !missing;
+
+            if (missing && cur->required[i]) {
+                has_required = false;
+                break;
+            }
         }
-        next_row++;
-    }
 
-    if (next_row < it->src->num_rows) {
-        view.valid_time = &it->src->valid_times[next_row];
-        view.wspd = spd_val;
-        view.wspd_std = spd_std_val;
-        view.wdir = dir_val;
-        view.gust = gst_val;
-        view.gust_std = gst_std_val;
-        it->curr_row = next_row + 1;
+        if (has_any && has_required) {
+            return true;
+        }
     }
 
-    return view;
+    return false;
+}
+
+time_t
+nbm_data_row_cursor_valid_time(struct NBMDataRowCursor const *cur)
+{
+    assert(cur->curr_row > 0);
+    return cur->src->valid_times[cur->curr_row - 1];
+}
+
+double
+nbm_data_row_cursor_value(struct NBMDataRowCursor const *cur, size_t col)
+{
+    assert(cur->curr_row > 0);
+    assert(col < cur->num_cols);
+
+    struct NBMData const *src = cur->src;
+    return src->vals[(cur->curr_row - 1) * src->num_cols + cur->col_nums[col]];
 }
+
 /*-------------------------------------------------------------------------------------------------
  *                                  CSVParserState - internal only
  *-----------------------------------------------------------------------------------------------*/
@@ -295,7 +347,8 @@ init_parser_state(char *text_data, time_t init_time, char const site_id[static 1
                             .num_rows = rows - 1, // First row is stored in .col_names
                             .col_names = calloc(cols - 1, sizeof(char *)),
                             .valid_times = calloc(rows, sizeof(time_t)),
-                            .vals = calloc((rows - 1) * (cols - 1), sizeof(double))};
+                            .vals = calloc((rows - 1) * (cols - 1), sizeof(double)),
+                            .ref_count = 1};
 
     return (struct CSVParserState){.row = 0, .col = 0, .nbm_data = nbm};
 }
@@ -397,6 +450,9 @@ do_parsing(struct csv_parser *parser, RawNbmData *raw)
 struct NBMData *
 parse_raw_nbm_data(RawNbmData *raw)
 {
+    ProfileSpan span = profile_begin("csv_parse", 0);
+    double start = metrics_now();
+
     struct csv_parser parser = initialize_a_csv_parser();
 
     struct NBMData *nbm_data = do_parsing(&parser, raw);
@@ -404,6 +460,9 @@ parse_raw_nbm_data(RawNbmData *raw)
 
     csv_free(&parser);
 
+    metrics_parse(metrics_now() - start);
+    profile_end(&span);
+
     return nbm_data;
 }
 
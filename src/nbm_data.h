@@ -1,5 +1,8 @@
 #pragma once
 
+#include <stdbool.h>
+#include <stddef.h>
+
 #include "raw_nbm_data.h"
 #include "site_validation.h"
 
@@ -24,7 +27,19 @@ NBMData *parse_raw_nbm_data(RawNbmData *);
  */
 NBMData *retrieve_data(SiteValidation *validation);
 
-/** Free memory associated with an \c NBMData object, and nullify the pointer. */
+/** Get another reference to an \c NBMData object.
+ *
+ * \c NBMData is never modified after it is parsed, so it can be shared between threads. Each
+ * reference must be released with \c nbm_data_free().
+ *
+ * \returns \a nbm.
+ */
+NBMData *nbm_data_ref(NBMData *nbm);
+
+/** Release a reference to an \c NBMData object, and nullify the pointer.
+ *
+ * The memory is freed when the last reference is released.
+ */
 void nbm_data_free(NBMData **ptrptr);
 
 /** Get the age of the forecast in seconds. */
@@ -39,6 +54,33 @@ char const *const nbm_data_site_name(NBMData const *);
 /** Get the initialization time of this model run. */
 time_t nbm_data_init_time(NBMData const *);
 
+/** Get the number of bytes of memory used by this data. */
+size_t nbm_data_memory_bytes(NBMData const *);
+
+/*-------------------------------------------------------------------------------------------------
+ *                                     Direct row access
+ *-----------------------------------------------------------------------------------------------*/
+/** Find the index of a column.
+ *
+ * Looking up the columns once and then reading the rows with nbm_data_row_values() is faster than
+ * using an iterator for each column when many columns are needed at the same time.
+ *
+ * \returns the index of the column, or -1 if there is no such column.
+ */
+int nbm_data_column_index(NBMData const *nbm, char const *col_name);
+
+/** Get the number of rows (valid times), including rows without any data. */
+size_t nbm_data_num_rows(NBMData const *nbm);
+
+/** Get the valid time of a row. */
+time_t nbm_data_valid_time(NBMData const *nbm, size_t row);
+
+/** Get all the values in a row.
+ *
+ * \returns an array indexed by the values from nbm_data_column_index(). Missing values are \c NAN.
+ */
+double const *nbm_data_row_values(NBMData const *nbm, size_t row);
+
 /*-------------------------------------------------------------------------------------------------
  *                           Aquiring and using iterators over NBMData
  *-----------------------------------------------------------------------------------------------*/
@@ -51,15 +93,6 @@ time_t nbm_data_init_time(NBMData const *);
  */
 typedef struct NBMDataRowIterator NBMDataRowIterator;
 
-/** An iterator over the rows (valid times) of NBM forecasts for a vector element.
- *
- * Currently wind is the only vector element, hence the name.
- *
- * This iterator will skip all rows without any data. Units are degrees for direction and miles per
- * hour for speeds.
- */
-typedef struct NBMDataRowIteratorWind NBMDataRowIteratorWind;
-
 /** A view into the current values stored in an iterator.
  *
  * The units of the output depend on the value requested. For instance, probabilities are always in
@@ -70,19 +103,6 @@ struct NBMDataRowIteratorValueView {
     double *value; /**< The semantic meaning depends on the column this value was drawnf rom. */
 };
 
-/** A view into the current values stored in a wind iterator.
- *
- * Units are degrees for direction and miles per hour for speeds.
- */
-struct NBMDataRowIteratorWindValueView {
-    time_t *valid_time; /**< Valid time of data on this row. */
-    double *wspd;       /**< The wind speed in mph. */
-    double *wspd_std;   /**< The standard deviation of the wind speeds (mph). */
-    double *wdir;       /**< The compass direction the wind is coming from. */
-    double *gust;       /**< The wind gust in mph. */
-    double *gust_std;   /**< The standard deviation of the wind gusts. */
-};
-
 /** Get an iterator over a column.
  *
  * \param nbm the NBM data to query.
@@ -103,20 +123,60 @@ void nbm_data_row_iterator_free(NBMDataRowIterator **);
  */
 struct NBMDataRowIteratorValueView nbm_data_row_iterator_next(NBMDataRowIterator *);
 
-/** Get an iterator over the winds.
+/*-------------------------------------------------------------------------------------------------
+ *                         Reading several columns of NBMData at once
+ *-----------------------------------------------------------------------------------------------*/
+// implentations in src/nbm_data.c
+/** A cursor over the rows (valid times) of NBM forecasts that reads several columns at once.
+ *
+ * Building a summary from many columns with one cursor takes a single pass over the data, instead
+ * of one pass for each column. The values are in the units of the NBM file, just like the
+ * iterators.
+ */
+typedef struct NBMDataRowCursor NBMDataRowCursor;
+
+/** Whether a \c NBMDataRowCursor should stop on rows that are missing a column's value. */
+enum NBMDataColumnUse {
+    NBM_DATA_COLUMN_OPTIONAL, /**< Visit rows without this value, it will be \c NAN. */
+    NBM_DATA_COLUMN_REQUIRED, /**< Skip rows without this value. */
+};
+
+/** A column to read with a \c NBMDataRowCursor. */
+struct NBMDataCursorColumn {
+    char const *name; /**< The name of the column in the NBM file. */
+    enum NBMDataColumnUse use;
+};
+
+/** Get a cursor over several columns.
+ *
+ * The cursor visits every row that has all of the required values and at least one value from
+ * any of the columns. It starts before the first row.
  *
  * \param nbm the NBM data to query.
+ * \param num_cols is the number of columns in \a cols.
+ * \param cols are the columns to read. The same column may be listed more than once.
  *
- * \returns an iterator over the rows of wind data.
+ * \returns a cursor, or \c NULL if any of the columns are not in the data.
  */
-NBMDataRowIteratorWind *nbm_data_rows_wind(NBMData const *nbm);
+NBMDataRowCursor *nbm_data_row_cursor_new(NBMData const *nbm, size_t num_cols,
+                                          struct NBMDataCursorColumn const cols[num_cols]);
 
-/** Free memory associated with the iterator and nullify the pointer. */
-void nbm_data_row_wind_iterator_free(NBMDataRowIteratorWind **);
+/** Free memory associated with the cursor and nullify the pointer. */
+void nbm_data_row_cursor_free(NBMDataRowCursor **);
 
-/** Get the next values in the iterator.
+/** Move to the next row.
  *
- * If there are no more values, the all of the pointers in the \c NBMDataRowIteratorWindValueView
- * object are set to null.
+ * \returns \c false if there are no more rows.
+ */
+bool nbm_data_row_cursor_next(NBMDataRowCursor *cur);
+
+/** Get the valid time of the current row. */
+time_t nbm_data_row_cursor_valid_time(NBMDataRowCursor const *cur);
+
+/** Get a value from the current row.
+ *
+ * \param col is the position of the column in the list given to nbm_data_row_cursor_new().
+ *
+ * \returns the value, or \c NAN if it is missing.
  */
-struct NBMDataRowIteratorWindValueView nbm_data_row_wind_iterator_next(NBMDataRowIteratorWind *);
+double nbm_data_row_cursor_value(NBMDataRowCursor const *cur, size_t col);
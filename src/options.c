@@ -133,6 +133,15 @@ static GOptionEntry entries[] = {
      .description = "show snow scenarios",
      .arg_description = 0},
 
+    {.long_name = "format",
+     .short_name = 0,
+     .flags = G_OPTION_FLAG_NONE,
+     .arg = G_OPTION_ARG_CALLBACK,
+     .arg_data = option_callback,
+     .description = "how to write the summaries: table (the default), jsonl for one JSON object "
+                    "per line, or csv for one value per row.",
+     .arg_description = "FORMAT"},
+
     {.long_name = "request-time",
      .short_name = 0,
      .flags = G_OPTION_FLAG_NONE,
@@ -158,11 +167,143 @@ static GOptionEntry entries[] = {
      .description = "how to prefix a file name.",
      .arg_description = "PREFIX"},
 
+    {.long_name = "save-binary",
+     .short_name = 0,
+     .flags = G_OPTION_FLAG_NO_ARG,
+     .arg = G_OPTION_ARG_CALLBACK,
+     .arg_data = option_callback,
+     .description = "with --save-dir, save the CDFs, PDFs, and scenarios of all the summaries in "
+                    "one binary file instead of text files.",
+     .arg_description = 0},
+
+    {.long_name = "dump-dists",
+     .short_name = 0,
+     .flags = G_OPTION_FLAG_FILENAME,
+     .arg = G_OPTION_ARG_CALLBACK,
+     .arg_data = option_callback,
+     .description = "instead of showing a report, print the contents of a binary file saved with "
+                    "--save-binary. No SITE is needed.",
+     .arg_description = "FILE"},
+
+    {.long_name = "profile",
+     .short_name = 0,
+     .flags = G_OPTION_FLAG_NONE,
+     .arg = G_OPTION_ARG_CALLBACK,
+     .arg_data = option_callback,
+     .description = "time the phases of making the report and write them to stderr when done: "
+                    "table for a summary, or trace for Chrome trace event JSON. Builds made with "
+                    "make profile also count allocations. Not allowed with --serve, or with "
+                    "--prefetch without --once.",
+     .arg_description = "FORMAT"},
+
+    {.long_name = "profile-file",
+     .short_name = 0,
+     .flags = G_OPTION_FLAG_FILENAME,
+     .arg = G_OPTION_ARG_CALLBACK,
+     .arg_data = option_callback,
+     .description = "with --profile, write the timings to this file instead of stderr.",
+     .arg_description = "FILE"},
+
+    {.long_name = "metrics-file",
+     .short_name = 0,
+     .flags = G_OPTION_FLAG_FILENAME,
+     .arg = G_OPTION_ARG_CALLBACK,
+     .arg_data = option_callback,
+     .description = "write cache, download, and timing metrics to FILE in the Prometheus text "
+                    "format when done, and as they change with --serve and --prefetch.",
+     .arg_description = "FILE"},
+
+    {.long_name = "mirror-url",
+     .short_name = 0,
+     .flags = G_OPTION_FLAG_NONE,
+     .arg = G_OPTION_ARG_CALLBACK,
+     .arg_data = option_callback,
+     .description = "download from a mirror with the same layout as the online archive instead.",
+     .arg_description = "URL"},
+
+    {.long_name = "archive-dir",
+     .short_name = 0,
+     .flags = G_OPTION_FLAG_FILENAME,
+     .arg = G_OPTION_ARG_CALLBACK,
+     .arg_data = option_callback,
+     .description = "read from a local directory with the same layout as the online archive "
+                    "instead of downloading. The download cache is not used.",
+     .arg_description = "PATH"},
+
+    {.long_name = "record",
+     .short_name = 0,
+     .flags = G_OPTION_FLAG_FILENAME,
+     .arg = G_OPTION_ARG_CALLBACK,
+     .arg_data = option_callback,
+     .description = "save every file retrieved, and which ones were not available, in a replay "
+                    "bundle in DIR. The caches are not used, so everything is retrieved.",
+     .arg_description = "DIR"},
+
+    {.long_name = "replay",
+     .short_name = 0,
+     .flags = G_OPTION_FLAG_FILENAME,
+     .arg = G_OPTION_ARG_CALLBACK,
+     .arg_data = option_callback,
+     .description = "retrieve files only from a bundle saved with --record, with no network or "
+                    "caches. Asking for a file that wasn't recorded is an error.",
+     .arg_description = "DIR"},
+
+    {.long_name = "prefetch",
+     .short_name = 0,
+     .flags = G_OPTION_FLAG_FILENAME,
+     .arg = G_OPTION_ARG_CALLBACK,
+     .arg_data = option_callback,
+     .description = "instead of showing a report, keep downloading the data for the sites listed "
+                    "in FILE into the cache as each new NBM cycle is posted. No SITE is needed.",
+     .arg_description = "FILE"},
+
+    {.long_name = "once",
+     .short_name = 0,
+     .flags = G_OPTION_FLAG_NO_ARG,
+     .arg = G_OPTION_ARG_CALLBACK,
+     .arg_data = option_callback,
+     .description = "with --prefetch, only fetch the most recent cycle and exit.",
+     .arg_description = 0},
+
+    {.long_name = "poll-minutes",
+     .short_name = 0,
+     .flags = G_OPTION_FLAG_NONE,
+     .arg = G_OPTION_ARG_CALLBACK,
+     .arg_data = option_callback,
+     .description = "with --prefetch, how often to check for a new cycle, default is 5 minutes.",
+     .arg_description = "M"},
+
+    {.long_name = "serve",
+     .short_name = 0,
+     .flags = G_OPTION_FLAG_FILENAME,
+     .arg = G_OPTION_ARG_CALLBACK,
+     .arg_data = option_callback,
+     .description = "instead of showing a report, keep running and answer report requests made "
+                    "with --connect on the Unix domain socket at SOCKET. No SITE is needed.",
+     .arg_description = "SOCKET"},
+
+    {.long_name = "memory-limit",
+     .short_name = 0,
+     .flags = G_OPTION_FLAG_NONE,
+     .arg = G_OPTION_ARG_CALLBACK,
+     .arg_data = option_callback,
+     .description = "with --serve, how much memory to use keeping recently requested sites and "
+                    "their summaries, default is 256 MB.",
+     .arg_description = "MB"},
+
+    {.long_name = "connect",
+     .short_name = 0,
+     .flags = G_OPTION_FLAG_FILENAME,
+     .arg = G_OPTION_ARG_CALLBACK,
+     .arg_data = option_callback,
+     .description = "ask the server listening on SOCKET for the report instead of making it here.",
+     .arg_description = "SOCKET"},
+
     {.long_name = "verbose",
      .short_name = 'v',
-     .flags = G_OPTION_FLAG_NONE,
-     .arg = G_OPTION_ARG_NONE,
-     .arg_data = &global_verbose,
+     .flags = G_OPTION_FLAG_NO_ARG,
+     .arg = G_OPTION_ARG_CALLBACK,
+     .arg_data = option_callback,
      .description = "show verbose output.",
      .arg_description = 0},
 
@@ -209,25 +350,86 @@ option_callback(const char *name, const char *value, void *data, GError **unused
         opts->show_precip_scenarios = true;
     } else if (strcmp(name, "--snow-scenarios") == 0) {
         opts->show_snow_scenarios = true;
+    } else if (strcmp(name, "--format") == 0) {
+        if (strcmp(value, "table") == 0) {
+            opts->format = OUTPUT_FORMAT_TABLE;
+        } else if (strcmp(value, "jsonl") == 0) {
+            opts->format = OUTPUT_FORMAT_JSONL;
+        } else if (strcmp(value, "csv") == 0) {
+            opts->format = OUTPUT_FORMAT_CSV;
+        } else {
+            Stopif(true, return false, "Invalid output format: %s", value);
+        }
     } else if (strcmp(name, "--request-time") == 0) {
         struct tm req_time = {0};
         char *next_char = strptime(value, "%Y-%m-%d-%H", &req_time);
         Stopif(!next_char, return false, "Error parsing request time: %s", value);
         opts->request_time = timegm(&req_time);
     } else if (strcmp(name, "--accumulation-period") == 0 || strcmp(name, "-a") == 0) {
-        if (opts->num_accum_periods < sizeof(opts->accum_hours)) {
+        int const max_accum_periods = sizeof(opts->accum_hours) / sizeof(opts->accum_hours[0]);
+        if (opts->num_accum_periods < max_accum_periods) {
             opts->accum_hours[opts->num_accum_periods] = atoi(value);
             opts->num_accum_periods++;
         } else {
             fprintf(stderr, "Too many accumulation periods!\n");
             return false;
         }
+    } else if (strcmp(name, "--verbose") == 0 || strcmp(name, "-v") == 0) {
+        opts->verbose = true;
     } else if (strcmp(name, "--save-dir") == 0) {
         int retcode = asprintf(&opts->save_dir, "%s", value);
         Stopif(retcode < 0, exit(EXIT_FAILURE), "out of memory");
     } else if (strcmp(name, "--save-prefix") == 0) {
         int retcode = asprintf(&opts->save_prefix, "%s", value);
         Stopif(retcode < 0, exit(EXIT_FAILURE), "out of memory");
+    } else if (strcmp(name, "--save-binary") == 0) {
+        opts->save_binary = true;
+    } else if (strcmp(name, "--dump-dists") == 0) {
+        int retcode = asprintf(&opts->dump_dists, "%s", value);
+        Stopif(retcode < 0, exit(EXIT_FAILURE), "out of memory");
+    } else if (strcmp(name, "--profile") == 0) {
+        if (strcmp(value, "table") == 0) {
+            opts->profile = PROFILE_TABLE;
+        } else if (strcmp(value, "trace") == 0) {
+            opts->profile = PROFILE_TRACE;
+        } else {
+            Stopif(true, return false, "Invalid profile format: %s", value);
+        }
+    } else if (strcmp(name, "--profile-file") == 0) {
+        int retcode = asprintf(&opts->profile_file, "%s", value);
+        Stopif(retcode < 0, exit(EXIT_FAILURE), "out of memory");
+    } else if (strcmp(name, "--prefetch") == 0) {
+        int retcode = asprintf(&opts->prefetch_watchlist, "%s", value);
+        Stopif(retcode < 0, exit(EXIT_FAILURE), "out of memory");
+    } else if (strcmp(name, "--once") == 0) {
+        opts->prefetch_once = true;
+    } else if (strcmp(name, "--poll-minutes") == 0) {
+        opts->poll_minutes = atoi(value);
+        Stopif(opts->poll_minutes <= 0, return false, "Invalid poll interval: %s", value);
+    } else if (strcmp(name, "--serve") == 0) {
+        int retcode = asprintf(&opts->serve_socket, "%s", value);
+        Stopif(retcode < 0, exit(EXIT_FAILURE), "out of memory");
+    } else if (strcmp(name, "--memory-limit") == 0) {
+        opts->memory_limit_mb = atoi(value);
+        Stopif(opts->memory_limit_mb <= 0, return false, "Invalid memory limit: %s", value);
+    } else if (strcmp(name, "--connect") == 0) {
+        // Handled by options_find_connect_socket() before parsing, so it's only here for the help.
+        Stopif(true, return false, "--connect cannot be used here.");
+    } else if (strcmp(name, "--metrics-file") == 0) {
+        int retcode = asprintf(&opts->metrics_file, "%s", value);
+        Stopif(retcode < 0, exit(EXIT_FAILURE), "out of memory");
+    } else if (strcmp(name, "--mirror-url") == 0) {
+        int retcode = asprintf(&opts->mirror_url, "%s", value);
+        Stopif(retcode < 0, exit(EXIT_FAILURE), "out of memory");
+    } else if (strcmp(name, "--archive-dir") == 0) {
+        int retcode = asprintf(&opts->archive_dir, "%s", value);
+        Stopif(retcode < 0, exit(EXIT_FAILURE), "out of memory");
+    } else if (strcmp(name, "--record") == 0) {
+        int retcode = asprintf(&opts->record_dir, "%s", value);
+        Stopif(retcode < 0, exit(EXIT_FAILURE), "out of memory");
+    } else if (strcmp(name, "--replay") == 0) {
+        int retcode = asprintf(&opts->replay_dir, "%s", value);
+        Stopif(retcode < 0, exit(EXIT_FAILURE), "out of memory");
     } else {
         return false;
     }
@@ -235,8 +437,13 @@ option_callback(const char *name, const char *value, void *data, GError **unused
     return true;
 }
 
-struct OptArgs
-parse_cmd_line(int argc, char *argv[argc + 1])
+/** Parse a command line or a request sent to a server.
+ *
+ * A request must name a site, can't change how data is retrieved, and can't ask for help, because
+ * that prints to \c stdout and exits.
+ */
+static struct OptArgs
+parse_args(int argc, char *argv[argc + 1], bool is_request)
 {
     struct OptArgs result = {
         .site = 0,
@@ -247,6 +454,7 @@ parse_cmd_line(int argc, char *argv[argc + 1])
         .show_ice = false,
         .num_accum_periods = 0,
         .accum_hours = {24, 0, 0, 0},
+        .format = OUTPUT_FORMAT_TABLE,
         .show_temperature = false,
         .show_wind = false,
         .show_gust = false,
@@ -256,6 +464,15 @@ parse_cmd_line(int argc, char *argv[argc + 1])
         .show_precip_scenarios = false,
         .show_snow_scenarios = false,
         .request_time = 0,
+        .prefetch_watchlist = 0,
+        .prefetch_once = false,
+        .poll_minutes = 5,
+        .serve_socket = 0,
+        .memory_limit_mb = 256,
+        .save_binary = false,
+        .dump_dists = 0,
+        .profile = PROFILE_OFF,
+        .profile_file = 0,
         .error_parsing_options = false,
     };
 
@@ -263,6 +480,7 @@ parse_cmd_line(int argc, char *argv[argc + 1])
     GOptionGroup *main = g_option_group_new("main", "main options", "main help", &result, 0);
     g_option_group_add_entries(main, entries);
     g_option_context_set_main_group(context, main);
+    g_option_context_set_help_enabled(context, !is_request);
 
     bool success = g_option_context_parse(context, &argc, &argv, 0);
     Stopif(!success, goto ERR_RETURN, "Error parsing command line arguments.");
@@ -275,11 +493,47 @@ parse_cmd_line(int argc, char *argv[argc + 1])
                "Invalid accumulation period: %d - %d", i, result.accum_hours[i]);
     }
 
+    Stopif((result.mirror_url != 0) + (result.archive_dir != 0) + (result.replay_dir != 0) > 1,
+           goto ERR_RETURN, "Only one of --mirror-url, --archive-dir, and --replay may be used.");
+    Stopif(result.record_dir && result.replay_dir, goto ERR_RETURN,
+           "Only one of --record and --replay may be used.");
+
+    // The timings, metrics, and verbosity belong to the whole process, so a server's requests
+    // can't ask for them. Nor can they have the server write files wherever they like.
+    Stopif(is_request && (result.mirror_url || result.archive_dir || result.record_dir ||
+                          result.replay_dir || result.prefetch_watchlist || result.serve_socket ||
+                          result.dump_dists || result.profile != PROFILE_OFF ||
+                          result.profile_file || result.metrics_file || result.verbose ||
+                          result.save_dir || result.save_prefix || result.save_binary),
+           goto ERR_RETURN,
+           "Data source, mode, profiling, metrics, verbose, and save options are not allowed in "
+           "a request.");
+
+    if (result.verbose) {
+        global_verbose = true;
+    }
+
     // If request time was not given, assume it is now.
     if (result.request_time == 0) {
         result.request_time = time(0);
     }
 
+    Stopif(result.prefetch_watchlist && result.serve_socket, goto ERR_RETURN,
+           "Only one of --prefetch and --serve may be used.");
+
+    // The timings are kept until the process exits, so they would grow without bound in a daemon.
+    Stopif(result.profile != PROFILE_OFF &&
+               (result.serve_socket || (result.prefetch_watchlist && !result.prefetch_once)),
+           goto ERR_RETURN,
+           "--profile may not be used with --serve, or with --prefetch without --once.");
+
+    // In prefetch mode the sites come from the watchlist, and a server gets them from requests.
+    // Dumping a file doesn't need a site at all.
+    if (result.prefetch_watchlist || result.serve_socket || result.dump_dists) {
+        g_option_context_free(context);
+        return result;
+    }
+
     Stopif(argc < 2, goto ERR_RETURN, "Missing site argument.");
 
     result.site = argv[1];
@@ -290,11 +544,90 @@ parse_cmd_line(int argc, char *argv[argc + 1])
 
 ERR_RETURN:;
 
-    char *err_msg = g_option_context_get_help(context, true, 0);
-    puts(err_msg);
-    g_free(err_msg);
+    if (!is_request) {
+        char *err_msg = g_option_context_get_help(context, true, 0);
+        puts(err_msg);
+        g_free(err_msg);
+    }
     g_option_context_free(context);
     result.error_parsing_options = true;
 
     return result;
 }
+
+struct OptArgs
+parse_cmd_line(int argc, char *argv[argc + 1])
+{
+    return parse_args(argc, argv, false);
+}
+
+struct OptArgs
+parse_request(int argc, char *argv[argc + 1])
+{
+    return parse_args(argc, argv, true);
+}
+
+void
+opt_args_clear(struct OptArgs opt_args[static 1])
+{
+    free(opt_args->save_dir);
+    free(opt_args->save_prefix);
+    free(opt_args->mirror_url);
+    free(opt_args->archive_dir);
+    free(opt_args->record_dir);
+    free(opt_args->replay_dir);
+    free(opt_args->prefetch_watchlist);
+    free(opt_args->serve_socket);
+    free(opt_args->dump_dists);
+    free(opt_args->profile_file);
+    free(opt_args->metrics_file);
+
+    opt_args->save_dir = 0;
+    opt_args->save_prefix = 0;
+    opt_args->mirror_url = 0;
+    opt_args->archive_dir = 0;
+    opt_args->record_dir = 0;
+    opt_args->replay_dir = 0;
+    opt_args->prefetch_watchlist = 0;
+    opt_args->serve_socket = 0;
+    opt_args->dump_dists = 0;
+    opt_args->profile_file = 0;
+    opt_args->metrics_file = 0;
+}
+
+char *
+options_find_connect_socket(int *argc, char *argv[*argc + 1])
+{
+    static char const flag[] = "--connect";
+    size_t const flag_len = sizeof(flag) - 1;
+
+    for (int i = 1; i < *argc; i++) {
+        if (strcmp(argv[i], "--") == 0) {
+            break;
+        }
+
+        if (strncmp(argv[i], flag, flag_len) != 0) {
+            continue;
+        }
+
+        char *socket_path = 0;
+        int num_args = 0;
+        if (argv[i][flag_len] == '=') {
+            socket_path = &argv[i][flag_len + 1];
+            num_args = 1;
+        } else if (argv[i][flag_len] == '\0' && i + 1 < *argc) {
+            socket_path = argv[i + 1];
+            num_args = 2;
+        } else {
+            continue;
+        }
+
+        // Remove it, including the terminating null pointer.
+        memmove(&argv[i], &argv[i + num_args], (*argc - i - num_args + 1) * sizeof(char *));
+        *argc -= num_args;
+
+        return socket_path;
+    }
+
+    return 0;
+}
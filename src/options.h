@@ -3,18 +3,51 @@
 #include <stdbool.h>
 #include <time.h>
 
+#include "profile.h"
+
+/** How the summaries in a report are written. */
+enum OutputFormat {
+    OUTPUT_FORMAT_TABLE, // Tables meant for reading in a terminal.
+    OUTPUT_FORMAT_JSONL, // One JSON object per line for each valid time of each summary.
+    OUTPUT_FORMAT_CSV,   // One row per value, see records.h for the columns.
+};
+
 /** The command line options. */
 struct OptArgs {
     char *site;
 
     char *save_dir;
     char *save_prefix;
+    bool save_binary;
+
+    char *dump_dists;
+
+    enum ProfileFormat profile;
+    char *profile_file;
+
+    bool verbose;
+
+    char *metrics_file;
+
+    char *mirror_url;
+    char *archive_dir;
+    char *record_dir;
+    char *replay_dir;
+
+    char *prefetch_watchlist;
+    bool prefetch_once;
+    int poll_minutes;
+
+    char *serve_socket;
+    int memory_limit_mb;
 
     time_t request_time;
 
     int num_accum_periods;
     int accum_hours[4];
 
+    enum OutputFormat format;
+
     bool show_summary;
     bool show_hourly;
     bool show_rain;
@@ -38,3 +71,27 @@ struct OptArgs {
  * This routine may also set some global configuration variables, like a verbose flag.
  */
 struct OptArgs parse_cmd_line(int argc, char *argv[argc + 1]);
+
+/** Parse the arguments of a report request sent to a server.
+ *
+ * This is like \c parse_cmd_line(), but a site is always required, options that select the data
+ * source or the mode of the program are rejected, and help is not available. Errors are not
+ * written to \c stdout.
+ */
+struct OptArgs parse_request(int argc, char *argv[argc + 1]);
+
+/** Free the memory owned by a \c struct \c OptArgs.
+ *
+ * The site is an alias into the argument vector that was parsed, so it is not freed.
+ */
+void opt_args_clear(struct OptArgs opt_args[static 1]);
+
+/** Find the socket given with \c --connect, if any.
+ *
+ * This is checked before anything else is initialized, because a client doesn't need the cache or
+ * the network. The \c --connect option and its value are removed from \a argv and \a argc is
+ * updated.
+ *
+ * \returns an alias into \a argv, or \c NULL if there was no \c --connect option.
+ */
+char *options_find_connect_socket(int *argc, char *argv[*argc + 1]);
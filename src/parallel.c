@@ -0,0 +1,144 @@
+#include "parallel.h"
+#include "alloc_stats.h"
+
+#include <assert.h>
+#include <stdbool.h>
+
+#include <glib.h>
+
+/*-------------------------------------------------------------------------------------------------
+ *                                         Parallel for
+ *-----------------------------------------------------------------------------------------------*/
+/* One set of threads is started the first time it's needed and lives as long as the process.
+ * Each parallel_for() puts a job on a queue for them, and the calling thread works on its own job
+ * too, so a job always finishes even when every pool thread is busy. That also makes it safe for
+ * the pool threads to call parallel_for() themselves, which puts idle threads to work on the inner
+ * loop. A thread waiting for its job doesn't pick up other jobs, so no thread ever works on the
+ * same job twice.
+ */
+
+/** Upper limit on the number of threads, there isn't enough work in a report to keep more busy. */
+#define PARALLEL_MAX_WORKERS 16
+
+/** One call to parallel_for(), it lives on the stack of the calling thread. */
+struct ParallelForJob {
+    ParallelForFunc func;
+    void *user_data;
+    gint count;
+    gint next_index;
+    gint next_worker;
+    int num_helpers;          // Pool threads working on the job, guarded by pool.lock.
+    struct AllocCounts allocs; // Made by the pool threads for the job, guarded by pool.lock.
+};
+
+static struct {
+    GMutex lock;
+    GCond job_added;
+    GCond job_done;
+    GQueue jobs; // Jobs with indexes left that pool threads can help with.
+    bool started;
+} pool = {0};
+
+/** Work on a job until all of its indexes have been taken. */
+static void
+run_job(struct ParallelForJob *job)
+{
+    int const worker = g_atomic_int_add(&job->next_worker, 1);
+    assert(worker < parallel_num_workers());
+
+    // Take indexes one at a time so threads that draw cheap items pick up more of them.
+    gint index = 0;
+    while ((index = g_atomic_int_add(&job->next_index, 1)) < job->count) {
+        job->func(index, worker, job->user_data);
+    }
+}
+
+static void *
+pool_thread(void *unused)
+{
+    g_mutex_lock(&pool.lock);
+    while (true) {
+        struct ParallelForJob *job = g_queue_peek_head(&pool.jobs);
+        if (!job) {
+            g_cond_wait(&pool.job_added, &pool.lock);
+            continue;
+        }
+
+        job->num_helpers++;
+        g_mutex_unlock(&pool.lock);
+
+        struct AllocCounts const start = alloc_stats_thread();
+        run_job(job);
+        struct AllocCounts const end = alloc_stats_thread();
+
+        g_mutex_lock(&pool.lock);
+        // Charge the allocations to the thread that called parallel_for().
+        job->allocs.allocs += end.allocs - start.allocs;
+        job->allocs.alloc_bytes += end.alloc_bytes - start.alloc_bytes;
+        job->allocs.frees += end.frees - start.frees;
+        job->allocs.freed_bytes += end.freed_bytes - start.freed_bytes;
+
+        // All the indexes are taken, so nobody else should pick it up.
+        g_queue_remove(&pool.jobs, job);
+        job->num_helpers--;
+        if (job->num_helpers == 0) {
+            g_cond_broadcast(&pool.job_done);
+        }
+    }
+
+    return 0;
+}
+
+int
+parallel_num_workers(void)
+{
+    static gint num_workers = 0;
+
+    gint n = g_atomic_int_get(&num_workers);
+    if (n == 0) {
+        n = g_get_num_processors();
+        n = n < 1 ? 1 : n;
+        n = n > PARALLEL_MAX_WORKERS ? PARALLEL_MAX_WORKERS : n;
+        g_atomic_int_set(&num_workers, n);
+    }
+
+    return n;
+}
+
+void
+parallel_for(size_t count, ParallelForFunc func, void *user_data)
+{
+    assert(count <= G_MAXINT);
+
+    if (parallel_num_workers() <= 1 || count <= 1) {
+        for (size_t i = 0; i < count; i++) {
+            func(i, 0, user_data);
+        }
+        return;
+    }
+
+    struct ParallelForJob job = {.func = func, .user_data = user_data, .count = count};
+
+    g_mutex_lock(&pool.lock);
+    if (!pool.started) {
+        for (int i = 1; i < parallel_num_workers(); i++) {
+            g_thread_unref(g_thread_new("parallel_for", pool_thread, 0));
+        }
+        pool.started = true;
+    }
+    g_queue_push_tail(&pool.jobs, &job);
+    g_cond_broadcast(&pool.job_added);
+    g_mutex_unlock(&pool.lock);
+
+    run_job(&job);
+
+    // Stop more helpers from joining, then wait for the ones still working on it.
+    g_mutex_lock(&pool.lock);
+    g_queue_remove(&pool.jobs, &job);
+    while (job.num_helpers > 0) {
+        g_cond_wait(&pool.job_done, &pool.lock);
+    }
+    g_mutex_unlock(&pool.lock);
+
+    alloc_stats_add(job.allocs);
+}
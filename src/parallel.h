@@ -0,0 +1,34 @@
+#pragma once
+
+#include <stddef.h>
+
+/*-------------------------------------------------------------------------------------------------
+ *                                         Parallel for
+ *-----------------------------------------------------------------------------------------------*/
+/** Work done by parallel_for() for one index.
+ *
+ * \param index is the item to work on.
+ * \param worker identifies the thread doing the work, it is less than parallel_num_workers() and
+ * no two threads use the same one at the same time. Use it to pick per thread scratch space.
+ * \param user_data is the pointer passed to parallel_for().
+ */
+typedef void (*ParallelForFunc)(size_t index, int worker, void *user_data);
+
+/** The most threads parallel_for() will use, including the calling thread. */
+int parallel_num_workers(void);
+
+/** Call \a func once for each index from 0 up to \a count, spread across several threads.
+ *
+ * The calling thread does some of the work, and this returns after all of it is done. The order
+ * the indexes are visited in is not defined, so \a func should write its result into a slot for
+ * its index. Anything shared through \a user_data, such as an \c Arena, must not be modified by
+ * \a func unless it is thread safe.
+ *
+ * All calls share one pool of threads, so calling it from several threads, or from inside
+ * another parallel_for(), doesn't multiply the number of threads. Idle pool threads help with
+ * whichever loops are running.
+ *
+ * Allocations made by the pool threads for the loop are added to the counts of the calling thread
+ * (see alloc_stats.h), so they show up in the profiler spans open around the call.
+ */
+void parallel_for(size_t count, ParallelForFunc func, void *user_data);
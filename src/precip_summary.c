@@ -16,9 +16,10 @@ struct PrecipSum {
 
     int accum_hours;
 
-    GTree *cdfs;
-    GTree *pdfs;
-    GTree *scenarios;
+    Arena *arena;
+    TimeSeries *cdfs;
+    TimeSeries *pdfs;
+    TimeSeries *scenarios;
 };
 
 #define NUM_PROB_EXC_VALS 10
@@ -26,8 +27,12 @@ static char const *exc_vals[NUM_PROB_EXC_VALS] = {
     "0.254", "2.54", "6.35", "12.7", "25.4", "50.8", "101.6", "76.2", "127", "152.4",
 };
 
-static GTree *
-build_cdfs(NBMData const *nbm, int hours)
+/** The thresholds the probabilities of exceedance are shown for, in inches. */
+static double const summary_exc_vals[] = {0.01, 0.10, 0.25, 0.50, 0.75, 1.0};
+#define NUM_SUMMARY_EXC_VALS (sizeof(summary_exc_vals) / sizeof(summary_exc_vals[0]))
+
+static TimeSeries *
+build_cdfs(Arena *arena, NBMData const *nbm, int hours)
 {
     char percentile_format[32] = {0};
     char deterministic_precip_key[32] = {0};
@@ -35,14 +40,13 @@ build_cdfs(NBMData const *nbm, int hours)
     sprintf(percentile_format, "APCP%dhr_surface_%%d%%%% level", hours);
     sprintf(deterministic_precip_key, "APCP%dhr_surface", hours);
 
-    GTree *cdfs = extract_cdfs(nbm, percentile_format, deterministic_precip_key, mm_to_in);
-    Stopif(!cdfs, return 0, "Error extracting CDFs for QPF.");
-
     char prob_exceedence_format[32] = {0};
     sprintf(prob_exceedence_format, "APCP%dhr_surface_prob >%%s", hours);
 
-    cdfs = extract_exceedence_to_cdfs(cdfs, nbm, prob_exceedence_format, NUM_PROB_EXC_VALS,
-                                      exc_vals, mm_to_in);
+    TimeSeries *cdfs = extract_cdfs(arena, nbm, percentile_format, deterministic_precip_key,
+                                    prob_exceedence_format, NUM_PROB_EXC_VALS, exc_vals,
+                                    mm_to_in);
+    Stopif(!cdfs, return 0, "Error extracting CDFs for QPF.");
 
     return cdfs;
 }
@@ -59,7 +63,8 @@ precip_sum_build(NBMData const *nbm, int accum_hours)
 
     new->accum_hours = accum_hours;
 
-    new->cdfs = build_cdfs(nbm, accum_hours);
+    new->arena = arena_new();
+    new->cdfs = build_cdfs(new->arena, nbm, accum_hours);
     Stopif(!new->cdfs, goto ERR_RETURN, "Error extracting CDFs for QPF.");
 
     new->pdfs = 0;
@@ -79,7 +84,8 @@ static void
 build_title(struct PrecipSum const *psum, Table *tbl, int type)
 {
     char title_buf[256] = {0};
-    struct tm init = *gmtime(&psum->init_time);
+    struct tm init = {0};
+    gmtime_r(&psum->init_time, &init);
 
     if (type == SUMMARY) {
         sprintf(title_buf, "%d Hr Probabilistic Precipitation for %s (%s) - ", psum->accum_hours,
@@ -108,21 +114,29 @@ add_row_prob_liquid_exceedence_to_table(void *key, void *value, void *state)
 
     double pm_value = round(cumulative_dist_pm_value(dist) * 100.0) / 100.0;
 
-    double p10th = round(cumulative_dist_percentile_value(dist, 10.0) * 100.0) / 100.0;
-    double p25th = round(cumulative_dist_percentile_value(dist, 25.0) * 100.0) / 100.0;
-    double p50th = round(cumulative_dist_percentile_value(dist, 50.0) * 100.0) / 100.0;
-    double p75th = round(cumulative_dist_percentile_value(dist, 75.0) * 100.0) / 100.0;
-    double p90th = round(cumulative_dist_percentile_value(dist, 90.0) * 100.0) / 100.0;
+    static double const pcts[5] = {10.0, 25.0, 50.0, 75.0, 90.0};
+    double pct_vals[5] = {0};
+    cumulative_dist_percentile_values(dist, 5, pcts, pct_vals);
+
+    double p10th = round(pct_vals[0] * 100.0) / 100.0;
+    double p25th = round(pct_vals[1] * 100.0) / 100.0;
+    double p50th = round(pct_vals[2] * 100.0) / 100.0;
+    double p75th = round(pct_vals[3] * 100.0) / 100.0;
+    double p90th = round(pct_vals[4] * 100.0) / 100.0;
 
-    double prob_001 = round(interpolate_prob_of_exceedance(dist, 0.01));
-    double prob_010 = round(interpolate_prob_of_exceedance(dist, 0.10));
-    double prob_025 = round(interpolate_prob_of_exceedance(dist, 0.25));
-    double prob_050 = round(interpolate_prob_of_exceedance(dist, 0.50));
-    double prob_075 = round(interpolate_prob_of_exceedance(dist, 0.75));
-    double prob_100 = round(interpolate_prob_of_exceedance(dist, 1.0));
+    double probs[NUM_SUMMARY_EXC_VALS] = {0};
+    interpolate_probs_of_exceedance(dist, NUM_SUMMARY_EXC_VALS, summary_exc_vals, probs);
+
+    double prob_001 = round(probs[0]);
+    double prob_010 = round(probs[1]);
+    double prob_025 = round(probs[2]);
+    double prob_050 = round(probs[3]);
+    double prob_075 = round(probs[4]);
+    double prob_100 = round(probs[5]);
 
     char datebuf[64] = {0};
-    strftime(datebuf, sizeof(datebuf), "%a, %Y-%m-%d %HZ", gmtime(vt));
+    struct tm vt_tm = {0};
+    strftime(datebuf, sizeof(datebuf), "%a, %Y-%m-%d %HZ", gmtime_r(vt, &vt_tm));
 
     table_set_string_value(tbl, 0, row, strlen(datebuf), datebuf);
 
@@ -147,19 +161,19 @@ add_row_prob_liquid_exceedence_to_table(void *key, void *value, void *state)
 }
 
 void
-show_precip_summary(struct PrecipSum const *psum)
+show_precip_summary(struct PrecipSum const *psum, FILE *out)
 {
     assert(psum);
 
     char left_col_title[32] = {0};
     sprintf(left_col_title, "%d Hrs Ending", psum->accum_hours);
 
-    GTree *cdfs = psum->cdfs;
+    TimeSeries *cdfs = psum->cdfs;
     assert(cdfs);
 
-    int num_rows = g_tree_nnodes(cdfs);
+    int num_rows = time_series_len(cdfs);
     if (num_rows == 0) {
-        printf("\n\n     ***** No precipitation summary for accumulation period %d. *****\n\n",
+        fprintf(out, "\n\n     ***** No precipitation summary for accumulation period %d. *****\n\n",
                psum->accum_hours);
         return;
     }
@@ -194,40 +208,21 @@ show_precip_summary(struct PrecipSum const *psum)
     }
 
     struct TableFillerState state = {.row = 0, .tbl = tbl};
-    g_tree_foreach(cdfs, add_row_prob_liquid_exceedence_to_table, &state);
+    time_series_foreach(cdfs, add_row_prob_liquid_exceedence_to_table, &state);
 
-    table_display(tbl, stdout);
+    table_display(tbl, out);
 
     table_free(&tbl);
 
     return;
 }
 
-static int
-create_pdf_from_cdf_and_add_too_pdf_tree(void *key, void *val, void *data)
-{
-    CumulativeDistribution *cdf = val;
-    GTree *pdfs = data;
-
-    ProbabilityDistribution *pdf = probability_dist_calc(cdf);
-
-    g_tree_insert(pdfs, key, pdf);
-
-    return false;
-}
-
 static void
 precip_sum_build_pdfs(struct PrecipSum *psum)
 {
     assert(psum && psum->cdfs);
 
-    // Don't free the keys, we'll just point those to the same location as the keys
-    // used in the GTree of CDFs.
-    GTree *pdfs = g_tree_new_full(time_t_compare_func, 0, 0, probability_dist_free);
-
-    g_tree_foreach(psum->cdfs, create_pdf_from_cdf_and_add_too_pdf_tree, pdfs);
-
-    psum->pdfs = pdfs;
+    psum->pdfs = create_pdfs_from_cdfs(psum->arena, psum->cdfs);
 }
 
 static void
@@ -235,7 +230,7 @@ precip_sum_build_scenarios(struct PrecipSum *psum)
 {
     assert(psum && psum->cdfs && psum->pdfs);
 
-    GTree *scenarios = create_scenarios_from_pdfs(psum->pdfs, 0.01, 0.02);
+    TimeSeries *scenarios = create_scenarios_from_pdfs(psum->arena, psum->pdfs, 0.01, 0.02);
     assert(scenarios);
 
     psum->scenarios = scenarios;
@@ -245,27 +240,27 @@ static int
 add_row_scenario_to_table(void *key, void *value, void *state)
 {
     time_t *vt = key;
-    GList *scenarios = value;
+    ScenarioList const *scenarios = value;
 
     struct TableFillerState *tbl_state = state;
     Table *tbl = tbl_state->tbl;
     int row = tbl_state->row;
 
     char datebuf[64] = {0};
-    strftime(datebuf, sizeof(datebuf), "%a, %Y-%m-%d %HZ", gmtime(vt));
+    struct tm vt_tm = {0};
+    strftime(datebuf, sizeof(datebuf), "%a, %Y-%m-%d %HZ", gmtime_r(vt, &vt_tm));
 
     table_set_string_value(tbl, 0, row, strlen(datebuf), datebuf);
 
-    size_t scenario_num = 1;
-    for (GList *curr = scenarios; curr && scenario_num <= 4; curr = curr->next, scenario_num++) {
-        struct Scenario *sc = curr->data;
+    for (int i = 0; i < scenario_list_len(scenarios); i++) {
+        Scenario const *sc = scenario_list_get(scenarios, i);
 
         double min = round(scenario_get_minimum(sc) * 100.0) / 100.0;
         double mode = round(scenario_get_mode(sc) * 100.0) / 100.0;
         double max = round(scenario_get_maximum(sc) * 100.0) / 100.0;
         double prob = round(scenario_get_probability(sc) * 100.0);
 
-        table_set_scenario(tbl, scenario_num, row, mode, min, max, prob);
+        table_set_scenario(tbl, i + 1, row, mode, min, max, prob);
     }
 
     tbl_state->row++;
@@ -274,7 +269,7 @@ add_row_scenario_to_table(void *key, void *value, void *state)
 }
 
 void
-show_precip_scenarios(struct PrecipSum *psum)
+show_precip_scenarios(struct PrecipSum *psum, FILE *out)
 {
     assert(psum);
     if (!psum->pdfs) {
@@ -290,12 +285,12 @@ show_precip_scenarios(struct PrecipSum *psum)
     char left_col_title[32] = {0};
     sprintf(left_col_title, "%d Hrs Ending", psum->accum_hours);
 
-    GTree *scenarios = psum->scenarios;
+    TimeSeries *scenarios = psum->scenarios;
     assert(scenarios);
 
-    int num_rows = g_tree_nnodes(scenarios);
+    int num_rows = time_series_len(scenarios);
     if (num_rows == 0) {
-        printf("\n\n     ***** No precipitation scenarios for accumulation period %d. *****\n\n",
+        fprintf(out, "\n\n     ***** No precipitation scenarios for accumulation period %d. *****\n\n",
                psum->accum_hours);
         return;
     }
@@ -322,13 +317,39 @@ show_precip_scenarios(struct PrecipSum *psum)
     table_set_double_left_border(tbl, 4);
 
     struct TableFillerState state = {.row = 0, .tbl = tbl};
-    g_tree_foreach(scenarios, add_row_scenario_to_table, &state);
+    time_series_foreach(scenarios, add_row_scenario_to_table, &state);
 
-    table_display(tbl, stdout);
+    table_display(tbl, out);
 
     table_free(&tbl);
 }
 
+void
+precip_sum_write_records(PrecipSum *psum, bool summary, bool scenarios, RecordWriter *w)
+{
+    assert(psum && psum->cdfs);
+
+    char element[32] = {0};
+
+    if (summary) {
+        sprintf(element, "precip_%dh", psum->accum_hours);
+        records_write_cdfs(w, element, psum->cdfs, NUM_SUMMARY_EXC_VALS, summary_exc_vals);
+    }
+
+    if (scenarios) {
+        if (!psum->pdfs) {
+            precip_sum_build_pdfs(psum);
+        }
+
+        if (!psum->scenarios) {
+            precip_sum_build_scenarios(psum);
+        }
+
+        sprintf(element, "precip_%dh_scenarios", psum->accum_hours);
+        records_write_scenarios(w, element, psum->scenarios);
+    }
+}
+
 static int
 write_cdf(void *key, void *value, void *state)
 {
@@ -337,7 +358,8 @@ write_cdf(void *key, void *value, void *state)
     FILE *f = state;
 
     char datebuf[64] = {0};
-    strftime(datebuf, sizeof(datebuf), "%a, %Y-%m-%d %HZ", gmtime(vt));
+    struct tm vt_tm = {0};
+    strftime(datebuf, sizeof(datebuf), "%a, %Y-%m-%d %HZ", gmtime_r(vt, &vt_tm));
 
     fprintf(f, "\n\n\"Period ending: %s\"\n", datebuf);
 
@@ -354,7 +376,8 @@ write_pdf(void *key, void *value, void *state)
     FILE *f = state;
 
     char datebuf[64] = {0};
-    strftime(datebuf, sizeof(datebuf), "%a, %Y-%m-%d %HZ", gmtime(vt));
+    struct tm vt_tm = {0};
+    strftime(datebuf, sizeof(datebuf), "%a, %Y-%m-%d %HZ", gmtime_r(vt, &vt_tm));
 
     fprintf(f, "\n\n\"Period ending: %s\"\n", datebuf);
 
@@ -367,16 +390,17 @@ static int
 write_scenario(void *key, void *value, void *state)
 {
     time_t *vt = key;
-    GList *scenarios = value;
+    ScenarioList const *scenarios = value;
     FILE *f = state;
 
     char datebuf[64] = {0};
-    strftime(datebuf, sizeof(datebuf), "%a, %Y-%m-%d %HZ", gmtime(vt));
+    struct tm vt_tm = {0};
+    strftime(datebuf, sizeof(datebuf), "%a, %Y-%m-%d %HZ", gmtime_r(vt, &vt_tm));
 
     fprintf(f, "\n\n\"Period ending: %s\"\n", datebuf);
 
-    for (GList *curr = scenarios; curr; curr = curr->next) {
-        Scenario *sc = curr->data;
+    for (int i = 0; i < scenario_list_len(scenarios); i++) {
+        Scenario const *sc = scenario_list_get(scenarios, i);
 
         fprintf(f, "%8lf %8lf %8lf %8lf\n", scenario_get_minimum(sc), scenario_get_mode(sc),
                 scenario_get_maximum(sc), scenario_get_probability(sc));
@@ -421,15 +445,61 @@ precip_sum_save(struct PrecipSum *psum, char const *directory, char const *file_
     FILE *scenario_f = fopen(scenario_path, "w");
     Stopif(!scenario_f, return, "Unable to open scenarios.dat");
 
-    g_tree_foreach(psum->cdfs, write_cdf, cdf_f);
-    g_tree_foreach(psum->pdfs, write_pdf, pdf_f);
-    g_tree_foreach(psum->scenarios, write_scenario, scenario_f);
+    time_series_foreach(psum->cdfs, write_cdf, cdf_f);
+    time_series_foreach(psum->pdfs, write_pdf, pdf_f);
+    time_series_foreach(psum->scenarios, write_scenario, scenario_f);
 
     fclose(cdf_f);
     fclose(pdf_f);
     fclose(scenario_f);
 }
 
+void
+precip_sum_archive(PrecipSum *psum, DistArchiveWriter *writer)
+{
+    assert(psum && psum->cdfs);
+
+    if (!psum->pdfs) {
+        precip_sum_build_pdfs(psum);
+    }
+
+    if (!psum->scenarios) {
+        precip_sum_build_scenarios(psum);
+    }
+
+    char element[DIST_ARCHIVE_ELEMENT_LEN] = {0};
+    sprintf(element, "precip_%dh", psum->accum_hours);
+    dist_archive_add(writer, element, psum->cdfs, psum->pdfs, psum->scenarios);
+}
+
+void
+precip_sum_prepare(struct PrecipSum *psum, bool scenarios)
+{
+    assert(psum && psum->cdfs);
+
+    if (!scenarios) {
+        return;
+    }
+
+    if (!psum->pdfs) {
+        precip_sum_build_pdfs(psum);
+    }
+
+    if (!psum->scenarios) {
+        precip_sum_build_scenarios(psum);
+    }
+}
+
+size_t
+precip_sum_memory_bytes(struct PrecipSum const *psum)
+{
+    assert(psum);
+
+    return sizeof(*psum) + strlen(psum->id) + strlen(psum->name) + 2 +
+           arena_memory_bytes(psum->arena) + time_series_memory_bytes(psum->cdfs) +
+           time_series_memory_bytes(psum->pdfs) + time_series_memory_bytes(psum->scenarios);
+}
+
 void
 precip_sum_free(struct PrecipSum **psum)
 {
@@ -442,14 +512,16 @@ precip_sum_free(struct PrecipSum **psum)
         free(ptr->name);
 
         if (ptr->scenarios) {
-            g_tree_unref(ptr->scenarios);
+            time_series_free(&ptr->scenarios);
         }
         if (ptr->pdfs) {
-            g_tree_unref(ptr->pdfs);
+            time_series_free(&ptr->pdfs);
         }
         if (ptr->cdfs) {
-            g_tree_unref(ptr->cdfs);
+            time_series_free(&ptr->cdfs);
         }
+
+        arena_free(&ptr->arena);
     }
 
     free(ptr);
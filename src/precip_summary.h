@@ -1,6 +1,11 @@
 #pragma once
 
+#include <stdbool.h>
+#include <stdio.h>
+
+#include "dist_archive.h"
 #include "nbm_data.h"
+#include "records.h"
 
 /** A precipitation Summary. */
 typedef struct PrecipSum PrecipSum;
@@ -13,10 +18,19 @@ typedef struct PrecipSum PrecipSum;
 PrecipSum *precip_sum_build(NBMData const *nbm, int accum_hours);
 
 /** Print a probabilistic summary. */
-void show_precip_summary(PrecipSum const *psum);
+void show_precip_summary(PrecipSum const *psum, FILE *out);
 
 /** Print a summary of the preciptation scenarios. */
-void show_precip_scenarios(PrecipSum *psum);
+void show_precip_scenarios(PrecipSum *psum, FILE *out);
+
+/** Write the summary and/or the scenarios as machine readable records.
+ *
+ * \param psum is the summary to write.
+ * \param summary is whether to write the probabilistic summary.
+ * \param scenarios is whether to write the precipitation scenarios.
+ * \param w is where to write the records.
+ */
+void precip_sum_write_records(PrecipSum *psum, bool summary, bool scenarios, RecordWriter *w);
 
 /** Save two files with the CDF and PDF information in them.
  *
@@ -29,5 +43,23 @@ void show_precip_scenarios(PrecipSum *psum);
  */
 void precip_sum_save(PrecipSum *psum, char const *directory, char const *file_prefix);
 
+/** Add the CDFs, PDFs, and scenarios to a binary archive, building them if needed. */
+void precip_sum_archive(PrecipSum *psum, DistArchiveWriter *writer);
+
+/** Build the PDFs and scenarios now instead of the first time they are used.
+ *
+ * Once they are built, showing, writing, saving, or archiving the summary only reads it, so it can
+ * be done from several threads at once.
+ *
+ * \param scenarios is whether the PDFs and scenarios will be needed.
+ */
+void precip_sum_prepare(PrecipSum *psum, bool scenarios);
+
+/** Get the approximate number of bytes of memory used by a \c PrecipSum.
+ *
+ * This includes the CDFs, PDFs, and scenarios that have been built so far.
+ */
+size_t precip_sum_memory_bytes(PrecipSum const *psum);
+
 /** Free the memory associated with a \c PrecipSum.*/
 void precip_sum_free(PrecipSum **psum);
@@ -0,0 +1,175 @@
+#include "prefetch.h"
+
+#include <signal.h>
+#include <unistd.h>
+
+#include "download.h"
+#include "metrics.h"
+#include "site_validation.h"
+#include "utils.h"
+
+extern bool global_verbose;
+
+/*-------------------------------------------------------------------------------------------------
+ *                                         Watchlist
+ *-----------------------------------------------------------------------------------------------*/
+/** The file names of the sites to prefetch. */
+struct Watchlist {
+    size_t size;
+    char **file_names;
+};
+
+static void
+watchlist_free(struct Watchlist *list)
+{
+    for (size_t i = 0; i < list->size; i++) {
+        free(list->file_names[i]);
+    }
+    free(list->file_names);
+    list->file_names = 0;
+    list->size = 0;
+}
+
+static struct Watchlist
+watchlist_load(char const path[static 1])
+{
+    struct Watchlist list = {.size = 0, .file_names = 0};
+    size_t capacity = 0;
+
+    FILE *f = fopen(path, "r");
+    Stopif(!f, return list, "Unable to open watchlist %s", path);
+
+    char line[256] = {0};
+    while (fgets(line, sizeof(line), f)) {
+        // Strip comments and surrounding white space.
+        char *comment = strchr(line, '#');
+        if (comment) {
+            *comment = '\0';
+        }
+
+        char *start = line;
+        while (*start && isspace(*start)) {
+            start++;
+        }
+
+        char *end = start + strlen(start);
+        while (end > start && isspace(end[-1])) {
+            end--;
+        }
+        *end = '\0';
+
+        if (!*start) {
+            continue;
+        }
+
+        to_uppercase(start);
+
+        if (list.size == capacity) {
+            capacity = capacity ? capacity * 2 : 16;
+            list.file_names = realloc(list.file_names, capacity * sizeof(char *));
+            assert(list.file_names);
+        }
+
+        int num_bytes = asprintf(&list.file_names[list.size], "%s.csv", start);
+        Stopif(num_bytes < 0, exit(EXIT_FAILURE), "out of memory");
+        list.size++;
+    }
+
+    fclose(f);
+
+    return list;
+}
+
+/*-------------------------------------------------------------------------------------------------
+ *                                      Signal Handling
+ *-----------------------------------------------------------------------------------------------*/
+/** Set when it is time to shut down. */
+static volatile sig_atomic_t stop_requested = 0;
+
+static void
+handle_stop_signal(int signum)
+{
+    stop_requested = 1;
+}
+
+static void
+install_signal_handlers(void)
+{
+    struct sigaction action = {.sa_handler = handle_stop_signal};
+    sigemptyset(&action.sa_mask);
+
+    // No SA_RESTART, so sleep() is interrupted and we shut down promptly.
+    sigaction(SIGINT, &action, 0);
+    sigaction(SIGTERM, &action, 0);
+}
+
+/*-------------------------------------------------------------------------------------------------
+ *                                        Prefetching
+ *-----------------------------------------------------------------------------------------------*/
+/** Try to get all the files for a cycle into the cache.
+ *
+ * \returns \c true if the locations file and every site on the watchlist are now in the cache.
+ */
+static bool
+prefetch_cycle(struct Watchlist const *list, time_t init_time)
+{
+    char const *const locations[] = {"locations.csv"};
+    if (download_files_to_cache(1, locations, init_time) == 0) {
+        // The cycle hasn't been posted yet.
+        return false;
+    }
+
+    size_t num_available =
+        download_files_to_cache(list->size, (char const *const *)list->file_names, init_time);
+
+    if (global_verbose) {
+        struct tm init = {0};
+        gmtime_r(&init_time, &init);
+        char datebuf[32] = {0};
+        strftime(datebuf, sizeof(datebuf), "%Y/%m/%d %Hz", &init);
+
+        printf("Prefetched %zu of %zu sites for %s\n", num_available, list->size, datebuf);
+    }
+
+    return num_available == list->size;
+}
+
+int
+prefetch_run(char const *watchlist_path, time_t request_time, bool once, int poll_minutes)
+{
+    assert(watchlist_path);
+    assert(poll_minutes > 0);
+
+    struct Watchlist list = watchlist_load(watchlist_path);
+    Stopif(list.size == 0, goto ERR_RETURN, "No sites in watchlist %s", watchlist_path);
+
+    if (once) {
+        bool complete = prefetch_cycle(&list, calc_most_recent_init_time(request_time));
+        watchlist_free(&list);
+        return complete ? 0 : 1;
+    }
+
+    install_signal_handlers();
+
+    time_t last_completed = 0;
+    while (!stop_requested) {
+        time_t init_time = calc_most_recent_init_time(time(0));
+
+        // Keep trying until everything on the watchlist for this cycle is in. Files that are
+        // already in the cache aren't downloaded again.
+        if (init_time > last_completed && prefetch_cycle(&list, init_time)) {
+            last_completed = init_time;
+        }
+
+        metrics_write();
+
+        sleep(poll_minutes * 60);
+    }
+
+    watchlist_free(&list);
+    return 0;
+
+ERR_RETURN:
+    watchlist_free(&list);
+    return 1;
+}
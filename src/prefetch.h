@@ -0,0 +1,22 @@
+#pragma once
+
+#include <stdbool.h>
+#include <time.h>
+
+/** Pre-warm the download cache for a list of sites.
+ *
+ * The watchlist is a text file with one site id per line. Blank lines and anything after a '#' are
+ * ignored. For each NBM cycle, once the locations.csv file for that cycle is available, the site
+ * files for every site on the watchlist are downloaded concurrently and stored in the cache so
+ * later requests for those sites never have to wait on the network.
+ *
+ * \param watchlist_path is the path to the watchlist file.
+ * \param request_time is the time to start from, usually now.
+ * \param once if \c true, only fetch the most recent cycle as of \a request_time and return. This
+ * is useful for running from \c cron. Otherwise keep running and fetch each new cycle as it is
+ * posted until the process is sent \c SIGINT or \c SIGTERM.
+ * \param poll_minutes is how often to check for new data while waiting for a cycle to post.
+ *
+ * \returns 0 on success.
+ */
+int prefetch_run(char const *watchlist_path, time_t request_time, bool once, int poll_minutes);
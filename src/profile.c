@@ -0,0 +1,347 @@
+#include "profile.h"
+#include "table.h"
+#include "utils.h"
+
+#include <assert.h>
+#include <inttypes.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include <glib.h>
+
+/*-------------------------------------------------------------------------------------------------
+ *                                        Recorded Spans
+ *-----------------------------------------------------------------------------------------------*/
+struct ProfileEvent {
+    char const *name;
+    char detail[PROFILE_DETAIL_LEN];
+    int64_t start_ns;
+    int64_t duration_ns;
+    uint64_t allocs;
+    uint64_t alloc_bytes;
+    int64_t net_bytes; // Allocated minus freed, negative if it freed memory allocated before.
+    int thread;
+};
+
+/** Only set before other threads start and after they are done, so it is read without a lock. */
+static enum ProfileFormat profile_format = PROFILE_OFF;
+
+static struct {
+    GMutex lock;
+    int64_t start_ns;
+    struct ProfileEvent *events;
+    size_t num_events;
+    size_t capacity;
+    gint num_threads;
+} profile = {0};
+
+/** The detail of the innermost open span on this thread. */
+static _Thread_local char const *current_detail = 0;
+
+/** A small number to identify this thread in a trace, 0 means it hasn't been assigned yet. */
+static _Thread_local int thread_number = 0;
+
+static int64_t
+now_ns(void)
+{
+    struct timespec ts = {0};
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+void
+profile_start(enum ProfileFormat format)
+{
+    assert(profile_format == PROFILE_OFF);
+
+    alloc_stats_start();
+    profile.start_ns = now_ns();
+    profile_format = format;
+}
+
+ProfileSpan
+profile_begin(char const *name, char const *detail)
+{
+    if (profile_format == PROFILE_OFF) {
+        return (ProfileSpan){0};
+    }
+
+    ProfileSpan span = {.name = name, .outer_detail = current_detail};
+    span.detail = detail ? detail : current_detail;
+    current_detail = span.detail;
+    span.start_allocs = alloc_stats_thread();
+    span.start_ns = now_ns();
+
+    return span;
+}
+
+void
+profile_end(ProfileSpan *span)
+{
+    if (!span->name) {
+        return;
+    }
+
+    int64_t end_ns = now_ns();
+    struct AllocCounts end_allocs = alloc_stats_thread();
+    current_detail = span->outer_detail;
+
+    if (thread_number == 0) {
+        thread_number = g_atomic_int_add(&profile.num_threads, 1) + 1;
+    }
+
+    struct ProfileEvent event = {.name = span->name,
+                                 .start_ns = span->start_ns - profile.start_ns,
+                                 .duration_ns = end_ns - span->start_ns,
+                                 .allocs = end_allocs.allocs - span->start_allocs.allocs,
+                                 .thread = thread_number};
+    event.alloc_bytes = end_allocs.alloc_bytes - span->start_allocs.alloc_bytes;
+    event.net_bytes = (int64_t)event.alloc_bytes -
+                      (int64_t)(end_allocs.freed_bytes - span->start_allocs.freed_bytes);
+    if (span->detail) {
+        strncpy(event.detail, span->detail, sizeof(event.detail) - 1);
+    }
+
+    g_mutex_lock(&profile.lock);
+    if (profile.num_events == profile.capacity) {
+        profile.capacity = profile.capacity ? 2 * profile.capacity : 256;
+        profile.events = realloc(profile.events, profile.capacity * sizeof(*profile.events));
+        Stopif(!profile.events, exit(EXIT_FAILURE), "out of memory");
+    }
+    profile.events[profile.num_events++] = event;
+    g_mutex_unlock(&profile.lock);
+
+    span->name = 0;
+}
+
+/*-------------------------------------------------------------------------------------------------
+ *                                        Summary Table
+ *-----------------------------------------------------------------------------------------------*/
+/** All the spans with the same name and detail. */
+struct ProfileGroup {
+    char const *name;
+    char const *detail;
+    int64_t first_start_ns;
+    int64_t total_ns;
+    int64_t max_ns;
+    uint64_t allocs;
+    uint64_t alloc_bytes;
+    int64_t net_bytes;
+    int count;
+};
+
+static int
+event_compare(void const *a, void const *b)
+{
+    struct ProfileEvent const *ea = a;
+    struct ProfileEvent const *eb = b;
+
+    int cmp = strcmp(ea->name, eb->name);
+    if (cmp == 0) {
+        cmp = strcmp(ea->detail, eb->detail);
+    }
+
+    return cmp;
+}
+
+/** Sort the groups in the order the phases first ran. */
+static int
+group_compare(void const *a, void const *b)
+{
+    struct ProfileGroup const *ga = a;
+    struct ProfileGroup const *gb = b;
+
+    if (ga->first_start_ns != gb->first_start_ns) {
+        return ga->first_start_ns < gb->first_start_ns ? -1 : 1;
+    }
+
+    return 0;
+}
+
+static void
+write_table(char const *site, FILE *out)
+{
+    qsort(profile.events, profile.num_events, sizeof(*profile.events), event_compare);
+
+    struct ProfileGroup *groups = calloc(profile.num_events, sizeof(struct ProfileGroup));
+    assert(groups || profile.num_events == 0);
+
+    int num_groups = 0;
+    for (size_t i = 0; i < profile.num_events; i++) {
+        struct ProfileEvent const *event = &profile.events[i];
+        if (i == 0 || event_compare(event, &profile.events[i - 1]) != 0) {
+            groups[num_groups++] = (struct ProfileGroup){.name = event->name,
+                                                         .detail = event->detail,
+                                                         .first_start_ns = event->start_ns};
+        }
+
+        struct ProfileGroup *group = &groups[num_groups - 1];
+        group->count++;
+        group->total_ns += event->duration_ns;
+        if (event->duration_ns > group->max_ns) {
+            group->max_ns = event->duration_ns;
+        }
+        if (event->start_ns < group->first_start_ns) {
+            group->first_start_ns = event->start_ns;
+        }
+        group->allocs += event->allocs;
+        group->alloc_bytes += event->alloc_bytes;
+        group->net_bytes += event->net_bytes;
+    }
+
+    qsort(groups, num_groups, sizeof(*groups), group_compare);
+
+    bool const with_allocs = alloc_stats_available();
+    Table *tbl = table_new(with_allocs ? 9 : 6, num_groups);
+
+    char title[128] = {0};
+    int len = snprintf(title, sizeof(title),
+                       "Profile for %s - %.3lf ms wall time - %.1lf MiB peak RSS",
+                       site ? site : "nbm", (now_ns() - profile.start_ns) / 1.0e6,
+                       alloc_stats_peak_rss_kb() / 1024.0);
+    table_add_title(tbl, len, title);
+
+    // clang-format off
+    table_add_column(tbl, 0, Table_ColumnType_TEXT,  "Phase",      "%s",        24);
+    table_add_column(tbl, 1, Table_ColumnType_TEXT,  "Detail",     "%s",        20);
+    table_add_column(tbl, 2, Table_ColumnType_VALUE, "Count",      " %5.0lf ",   7);
+    table_add_column(tbl, 3, Table_ColumnType_VALUE, "Total (ms)", " %9.3lf ",  11);
+    table_add_column(tbl, 4, Table_ColumnType_VALUE, "Mean (ms)",  " %9.3lf ",  11);
+    table_add_column(tbl, 5, Table_ColumnType_VALUE, "Max (ms)",   " %9.3lf ",  11);
+    if (with_allocs) {
+        table_add_column(tbl, 6, Table_ColumnType_VALUE, "Allocs",     " %8.0lf ",  10);
+        table_add_column(tbl, 7, Table_ColumnType_VALUE, "Alloc (MiB)", " %9.3lf ", 11);
+        table_add_column(tbl, 8, Table_ColumnType_VALUE, "Net (MiB)",  " %9.3lf ",  11);
+    }
+    // clang-format on
+
+    for (int i = 0; i < num_groups; i++) {
+        struct ProfileGroup const *group = &groups[i];
+
+        table_set_string_value(tbl, 0, i, strlen(group->name), group->name);
+        table_set_string_value(tbl, 1, i, strlen(group->detail), group->detail);
+        table_set_value(tbl, 2, i, group->count);
+        table_set_value(tbl, 3, i, group->total_ns / 1.0e6);
+        table_set_value(tbl, 4, i, group->total_ns / 1.0e6 / group->count);
+        table_set_value(tbl, 5, i, group->max_ns / 1.0e6);
+        if (with_allocs) {
+            table_set_value(tbl, 6, i, group->allocs);
+            table_set_value(tbl, 7, i, group->alloc_bytes / (1024.0 * 1024.0));
+            table_set_value(tbl, 8, i, group->net_bytes / (1024.0 * 1024.0));
+        }
+    }
+
+    table_display(tbl, out);
+
+    table_free(&tbl);
+    free(groups);
+}
+
+/*-------------------------------------------------------------------------------------------------
+ *                                     Chrome Trace Events
+ *-----------------------------------------------------------------------------------------------*/
+static void
+write_json_string(char const *str, FILE *out)
+{
+    fputc('"', out);
+    for (char const *c = str; *c; c++) {
+        if (*c == '"' || *c == '\\') {
+            fputc('\\', out);
+            fputc(*c, out);
+        } else if ((unsigned char)*c < 0x20) {
+            fprintf(out, "\\u%04x", (unsigned char)*c);
+        } else {
+            fputc(*c, out);
+        }
+    }
+    fputc('"', out);
+}
+
+/** Write complete ("X") events with times in microseconds from the start of profiling. */
+static void
+write_trace(char const *site, FILE *out)
+{
+    bool const with_allocs = alloc_stats_available();
+
+    fputs("{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n", out);
+
+    // Name the process after the site so traces from several runs can be loaded side by side.
+    fputs("{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":1,\"tid\":1,\"args\":{\"name\":", out);
+    write_json_string(site ? site : "nbm", out);
+    fputs("}}", out);
+
+    for (size_t i = 0; i < profile.num_events; i++) {
+        struct ProfileEvent const *event = &profile.events[i];
+
+        fputs(",\n{\"name\":", out);
+        write_json_string(event->name, out);
+        fprintf(out, ",\"cat\":\"nbm\",\"ph\":\"X\",\"ts\":%.3lf,\"dur\":%.3lf",
+                event->start_ns / 1.0e3, event->duration_ns / 1.0e3);
+        fprintf(out, ",\"pid\":1,\"tid\":%d", event->thread);
+
+        if (event->detail[0] || with_allocs) {
+            fputs(",\"args\":{", out);
+            if (event->detail[0]) {
+                fputs("\"detail\":", out);
+                write_json_string(event->detail, out);
+                fputs(with_allocs ? "," : "", out);
+            }
+            if (with_allocs) {
+                fprintf(out, "\"allocs\":%" PRIu64 ",\"alloc_bytes\":%" PRIu64, event->allocs,
+                        event->alloc_bytes);
+                fprintf(out, ",\"net_bytes\":%" PRId64, event->net_bytes);
+            }
+            fputc('}', out);
+        }
+        fputc('}', out);
+    }
+
+    // The peak resident set size as a counter at the end, so it shows on the timeline.
+    fprintf(out, ",\n{\"name\":\"memory\",\"ph\":\"C\",\"ts\":%.3lf,\"pid\":1,\"tid\":1,"
+                 "\"args\":{\"peak_rss_kb\":%ld}}",
+            (now_ns() - profile.start_ns) / 1.0e3, alloc_stats_peak_rss_kb());
+
+    fputs("\n]}\n", out);
+}
+
+void
+profile_finish(char const *site, char const *path)
+{
+    enum ProfileFormat format = profile_format;
+    if (format == PROFILE_OFF) {
+        return;
+    }
+
+    // Stop recording first, so writing the table isn't timed.
+    profile_format = PROFILE_OFF;
+
+    FILE *out = stderr;
+    if (path) {
+        out = fopen(path, "w");
+        Stopif(!out, goto EXIT, "Unable to open %s", path);
+    }
+
+    switch (format) {
+    case PROFILE_TABLE:
+        write_table(site, out);
+        break;
+    case PROFILE_TRACE:
+        write_trace(site, out);
+        break;
+    case PROFILE_OFF:
+        break;
+    }
+
+    if (path) {
+        fclose(out);
+    }
+
+EXIT:
+    free(profile.events);
+    profile.events = 0;
+    profile.num_events = 0;
+    profile.capacity = 0;
+}
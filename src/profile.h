@@ -0,0 +1,68 @@
+#pragma once
+
+#include "alloc_stats.h"
+
+#include <stdint.h>
+
+/*-------------------------------------------------------------------------------------------------
+ *                                     Timing the Pipeline
+ *-----------------------------------------------------------------------------------------------*/
+/* Spans are placed around the main phases of making a report, like downloading, parsing the CSV,
+ * and building the distributions. They cost a single branch until profiling is started, so they
+ * are left in the code permanently.
+ *
+ * Each span has a name for the phase and an optional detail, like the site or the element being
+ * summarized. Spans that don't give a detail inherit the one of the span they are nested in on
+ * the same thread, so the time spent building the PDFs for 24 hour precipitation can be told
+ * apart from that spent on the wind.
+ *
+ * When the build can count allocations (see alloc_stats.h), each span also records how many
+ * allocations the thread made while it was open, how many bytes they were, and how many of those
+ * bytes were still allocated when it ended. Like the times, these include nested spans, and the
+ * work parallel_for() handed to other threads while the span was open.
+ */
+
+/** How the timings are written when profiling is finished. */
+enum ProfileFormat {
+    PROFILE_OFF,   // Don't record anything.
+    PROFILE_TABLE, // A table with the count, total, mean, and max time of each phase and detail.
+    PROFILE_TRACE, // Chrome trace event JSON, for chrome://tracing or https://ui.perfetto.dev.
+};
+
+/** The longest detail that is kept, including the terminating null character. */
+#define PROFILE_DETAIL_LEN 32
+
+/** A span that has been started, pass it to profile_end() when the phase is done. */
+typedef struct ProfileSpan {
+    char const *name;
+    char const *detail;
+    char const *outer_detail;
+    int64_t start_ns;
+    struct AllocCounts start_allocs;
+} ProfileSpan;
+
+/** Start recording spans, and counting allocations if that's available.
+ *
+ * This must be called before any other threads are started, and only once.
+ */
+void profile_start(enum ProfileFormat format);
+
+/** Start timing a phase.
+ *
+ * \param name is the phase, it must be a string literal or otherwise live until the program ends.
+ * \param detail is what the phase is working on, it is copied when the span ends. If it is
+ * \c NULL, the detail of the enclosing span on this thread is used.
+ */
+ProfileSpan profile_begin(char const *name, char const *detail);
+
+/** Stop timing a phase and record it. */
+void profile_end(ProfileSpan *span);
+
+/** Write the recorded spans and stop profiling.
+ *
+ * Does nothing if profiling wasn't started.
+ *
+ * \param site is the site the report was for, it may be \c NULL.
+ * \param path is the file to write to, if it is \c NULL they go to \c stderr.
+ */
+void profile_finish(char const *site, char const *path);
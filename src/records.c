@@ -0,0 +1,192 @@
+#include "records.h"
+#include "utils.h"
+
+#include <assert.h>
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+/*-------------------------------------------------------------------------------------------------
+ *                                      Formatting Helpers
+ *-----------------------------------------------------------------------------------------------*/
+static void
+format_time(time_t t, size_t buf_len, char buf[buf_len])
+{
+    struct tm t_tm = {0};
+    strftime(buf, buf_len, "%Y-%m-%dT%H:%M:%SZ", gmtime_r(&t, &t_tm));
+}
+
+static void
+write_json_string(char const *str, FILE *out)
+{
+    fputc('"', out);
+    for (char const *c = str; *c; c++) {
+        if (*c == '"' || *c == '\\') {
+            fputc('\\', out);
+            fputc(*c, out);
+        } else if ((unsigned char)*c < 0x20) {
+            fprintf(out, "\\u%04x", (unsigned char)*c);
+        } else {
+            fputc(*c, out);
+        }
+    }
+    fputc('"', out);
+}
+
+/** Write a CSV field, quoting it only if it has a character that needs it. */
+static void
+write_csv_field(char const *str, FILE *out)
+{
+    if (!strpbrk(str, ",\"\r\n")) {
+        fputs(str, out);
+        return;
+    }
+
+    fputc('"', out);
+    for (char const *c = str; *c; c++) {
+        if (*c == '"') {
+            fputc('"', out);
+        }
+        fputc(*c, out);
+    }
+    fputc('"', out);
+}
+
+/*-------------------------------------------------------------------------------------------------
+ *                                       Record Writer
+ *-----------------------------------------------------------------------------------------------*/
+RecordWriter
+record_writer_new(enum OutputFormat format, FILE *out, char const *site, time_t init_time)
+{
+    assert(format == OUTPUT_FORMAT_JSONL || format == OUTPUT_FORMAT_CSV);
+
+    RecordWriter w = {.format = format, .out = out, .site = site};
+    format_time(init_time, sizeof(w.init_time), w.init_time);
+
+    return w;
+}
+
+void
+record_begin(RecordWriter *w, char const *element, time_t valid_time)
+{
+    int num_chars = snprintf(w->element, sizeof(w->element), "%s", element);
+    assert(num_chars < sizeof(w->element));
+    format_time(valid_time, sizeof(w->valid_time), w->valid_time);
+
+    if (w->format == OUTPUT_FORMAT_JSONL) {
+        fputs("{\"site\":", w->out);
+        write_json_string(w->site, w->out);
+        fprintf(w->out, ",\"init_time\":\"%s\",\"element\":", w->init_time);
+        write_json_string(w->element, w->out);
+        fprintf(w->out, ",\"valid_time\":\"%s\"", w->valid_time);
+    }
+}
+
+void
+record_add_value(RecordWriter *w, char const *field, double value)
+{
+    switch (w->format) {
+    case OUTPUT_FORMAT_JSONL:
+        fputc(',', w->out);
+        write_json_string(field, w->out);
+        if (isnan(value)) {
+            fputs(":null", w->out);
+        } else {
+            fprintf(w->out, ":%.6g", value);
+        }
+        break;
+
+    case OUTPUT_FORMAT_CSV:
+        write_csv_field(w->site, w->out);
+        fprintf(w->out, ",%s,", w->init_time);
+        write_csv_field(w->element, w->out);
+        fprintf(w->out, ",%s,", w->valid_time);
+        write_csv_field(field, w->out);
+        if (isnan(value)) {
+            fputs(",\n", w->out);
+        } else {
+            fprintf(w->out, ",%.6g\n", value);
+        }
+        break;
+
+    case OUTPUT_FORMAT_TABLE:
+        assert(false);
+        break;
+    }
+}
+
+void
+record_add_cdf(RecordWriter *w, char const *prefix, CumulativeDistribution const *cdf,
+               size_t num_exc, double const exc_vals[num_exc])
+{
+    static double const pcts[5] = {10.0, 25.0, 50.0, 75.0, 90.0};
+    double pct_vals[5] = {0};
+    cumulative_dist_percentile_values(cdf, 5, pcts, pct_vals);
+
+    double probs[num_exc > 0 ? num_exc : 1];
+    interpolate_probs_of_exceedance(cdf, num_exc, exc_vals, probs);
+
+    char field[64] = {0};
+
+    snprintf(field, sizeof(field), "%spm", prefix);
+    record_add_value(w, field, cumulative_dist_pm_value(cdf));
+
+    for (int i = 0; i < 5; i++) {
+        snprintf(field, sizeof(field), "%sp%.0lf", prefix, pcts[i]);
+        record_add_value(w, field, pct_vals[i]);
+    }
+
+    for (size_t i = 0; i < num_exc; i++) {
+        snprintf(field, sizeof(field), "%spoe_%g", prefix, exc_vals[i]);
+        record_add_value(w, field, probs[i]);
+    }
+}
+
+void
+record_add_scenarios(RecordWriter *w, ScenarioList const *scenarios)
+{
+    char field[64] = {0};
+
+    for (int i = 0; i < scenario_list_len(scenarios); i++) {
+        Scenario const *sc = scenario_list_get(scenarios, i);
+
+        snprintf(field, sizeof(field), "scenario%d_mode", i + 1);
+        record_add_value(w, field, scenario_get_mode(sc));
+        snprintf(field, sizeof(field), "scenario%d_min", i + 1);
+        record_add_value(w, field, scenario_get_minimum(sc));
+        snprintf(field, sizeof(field), "scenario%d_max", i + 1);
+        record_add_value(w, field, scenario_get_maximum(sc));
+        snprintf(field, sizeof(field), "scenario%d_prob", i + 1);
+        record_add_value(w, field, scenario_get_probability(sc) * 100.0);
+    }
+}
+
+void
+record_end(RecordWriter *w)
+{
+    if (w->format == OUTPUT_FORMAT_JSONL) {
+        fputs("}\n", w->out);
+    }
+}
+
+void
+records_write_cdfs(RecordWriter *w, char const *element, TimeSeries const *cdfs, size_t num_exc,
+                   double const exc_vals[num_exc])
+{
+    for (size_t i = 0; i < time_series_len(cdfs); i++) {
+        record_begin(w, element, time_series_time(cdfs, i));
+        record_add_cdf(w, "", time_series_value(cdfs, i), num_exc, exc_vals);
+        record_end(w);
+    }
+}
+
+void
+records_write_scenarios(RecordWriter *w, char const *element, TimeSeries const *scenarios)
+{
+    for (size_t i = 0; i < time_series_len(scenarios); i++) {
+        record_begin(w, element, time_series_time(scenarios, i));
+        record_add_scenarios(w, time_series_value(scenarios, i));
+        record_end(w);
+    }
+}
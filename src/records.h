@@ -0,0 +1,91 @@
+#pragma once
+
+#include <stdio.h>
+#include <time.h>
+
+#include "distributions.h"
+#include "options.h"
+#include "time_series.h"
+
+/*-------------------------------------------------------------------------------------------------
+ *                                    Machine Readable Records
+ *-----------------------------------------------------------------------------------------------*/
+/** Writes summaries as records meant for other programs instead of tables.
+ *
+ * There is one record for each valid time of a summary. Every record has the site, the model
+ * initialization time, the element that was summarized, and the valid time, followed by named
+ * values.
+ *
+ * With \c OUTPUT_FORMAT_JSONL each record is a JSON object on a single line. With
+ * \c OUTPUT_FORMAT_CSV each value is a row with the columns in \ref RECORDS_CSV_HEADER, so every
+ * summary has the same columns. Times are ISO 8601 in UTC and missing values are \c null in JSON
+ * and empty in CSV.
+ *
+ * Values are in the same units as the tables and they are not rounded. Probabilities, including
+ * those of the scenarios, are in percent.
+ */
+typedef struct RecordWriter {
+    enum OutputFormat format;
+    FILE *out;
+    char const *site;
+    char init_time[32];
+    char element[32];
+    char valid_time[32];
+} RecordWriter;
+
+/** The first line of CSV output. */
+#define RECORDS_CSV_HEADER "site,init_time,element,valid_time,field,value\n"
+
+/** Create a writer for the records of one site and model run.
+ *
+ * \param format must be \c OUTPUT_FORMAT_JSONL or \c OUTPUT_FORMAT_CSV.
+ * \param out is where to write the records.
+ * \param site is an alias that must live as long as the writer.
+ * \param init_time is the initialization time of the model run.
+ */
+RecordWriter record_writer_new(enum OutputFormat format, FILE *out, char const *site,
+                               time_t init_time);
+
+/** Start a record, it must be finished with record_end().
+ *
+ * \param w is the writer.
+ * \param element is the name of the summary the record belongs to, e.g. \c precip_24h.
+ * \param valid_time is the valid time of the record.
+ */
+void record_begin(RecordWriter *w, char const *element, time_t valid_time);
+
+/** Add a named value to the current record. \c NAN is written as a missing value. */
+void record_add_value(RecordWriter *w, char const *field, double value);
+
+/** Add the probability matched value, the 10th, 25th, 50th, 75th, and 90th percentiles, and the
+ * probabilities of exceedance of a CDF to the current record.
+ *
+ * The fields are \c pm, \c p10 through \c p90, and \c poe_ followed by the threshold, all preceded
+ * by \a prefix.
+ *
+ * \param w is the writer.
+ * \param prefix is added to the start of every field name, it may be an empty string.
+ * \param cdf is the distribution.
+ * \param num_exc is the number of thresholds in \a exc_vals.
+ * \param exc_vals are the thresholds to get the probabilities of exceedance for, in ascending
+ * order.
+ */
+void record_add_cdf(RecordWriter *w, char const *prefix, CumulativeDistribution const *cdf,
+                    size_t num_exc, double const exc_vals[num_exc]);
+
+/** Add the mode, minimum, maximum, and probability of each scenario to the current record.
+ *
+ * The fields are \c scenario1_mode, \c scenario1_min, \c scenario1_max, \c scenario1_prob and so
+ * on for every scenario in the list, the most likely scenario is first.
+ */
+void record_add_scenarios(RecordWriter *w, ScenarioList const *scenarios);
+
+/** Finish the current record. */
+void record_end(RecordWriter *w);
+
+/** Write a record with \ref record_add_cdf() for each CDF in a \c TimeSeries. */
+void records_write_cdfs(RecordWriter *w, char const *element, TimeSeries const *cdfs,
+                        size_t num_exc, double const exc_vals[num_exc]);
+
+/** Write a record with \ref record_add_scenarios() for each list in a \c TimeSeries. */
+void records_write_scenarios(RecordWriter *w, char const *element, TimeSeries const *scenarios);
@@ -0,0 +1,552 @@
+#include "report.h"
+
+#include <math.h>
+
+#include "cache.h"
+#include "daily_summary.h"
+#include "data_source.h"
+#include "dist_archive.h"
+#include "hourly.h"
+#include "ice_summary.h"
+#include "metrics.h"
+#include "parallel.h"
+#include "profile.h"
+#include "records.h"
+
+/*-------------------------------------------------------------------------------------------------
+ *                                    Quality checks/alerts.
+ *-----------------------------------------------------------------------------------------------*/
+static void
+alert_age(time_t init_time, FILE *out)
+{
+    double age_secs = difftime(time(0), init_time);
+    int age_hrs = (int)round(age_secs / 3600.0);
+
+    if (age_hrs >= 12) {
+        int age_days = age_hrs / 24;
+        age_hrs -= age_days * 24;
+
+        fprintf(out, "     *\n");
+        fprintf(out, "     * OLD NBM DATA - data is: ");
+        if (age_days > 1) {
+            fprintf(out, "%d days and", age_days);
+        } else if (age_days > 0) {
+            fprintf(out, "%d day and", age_days);
+        }
+        if (age_hrs > 1) {
+            fprintf(out, " %d hours old", age_hrs);
+        } else if (age_hrs > 0) {
+            fprintf(out, " %d hour old", age_hrs);
+        }
+        fprintf(out, "\n");
+        fprintf(out, "     *\n");
+    }
+}
+
+static void
+write_alerts(time_t init_time, struct OptArgs const *opt_args, FILE *out)
+{
+    // Other programs reading records don't expect anything else in the output.
+    if (opt_args->format != OUTPUT_FORMAT_TABLE) {
+        return;
+    }
+
+    // Check the time we requested data for, if it is more than an hour ago, don't bother alerting
+    // for the age, since we are probably requesting an archived run and not the most recent. If
+    // it is more recent than an hour, we probably requested the most recent run and should be
+    // alerted if it is too old.
+    if (difftime(time(0), opt_args->request_time) < 3600.0) {
+        alert_age(init_time, out);
+    }
+}
+
+/*-------------------------------------------------------------------------------------------------
+ *                                    Main Output
+ *-----------------------------------------------------------------------------------------------*/
+/** The parts of a report that can be built and written independently of each other. */
+enum SectionType {
+    SECTION_DAILY_SUMMARY,
+    SECTION_HOURLY,
+    SECTION_TEMPERATURE,
+    SECTION_PRECIP,
+    SECTION_SNOW,
+    SECTION_ICE,
+    SECTION_WIND,
+    SECTION_GUST,
+};
+
+/** Daily, hourly, temperature, wind, and gust, plus precip, snow, and ice for each period. */
+#define MAX_SECTIONS (5 + 3 * 4)
+
+/** A part of a report and the text written for it. */
+struct Section {
+    enum SectionType type;
+    int accum_hours;
+    int same_as; // Index of an earlier section with the same output, or -1.
+    char *text;
+    size_t size;
+};
+
+static void
+write_section(SiteData *sd, struct OptArgs const *opt_args, struct Section const *section,
+              FILE *out)
+{
+    NBMData const *nbm = site_data_nbm(sd);
+
+    // Records are written straight from the summaries instead of the tables.
+    RecordWriter records = {0};
+    RecordWriter *w = 0;
+    if (opt_args->format != OUTPUT_FORMAT_TABLE) {
+        records = record_writer_new(opt_args->format, out, nbm_data_site_id(nbm),
+                                    nbm_data_init_time(nbm));
+        w = &records;
+    }
+
+    // Saving and archiving write the scenarios too.
+    bool const save = opt_args->save_dir != 0;
+
+    switch (section->type) {
+    case SECTION_DAILY_SUMMARY:
+        if (w) {
+            daily_summary_write_records(nbm, w);
+        } else {
+            show_daily_summary(nbm, out);
+        }
+        break;
+
+    case SECTION_HOURLY:
+        if (w) {
+            hourly_write_records(nbm, w);
+        } else {
+            show_hourly(nbm, out);
+        }
+        break;
+
+    case SECTION_TEMPERATURE: {
+        TempSum *tsum = site_data_temp_sum(sd, opt_args->show_temperature_scenarios || save);
+
+        if (w) {
+            temp_sum_write_records(tsum, opt_args->show_temperature,
+                                   opt_args->show_temperature_scenarios, w);
+        } else {
+            if (opt_args->show_temperature) {
+                show_temp_summary(tsum, out);
+            }
+            if (opt_args->show_temperature_scenarios) {
+                show_temp_scenarios(tsum, out);
+            }
+        }
+
+        if (opt_args->save_dir && !opt_args->save_binary) {
+            temp_sum_save(tsum, opt_args->save_dir, opt_args->save_prefix);
+        }
+    } break;
+
+    case SECTION_PRECIP: {
+        PrecipSum *psum = site_data_precip_sum(sd, section->accum_hours,
+                                               opt_args->show_precip_scenarios || save);
+
+        if (w) {
+            precip_sum_write_records(psum, opt_args->show_rain, opt_args->show_precip_scenarios,
+                                     w);
+        } else {
+            if (opt_args->show_rain) {
+                show_precip_summary(psum, out);
+            }
+
+            if (opt_args->show_precip_scenarios) {
+                show_precip_scenarios(psum, out);
+            }
+        }
+
+        if (opt_args->save_dir && !opt_args->save_binary) {
+            precip_sum_save(psum, opt_args->save_dir, opt_args->save_prefix);
+        }
+    } break;
+
+    case SECTION_SNOW: {
+        SnowSum *ssum =
+            site_data_snow_sum(sd, section->accum_hours, opt_args->show_snow_scenarios || save);
+
+        if (w) {
+            snow_sum_write_records(ssum, opt_args->show_snow, opt_args->show_snow_scenarios, w);
+        } else {
+            if (opt_args->show_snow) {
+                show_snow_summary(ssum, out);
+            }
+
+            if (opt_args->show_snow_scenarios) {
+                show_snow_scenarios(ssum, out);
+            }
+        }
+
+        if (opt_args->save_dir && !opt_args->save_binary) {
+            snow_sum_save(ssum, opt_args->save_dir, opt_args->save_prefix);
+        }
+    } break;
+
+    case SECTION_ICE:
+        if (w) {
+            ice_summary_write_records(nbm, section->accum_hours, w);
+        } else {
+            show_ice_summary(nbm, section->accum_hours, out);
+        }
+        break;
+
+    case SECTION_WIND: {
+        WindSum *wsum = site_data_wind_sum(sd, opt_args->show_wind_scenarios || save);
+
+        if (w) {
+            wind_sum_write_records(wsum, opt_args->show_wind, opt_args->show_wind_scenarios, w);
+        } else {
+            if (opt_args->show_wind) {
+                show_wind_summary(wsum, out);
+            }
+            if (opt_args->show_wind_scenarios) {
+                show_wind_scenarios(wsum, out);
+            }
+        }
+
+        if (opt_args->save_dir && !opt_args->save_binary) {
+            wind_sum_save(wsum, opt_args->save_dir, opt_args->save_prefix);
+        }
+    } break;
+
+    case SECTION_GUST: {
+        GustSum *gsum = site_data_gust_sum(sd, opt_args->show_gust_scenarios || save);
+
+        if (w) {
+            gust_sum_write_records(gsum, opt_args->show_gust, opt_args->show_gust_scenarios, w);
+        } else {
+            if (opt_args->show_gust) {
+                show_gust_summary(gsum, out);
+            }
+            if (opt_args->show_gust_scenarios) {
+                show_gust_scenarios(gsum, out);
+            }
+        }
+
+        if (opt_args->save_dir && !opt_args->save_binary) {
+            gust_sum_save(gsum, opt_args->save_dir, opt_args->save_prefix);
+        }
+    } break;
+    }
+}
+
+static void
+add_section(int *num_sections, struct Section sections[MAX_SECTIONS], enum SectionType type,
+            int accum_hours)
+{
+    assert(*num_sections < MAX_SECTIONS);
+
+    // Two sections for the same summary would write the same text, so repeat the output of the
+    // first one instead.
+    int same_as = -1;
+    for (int i = 0; i < *num_sections; i++) {
+        if (sections[i].type == type && sections[i].accum_hours == accum_hours) {
+            same_as = i;
+            break;
+        }
+    }
+
+    sections[*num_sections] = (struct Section){
+        .type = type, .accum_hours = accum_hours, .same_as = same_as, .text = 0, .size = 0};
+    (*num_sections)++;
+}
+
+/** List the sections of a report in the order they are written. */
+static int
+plan_sections(struct OptArgs const *opt_args, struct Section sections[MAX_SECTIONS])
+{
+    int num_sections = 0;
+
+    if (opt_args->show_summary)
+        add_section(&num_sections, sections, SECTION_DAILY_SUMMARY, 0);
+
+    if (opt_args->show_hourly)
+        add_section(&num_sections, sections, SECTION_HOURLY, 0);
+
+    if (opt_args->show_temperature || opt_args->show_temperature_scenarios) {
+        add_section(&num_sections, sections, SECTION_TEMPERATURE, 0);
+    }
+
+    int const max_accum_periods = sizeof(opt_args->accum_hours) / sizeof(opt_args->accum_hours[0]);
+    for (int i = 0; i < max_accum_periods && opt_args->accum_hours[i]; i++) {
+        int accum_hours = opt_args->accum_hours[i];
+
+        if (opt_args->show_rain || opt_args->show_precip_scenarios) {
+            add_section(&num_sections, sections, SECTION_PRECIP, accum_hours);
+        }
+
+        if (opt_args->show_snow || opt_args->show_snow_scenarios) {
+            add_section(&num_sections, sections, SECTION_SNOW, accum_hours);
+        }
+
+        if (opt_args->show_ice) {
+            add_section(&num_sections, sections, SECTION_ICE, accum_hours);
+        }
+    }
+
+    if (opt_args->show_wind || opt_args->show_wind_scenarios) {
+        add_section(&num_sections, sections, SECTION_WIND, 0);
+    }
+
+    if (opt_args->show_gust || opt_args->show_gust_scenarios) {
+        add_section(&num_sections, sections, SECTION_GUST, 0);
+    }
+
+    return num_sections;
+}
+
+/** Save the distributions of every summary in the report to one binary file.
+ *
+ * This is done after the sections are written, so every summary it needs was already built.
+ */
+static void
+save_archive(SiteData *sd, struct OptArgs const *opt_args, int num_sections,
+             struct Section const sections[num_sections])
+{
+    NBMData const *nbm = site_data_nbm(sd);
+    char const *site_id = nbm_data_site_id(nbm);
+    time_t init_time = nbm_data_init_time(nbm);
+
+    char init_buf[16] = {0};
+    struct tm init_tm = {0};
+    strftime(init_buf, sizeof(init_buf), "%Y%m%d%H", gmtime_r(&init_time, &init_tm));
+
+    char const *prefix = opt_args->save_prefix ? opt_args->save_prefix : "";
+    char const *sep = opt_args->save_prefix ? "_" : "";
+
+    char *path = 0;
+    int retcode = asprintf(&path, "%s/%s%s%s_%s.nbmdist", opt_args->save_dir, prefix, sep, site_id,
+                           init_buf);
+    Stopif(retcode < 0, exit(EXIT_FAILURE), "out of memory");
+
+    DistArchiveWriter *writer = dist_archive_writer_new(site_id, init_time);
+
+    for (int i = 0; i < num_sections; i++) {
+        struct Section const *section = &sections[i];
+        if (section->same_as >= 0) {
+            continue;
+        }
+
+        switch (section->type) {
+        case SECTION_TEMPERATURE:
+            temp_sum_archive(site_data_temp_sum(sd, true), writer);
+            break;
+        case SECTION_PRECIP:
+            precip_sum_archive(site_data_precip_sum(sd, section->accum_hours, true), writer);
+            break;
+        case SECTION_SNOW:
+            snow_sum_archive(site_data_snow_sum(sd, section->accum_hours, true), writer);
+            break;
+        case SECTION_WIND:
+            wind_sum_archive(site_data_wind_sum(sd, true), writer);
+            break;
+        case SECTION_GUST:
+            gust_sum_archive(site_data_gust_sum(sd, true), writer);
+            break;
+        case SECTION_DAILY_SUMMARY:
+        case SECTION_HOURLY:
+        case SECTION_ICE:
+            // These don't keep any distributions.
+            break;
+        }
+    }
+
+    dist_archive_writer_close(&writer, path);
+    free(path);
+}
+
+/** Name a section after what it summarizes, like the elements in the records and archives. */
+static void
+section_name(struct Section const *section, size_t buf_len, char buf[buf_len])
+{
+    switch (section->type) {
+    case SECTION_DAILY_SUMMARY:
+        snprintf(buf, buf_len, "daily_summary");
+        break;
+    case SECTION_HOURLY:
+        snprintf(buf, buf_len, "hourly");
+        break;
+    case SECTION_TEMPERATURE:
+        snprintf(buf, buf_len, "temperature");
+        break;
+    case SECTION_PRECIP:
+        snprintf(buf, buf_len, "precip_%dh", section->accum_hours);
+        break;
+    case SECTION_SNOW:
+        snprintf(buf, buf_len, "snow_%dh", section->accum_hours);
+        break;
+    case SECTION_ICE:
+        snprintf(buf, buf_len, "ice_%dh", section->accum_hours);
+        break;
+    case SECTION_WIND:
+        snprintf(buf, buf_len, "wind");
+        break;
+    case SECTION_GUST:
+        snprintf(buf, buf_len, "gust");
+        break;
+    }
+}
+
+struct WriteSectionsData {
+    SiteData *sd;
+    struct OptArgs const *opt_args;
+    struct Section *sections;
+};
+
+static void
+write_section_task(size_t index, int worker, void *user_data)
+{
+    struct WriteSectionsData *data = user_data;
+    struct Section *section = &data->sections[index];
+
+    if (section->same_as >= 0) {
+        return;
+    }
+
+    char name[PROFILE_DETAIL_LEN] = {0};
+    section_name(section, sizeof(name), name);
+    ProfileSpan span = profile_begin("section", name);
+    double start = metrics_now();
+
+    FILE *mem = open_memstream(&section->text, &section->size);
+    Stopif(!mem, exit(EXIT_FAILURE), "out of memory");
+
+    write_section(data->sd, data->opt_args, section, mem);
+    fclose(mem);
+
+    metrics_element_build(name, metrics_now() - start);
+    profile_end(&span);
+}
+
+/** Write all the requested summaries.
+ *
+ * Every summary only reads the site's data, so the sections are built and written to memory
+ * concurrently, then copied to \a out in order.
+ */
+static void
+write_summaries(SiteData *sd, struct OptArgs opt_args, FILE *out)
+{
+    struct Section sections[MAX_SECTIONS] = {0};
+    int num_sections = plan_sections(&opt_args, sections);
+
+    struct WriteSectionsData data = {.sd = sd, .opt_args = &opt_args, .sections = sections};
+    parallel_for(num_sections, write_section_task, &data);
+
+    // Every section has the same columns, so there is only one header.
+    if (opt_args.format == OUTPUT_FORMAT_CSV) {
+        fputs(RECORDS_CSV_HEADER, out);
+    }
+
+    for (int i = 0; i < num_sections; i++) {
+        struct Section const *src = sections[i].same_as >= 0 ? &sections[sections[i].same_as]
+                                                              : &sections[i];
+        fwrite(src->text, 1, src->size, out);
+    }
+
+    if (opt_args.save_dir && opt_args.save_binary) {
+        ProfileSpan span = profile_begin("save_archive", 0);
+        save_archive(sd, &opt_args, num_sections, sections);
+        profile_end(&span);
+    }
+
+    for (int i = 0; i < num_sections; i++) {
+        free(sections[i].text);
+    }
+}
+
+/*-------------------------------------------------------------------------------------------------
+ *                                   Rendered Report Cache
+ *-----------------------------------------------------------------------------------------------*/
+/** Change this whenever the output changes so old reports in the cache aren't used. */
+#define REPORT_CACHE_VERSION 2
+
+/** Everything but the alerts only depends on the data and these options, so the rendered text
+ * can be reused. Saving files is a side effect the cache can't replay, and reports are only cached
+ * when the downloads are, e.g. files in a local archive can change under us.
+ */
+static bool
+report_is_cacheable(struct OptArgs const *opt_args)
+{
+    return !opt_args->save_dir && data_source_uses_cache();
+}
+
+/** Make a string that identifies the options that affect the report. */
+static void
+make_options_key(struct OptArgs const *opt, size_t buf_len, char buf[buf_len])
+{
+    int num_chars = snprintf(
+        buf, buf_len, "v%d %d%d%d%d%d%d%d%d %d%d%d%d%d a%d,%d,%d,%d f%d", REPORT_CACHE_VERSION,
+        opt->show_summary, opt->show_hourly, opt->show_rain, opt->show_snow, opt->show_ice,
+        opt->show_temperature, opt->show_wind, opt->show_gust, opt->show_temperature_scenarios,
+        opt->show_precip_scenarios, opt->show_snow_scenarios, opt->show_wind_scenarios,
+        opt->show_gust_scenarios, opt->accum_hours[0], opt->accum_hours[1], opt->accum_hours[2],
+        opt->accum_hours[3], opt->format);
+    assert(num_chars < buf_len);
+}
+
+bool
+report_write_cached(char const *site_id, time_t init_time, struct OptArgs opt_args, FILE *out)
+{
+    if (!report_is_cacheable(&opt_args)) {
+        return false;
+    }
+
+    char key[64] = {0};
+    make_options_key(&opt_args, sizeof(key), key);
+
+    ProfileSpan span = profile_begin("report_cache_retrieve", site_id);
+    struct TextBuffer buf = cache_retrieve_report(site_id, init_time, key);
+    profile_end(&span);
+    metrics_cache_lookup(METRICS_CACHE_REPORTS, !text_buffer_is_empty(buf), buf.size);
+    if (text_buffer_is_empty(buf)) {
+        return false;
+    }
+
+    write_alerts(init_time, &opt_args, out);
+    fwrite(buf.text_data, 1, buf.size - 1, out); // Don't write the terminating null character.
+
+    text_buffer_clear(&buf);
+
+    return true;
+}
+
+void
+report_write(SiteData *sd, struct OptArgs opt_args, FILE *out)
+{
+    NBMData const *nbm = site_data_nbm(sd);
+    write_alerts(nbm_data_init_time(nbm), &opt_args, out);
+
+    char *text = 0;
+    size_t size = 0;
+    FILE *mem = 0;
+    if (report_is_cacheable(&opt_args)) {
+        mem = open_memstream(&text, &size);
+    }
+
+    if (!mem) {
+        write_summaries(sd, opt_args, out);
+        return;
+    }
+
+    write_summaries(sd, opt_args, mem);
+    fclose(mem);
+
+    fwrite(text, 1, size, out);
+
+    // The memory stream always adds a terminating null character.
+    struct TextBuffer buf = {.text_data = text, .size = size + 1, .capacity = size + 1};
+
+    char key[64] = {0};
+    make_options_key(&opt_args, sizeof(key), key);
+    ProfileSpan span = profile_begin("report_cache_add", nbm_data_site_id(nbm));
+    int cache_res = cache_add_report(nbm_data_site_id(nbm), nbm_data_init_time(nbm), key, &buf);
+    profile_end(&span);
+    if (cache_res == 0) {
+        metrics_cache_store(METRICS_CACHE_REPORTS, buf.size);
+    }
+
+    text_buffer_clear(&buf);
+}
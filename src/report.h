@@ -0,0 +1,31 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stdio.h>
+#include <time.h>
+
+#include "options.h"
+#include "site_cache.h"
+
+/** Write a report from the cache of rendered reports, if it is there.
+ *
+ * This skips parsing the data and building the summaries entirely.
+ *
+ * \param site_id is the site the report is for.
+ * \param init_time is the model initialization time of the data for the report.
+ * \param opt_args are the options that select which summaries to show and save.
+ * \param out is where to write the report, usually \c stdout.
+ *
+ * \returns \c true if the report was written.
+ */
+bool report_write_cached(char const *site_id, time_t init_time, struct OptArgs opt_args, FILE *out);
+
+/** Write the report for a site as requested on the command line.
+ *
+ * When possible, the rendered report is also stored in the cache for \c report_write_cached().
+ *
+ * \param sd is the data to summarize. Any summaries it needs are built and kept in it.
+ * \param opt_args are the options that select which summaries to show and save.
+ * \param out is where to write the report, usually \c stdout.
+ */
+void report_write(SiteData *sd, struct OptArgs opt_args, FILE *out);
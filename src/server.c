@@ -0,0 +1,404 @@
+#include "server.h"
+
+#include <errno.h>
+#include <poll.h>
+#include <signal.h>
+#include <stdint.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <sys/un.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <glib.h>
+
+#include "metrics.h"
+#include "nbm_data.h"
+#include "options.h"
+#include "report.h"
+#include "site_cache.h"
+#include "site_validation.h"
+#include "utils.h"
+
+/*
+ * A request is the command line arguments for the report, each terminated by a '\0', followed by
+ * an empty argument. The client then shuts down its side of the connection.
+ *
+ * The response is a single status byte, 0 for success, followed by the text of the report. The
+ * server closes the connection when it's done.
+ */
+
+/** The most arguments a request may have. */
+#define MAX_REQUEST_ARGS 64
+
+/** The largest request the server will read. */
+#define MAX_REQUEST_BYTES (16 * 1024)
+
+/** How long a client has to send the whole request, and to take each part of the response.
+ *
+ * A client that takes longer is dropped, so idle connections can't tie up the workers.
+ */
+#define CLIENT_TIMEOUT_MS 5000
+
+/*-------------------------------------------------------------------------------------------------
+ *                                      Socket Helpers
+ *-----------------------------------------------------------------------------------------------*/
+static bool
+make_socket_address(char const socket_path[static 1], struct sockaddr_un *addr)
+{
+    *addr = (struct sockaddr_un){.sun_family = AF_UNIX};
+    Stopif(strlen(socket_path) >= sizeof(addr->sun_path), return false,
+           "Socket path too long: %s", socket_path);
+
+    strcpy(addr->sun_path, socket_path);
+    return true;
+}
+
+static bool
+write_all(int fd, size_t num_bytes, char const data[num_bytes])
+{
+    while (num_bytes > 0) {
+        ssize_t num_written = write(fd, data, num_bytes);
+        if (num_written < 0 && errno == EINTR) {
+            continue;
+        }
+        Stopif(num_written < 0, return false, "Error writing to socket: %s", strerror(errno));
+
+        data += num_written;
+        num_bytes -= num_written;
+    }
+
+    return true;
+}
+
+static int64_t
+now_ms(void)
+{
+    struct timespec ts = {0};
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+/** Read until the other side shuts down its end of the connection, or \a max_bytes are read.
+ *
+ * \param timeout_ms is how long the other side has to finish, or -1 to wait as long as it takes.
+ *
+ * \returns \c false if there was an error or the other side didn't finish in time.
+ */
+static bool
+read_all(int fd, size_t max_bytes, int timeout_ms, struct ByteBuffer buf[static 1])
+{
+    int64_t const deadline = now_ms() + timeout_ms;
+
+    while (buf->size < max_bytes) {
+        if (byte_buffer_remaining_capacity(buf) == 0) {
+            byte_buffer_set_capacity(buf, 2 * buf->capacity);
+        }
+
+        int64_t time_left = timeout_ms < 0 ? -1 : deadline - now_ms();
+        Stopif(timeout_ms >= 0 && time_left <= 0, return false, "Timed out reading.");
+
+        struct pollfd pfd = {.fd = fd, .events = POLLIN};
+        int ready = poll(&pfd, 1, (int)time_left);
+        if (ready < 0 && errno == EINTR) {
+            continue;
+        }
+        Stopif(ready < 0, return false, "Error waiting for request: %s", strerror(errno));
+        if (ready == 0) {
+            continue; // Out of time, caught at the top of the loop.
+        }
+
+        ssize_t num_read =
+            read(fd, byte_buffer_next_write_pos(buf), byte_buffer_remaining_capacity(buf));
+        if (num_read < 0 && errno == EINTR) {
+            continue;
+        }
+        Stopif(num_read < 0, return false, "Error reading from socket: %s", strerror(errno));
+
+        if (num_read == 0) {
+            break;
+        }
+
+        byte_buffer_increase_size(buf, num_read);
+    }
+
+    return true;
+}
+
+/*-------------------------------------------------------------------------------------------------
+ *                                     Handling Requests
+ *-----------------------------------------------------------------------------------------------*/
+/** Split a request into an argument vector, with a program name first like a command line.
+ *
+ * \returns the number of arguments, or -1 if the request was malformed.
+ */
+static int
+split_request(struct ByteBuffer const request[static 1], char *argv[MAX_REQUEST_ARGS + 2])
+{
+    static char program_name[] = "nbm";
+
+    argv[0] = program_name;
+    int argc = 1;
+
+    size_t pos = 0;
+    while (pos < request->size) {
+        char *arg = (char *)&request->data[pos];
+        size_t len = strnlen(arg, request->size - pos);
+        Stopif(pos + len == request->size, return -1, "Unterminated argument in request.");
+
+        if (len == 0) {
+            // The empty argument marks the end.
+            argv[argc] = 0;
+            return argc;
+        }
+
+        Stopif(argc > MAX_REQUEST_ARGS, return -1, "Too many arguments in request.");
+        argv[argc++] = arg;
+        pos += len + 1;
+    }
+
+    Stopif(true, return -1, "Incomplete request.");
+}
+
+/** Make the report for a request.
+ *
+ * \returns the exit code a command line program would have returned.
+ */
+static int
+make_report(int argc, char *argv[argc + 1], FILE *out)
+{
+    int exit_code = EXIT_FAILURE;
+    SiteValidation *validation = 0;
+    SiteData *sd = 0;
+
+    struct OptArgs opt_args = parse_request(argc, argv);
+    if (opt_args.error_parsing_options) {
+        fprintf(out, "\nError parsing request.\n");
+        goto EXIT_ERR;
+    }
+
+    validation = site_validation_create(opt_args.site, opt_args.request_time);
+    if (site_validation_failed(validation)) {
+        site_validation_print_failure_message(validation, out);
+        goto EXIT_ERR;
+    }
+
+    char const *file_name = site_validation_file_name_alias(validation);
+    time_t init_time = site_validation_init_time(validation);
+
+    if (report_write_cached(site_validation_site_id_alias(validation), init_time, opt_args, out)) {
+        exit_code = EXIT_SUCCESS;
+        goto EXIT_ERR;
+    }
+
+    sd = site_cache_checkout(file_name, init_time);
+    if (!sd) {
+        NBMData *nbm = retrieve_data(validation);
+        if (!nbm) {
+            fprintf(out, "\nError retrieving data for %s.\n", opt_args.site);
+            goto EXIT_ERR;
+        }
+
+        sd = site_cache_add(file_name, init_time, nbm);
+    }
+
+    report_write(sd, opt_args, out);
+
+    exit_code = EXIT_SUCCESS;
+
+EXIT_ERR:
+    if (sd) {
+        site_cache_checkin(&sd);
+    }
+    site_validation_free(&validation);
+    opt_args_clear(&opt_args);
+
+    return exit_code;
+}
+
+/** Thread pool function to answer a request.
+ *
+ * \param data is the connected socket plus one, because the pool doesn't take \c NULL tasks.
+ */
+static void
+handle_request(void *data, void *unused)
+{
+    int fd = GPOINTER_TO_INT(data) - 1;
+
+    char *argv[MAX_REQUEST_ARGS + 2] = {0};
+    char *response = 0;
+    size_t response_size = 0;
+
+    struct ByteBuffer request = byte_buffer_with_capacity(4096);
+
+    // A client that doesn't take its response in time is dropped too.
+    struct timeval send_timeout = {.tv_sec = CLIENT_TIMEOUT_MS / 1000,
+                                   .tv_usec = (CLIENT_TIMEOUT_MS % 1000) * 1000};
+    setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &send_timeout, sizeof(send_timeout));
+
+    if (!read_all(fd, MAX_REQUEST_BYTES, CLIENT_TIMEOUT_MS, &request)) {
+        goto CLOSE;
+    }
+
+    FILE *out = open_memstream(&response, &response_size);
+    Stopif(!out, goto CLOSE, "Unable to open memory stream: %s", strerror(errno));
+
+    int argc = split_request(&request, argv);
+    int exit_code = EXIT_FAILURE;
+    if (argc < 0) {
+        fprintf(out, "\nMalformed request.\n");
+    } else {
+        exit_code = make_report(argc, argv, out);
+    }
+
+    fclose(out);
+
+    char status = exit_code == EXIT_SUCCESS ? 0 : 1;
+    if (write_all(fd, 1, &status)) {
+        write_all(fd, response_size, response);
+    }
+
+CLOSE:
+    free(response);
+    byte_buffer_clear(&request);
+    close(fd);
+}
+
+/*-------------------------------------------------------------------------------------------------
+ *                                      Signal Handling
+ *-----------------------------------------------------------------------------------------------*/
+/** Set when it is time to shut down. */
+static volatile sig_atomic_t stop_requested = 0;
+
+static void
+handle_stop_signal(int signum)
+{
+    stop_requested = 1;
+}
+
+static void
+install_signal_handlers(void)
+{
+    struct sigaction action = {.sa_handler = handle_stop_signal};
+    sigemptyset(&action.sa_mask);
+
+    sigaction(SIGINT, &action, 0);
+    sigaction(SIGTERM, &action, 0);
+
+    // A client that goes away shouldn't take the server with it.
+    signal(SIGPIPE, SIG_IGN);
+}
+
+/*-------------------------------------------------------------------------------------------------
+ *                                        Public API
+ *-----------------------------------------------------------------------------------------------*/
+int
+server_run(char const *socket_path, int memory_limit_mb)
+{
+    assert(socket_path);
+
+    int listen_fd = -1;
+    GThreadPool *pool = 0;
+
+    struct sockaddr_un addr = {0};
+    Stopif(!make_socket_address(socket_path, &addr), return 1, "Invalid socket path.");
+
+    listen_fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    Stopif(listen_fd < 0, return 1, "Unable to create socket: %s", strerror(errno));
+
+    // Clean up after a server that didn't shut down cleanly.
+    unlink(socket_path);
+
+    int res = bind(listen_fd, (struct sockaddr *)&addr, sizeof(addr));
+    Stopif(res != 0, goto ERR_RETURN, "Unable to bind %s: %s", socket_path, strerror(errno));
+
+    res = listen(listen_fd, SOMAXCONN);
+    Stopif(res != 0, goto ERR_RETURN, "Unable to listen on %s: %s", socket_path, strerror(errno));
+
+    pool = g_thread_pool_new(handle_request, 0, g_get_num_processors(), false, 0);
+    Stopif(!pool, goto ERR_RETURN, "Unable to create thread pool.");
+
+    site_cache_initialize((size_t)memory_limit_mb * 1024 * 1024);
+    site_validation_keep_locations();
+    install_signal_handlers();
+
+    while (!stop_requested) {
+        // Keep the metrics file current for scraping, it's only rewritten if something changed.
+        metrics_write();
+
+        // Wake up now and then to check if it's time to stop.
+        struct pollfd pfd = {.fd = listen_fd, .events = POLLIN};
+        if (poll(&pfd, 1, 1000) <= 0) {
+            continue;
+        }
+
+        int fd = accept(listen_fd, 0, 0);
+        if (fd < 0) {
+            Stopif(errno != EINTR && errno != ECONNABORTED, break, "Error accepting connection: %s",
+                   strerror(errno));
+            continue;
+        }
+
+        g_thread_pool_push(pool, GINT_TO_POINTER(fd + 1), 0);
+    }
+
+    // Finish the requests already accepted.
+    g_thread_pool_free(pool, false, true);
+
+    close(listen_fd);
+    unlink(socket_path);
+    site_cache_finalize();
+    site_validation_finalize();
+
+    return 0;
+
+ERR_RETURN:
+    if (pool) {
+        g_thread_pool_free(pool, true, true);
+    }
+    close(listen_fd);
+    return 1;
+}
+
+int
+server_send_request(char const *socket_path, int argc, char *argv[argc + 1], FILE *out)
+{
+    assert(socket_path);
+
+    struct ByteBuffer response = {0};
+
+    struct sockaddr_un addr = {0};
+    Stopif(!make_socket_address(socket_path, &addr), return EXIT_FAILURE, "Invalid socket path.");
+
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    Stopif(fd < 0, return EXIT_FAILURE, "Unable to create socket: %s", strerror(errno));
+
+    int res = connect(fd, (struct sockaddr *)&addr, sizeof(addr));
+    Stopif(res != 0, goto ERR_RETURN, "Unable to connect to %s: %s", socket_path,
+           strerror(errno));
+
+    for (int i = 1; i < argc; i++) {
+        Stopif(!write_all(fd, strlen(argv[i]) + 1, argv[i]), goto ERR_RETURN,
+               "Error sending request.");
+    }
+    Stopif(!write_all(fd, 1, ""), goto ERR_RETURN, "Error sending request.");
+    shutdown(fd, SHUT_WR);
+
+    // Making a report can take a while if the data has to be downloaded first.
+    response = byte_buffer_with_capacity(4096);
+    bool received = read_all(fd, SIZE_MAX, -1, &response);
+    Stopif(!received || response.size == 0, goto ERR_RETURN, "No response from server.");
+
+    int exit_code = response.data[0] == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+    fwrite(&response.data[1], 1, response.size - 1, out);
+
+    byte_buffer_clear(&response);
+    close(fd);
+
+    return exit_code;
+
+ERR_RETURN:
+    byte_buffer_clear(&response);
+    close(fd);
+    return EXIT_FAILURE;
+}
@@ -0,0 +1,31 @@
+#pragma once
+
+#include <stdio.h>
+
+/** Run as a server answering report requests on a Unix domain socket.
+ *
+ * The cache connection, the locations database, and the data and summaries for recently requested
+ * sites are kept in memory between requests, so most of the time spent on a request goes into
+ * making the report. Requests are handled concurrently on a pool of threads. This keeps running
+ * until the process is sent \c SIGINT or \c SIGTERM.
+ *
+ * The data source options given on the server's command line apply to every request.
+ *
+ * \param socket_path is where to create the socket. It is removed when the server shuts down.
+ * \param memory_limit_mb is about how much memory to use keeping recently requested sites.
+ *
+ * \returns 0 on success.
+ */
+int server_run(char const *socket_path, int memory_limit_mb);
+
+/** Ask a server for a report.
+ *
+ * \param socket_path is the socket the server is listening on.
+ * \param argc is the number of arguments in \a argv.
+ * \param argv are the command line arguments for the request, the first one is the program name
+ * and is not sent.
+ * \param out is where to write the report.
+ *
+ * \returns the exit code for the program.
+ */
+int server_send_request(char const *socket_path, int argc, char *argv[argc + 1], FILE *out);
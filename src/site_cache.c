@@ -0,0 +1,371 @@
+#include "site_cache.h"
+
+#include <assert.h>
+#include <stdbool.h>
+#include <stdlib.h>
+
+#include <glib.h>
+
+#include "utils.h"
+
+/*-------------------------------------------------------------------------------------------------
+ *                                          SiteData
+ *-----------------------------------------------------------------------------------------------*/
+#define NUM_ACCUM_PERIODS 5
+static int const accum_periods[NUM_ACCUM_PERIODS] = {6, 12, 24, 48, 72};
+
+/** Internal implementation of \ref SiteData. */
+struct SiteData {
+    NBMData *nbm;
+
+    TempSum *tsum;
+    PrecipSum *psums[NUM_ACCUM_PERIODS];
+    SnowSum *ssums[NUM_ACCUM_PERIODS];
+    WindSum *wsum;
+    GustSum *gsum;
+
+    int ref_count;
+    GMutex lock; // Held while building the summaries.
+
+    // Only used while it is in the cache.
+    char *key;
+    size_t bytes;
+    GList *link;
+};
+
+static int
+accum_period_index(int accum_hours)
+{
+    for (int i = 0; i < NUM_ACCUM_PERIODS; i++) {
+        if (accum_periods[i] == accum_hours) {
+            return i;
+        }
+    }
+
+    assert(false);
+    return -1;
+}
+
+struct SiteData *
+site_data_new(NBMData *nbm)
+{
+    assert(nbm);
+
+    struct SiteData *sd = calloc(1, sizeof(struct SiteData));
+    assert(sd);
+
+    sd->nbm = nbm;
+    sd->ref_count = 1;
+    g_mutex_init(&sd->lock);
+
+    return sd;
+}
+
+void
+site_data_free(struct SiteData **sdptr)
+{
+    struct SiteData *sd = *sdptr;
+    *sdptr = 0;
+
+    if (!sd || !g_atomic_int_dec_and_test(&sd->ref_count)) {
+        return;
+    }
+
+    if (sd->tsum) {
+        temp_sum_free(&sd->tsum);
+    }
+    for (int i = 0; i < NUM_ACCUM_PERIODS; i++) {
+        if (sd->psums[i]) {
+            precip_sum_free(&sd->psums[i]);
+        }
+        if (sd->ssums[i]) {
+            snow_sum_free(&sd->ssums[i]);
+        }
+    }
+    if (sd->wsum) {
+        wind_sum_free(&sd->wsum);
+    }
+    if (sd->gsum) {
+        gust_sum_free(&sd->gsum);
+    }
+
+    nbm_data_free(&sd->nbm);
+    free(sd->key);
+    g_mutex_clear(&sd->lock);
+    free(sd);
+}
+
+NBMData const *
+site_data_nbm(struct SiteData const *sd)
+{
+    return sd->nbm;
+}
+
+TempSum *
+site_data_temp_sum(struct SiteData *sd, bool scenarios)
+{
+    g_mutex_lock(&sd->lock);
+    if (!sd->tsum) {
+        sd->tsum = temp_sum_build(sd->nbm);
+    }
+    temp_sum_prepare(sd->tsum, scenarios);
+    TempSum *tsum = sd->tsum;
+    g_mutex_unlock(&sd->lock);
+
+    return tsum;
+}
+
+PrecipSum *
+site_data_precip_sum(struct SiteData *sd, int accum_hours, bool scenarios)
+{
+    int i = accum_period_index(accum_hours);
+
+    g_mutex_lock(&sd->lock);
+    if (!sd->psums[i]) {
+        sd->psums[i] = precip_sum_build(sd->nbm, accum_hours);
+    }
+    precip_sum_prepare(sd->psums[i], scenarios);
+    PrecipSum *psum = sd->psums[i];
+    g_mutex_unlock(&sd->lock);
+
+    return psum;
+}
+
+SnowSum *
+site_data_snow_sum(struct SiteData *sd, int accum_hours, bool scenarios)
+{
+    int i = accum_period_index(accum_hours);
+
+    g_mutex_lock(&sd->lock);
+    if (!sd->ssums[i]) {
+        sd->ssums[i] = snow_sum_build(sd->nbm, accum_hours);
+    }
+    snow_sum_prepare(sd->ssums[i], scenarios);
+    SnowSum *ssum = sd->ssums[i];
+    g_mutex_unlock(&sd->lock);
+
+    return ssum;
+}
+
+WindSum *
+site_data_wind_sum(struct SiteData *sd, bool scenarios)
+{
+    g_mutex_lock(&sd->lock);
+    if (!sd->wsum) {
+        sd->wsum = wind_sum_build(sd->nbm);
+    }
+    wind_sum_prepare(sd->wsum, scenarios);
+    WindSum *wsum = sd->wsum;
+    g_mutex_unlock(&sd->lock);
+
+    return wsum;
+}
+
+GustSum *
+site_data_gust_sum(struct SiteData *sd, bool scenarios)
+{
+    g_mutex_lock(&sd->lock);
+    if (!sd->gsum) {
+        sd->gsum = gust_sum_build(sd->nbm);
+    }
+    gust_sum_prepare(sd->gsum, scenarios);
+    GustSum *gsum = sd->gsum;
+    g_mutex_unlock(&sd->lock);
+
+    return gsum;
+}
+
+size_t
+site_data_memory_bytes(struct SiteData const *sd)
+{
+    size_t total = sizeof(*sd) + nbm_data_memory_bytes(sd->nbm);
+
+    if (sd->tsum) {
+        total += temp_sum_memory_bytes(sd->tsum);
+    }
+    for (int i = 0; i < NUM_ACCUM_PERIODS; i++) {
+        if (sd->psums[i]) {
+            total += precip_sum_memory_bytes(sd->psums[i]);
+        }
+        if (sd->ssums[i]) {
+            total += snow_sum_memory_bytes(sd->ssums[i]);
+        }
+    }
+    if (sd->wsum) {
+        total += wind_sum_memory_bytes(sd->wsum);
+    }
+    if (sd->gsum) {
+        total += gust_sum_memory_bytes(sd->gsum);
+    }
+
+    return total;
+}
+
+/*-------------------------------------------------------------------------------------------------
+ *                                          SiteCache
+ *-----------------------------------------------------------------------------------------------*/
+/** The cache holds a reference to each \c SiteData in it. */
+static struct {
+    GMutex lock;
+    bool enabled;
+    size_t max_bytes;
+    size_t total_bytes;
+    GHashTable *sites; // Keyed by SiteData.key
+    GQueue lru;        // Most recently used first.
+} cache = {.enabled = false, .max_bytes = 0, .total_bytes = 0, .sites = 0, .lru = G_QUEUE_INIT};
+
+static char *
+make_key(char const file_name[static 1], time_t init_time)
+{
+    char *key = 0;
+    int num_bytes = asprintf(&key, "%s@%lld", file_name, (long long)init_time);
+    Stopif(num_bytes < 0, exit(EXIT_FAILURE), "out of memory");
+
+    return key;
+}
+
+/** Remove the least recently used site. Must be called while holding the lock. */
+static void
+drop_least_recently_used(void)
+{
+    struct SiteData *sd = g_queue_pop_tail(&cache.lru);
+    assert(sd);
+
+    sd->link = 0;
+    g_hash_table_remove(cache.sites, sd->key);
+    cache.total_bytes -= sd->bytes;
+
+    site_data_free(&sd);
+}
+
+/** Drop sites until the cache fits in its budget. Must be called while holding the lock. */
+static void
+enforce_budget(void)
+{
+    while (cache.total_bytes > cache.max_bytes && cache.lru.length > 0) {
+        drop_least_recently_used();
+    }
+}
+
+/** Get a site that is in the cache for a caller. Must be called while holding the lock. */
+static struct SiteData *
+use_cached(struct SiteData *sd)
+{
+    g_queue_unlink(&cache.lru, sd->link);
+    g_queue_push_head_link(&cache.lru, sd->link);
+
+    g_atomic_int_inc(&sd->ref_count);
+    return sd;
+}
+
+void
+site_cache_initialize(size_t max_bytes)
+{
+    g_mutex_lock(&cache.lock);
+    assert(!cache.enabled);
+
+    cache.enabled = true;
+    cache.max_bytes = max_bytes;
+    cache.total_bytes = 0;
+    cache.sites = g_hash_table_new(g_str_hash, g_str_equal);
+
+    g_mutex_unlock(&cache.lock);
+}
+
+void
+site_cache_finalize(void)
+{
+    g_mutex_lock(&cache.lock);
+
+    if (cache.enabled) {
+        while (cache.lru.length > 0) {
+            drop_least_recently_used();
+        }
+
+        g_hash_table_destroy(cache.sites);
+        cache.sites = 0;
+        cache.enabled = false;
+    }
+
+    g_mutex_unlock(&cache.lock);
+}
+
+SiteData *
+site_cache_checkout(char const file_name[static 1], time_t init_time)
+{
+    struct SiteData *sd = 0;
+
+    g_mutex_lock(&cache.lock);
+    if (cache.enabled) {
+        char *key = make_key(file_name, init_time);
+        sd = g_hash_table_lookup(cache.sites, key);
+        free(key);
+
+        if (sd) {
+            use_cached(sd);
+        }
+    }
+    g_mutex_unlock(&cache.lock);
+
+    return sd;
+}
+
+SiteData *
+site_cache_add(char const file_name[static 1], time_t init_time, NBMData *nbm)
+{
+    struct SiteData *sd = 0;
+
+    g_mutex_lock(&cache.lock);
+    if (cache.enabled) {
+        char *key = make_key(file_name, init_time);
+        sd = g_hash_table_lookup(cache.sites, key);
+
+        if (sd) {
+            // Another thread beat us to it.
+            free(key);
+            nbm_data_free(&nbm);
+            use_cached(sd);
+        } else {
+            sd = site_data_new(nbm);
+            sd->key = key;
+            sd->bytes = site_data_memory_bytes(sd);
+
+            g_hash_table_insert(cache.sites, sd->key, sd);
+            g_queue_push_head(&cache.lru, sd);
+            sd->link = cache.lru.head;
+            cache.total_bytes += sd->bytes;
+
+            // One reference for the cache, one for the caller.
+            g_atomic_int_inc(&sd->ref_count);
+            enforce_budget();
+        }
+    } else {
+        sd = site_data_new(nbm);
+    }
+    g_mutex_unlock(&cache.lock);
+
+    return sd;
+}
+
+void
+site_cache_checkin(struct SiteData **sdptr)
+{
+    struct SiteData *sd = *sdptr;
+    assert(sd);
+
+    // Another thread may be building a summary for the same site.
+    g_mutex_lock(&sd->lock);
+    size_t bytes = site_data_memory_bytes(sd);
+    g_mutex_unlock(&sd->lock);
+
+    g_mutex_lock(&cache.lock);
+    if (sd->link) {
+        // Still in the cache.
+        cache.total_bytes = cache.total_bytes - sd->bytes + bytes;
+        sd->bytes = bytes;
+        enforce_budget();
+    }
+    g_mutex_unlock(&cache.lock);
+
+    site_data_free(sdptr);
+}
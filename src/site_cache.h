@@ -0,0 +1,115 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <time.h>
+
+#include "gust_summary.h"
+#include "nbm_data.h"
+#include "precip_summary.h"
+#include "snow_summary.h"
+#include "temp_summary.h"
+#include "wind_summary.h"
+
+/*-------------------------------------------------------------------------------------------------
+ *                                          SiteData
+ *-----------------------------------------------------------------------------------------------*/
+/** The parsed data for a site along with the summaries built from it.
+ *
+ * The summaries are built the first time they are asked for and kept until the \c SiteData is
+ * freed, so the distributions and scenarios are only calculated once no matter how many times
+ * they are shown. Only building them is done one thread at a time. A summary that has been
+ * returned is finished, so several threads can show it at once.
+ */
+typedef struct SiteData SiteData;
+
+/** Create a \c SiteData.
+ *
+ * \param nbm is the data for the site. The new object takes over this reference.
+ */
+SiteData *site_data_new(NBMData *nbm);
+
+/** Release a reference to a \c SiteData and nullify the pointer. */
+void site_data_free(SiteData **sd);
+
+/** Get the parsed data for the site. */
+NBMData const *site_data_nbm(SiteData const *sd);
+
+/** Get the temperature summary, building it if needed.
+ *
+ * \param scenarios is whether the scenarios will be shown, saved, or archived.
+ */
+TempSum *site_data_temp_sum(SiteData *sd, bool scenarios);
+
+/** Get the precipitation summary for an accumulation period, building it if needed.
+ *
+ * \param accum_hours must be 6, 12, 24, 48, or 72.
+ * \param scenarios is whether the scenarios will be shown, saved, or archived.
+ */
+PrecipSum *site_data_precip_sum(SiteData *sd, int accum_hours, bool scenarios);
+
+/** Get the snow summary for an accumulation period, building it if needed.
+ *
+ * \param accum_hours must be 6, 12, 24, 48, or 72.
+ * \param scenarios is whether the scenarios will be shown, saved, or archived.
+ */
+SnowSum *site_data_snow_sum(SiteData *sd, int accum_hours, bool scenarios);
+
+/** Get the wind summary, building it if needed.
+ *
+ * \param scenarios is whether the scenarios will be shown, saved, or archived.
+ */
+WindSum *site_data_wind_sum(SiteData *sd, bool scenarios);
+
+/** Get the gust summary, building it if needed.
+ *
+ * \param scenarios is whether the scenarios will be shown, saved, or archived.
+ */
+GustSum *site_data_gust_sum(SiteData *sd, bool scenarios);
+
+/** Get the approximate number of bytes of memory used by the data and the summaries. */
+size_t site_data_memory_bytes(SiteData const *sd);
+
+/*-------------------------------------------------------------------------------------------------
+ *                                          SiteCache
+ *-----------------------------------------------------------------------------------------------*/
+/** Start keeping recently used \c SiteData in memory.
+ *
+ * When the total memory used goes over \a max_bytes, the least recently used sites are dropped.
+ * The cache is safe to use from several threads.
+ */
+void site_cache_initialize(size_t max_bytes);
+
+/** Drop everything in the cache. */
+void site_cache_finalize(void);
+
+/** Get the data for a site from the cache.
+ *
+ * Several threads may have the same \c SiteData checked out at once.
+ *
+ * \param file_name is the name of the file the site's data came from.
+ * \param init_time is the NBM initialization time of the data.
+ *
+ * \returns the data, which must be returned with \c site_cache_checkin(), or \c NULL if it isn't
+ * in the cache.
+ */
+SiteData *site_cache_checkout(char const *file_name, time_t init_time);
+
+/** Add the data for a site to the cache and check it out.
+ *
+ * If another thread already added data for the same site, that is used instead.
+ *
+ * \param file_name is the name of the file the site's data came from.
+ * \param init_time is the NBM initialization time of the data.
+ * \param nbm is the data, the cache takes over this reference.
+ *
+ * \returns the data, which must be returned with \c site_cache_checkin().
+ */
+SiteData *site_cache_add(char const *file_name, time_t init_time, NBMData *nbm);
+
+/** Return data checked out from the cache, and nullify the pointer.
+ *
+ * The memory used by any summaries built while it was checked out is counted at this time, which
+ * may cause older sites to be dropped from the cache.
+ */
+void site_cache_checkin(SiteData **sd);
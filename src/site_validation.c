@@ -7,6 +7,8 @@
 #include <sqlite3.h>
 
 #include "download.h"
+#include "metrics.h"
+#include "profile.h"
 
 #define MAX_VERSIONS_TO_ATTEMP_DOWNLOADING 20
 
@@ -21,14 +23,11 @@ extern bool global_verbose;
 /*-------------------------------------------------------------------------------------------------
  *                                       Helper Functions
  *-----------------------------------------------------------------------------------------------*/
-/** Given a starting time, calculate the most recent NBM initialization time.
- *
- * This currently assumes we are only interested in the 1, 7, 13, or 19Z NBM runs.
- */
-static time_t
+time_t
 calc_most_recent_init_time(time_t starting_time)
 {
-    struct tm working_time = *gmtime(&starting_time);
+    struct tm working_time = {0};
+    gmtime_r(&starting_time, &working_time);
 
     // Force time to be on an hour by truncating minutes and seconds.
     working_time.tm_min = 0;
@@ -81,6 +80,9 @@ get_locations_csv_file(time_t request_time)
         num_attempts_left--;
     }
 
+    metrics_locations_lookup(num_attempts_left > 0,
+                             MAX_VERSIONS_TO_ATTEMP_DOWNLOADING - num_attempts_left);
+
     return (struct LocationsCSV){.buf = buf, .init_time = init_time};
 }
 
@@ -111,13 +113,13 @@ matched_sites_record_free(void *data)
 
 /** Callback to print all the strings in a \c GSList via g_slist_foreach. */
 static void
-print_list(void *data, void *unused)
+print_list(void *data, void *out)
 {
     struct MatchedSitesRecord *rec = data;
     char namebuf[256] = {0};
 
     sprintf(namebuf, "%s, %s", rec->name, rec->state);
-    printf("%-30s %6.3lf %8.3lf %s\n", namebuf, rec->lat, rec->lon, rec->id);
+    fprintf(out, "%-30s %6.3lf %8.3lf %s\n", namebuf, rec->lat, rec->lon, rec->id);
 }
 
 /*-------------------------------------------------------------------------------------------------
@@ -290,7 +292,10 @@ build_locations_database(struct TextBuffer *buf)
     csv_initialized = csv_init(&p, CSV_APPEND_NULL | CSV_EMPTY_IS_NULL) == 0;
     Stopif(!csv_initialized, goto ERR_RETURN, "error initializing csv");
 
+    // The rows are inserted as they are parsed, so this includes the inserts but not the commit.
+    ProfileSpan span = profile_begin("locations_csv_parse", 0);
     int csv_bytes = csv_parse(&p, buf->text_data, buf->size, process_col, process_row, &csv_state);
+    profile_end(&span);
     Stopif(csv_bytes != buf->size, goto ERR_RETURN, "error parsing locations csv");
 
     int csv_fini_err = csv_fini(&p, process_col, process_row, &csv_state);
@@ -370,16 +375,16 @@ find_exact_case_insensitive_match(sqlite3 *db, char const site[static 1])
     Stopif(num_bytes < 1, exit(EXIT_FAILURE), "out of memory");
     to_uppercase(upper_case_site);
 
-    char *query = 0;
-    num_bytes = asprintf(&query, "SELECT id, name, state, lat, lon FROM locations WHERE id = '%s'",
-                         upper_case_site);
-    Stopif(num_bytes < 1, exit(EXIT_FAILURE), "out of memory");
+    char const *query = "SELECT id, name, state, lat, lon FROM locations WHERE id = ?";
 
     sqlite3_stmt *stmt = 0;
     int res = sqlite3_prepare_v2(db, query, -1, &stmt, 0);
     Stopif(res != SQLITE_OK, goto ERR_RETURN, "error preparing exact case statement: %s",
            sqlite3_errstr(res));
 
+    res = sqlite3_bind_text(stmt, 1, upper_case_site, -1, 0);
+    Stopif(res != SQLITE_OK, goto ERR_RETURN, "error binding site in exact case statement.");
+
     res = sqlite3_step(stmt);
     if (res == SQLITE_ROW) {
         ret = g_slist_append(ret, create_record_from_row(stmt));
@@ -392,7 +397,6 @@ ERR_RETURN:
     }
 
     free(upper_case_site);
-    free(query);
 
     return ret;
 }
@@ -402,21 +406,21 @@ find_similar_sites(sqlite3 *db, char const site[static 1])
 {
     GSList *ret = 0;
 
-    char *query = 0;
-    int num_bytes = asprintf(&query,
-                             "SELECT id, name, state, lat, lon "
-                             "FROM locations                   "
-                             "WHERE id LIKE '%%%s%%'           "
-                             "    OR name LIKE '%%%s%%'        "
-                             "    OR state LIKE '%s'           ",
-                             site, site, site);
-    Stopif(num_bytes < 0, exit(EXIT_FAILURE), "out of memory");
+    // The site comes from the user, so it's bound as a parameter rather than pasted in.
+    char const *query = "SELECT id, name, state, lat, lon     "
+                        "FROM locations                       "
+                        "WHERE id LIKE '%' || ?1 || '%'       "
+                        "    OR name LIKE '%' || ?1 || '%'    "
+                        "    OR state LIKE ?1                 ";
 
     sqlite3_stmt *stmt = 0;
     int res = sqlite3_prepare_v2(db, query, -1, &stmt, 0);
     Stopif(res != SQLITE_OK, goto ERR_RETURN, "error preparing like statement: %s",
            sqlite3_errstr(res));
 
+    res = sqlite3_bind_text(stmt, 1, site, -1, 0);
+    Stopif(res != SQLITE_OK, goto ERR_RETURN, "error binding site in like statement.");
+
     res = sqlite3_step(stmt);
     while (res == SQLITE_ROW) {
         ret = g_slist_append(ret, create_record_from_row(stmt));
@@ -429,8 +433,6 @@ ERR_RETURN:
         sqlite3_finalize(stmt);
     }
 
-    free(query);
-
     return ret;
 }
 
@@ -473,20 +475,20 @@ site_validation_failed(struct SiteValidation *validation)
 }
 
 void
-site_validation_print_failure_message(struct SiteValidation *validation)
+site_validation_print_failure_message(struct SiteValidation *validation, FILE *out)
 {
     switch (get_failure_mode(validation)) {
     case FAILURE_MODE_NOT_ENOUGH:
-        printf("\nNo sites matched request.\n");
+        fprintf(out, "\nNo sites matched request.\n");
         break;
     case FAILURE_MODE_TOO_MANY:
-        printf("\nAmbiguous site with multiple matches:\n");
-        printf("%-30s %-6s %-8s %s\n", "Station Name", "Lat", "Lon", "ID");
-        printf("----------------------------------------------------\n");
-        g_slist_foreach(validation->matched_sites, print_list, 0);
+        fprintf(out, "\nAmbiguous site with multiple matches:\n");
+        fprintf(out, "%-30s %-6s %-8s %s\n", "Station Name", "Lat", "Lon", "ID");
+        fprintf(out, "----------------------------------------------------\n");
+        g_slist_foreach(validation->matched_sites, print_list, out);
         break;
     case FAILURE_MODE_UNABLE_TO_CONNECT:
-        printf("\nUnable to connect to server for last %d model cycles.\n",
+        fprintf(out, "\nUnable to connect to server for last %d model cycles.\n",
                MAX_VERSIONS_TO_ATTEMP_DOWNLOADING);
         break;
     default:
@@ -528,6 +530,151 @@ site_validation_init_time(struct SiteValidation *validation)
     return validation->init_time;
 }
 
+/*-------------------------------------------------------------------------------------------------
+ *                                    Kept Locations Index
+ *-----------------------------------------------------------------------------------------------*/
+/** How long to wait before checking again for a cycle that hasn't been posted yet. */
+#define RECHECK_SECS (5 * 60)
+
+/** A locations database kept between validations by a long running process. */
+static struct {
+    GMutex lock;
+    GCond updated; // Signaled when an update finishes.
+    bool enabled;
+    bool updating; // A thread is fetching a new database, with the lock released.
+    sqlite3 *db;
+    time_t init_time;
+    time_t missing_init_time; // Most recent cycle we looked for and didn't find.
+    time_t missing_checked;   // When we looked for it.
+} kept = {.enabled = false, .db = 0, .init_time = 0, .missing_init_time = 0, .missing_checked = 0};
+
+void
+site_validation_keep_locations(void)
+{
+    g_mutex_lock(&kept.lock);
+    kept.enabled = true;
+    g_mutex_unlock(&kept.lock);
+}
+
+void
+site_validation_finalize(void)
+{
+    g_mutex_lock(&kept.lock);
+    while (kept.updating) {
+        g_cond_wait(&kept.updated, &kept.lock);
+    }
+    if (kept.db) {
+        destroy_locations_database(kept.db);
+    }
+    kept.db = 0;
+    kept.init_time = 0;
+    kept.enabled = false;
+    g_mutex_unlock(&kept.lock);
+}
+
+/** Check if the kept database can answer a request made at \a request_time.
+ *
+ * Must be called while holding the lock.
+ */
+static bool
+kept_locations_are_current(time_t request_time)
+{
+    if (!kept.db) {
+        return false;
+    }
+
+    time_t wanted = calc_most_recent_init_time(request_time);
+    if (wanted == kept.init_time) {
+        return true;
+    }
+
+    // A newer cycle that wasn't posted the last time we looked, don't hammer the server for it.
+    return wanted > kept.init_time && wanted == kept.missing_init_time &&
+           time(0) - kept.missing_checked < RECHECK_SECS;
+}
+
+/** Make sure the kept database is the right one for \a request_time.
+ *
+ * Must be called while holding the lock. It is released while downloading the locations file and
+ * building the database, so other threads can keep using the old database in the meantime. Only
+ * one thread updates at a time, the others use the old database, or wait for the new one if
+ * there isn't one yet.
+ *
+ * \returns \c false if no locations file could be retrieved.
+ */
+static bool
+update_kept_locations(time_t request_time)
+{
+    if (kept_locations_are_current(request_time)) {
+        return true;
+    }
+
+    if (kept.updating) {
+        while (kept.updating && !kept.db) {
+            g_cond_wait(&kept.updated, &kept.lock);
+        }
+        return kept.db != 0;
+    }
+
+    kept.updating = true;
+    time_t const kept_init_time = kept.db ? kept.init_time : 0;
+    g_mutex_unlock(&kept.lock);
+
+    struct LocationsCSV locations_info = get_locations_csv_file(request_time);
+    bool const found = !text_buffer_is_empty(locations_info.buf);
+
+    sqlite3 *db = 0;
+    if (found && locations_info.init_time != kept_init_time) {
+        ProfileSpan span = profile_begin("locations_db_build", 0);
+        db = build_locations_database(&locations_info.buf);
+        profile_end(&span);
+
+        if (!db) {
+            fprintf(stderr, "Unable to build locations database.\n");
+        }
+    }
+    text_buffer_clear(&locations_info.buf);
+
+    g_mutex_lock(&kept.lock);
+
+    time_t wanted = calc_most_recent_init_time(request_time);
+    if (found && locations_info.init_time != wanted) {
+        kept.missing_init_time = wanted;
+        kept.missing_checked = time(0);
+    }
+
+    if (db) {
+        if (kept.db) {
+            destroy_locations_database(kept.db);
+        }
+        kept.db = db;
+        kept.init_time = locations_info.init_time;
+    }
+
+    kept.updating = false;
+    g_cond_broadcast(&kept.updated);
+
+    return kept.db != 0;
+}
+
+/*-------------------------------------------------------------------------------------------------
+ *                                   Public API for Validation
+ *-----------------------------------------------------------------------------------------------*/
+static GSList *
+find_matches(sqlite3 *db, char const site[static 1])
+{
+    ProfileSpan span = profile_begin("site_query", 0);
+
+    GSList *matches = find_exact_case_insensitive_match(db, site);
+    if (!matches) {
+        matches = find_similar_sites(db, site);
+    }
+
+    profile_end(&span);
+
+    return matches;
+}
+
 struct SiteValidation *
 site_validation_create(char const site[static 1], time_t request_time)
 {
@@ -536,6 +683,20 @@ site_validation_create(char const site[static 1], time_t request_time)
     struct SiteValidation *res = calloc(1, sizeof(struct SiteValidation));
     assert(res);
 
+    g_mutex_lock(&kept.lock);
+    if (kept.enabled) {
+        if (update_kept_locations(request_time)) {
+            res->init_time = kept.init_time;
+            res->matched_sites = find_matches(kept.db, site);
+        } else {
+            res->unable_to_connect = true;
+        }
+        g_mutex_unlock(&kept.lock);
+
+        return res;
+    }
+    g_mutex_unlock(&kept.lock);
+
     struct LocationsCSV locations_info = get_locations_csv_file(request_time);
     struct TextBuffer buf = locations_info.buf;
     time_t init_time = locations_info.init_time;
@@ -545,14 +706,14 @@ site_validation_create(char const site[static 1], time_t request_time)
         return res;
     }
 
+    ProfileSpan span = profile_begin("locations_db_build", 0);
     sqlite3 *db = build_locations_database(&buf);
+    profile_end(&span);
+
     text_buffer_clear(&buf); // We're done with the text.
     assert(db);
 
-    GSList *matches = find_exact_case_insensitive_match(db, site);
-    if (!matches) {
-        matches = find_similar_sites(db, site);
-    }
+    GSList *matches = find_matches(db, site);
 
     destroy_locations_database(db);
 
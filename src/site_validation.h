@@ -1,9 +1,16 @@
 #pragma once
 
 #include <stdbool.h>
+#include <stdio.h>
 
 #include <time.h>
 
+/** Given a starting time, calculate the most recent NBM initialization time.
+ *
+ * This currently assumes we are only interested in the 1, 7, 13, or 19Z NBM runs.
+ */
+time_t calc_most_recent_init_time(time_t starting_time);
+
 /** The results of validating a site. */
 typedef struct SiteValidation SiteValidation;
 
@@ -23,12 +30,12 @@ SiteValidation *site_validation_create(char const *site, time_t request_time);
  */
 bool site_validation_failed(SiteValidation *validation);
 
-/** Print a message explaining the validation failure.
+/** Print a message explaining the validation failure to \c out.
  *
  * Before using this function you check us \c site_validation_failed() to make sure it actually
  * failed.
  */
-void site_validation_print_failure_message(SiteValidation *validation);
+void site_validation_print_failure_message(SiteValidation *validation, FILE *out);
 
 /** Get an alias (pointer) to the site name.
  *
@@ -48,6 +55,16 @@ time_t site_validation_init_time(SiteValidation *validation);
 /** Free resources and nullify the object. */
 void site_validation_free(SiteValidation **validation);
 
+/** Keep the locations database in memory between calls to \c site_validation_create().
+ *
+ * This is for long running processes, like the server. The database is rebuilt when a request
+ * needs a newer (or older) NBM cycle. Call \c site_validation_finalize() to release it.
+ */
+void site_validation_keep_locations(void);
+
+/** Release the locations database kept by \c site_validation_keep_locations(). */
+void site_validation_finalize(void);
+
 /** Get an alias (pointer) to the file name.
  *
  * The returned pointer is an alias and SHOULD NOT BE FREED.
@@ -19,17 +19,22 @@ struct SnowSum {
 
     int accum_hours;
 
-    GTree *cdfs;
-    GTree *pdfs;
-    GTree *scenarios;
+    Arena *arena;
+    TimeSeries *cdfs;
+    TimeSeries *pdfs;
+    TimeSeries *scenarios;
 };
 
 #define NUM_PROB_EXC_VALS 10
 static char const *exc_vals[NUM_PROB_EXC_VALS] = {"0.00254", "0.0254", "0.0508", "0.1016", "0.1524",
                                                   "0.2032",  "0.3048", "0.4572", "0.6096", "0.762"};
 
-static GTree *
-build_cdfs(NBMData const *nbm, int hours)
+/** The thresholds the probabilities of exceedance are shown for, in inches. */
+static double const summary_exc_vals[] = {0.1, 0.5, 1.0, 3.0, 6.0, 8.0, 12.0, 18.0, 24.0};
+#define NUM_SUMMARY_EXC_VALS (sizeof(summary_exc_vals) / sizeof(summary_exc_vals[0]))
+
+static TimeSeries *
+build_cdfs(Arena *arena, NBMData const *nbm, int hours)
 {
     char percentile_format[32] = {0};
     char deterministic_snow_key[32] = {0};
@@ -37,14 +42,13 @@ build_cdfs(NBMData const *nbm, int hours)
     sprintf(percentile_format, "ASNOW%dhr_surface_%%d%%%% level", hours);
     sprintf(deterministic_snow_key, "ASNOW%dhr_surface", hours);
 
-    GTree *cdfs = extract_cdfs(nbm, percentile_format, deterministic_snow_key, m_to_in);
-    Stopif(!cdfs, return 0, "Error extracting CDFs for snow.");
-
     char prob_exceedence_format[32] = {0};
     sprintf(prob_exceedence_format, "ASNOW%dhr_surface_prob >%%s", hours);
 
-    cdfs = extract_exceedence_to_cdfs(cdfs, nbm, prob_exceedence_format, NUM_PROB_EXC_VALS,
-                                      exc_vals, m_to_in);
+    TimeSeries *cdfs = extract_cdfs(arena, nbm, percentile_format, deterministic_snow_key,
+                                    prob_exceedence_format, NUM_PROB_EXC_VALS, exc_vals,
+                                    m_to_in);
+    Stopif(!cdfs, return 0, "Error extracting CDFs for snow.");
 
     return cdfs;
 }
@@ -61,7 +65,8 @@ snow_sum_build(NBMData const *nbm, int accum_hours)
 
     new->accum_hours = accum_hours;
 
-    new->cdfs = build_cdfs(nbm, accum_hours);
+    new->arena = arena_new();
+    new->cdfs = build_cdfs(new->arena, nbm, accum_hours);
     Stopif(!new->cdfs, goto ERR_RETURN, "Error extracting CDFs for snow.");
 
     new->pdfs = 0;
@@ -81,7 +86,8 @@ static void
 build_title(struct SnowSum const *ssum, Table *tbl, int type)
 {
     char title_buf[256] = {0};
-    struct tm init = *gmtime(&ssum->init_time);
+    struct tm init = {0};
+    gmtime_r(&ssum->init_time, &init);
 
     if (type == SUMMARY) {
         sprintf(title_buf, "%d Hr Probabilistic Snow for %s (%s) - ", ssum->accum_hours, ssum->name,
@@ -108,24 +114,32 @@ add_row_prob_snow_exceedence_to_table(void *key, void *value, void *state)
     Table *tbl = tbl_state->tbl;
     int row = tbl_state->row;
 
-    double p10th = round(cumulative_dist_percentile_value(dist, 10.0) * 10.0) / 10.0;
-    double p25th = round(cumulative_dist_percentile_value(dist, 25.0) * 10.0) / 10.0;
-    double p50th = round(cumulative_dist_percentile_value(dist, 50.0) * 10.0) / 10.0;
-    double p75th = round(cumulative_dist_percentile_value(dist, 75.0) * 10.0) / 10.0;
-    double p90th = round(cumulative_dist_percentile_value(dist, 90.0) * 10.0) / 10.0;
-
-    double prob_01 = round(interpolate_prob_of_exceedance(dist, 0.1));
-    double prob_05 = round(interpolate_prob_of_exceedance(dist, 0.5));
-    double prob_10 = round(interpolate_prob_of_exceedance(dist, 1.0));
-    double prob_30 = round(interpolate_prob_of_exceedance(dist, 3.0));
-    double prob_60 = round(interpolate_prob_of_exceedance(dist, 6.0));
-    double prob_80 = round(interpolate_prob_of_exceedance(dist, 8.0));
-    double prob_120 = round(interpolate_prob_of_exceedance(dist, 12.0));
-    double prob_180 = round(interpolate_prob_of_exceedance(dist, 18.0));
-    double prob_240 = round(interpolate_prob_of_exceedance(dist, 24.0));
+    static double const pcts[5] = {10.0, 25.0, 50.0, 75.0, 90.0};
+    double pct_vals[5] = {0};
+    cumulative_dist_percentile_values(dist, 5, pcts, pct_vals);
+
+    double p10th = round(pct_vals[0] * 10.0) / 10.0;
+    double p25th = round(pct_vals[1] * 10.0) / 10.0;
+    double p50th = round(pct_vals[2] * 10.0) / 10.0;
+    double p75th = round(pct_vals[3] * 10.0) / 10.0;
+    double p90th = round(pct_vals[4] * 10.0) / 10.0;
+
+    double probs[NUM_SUMMARY_EXC_VALS] = {0};
+    interpolate_probs_of_exceedance(dist, NUM_SUMMARY_EXC_VALS, summary_exc_vals, probs);
+
+    double prob_01 = round(probs[0]);
+    double prob_05 = round(probs[1]);
+    double prob_10 = round(probs[2]);
+    double prob_30 = round(probs[3]);
+    double prob_60 = round(probs[4]);
+    double prob_80 = round(probs[5]);
+    double prob_120 = round(probs[6]);
+    double prob_180 = round(probs[7]);
+    double prob_240 = round(probs[8]);
 
     char datebuf[64] = {0};
-    strftime(datebuf, sizeof(datebuf), "%a, %Y-%m-%d %HZ", gmtime(vt));
+    struct tm vt_tm = {0};
+    strftime(datebuf, sizeof(datebuf), "%a, %Y-%m-%d %HZ", gmtime_r(vt, &vt_tm));
 
     table_set_string_value(tbl, 0, row, strlen(datebuf), datebuf);
 
@@ -151,19 +165,19 @@ add_row_prob_snow_exceedence_to_table(void *key, void *value, void *state)
 }
 
 void
-show_snow_summary(struct SnowSum const *ssum)
+show_snow_summary(struct SnowSum const *ssum, FILE *out)
 {
     assert(ssum);
 
     char left_col_title[32] = {0};
     sprintf(left_col_title, "%d Hrs Ending / in.", ssum->accum_hours);
 
-    GTree *cdfs = ssum->cdfs;
+    TimeSeries *cdfs = ssum->cdfs;
     assert(cdfs);
 
-    int num_rows = g_tree_nnodes(cdfs);
+    int num_rows = time_series_len(cdfs);
     if (num_rows == 0) {
-        printf("\n\n     ***** No snow summary for accumulation period %d. *****\n\n",
+        fprintf(out, "\n\n     ***** No snow summary for accumulation period %d. *****\n\n",
                ssum->accum_hours);
         return;
     }
@@ -198,38 +212,19 @@ show_snow_summary(struct SnowSum const *ssum)
     }
 
     struct TableFillerState state = {.row = 0, .tbl = tbl};
-    g_tree_foreach(cdfs, add_row_prob_snow_exceedence_to_table, &state);
+    time_series_foreach(cdfs, add_row_prob_snow_exceedence_to_table, &state);
 
-    table_display(tbl, stdout);
+    table_display(tbl, out);
 
     table_free(&tbl);
 }
 
-static int
-create_pdf_from_cdf_and_add_too_pdf_tree(void *key, void *val, void *data)
-{
-    CumulativeDistribution *cdf = val;
-    GTree *pdfs = data;
-
-    ProbabilityDistribution *pdf = probability_dist_calc(cdf);
-
-    g_tree_insert(pdfs, key, pdf);
-
-    return false;
-}
-
 static void
 snow_sum_build_pdfs(struct SnowSum *ssum)
 {
     assert(ssum && ssum->cdfs);
 
-    // Don't free the keys, we'll just point those to the same location as the keys
-    // used in the GTree of CDFs.
-    GTree *pdfs = g_tree_new_full(time_t_compare_func, 0, 0, probability_dist_free);
-
-    g_tree_foreach(ssum->cdfs, create_pdf_from_cdf_and_add_too_pdf_tree, pdfs);
-
-    ssum->pdfs = pdfs;
+    ssum->pdfs = create_pdfs_from_cdfs(ssum->arena, ssum->cdfs);
 }
 
 static void
@@ -237,7 +232,7 @@ snow_sum_build_scenarios(struct SnowSum *ssum)
 {
     assert(ssum && ssum->cdfs && ssum->pdfs);
 
-    GTree *scenarios = create_scenarios_from_pdfs(ssum->pdfs, 0.2, 0.2);
+    TimeSeries *scenarios = create_scenarios_from_pdfs(ssum->arena, ssum->pdfs, 0.2, 0.2);
     assert(scenarios);
 
     ssum->scenarios = scenarios;
@@ -247,27 +242,27 @@ static int
 add_row_scenario_to_table(void *key, void *value, void *state)
 {
     time_t *vt = key;
-    GList *scenarios = value;
+    ScenarioList const *scenarios = value;
 
     struct TableFillerState *tbl_state = state;
     Table *tbl = tbl_state->tbl;
     int row = tbl_state->row;
 
     char datebuf[64] = {0};
-    strftime(datebuf, sizeof(datebuf), "%a, %Y-%m-%d %HZ", gmtime(vt));
+    struct tm vt_tm = {0};
+    strftime(datebuf, sizeof(datebuf), "%a, %Y-%m-%d %HZ", gmtime_r(vt, &vt_tm));
 
     table_set_string_value(tbl, 0, row, strlen(datebuf), datebuf);
 
-    size_t scenario_num = 1;
-    for (GList *curr = scenarios; curr && scenario_num <= 4; curr = curr->next, scenario_num++) {
-        struct Scenario *sc = curr->data;
+    for (int i = 0; i < scenario_list_len(scenarios); i++) {
+        Scenario const *sc = scenario_list_get(scenarios, i);
 
         double min = round(scenario_get_minimum(sc) * 10.0) / 10.0;
         double mode = round(scenario_get_mode(sc) * 10.0) / 10.0;
         double max = round(scenario_get_maximum(sc) * 10.0) / 10.0;
         double prob = round(scenario_get_probability(sc) * 100.0);
 
-        table_set_scenario(tbl, scenario_num, row, mode, min, max, prob);
+        table_set_scenario(tbl, i + 1, row, mode, min, max, prob);
     }
 
     tbl_state->row++;
@@ -276,7 +271,7 @@ add_row_scenario_to_table(void *key, void *value, void *state)
 }
 
 void
-show_snow_scenarios(struct SnowSum *ssum)
+show_snow_scenarios(struct SnowSum *ssum, FILE *out)
 {
     assert(ssum);
     if (!ssum->pdfs) {
@@ -292,12 +287,12 @@ show_snow_scenarios(struct SnowSum *ssum)
     char left_col_title[32] = {0};
     sprintf(left_col_title, "%d Hrs Ending", ssum->accum_hours);
 
-    GTree *scenarios = ssum->scenarios;
+    TimeSeries *scenarios = ssum->scenarios;
     assert(scenarios);
 
-    int num_rows = g_tree_nnodes(scenarios);
+    int num_rows = time_series_len(scenarios);
     if (num_rows == 0) {
-        printf("\n\n     ***** No snow scenarios for accumulation period %d. *****\n\n",
+        fprintf(out, "\n\n     ***** No snow scenarios for accumulation period %d. *****\n\n",
                ssum->accum_hours);
         return;
     }
@@ -324,13 +319,39 @@ show_snow_scenarios(struct SnowSum *ssum)
     table_set_double_left_border(tbl, 4);
 
     struct TableFillerState state = {.row = 0, .tbl = tbl};
-    g_tree_foreach(scenarios, add_row_scenario_to_table, &state);
+    time_series_foreach(scenarios, add_row_scenario_to_table, &state);
 
-    table_display(tbl, stdout);
+    table_display(tbl, out);
 
     table_free(&tbl);
 }
 
+void
+snow_sum_write_records(SnowSum *ssum, bool summary, bool scenarios, RecordWriter *w)
+{
+    assert(ssum && ssum->cdfs);
+
+    char element[32] = {0};
+
+    if (summary) {
+        sprintf(element, "snow_%dh", ssum->accum_hours);
+        records_write_cdfs(w, element, ssum->cdfs, NUM_SUMMARY_EXC_VALS, summary_exc_vals);
+    }
+
+    if (scenarios) {
+        if (!ssum->pdfs) {
+            snow_sum_build_pdfs(ssum);
+        }
+
+        if (!ssum->scenarios) {
+            snow_sum_build_scenarios(ssum);
+        }
+
+        sprintf(element, "snow_%dh_scenarios", ssum->accum_hours);
+        records_write_scenarios(w, element, ssum->scenarios);
+    }
+}
+
 static int
 write_cdf(void *key, void *value, void *state)
 {
@@ -339,7 +360,8 @@ write_cdf(void *key, void *value, void *state)
     FILE *f = state;
 
     char datebuf[64] = {0};
-    strftime(datebuf, sizeof(datebuf), "%a, %Y-%m-%d %HZ", gmtime(vt));
+    struct tm vt_tm = {0};
+    strftime(datebuf, sizeof(datebuf), "%a, %Y-%m-%d %HZ", gmtime_r(vt, &vt_tm));
 
     fprintf(f, "\n\n\"Period ending: %s\"\n", datebuf);
 
@@ -356,7 +378,8 @@ write_pdf(void *key, void *value, void *state)
     FILE *f = state;
 
     char datebuf[64] = {0};
-    strftime(datebuf, sizeof(datebuf), "%a, %Y-%m-%d %HZ", gmtime(vt));
+    struct tm vt_tm = {0};
+    strftime(datebuf, sizeof(datebuf), "%a, %Y-%m-%d %HZ", gmtime_r(vt, &vt_tm));
 
     fprintf(f, "\n\n\"Period ending: %s\"\n", datebuf);
 
@@ -369,16 +392,17 @@ static int
 write_scenario(void *key, void *value, void *state)
 {
     time_t *vt = key;
-    GList *scenarios = value;
+    ScenarioList const *scenarios = value;
     FILE *f = state;
 
     char datebuf[64] = {0};
-    strftime(datebuf, sizeof(datebuf), "%a, %Y-%m-%d %HZ", gmtime(vt));
+    struct tm vt_tm = {0};
+    strftime(datebuf, sizeof(datebuf), "%a, %Y-%m-%d %HZ", gmtime_r(vt, &vt_tm));
 
     fprintf(f, "\n\n\"Period ending: %s\"\n", datebuf);
 
-    for (GList *curr = scenarios; curr; curr = curr->next) {
-        Scenario *sc = curr->data;
+    for (int i = 0; i < scenario_list_len(scenarios); i++) {
+        Scenario const *sc = scenario_list_get(scenarios, i);
 
         fprintf(f, "%8lf %8lf %8lf %8lf\n", scenario_get_minimum(sc), scenario_get_mode(sc),
                 scenario_get_maximum(sc), scenario_get_probability(sc));
@@ -423,15 +447,61 @@ snow_sum_save(struct SnowSum *ssum, char const *directory, char const *file_pref
     FILE *scenario_f = fopen(scenario_path, "w");
     Stopif(!scenario_f, return, "Unable to open scenarios.dat");
 
-    g_tree_foreach(ssum->cdfs, write_cdf, cdf_f);
-    g_tree_foreach(ssum->pdfs, write_pdf, pdf_f);
-    g_tree_foreach(ssum->scenarios, write_scenario, scenario_f);
+    time_series_foreach(ssum->cdfs, write_cdf, cdf_f);
+    time_series_foreach(ssum->pdfs, write_pdf, pdf_f);
+    time_series_foreach(ssum->scenarios, write_scenario, scenario_f);
 
     fclose(cdf_f);
     fclose(pdf_f);
     fclose(scenario_f);
 }
 
+void
+snow_sum_archive(SnowSum *ssum, DistArchiveWriter *writer)
+{
+    assert(ssum && ssum->cdfs);
+
+    if (!ssum->pdfs) {
+        snow_sum_build_pdfs(ssum);
+    }
+
+    if (!ssum->scenarios) {
+        snow_sum_build_scenarios(ssum);
+    }
+
+    char element[DIST_ARCHIVE_ELEMENT_LEN] = {0};
+    sprintf(element, "snow_%dh", ssum->accum_hours);
+    dist_archive_add(writer, element, ssum->cdfs, ssum->pdfs, ssum->scenarios);
+}
+
+void
+snow_sum_prepare(struct SnowSum *ssum, bool scenarios)
+{
+    assert(ssum && ssum->cdfs);
+
+    if (!scenarios) {
+        return;
+    }
+
+    if (!ssum->pdfs) {
+        snow_sum_build_pdfs(ssum);
+    }
+
+    if (!ssum->scenarios) {
+        snow_sum_build_scenarios(ssum);
+    }
+}
+
+size_t
+snow_sum_memory_bytes(struct SnowSum const *ssum)
+{
+    assert(ssum);
+
+    return sizeof(*ssum) + strlen(ssum->id) + strlen(ssum->name) + 2 +
+           arena_memory_bytes(ssum->arena) + time_series_memory_bytes(ssum->cdfs) +
+           time_series_memory_bytes(ssum->pdfs) + time_series_memory_bytes(ssum->scenarios);
+}
+
 void
 snow_sum_free(struct SnowSum **ssum)
 {
@@ -444,14 +514,16 @@ snow_sum_free(struct SnowSum **ssum)
         free(ptr->name);
 
         if (ptr->scenarios) {
-            g_tree_unref(ptr->scenarios);
+            time_series_free(&ptr->scenarios);
         }
         if (ptr->pdfs) {
-            g_tree_unref(ptr->pdfs);
+            time_series_free(&ptr->pdfs);
         }
         if (ptr->cdfs) {
-            g_tree_unref(ptr->cdfs);
+            time_series_free(&ptr->cdfs);
         }
+
+        arena_free(&ptr->arena);
     }
 
     free(ptr);
@@ -1,6 +1,11 @@
 #pragma once
 
+#include <stdbool.h>
+#include <stdio.h>
+
+#include "dist_archive.h"
 #include "nbm_data.h"
+#include "records.h"
 
 /** A snow summary. */
 typedef struct SnowSum SnowSum;
@@ -13,10 +18,19 @@ typedef struct SnowSum SnowSum;
 SnowSum *snow_sum_build(NBMData const *nbm, int accum_hours);
 
 /** Print a probabilistic summary. */
-void show_snow_summary(SnowSum const *ssum);
+void show_snow_summary(SnowSum const *ssum, FILE *out);
 
 /** Print a summary of the preciptation scenarios. */
-void show_snow_scenarios(SnowSum *ssum);
+void show_snow_scenarios(SnowSum *ssum, FILE *out);
+
+/** Write the summary and/or the scenarios as machine readable records.
+ *
+ * \param ssum is the summary to write.
+ * \param summary is whether to write the probabilistic summary.
+ * \param scenarios is whether to write the snow scenarios.
+ * \param w is where to write the records.
+ */
+void snow_sum_write_records(SnowSum *ssum, bool summary, bool scenarios, RecordWriter *w);
 
 /** Save two files with the CDF and PDF information in them.
  *
@@ -29,5 +43,23 @@ void show_snow_scenarios(SnowSum *ssum);
  */
 void snow_sum_save(SnowSum *ssum, char const *directory, char const *file_prefix);
 
+/** Add the CDFs, PDFs, and scenarios to a binary archive, building them if needed. */
+void snow_sum_archive(SnowSum *ssum, DistArchiveWriter *writer);
+
+/** Build the PDFs and scenarios now instead of the first time they are used.
+ *
+ * Once they are built, showing, writing, saving, or archiving the summary only reads it, so it can
+ * be done from several threads at once.
+ *
+ * \param scenarios is whether the PDFs and scenarios will be needed.
+ */
+void snow_sum_prepare(SnowSum *ssum, bool scenarios);
+
+/** Get the approximate number of bytes of memory used by a \c SnowSum.
+ *
+ * This includes the CDFs, PDFs, and scenarios that have been built so far.
+ */
+size_t snow_sum_memory_bytes(SnowSum const *ssum);
+
 /** Free the memory associated with a \c SnowSum.*/
 void snow_sum_free(SnowSum **ssum);
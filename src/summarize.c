@@ -13,7 +13,7 @@
  *                             Extract Values for a Daily Summary.
  *-----------------------------------------------------------------------------------------------*/
 void
-extract_daily_summary_for_column(GTree *sums, NBMData const *nbm, char const *col_name,
+extract_daily_summary_for_column(TimeSeries *sums, NBMData const *nbm, char const *col_name,
                                  KeepFilter filter, SummarizeDate date_sum, Converter convert,
                                  Accumulator accumulate, Creator create_new, Extractor extract)
 {
@@ -27,12 +27,10 @@ extract_daily_summary_for_column(GTree *sums, NBMData const *nbm, char const *co
             time_t date = date_sum(view.valid_time);
             double x_val = convert(*view.value);
 
-            void *sum = g_tree_lookup(sums, &date);
+            void *sum = time_series_lookup(sums, date);
             if (!sum) {
-                time_t *key = malloc(sizeof(time_t));
-                *key = date;
                 sum = create_new();
-                g_tree_insert(sums, key, sum);
+                time_series_insert(sums, date, sum);
             }
             double *sum_val = extract(sum);
             *sum_val = accumulate(*sum_val, x_val);
@@ -56,7 +54,8 @@ keep_all(time_t const *vt)
 bool
 keep_aft(time_t const *vt)
 {
-    struct tm tmp = *gmtime(vt);
+    struct tm tmp = {0};
+    gmtime_r(vt, &tmp);
     if (tmp.tm_hour >= 18) {
         return true;
     }
@@ -66,7 +65,8 @@ keep_aft(time_t const *vt)
 bool
 keep_mrn(time_t const *vt)
 {
-    struct tm tmp = *gmtime(vt);
+    struct tm tmp = {0};
+    gmtime_r(vt, &tmp);
     if (tmp.tm_hour < 18 && tmp.tm_hour >= 12) {
         return true;
     }
@@ -76,7 +76,8 @@ keep_mrn(time_t const *vt)
 bool
 keep_eve(time_t const *vt)
 {
-    struct tm tmp = *gmtime(vt);
+    struct tm tmp = {0};
+    gmtime_r(vt, &tmp);
     if (tmp.tm_hour < 6) {
         return true;
     }
@@ -86,7 +87,8 @@ keep_eve(time_t const *vt)
 bool
 keep_night(time_t const *vt)
 {
-    struct tm tmp = *gmtime(vt);
+    struct tm tmp = {0};
+    gmtime_r(vt, &tmp);
     if (tmp.tm_hour < 12 && tmp.tm_hour >= 6) {
         return true;
     }
@@ -96,7 +98,8 @@ keep_night(time_t const *vt)
 bool
 keep_00z(time_t const *vt)
 {
-    struct tm tmp = *gmtime(vt);
+    struct tm tmp = {0};
+    gmtime_r(vt, &tmp);
     return tmp.tm_hour == 0;
 }
 
@@ -106,7 +109,8 @@ keep_00z(time_t const *vt)
 time_t
 summary_date_18z(time_t const *valid_time)
 {
-    struct tm tmp = *gmtime(valid_time);
+    struct tm tmp = {0};
+    gmtime_r(valid_time, &tmp);
     if (tmp.tm_hour <= 18) {
         tmp.tm_mday--;
     }
@@ -122,7 +126,8 @@ summary_date_18z(time_t const *valid_time)
 time_t
 summary_date_12z(time_t const *valid_time)
 {
-    struct tm tmp = *gmtime(valid_time);
+    struct tm tmp = {0};
+    gmtime_r(valid_time, &tmp);
     if (tmp.tm_hour <= 12) {
         tmp.tm_mday--;
     }
@@ -138,7 +143,8 @@ summary_date_12z(time_t const *valid_time)
 time_t
 summary_date_06z(time_t const *valid_time)
 {
-    struct tm tmp = *gmtime(valid_time);
+    struct tm tmp = {0};
+    gmtime_r(valid_time, &tmp);
     if (tmp.tm_hour <= 6) {
         tmp.tm_mday--;
     }
@@ -1,9 +1,11 @@
 #include "table.h"
+#include "profile.h"
 #include "utils.h"
 
 #include <assert.h>
 #include <ctype.h>
 #include <math.h>
+#include <stdarg.h>
 #include <stdbool.h>
 #include <stdio.h>
 #include <stdlib.h>
@@ -283,118 +285,173 @@ calc_table_width(struct Table *tbl)
     return width;
 }
 
+/*-------------------------------------------------------------------------------------------------
+ *                                         Rendering
+ *-----------------------------------------------------------------------------------------------*/
+/* The whole table is laid out in memory and written with a single call, so nothing is shared
+ * between calls and tables can be rendered from several threads at once.
+ */
+
+/** Make room for \a len more bytes at the end of the text and return where they go. */
+static char *
+append_space(struct TextBuffer *buf, size_t len)
+{
+    size_t start = buf->size == 0 ? 0 : buf->size - 1;
+    size_t needed = start + len + 1;
+    if (buf->capacity < needed) {
+        text_buffer_set_capacity(buf, needed > 2 * buf->capacity ? needed : 2 * buf->capacity);
+    }
+
+    buf->text_data[needed - 1] = '\0';
+    buf->size = needed;
+
+    return &buf->text_data[start];
+}
+
 static void
-print_centered(char const *str, int width, FILE *out)
+append_str(struct TextBuffer *buf, char const *str)
 {
+    size_t len = strlen(str);
+    memcpy(append_space(buf, len), str, len);
+}
 
-    int left_padding = 0;
-    int right_padding = 0;
-    if (str) {
-        right_padding = (width - strlen(str)) / 2;
-        left_padding = (width - strlen(str)) - right_padding;
-    } else {
-        left_padding = width;
-        right_padding = 0;
+/** Append \a str \a count times, used for padding and the borders. */
+static void
+append_repeated(struct TextBuffer *buf, char const *str, int count)
+{
+    if (count <= 0) {
+        return;
     }
 
-    for (int i = 0; i < left_padding; i++) {
-        fputc(' ', out);
+    size_t len = strlen(str);
+    char *next = append_space(buf, len * count);
+    for (int i = 0; i < count; i++) {
+        memcpy(&next[i * len], str, len);
     }
-    fprintf(out, "%s", str);
-    for (int i = 0; i < right_padding; i++) {
-        fputc(' ', out);
+}
+
+/** Replace the contents of \a buf with formatted text, growing it as needed. */
+static void
+format_into(struct TextBuffer *buf, char const *fmt, ...)
+{
+    va_list args;
+
+    va_start(args, fmt);
+    int len = vsnprintf(buf->text_data, buf->capacity, fmt, args);
+    va_end(args);
+    assert(len >= 0);
+
+    if (len + 1 > buf->capacity) {
+        text_buffer_set_capacity(buf, len + 1);
+
+        va_start(args, fmt);
+        vsnprintf(buf->text_data, buf->capacity, fmt, args);
+        va_end(args);
     }
+
+    buf->size = len + 1;
 }
 
 static void
-print_header(struct Table *tbl, FILE *out)
+render_centered(struct TextBuffer *buf, char const *str, int width)
+{
+    if (!str) {
+        str = "";
+    }
+
+    int right_padding = (width - strlen(str)) / 2;
+    int left_padding = (width - strlen(str)) - right_padding;
+
+    append_repeated(buf, " ", left_padding);
+    append_str(buf, str);
+    append_repeated(buf, " ", right_padding);
+}
+
+/** Render a horizontal border.
+ *
+ * \param line is the string to repeat across each column.
+ * \param left, right are the ends of the border.
+ * \param single, dbl are the joints between columns with a single or double left border.
+ */
+static void
+render_border(struct Table const *tbl, struct TextBuffer *buf, char const *line,
+              char const *left, char const *single, char const *dbl, char const *right)
+{
+    append_str(buf, left);
+    append_repeated(buf, line, tbl->cols[0].col_width);
+    for (int col = 1; col < tbl->num_cols; col++) {
+        append_str(buf, tbl->cols[col].double_left_border ? dbl : single);
+        append_repeated(buf, line, tbl->cols[col].col_width);
+    }
+    append_str(buf, right);
+}
+
+static void
+render_header(struct Table *tbl, struct TextBuffer *buf)
 {
     int table_width = calc_table_width(tbl);
 
     // Top bar.
-    fprintf(out, "┌");
-    for (int i = 0; i < table_width - 2; i++) {
-        fprintf(out, "─");
-    }
-    fprintf(out, "┐\n");
+    append_str(buf, "┌");
+    append_repeated(buf, "─", table_width - 2);
+    append_str(buf, "┐\n");
 
     // Print the title, centered.
-    fprintf(out, "│");
-    print_centered(tbl->title, table_width - 2, out);
-    fprintf(out, "│\n");
+    append_str(buf, "│");
+    render_centered(buf, tbl->title, table_width - 2);
+    append_str(buf, "│\n");
 
     // Print the top border.
-    fprintf(out, "├");
-    for (int i = 0; i < tbl->cols[0].col_width; i++) {
-        fprintf(out, "─");
-    }
-    for (int col = 1; col < tbl->num_cols; col++) {
-        if (tbl->cols[col].double_left_border) {
-            fprintf(out, "╥");
-        } else {
-            fprintf(out, "┬");
-        }
-        for (int i = 0; i < tbl->cols[col].col_width; i++) {
-            fprintf(out, "─");
-        }
-    }
-    fprintf(out, "┤\n");
+    render_border(tbl, buf, "─", "├", "┬", "╥", "┤\n");
 
     // Print the column labels
     for (int col = 0; col < tbl->num_cols; col++) {
-        if (tbl->cols[col].double_left_border) {
-            fprintf(out, "║");
-        } else {
-            fprintf(out, "│");
-        }
-        print_centered(tbl->cols[col].col_label, tbl->cols[col].col_width, out);
+        append_str(buf, tbl->cols[col].double_left_border ? "║" : "│");
+        render_centered(buf, tbl->cols[col].col_label, tbl->cols[col].col_width);
     }
-    fprintf(out, "│\n");
+    append_str(buf, "│\n");
 
     // Print the double line below.
-    fprintf(out, "╞");
-    for (int i = 0; i < tbl->cols[0].col_width; i++) {
-        fprintf(out, "═");
+    render_border(tbl, buf, "═", "╞", "╪", "╬", "╡\n");
+}
+
+/** Append the cell text right or left justified in the column, like "%*s" or "%-*s". */
+static void
+render_justified(struct TextBuffer *buf, struct TextBuffer const *cell, int width, bool left)
+{
+    int padding = width - (int)strlen(cell->text_data);
+
+    if (!left) {
+        append_repeated(buf, " ", padding);
     }
-    for (int col = 1; col < tbl->num_cols; col++) {
-        if (tbl->cols[col].double_left_border) {
-            fprintf(out, "╬");
-        } else {
-            fprintf(out, "╪");
-        }
-        for (int i = 0; i < tbl->cols[col].col_width; i++) {
-            fprintf(out, "═");
-        }
+    append_str(buf, cell->text_data);
+    if (left) {
+        append_repeated(buf, " ", padding);
     }
-    fprintf(out, "╡\n");
 }
 
-static char *
-print_table_value(struct Table *tbl, int col_num, int row_num, int buf_size, char buf[buf_size])
+/** Render one cell of the table.
+ *
+ * \param cell is scratch space for formatting the value.
+ */
+static void
+render_table_value(struct Table *tbl, int col_num, int row_num, struct TextBuffer *buf,
+                   struct TextBuffer *cell)
 {
-    char *next = &buf[strlen(buf)];
     struct Column *col = &tbl->cols[col_num];
     char *fmt = col->col_format;
 
-    if (tbl->cols[col_num].double_left_border) {
-        sprintf(next, "║");
-    } else {
-        sprintf(next, "│");
-    }
-    next = &next[strlen(next)];
+    append_str(buf, col->double_left_border ? "║" : "│");
 
-    char small_buf[64] = {0};
     switch (col->col_type) {
     case Table_ColumnType_TEXT: {
         char *val = col->text_values[row_num];
         if (val) {
-            sprintf(small_buf, fmt, val);
-            sprintf(next, "%-*s", col->col_width, small_buf);
+            format_into(cell, fmt, val);
+            render_justified(buf, cell, col->col_width, true);
         } else {
             // Fill with spaces.
-            for (int i = 0; i < col->col_width; i++) {
-                next[i] = ' ';
-            }
+            append_repeated(buf, " ", col->col_width);
         }
         break;
     }
@@ -402,21 +459,17 @@ print_table_value(struct Table *tbl, int col_num, int row_num, int buf_size, cha
         double val = col->values1[row_num];
 
         if (val == col->blank_value || (isnan(val) && isnan(col->blank_value))) {
-            for (int i = 0; i < col->col_width; i++) {
-                next[i] = ' ';
-            }
-            next[col->col_width] = '\0';
+            append_repeated(buf, " ", col->col_width);
         } else if (isnan(val)) {
-            for (int i = 0; i < col->col_width; i++) {
-                if (i == col->col_width - 2)
-                    next[i] = '-';
-                else
-                    next[i] = ' ';
+            if (col->col_width >= 2) {
+                append_repeated(buf, " ", col->col_width - 2);
+                append_str(buf, "- ");
+            } else {
+                append_repeated(buf, " ", col->col_width);
             }
-            next[col->col_width] = '\0';
         } else {
-            sprintf(small_buf, fmt, val);
-            sprintf(next, "%*s", col->col_width, small_buf);
+            format_into(cell, fmt, val);
+            render_justified(buf, cell, col->col_width, false);
         }
         break;
     }
@@ -424,8 +477,8 @@ print_table_value(struct Table *tbl, int col_num, int row_num, int buf_size, cha
         double avg = col->values1[row_num];
         double stdev = col->values2[row_num];
 
-        sprintf(small_buf, fmt, avg, stdev);
-        sprintf(next, "%*s", col->col_width, small_buf);
+        format_into(cell, fmt, avg, stdev);
+        render_justified(buf, cell, col->col_width, false);
         break;
     }
     case Table_ColumnType_SCENARIO: {
@@ -445,13 +498,14 @@ print_table_value(struct Table *tbl, int col_num, int row_num, int buf_size, cha
 
         if (isnan(prob)) {
             // print nothing - there is no scenario here.
+            format_into(cell, "%s", "");
         } else {
-            sprintf(small_buf, fmt, mode, min_val, max_val, prob);
+            format_into(cell, fmt, mode, min_val, max_val, prob);
         }
 
         // Remove NAN's from the string.
         char *nan_val = 0;
-        while ((nan_val = strstr(small_buf, "nan"))) {
+        while ((nan_val = strstr(cell->text_data, "nan"))) {
             nan_val[0] = ' ';
             nan_val[1] = ' ';
             nan_val[2] = ' ';
@@ -459,71 +513,57 @@ print_table_value(struct Table *tbl, int col_num, int row_num, int buf_size, cha
 
         // If all the values are zeros except the probability, only show the probability
         if (isnan(mode) && isnan(min_val) && isnan(max_val) && !isnan(prob)) {
-            for (char *c = small_buf; *c; c++) {
+            for (char *c = cell->text_data; *c; c++) {
                 if (!isdigit(*c)) {
                     *c = ' ';
                 }
             }
         }
 
-        sprintf(next, "%*s", col->col_width, small_buf);
+        render_justified(buf, cell, col->col_width, false);
         break;
     }
     default:
         assert(false);
     }
-
-    next = &next[strlen(next)];
-    return next;
 }
 
 static void
-print_rows(struct Table *tbl, FILE *out)
+render_rows(struct Table *tbl, struct TextBuffer *buf)
 {
-    static char buf[512] = {0};
+    struct TextBuffer cell = text_buffer_with_capacity(64);
 
     for (int row = 0; row < tbl->num_rows; row++) {
         if (!tbl->printable[row]) {
             continue;
         }
 
-        memset(buf, 0, sizeof(buf));
-        char *next = &buf[0];
-
         for (int col = 0; col < tbl->num_cols; col++) {
-            next = print_table_value(tbl, col, row, sizeof(buf) - (next - buf), next);
+            render_table_value(tbl, col, row, buf, &cell);
         }
 
-        sprintf(next, "│\n");
-
-        fputs(buf, out);
+        append_str(buf, "│\n");
     }
-}
 
-static void
-print_bottom(struct Table *tbl, FILE *out)
-{
-    fprintf(out, "╘");
-    for (int i = 0; i < tbl->cols[0].col_width; i++) {
-        fprintf(out, "═");
-    }
-    for (int col = 1; col < tbl->num_cols; col++) {
-        if (tbl->cols[col].double_left_border) {
-            fprintf(out, "╩");
-        } else {
-            fprintf(out, "╧");
-        }
-        for (int i = 0; i < tbl->cols[col].col_width; i++) {
-            fprintf(out, "═");
-        }
-    }
-    fprintf(out, "╛\n");
+    text_buffer_clear(&cell);
 }
 
 void
 table_display(struct Table *tbl, FILE *out)
 {
-    print_header(tbl, out);
-    print_rows(tbl, out);
-    print_bottom(tbl, out);
+    ProfileSpan span = profile_begin("table_render", 0);
+
+    // Each row takes about 3 bytes for each column of width, since border characters are 3 bytes.
+    int table_width = calc_table_width(tbl);
+    struct TextBuffer buf = text_buffer_with_capacity(3 * table_width * (tbl->num_rows + 8));
+
+    render_header(tbl, &buf);
+    render_rows(tbl, &buf);
+    render_border(tbl, &buf, "═", "╘", "╧", "╩", "╛\n");
+
+    fwrite(buf.text_data, 1, buf.size - 1, out); // Don't write the terminating null character.
+
+    text_buffer_clear(&buf);
+
+    profile_end(&span);
 }
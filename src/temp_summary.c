@@ -20,14 +20,15 @@ struct TempSum {
     time_t init_time;
 
     NBMData const *src;
+    Arena *arena;
 
-    GTree *max_cdfs;
-    GTree *max_pdfs;
-    GTree *max_scenarios;
+    TimeSeries *max_cdfs;
+    TimeSeries *max_pdfs;
+    TimeSeries *max_scenarios;
 
-    GTree *min_cdfs;
-    GTree *min_pdfs;
-    GTree *min_scenarios;
+    TimeSeries *min_cdfs;
+    TimeSeries *min_pdfs;
+    TimeSeries *min_scenarios;
 };
 
 struct TempSum *
@@ -41,6 +42,7 @@ temp_sum_build(NBMData const *nbm)
     new->init_time = nbm_data_init_time(nbm);
 
     new->src = nbm;
+    new->arena = arena_new();
 
     new->max_pdfs = 0;
     new->max_cdfs = 0;
@@ -72,43 +74,30 @@ temp_sum_build_cdfs(struct TempSum *tsum)
     char *max_percentile_format = "TMP_Max_2 m above ground_%d%% level";
     char *deterministic_max_temp_key = "TMP_Max_2 m above ground";
 
-    GTree *max_cdfs =
-        extract_cdfs(nbm, max_percentile_format, deterministic_max_temp_key, kelvin_to_fahrenheit);
+    TimeSeries *max_cdfs = extract_cdfs(tsum->arena, nbm, max_percentile_format,
+                                        deterministic_max_temp_key, 0, 0, 0, kelvin_to_fahrenheit);
 
-    // This mapping will change the values of the keys in the tree, which is not generally safe.
+    // This mapping will change the valid times in the series, which is not generally safe.
     // However, in this case since we will not change the relative ordering of the keys, it is
     // safe.
-    g_tree_foreach(max_cdfs, map_valid_time_to_valid_date, 0);
+    time_series_foreach(max_cdfs, map_valid_time_to_valid_date, 0);
 
     tsum->max_cdfs = max_cdfs;
 
     char *min_percentile_format = "TMP_Min_2 m above ground_%d%% level";
     char *deterministic_min_temp_key = "TMP_Min_2 m above ground";
 
-    GTree *min_cdfs =
-        extract_cdfs(nbm, min_percentile_format, deterministic_min_temp_key, kelvin_to_fahrenheit);
+    TimeSeries *min_cdfs = extract_cdfs(tsum->arena, nbm, min_percentile_format,
+                                        deterministic_min_temp_key, 0, 0, 0, kelvin_to_fahrenheit);
 
-    // This mapping will change the values of the keys in the tree, which is not generally safe.
+    // This mapping will change the valid times in the series, which is not generally safe.
     // However, in this case since we will not change the relative ordering of the keys, it is
     // safe.
-    g_tree_foreach(min_cdfs, map_valid_time_to_valid_date, 0);
+    time_series_foreach(min_cdfs, map_valid_time_to_valid_date, 0);
 
     tsum->min_cdfs = min_cdfs;
 }
 
-static int
-create_pdf_from_cdf_and_add_too_pdf_tree(void *key, void *val, void *data)
-{
-    CumulativeDistribution *cdf = val;
-    GTree *pdfs = data;
-
-    ProbabilityDistribution *pdf = probability_dist_calc(cdf);
-
-    g_tree_insert(pdfs, key, pdf);
-
-    return false;
-}
-
 static void
 temp_sum_build_pdfs(struct TempSum *tsum)
 {
@@ -119,16 +108,8 @@ temp_sum_build_pdfs(struct TempSum *tsum)
     }
     assert(tsum->max_cdfs && tsum->min_cdfs);
 
-    // Don't free the keys, we'll just point those to the same location as the keys
-    // used in the GTree of CDFs.
-    GTree *max_pdfs = g_tree_new_full(time_t_compare_func, 0, 0, probability_dist_free);
-    GTree *min_pdfs = g_tree_new_full(time_t_compare_func, 0, 0, probability_dist_free);
-
-    g_tree_foreach(tsum->max_cdfs, create_pdf_from_cdf_and_add_too_pdf_tree, max_pdfs);
-    g_tree_foreach(tsum->min_cdfs, create_pdf_from_cdf_and_add_too_pdf_tree, min_pdfs);
-
-    tsum->max_pdfs = max_pdfs;
-    tsum->min_pdfs = min_pdfs;
+    tsum->max_pdfs = create_pdfs_from_cdfs(tsum->arena, tsum->max_cdfs);
+    tsum->min_pdfs = create_pdfs_from_cdfs(tsum->arena, tsum->min_cdfs);
 }
 
 static void
@@ -139,9 +120,9 @@ temp_sum_build_scenarios(struct TempSum *tsum)
         temp_sum_build_pdfs(tsum);
     }
 
-    GTree *max_scenarios = create_scenarios_from_pdfs(tsum->max_pdfs, 0.5, 0.5);
+    TimeSeries *max_scenarios = create_scenarios_from_pdfs(tsum->arena, tsum->max_pdfs, 0.5, 0.5);
     assert(max_scenarios);
-    GTree *min_scenarios = create_scenarios_from_pdfs(tsum->min_pdfs, 0.5, 0.5);
+    TimeSeries *min_scenarios = create_scenarios_from_pdfs(tsum->arena, tsum->min_pdfs, 0.5, 0.5);
     assert(min_scenarios);
 
     tsum->max_scenarios = max_scenarios;
@@ -158,7 +139,8 @@ static void
 build_title(struct TempSum const *tsum, Table *tbl, char const *desc, int type)
 {
     char title_buf[256] = {0};
-    struct tm init = *gmtime(&tsum->init_time);
+    struct tm init = {0};
+    gmtime_r(&tsum->init_time, &init);
 
     if (type == SUMMARY) {
         sprintf(title_buf, "Temperature Quantiles for %s (%s) - ", tsum->name, tsum->id);
@@ -191,18 +173,24 @@ add_summary_row_to_table(void *key, void *value, void *state)
     int row = tbl_state->row;
 
     char datebuf[64] = {0};
-    strftime(datebuf, sizeof(datebuf), " %a, %Y-%m-%d ", gmtime(vt));
+    struct tm vt_tm = {0};
+    strftime(datebuf, sizeof(datebuf), " %a, %Y-%m-%d ", gmtime_r(vt, &vt_tm));
 
     table_set_string_value(tbl, 0, row, strlen(datebuf), datebuf);
 
+    static double const pcts[5] = {10.0, 25.0, 50.0, 75.0, 90.0};
+
     if (min_cdf) {
         double mint = round(cumulative_dist_pm_value(min_cdf));
 
-        double mint_10th = round(cumulative_dist_percentile_value(min_cdf, 10.0));
-        double mint_25th = round(cumulative_dist_percentile_value(min_cdf, 25.0));
-        double mint_50th = round(cumulative_dist_percentile_value(min_cdf, 50.0));
-        double mint_75th = round(cumulative_dist_percentile_value(min_cdf, 75.0));
-        double mint_90th = round(cumulative_dist_percentile_value(min_cdf, 90.0));
+        double min_pct_vals[5] = {0};
+        cumulative_dist_percentile_values(min_cdf, 5, pcts, min_pct_vals);
+
+        double mint_10th = round(min_pct_vals[0]);
+        double mint_25th = round(min_pct_vals[1]);
+        double mint_50th = round(min_pct_vals[2]);
+        double mint_75th = round(min_pct_vals[3]);
+        double mint_90th = round(min_pct_vals[4]);
 
         table_set_value(tbl, 1, row, mint);
         table_set_value(tbl, 2, row, mint_10th);
@@ -215,11 +203,14 @@ add_summary_row_to_table(void *key, void *value, void *state)
     if (max_cdf) {
         double maxt = round(cumulative_dist_pm_value(max_cdf));
 
-        double maxt_10th = round(cumulative_dist_percentile_value(max_cdf, 10.0));
-        double maxt_25th = round(cumulative_dist_percentile_value(max_cdf, 25.0));
-        double maxt_50th = round(cumulative_dist_percentile_value(max_cdf, 50.0));
-        double maxt_75th = round(cumulative_dist_percentile_value(max_cdf, 75.0));
-        double maxt_90th = round(cumulative_dist_percentile_value(max_cdf, 90.0));
+        double max_pct_vals[5] = {0};
+        cumulative_dist_percentile_values(max_cdf, 5, pcts, max_pct_vals);
+
+        double maxt_10th = round(max_pct_vals[0]);
+        double maxt_25th = round(max_pct_vals[1]);
+        double maxt_50th = round(max_pct_vals[2]);
+        double maxt_75th = round(max_pct_vals[3]);
+        double maxt_90th = round(max_pct_vals[4]);
 
         table_set_value(tbl, 7, row, maxt);
         table_set_value(tbl, 8, row, maxt_10th);
@@ -238,27 +229,27 @@ static int
 add_row_scenario_to_table(void *key, void *value, void *state)
 {
     time_t *vt = key;
-    GList *scenarios = value;
+    ScenarioList const *scenarios = value;
 
     struct TableFillerState *tbl_state = state;
     Table *tbl = tbl_state->tbl;
     int row = tbl_state->row;
 
     char datebuf[64] = {0};
-    strftime(datebuf, sizeof(datebuf), "%a, %Y-%m-%d", gmtime(vt));
+    struct tm vt_tm = {0};
+    strftime(datebuf, sizeof(datebuf), "%a, %Y-%m-%d", gmtime_r(vt, &vt_tm));
 
     table_set_string_value(tbl, 0, row, strlen(datebuf), datebuf);
 
-    size_t scenario_num = 1;
-    for (GList *curr = scenarios; curr && scenario_num <= 4; curr = curr->next, scenario_num++) {
-        struct Scenario *sc = curr->data;
+    for (int i = 0; i < scenario_list_len(scenarios); i++) {
+        Scenario const *sc = scenario_list_get(scenarios, i);
 
         double min = round(scenario_get_minimum(sc));
         double mode = round(scenario_get_mode(sc));
         double max = round(scenario_get_maximum(sc));
         double prob = round(scenario_get_probability(sc) * 100.0);
 
-        table_set_scenario(tbl, scenario_num, row, mode, min, max, prob);
+        table_set_scenario(tbl, i + 1, row, mode, min, max, prob);
     }
 
     tbl_state->row++;
@@ -271,12 +262,12 @@ add_max_to_pairs(void *key, void *value, void *data)
 {
     time_t *vt = key;
     struct CumulativeDistribution *max_cdf = value;
-    GTree *pairs = data;
+    TimeSeries *pairs = data;
 
     struct CDF_Pair *val = 0;
-    if (!(val = g_tree_lookup(pairs, vt))) {
+    if (!(val = time_series_lookup(pairs, *vt))) {
         val = calloc(1, sizeof(struct CDF_Pair));
-        g_tree_insert(pairs, vt, val);
+        time_series_insert(pairs, *vt, val);
     }
 
     val->maxs = max_cdf;
@@ -289,12 +280,12 @@ add_min_to_pairs(void *key, void *value, void *data)
 {
     time_t *vt = key;
     struct CumulativeDistribution *min_cdf = value;
-    GTree *pairs = data;
+    TimeSeries *pairs = data;
 
     struct CDF_Pair *val = 0;
-    if (!(val = g_tree_lookup(pairs, vt))) {
+    if (!(val = time_series_lookup(pairs, *vt))) {
         val = calloc(1, sizeof(struct CDF_Pair));
-        g_tree_insert(pairs, vt, val);
+        time_series_insert(pairs, *vt, val);
     }
 
     val->mins = min_cdf;
@@ -302,13 +293,13 @@ add_min_to_pairs(void *key, void *value, void *data)
     return false;
 }
 
-static GTree *
-create_joint_temperature_table(GTree *max_temps, GTree *min_temps)
+static TimeSeries *
+create_joint_temperature_table(TimeSeries *max_temps, TimeSeries *min_temps)
 {
-    GTree *cdf_pairs = g_tree_new_full(time_t_compare_func, 0, 0, 0);
+    TimeSeries *cdf_pairs = time_series_new(time_series_len(max_temps), free);
 
-    g_tree_foreach(max_temps, add_max_to_pairs, cdf_pairs);
-    g_tree_foreach(min_temps, add_min_to_pairs, cdf_pairs);
+    time_series_foreach(max_temps, add_max_to_pairs, cdf_pairs);
+    time_series_foreach(min_temps, add_min_to_pairs, cdf_pairs);
 
     return cdf_pairs;
 }
@@ -317,15 +308,15 @@ create_joint_temperature_table(GTree *max_temps, GTree *min_temps)
  *                                    External API functions.
  *-----------------------------------------------------------------------------------------------*/
 void
-show_temp_summary(struct TempSum *tsum)
+show_temp_summary(struct TempSum *tsum, FILE *out)
 {
     if (!tsum->max_cdfs || !tsum->min_cdfs) {
         temp_sum_build_cdfs(tsum);
     }
 
-    GTree *merge = create_joint_temperature_table(tsum->max_cdfs, tsum->min_cdfs);
+    TimeSeries *merge = create_joint_temperature_table(tsum->max_cdfs, tsum->min_cdfs);
 
-    int num_rows = g_tree_nnodes(merge);
+    int num_rows = time_series_len(merge);
 
     Table *tbl = table_new(13, num_rows);
     build_title(tsum, tbl, 0, SUMMARY);
@@ -350,14 +341,15 @@ show_temp_summary(struct TempSum *tsum)
     table_set_double_left_border(tbl, 7);
 
     struct TableFillerState state = {.row = 0, .tbl = tbl};
-    g_tree_foreach(merge, add_summary_row_to_table, &state);
+    time_series_foreach(merge, add_summary_row_to_table, &state);
 
-    table_display(tbl, stdout);
+    table_display(tbl, out);
     table_free(&tbl);
+    time_series_free(&merge);
 }
 
 void
-show_temp_scenarios(struct TempSum *tsum)
+show_temp_scenarios(struct TempSum *tsum, FILE *out)
 {
     assert(tsum);
     if (!tsum->max_scenarios || !tsum->min_scenarios) {
@@ -366,14 +358,14 @@ show_temp_scenarios(struct TempSum *tsum)
 
     assert(tsum->max_scenarios && tsum->min_scenarios);
 
-    GTree *max_scenarios = tsum->max_scenarios;
-    GTree *min_scenarios = tsum->min_scenarios;
+    TimeSeries *max_scenarios = tsum->max_scenarios;
+    TimeSeries *min_scenarios = tsum->min_scenarios;
     assert(max_scenarios && min_scenarios);
 
     // Build the MaxT scenarios table..
-    int num_rows = g_tree_nnodes(max_scenarios);
+    int num_rows = time_series_len(max_scenarios);
     if (num_rows == 0) {
-        printf("\n\n     ***** No max temperature scenarios. *****\n\n");
+        fprintf(out, "\n\n     ***** No max temperature scenarios. *****\n\n");
         return;
     }
 
@@ -399,15 +391,15 @@ show_temp_scenarios(struct TempSum *tsum)
     }
 
     struct TableFillerState state = {.row = 0, .tbl = tbl};
-    g_tree_foreach(max_scenarios, add_row_scenario_to_table, &state);
+    time_series_foreach(max_scenarios, add_row_scenario_to_table, &state);
 
-    table_display(tbl, stdout);
+    table_display(tbl, out);
     table_free(&tbl);
 
     // Show the scenarios for MinT
-    num_rows = g_tree_nnodes(min_scenarios);
+    num_rows = time_series_len(min_scenarios);
     if (num_rows == 0) {
-        printf("\n\n     ***** No min temperature scenarios. *****\n\n");
+        fprintf(out, "\n\n     ***** No min temperature scenarios. *****\n\n");
         return;
     }
 
@@ -433,12 +425,50 @@ show_temp_scenarios(struct TempSum *tsum)
     }
 
     state = (struct TableFillerState){.row = 0, .tbl = tbl};
-    g_tree_foreach(min_scenarios, add_row_scenario_to_table, &state);
+    time_series_foreach(min_scenarios, add_row_scenario_to_table, &state);
 
-    table_display(tbl, stdout);
+    table_display(tbl, out);
     table_free(&tbl);
 }
 
+void
+temp_sum_write_records(struct TempSum *tsum, bool summary, bool scenarios, RecordWriter *w)
+{
+    assert(tsum);
+
+    if (summary) {
+        if (!tsum->max_cdfs || !tsum->min_cdfs) {
+            temp_sum_build_cdfs(tsum);
+        }
+
+        TimeSeries *merge = create_joint_temperature_table(tsum->max_cdfs, tsum->min_cdfs);
+
+        for (size_t i = 0; i < time_series_len(merge); i++) {
+            struct CDF_Pair const *pair = time_series_value(merge, i);
+
+            record_begin(w, "temperature", time_series_time(merge, i));
+            if (pair->mins) {
+                record_add_cdf(w, "min_", pair->mins, 0, 0);
+            }
+            if (pair->maxs) {
+                record_add_cdf(w, "max_", pair->maxs, 0, 0);
+            }
+            record_end(w);
+        }
+
+        time_series_free(&merge);
+    }
+
+    if (scenarios) {
+        if (!tsum->max_scenarios || !tsum->min_scenarios) {
+            temp_sum_build_scenarios(tsum);
+        }
+
+        records_write_scenarios(w, "max_temperature_scenarios", tsum->max_scenarios);
+        records_write_scenarios(w, "min_temperature_scenarios", tsum->min_scenarios);
+    }
+}
+
 static int
 write_cdf(void *key, void *value, void *state)
 {
@@ -447,7 +477,8 @@ write_cdf(void *key, void *value, void *state)
     FILE *f = state;
 
     char datebuf[64] = {0};
-    strftime(datebuf, sizeof(datebuf), "%a %Y-%m-%d", gmtime(vt));
+    struct tm vt_tm = {0};
+    strftime(datebuf, sizeof(datebuf), "%a %Y-%m-%d", gmtime_r(vt, &vt_tm));
 
     fprintf(f, "\n\n\"%s\"\n", datebuf);
 
@@ -464,7 +495,8 @@ write_pdf(void *key, void *value, void *state)
     FILE *f = state;
 
     char datebuf[64] = {0};
-    strftime(datebuf, sizeof(datebuf), "%a %Y-%m-%d", gmtime(vt));
+    struct tm vt_tm = {0};
+    strftime(datebuf, sizeof(datebuf), "%a %Y-%m-%d", gmtime_r(vt, &vt_tm));
 
     fprintf(f, "\n\n\"%s\"\n", datebuf);
 
@@ -477,16 +509,17 @@ static int
 write_scenario(void *key, void *value, void *state)
 {
     time_t *vt = key;
-    GList *scenarios = value;
+    ScenarioList const *scenarios = value;
     FILE *f = state;
 
     char datebuf[64] = {0};
-    strftime(datebuf, sizeof(datebuf), "%a %Y-%m-%d", gmtime(vt));
+    struct tm vt_tm = {0};
+    strftime(datebuf, sizeof(datebuf), "%a %Y-%m-%d", gmtime_r(vt, &vt_tm));
 
     fprintf(f, "\n\n\"%s\"\n", datebuf);
 
-    for (GList *curr = scenarios; curr; curr = curr->next) {
-        Scenario *sc = curr->data;
+    for (int i = 0; i < scenario_list_len(scenarios); i++) {
+        Scenario const *sc = scenario_list_get(scenarios, i);
 
         fprintf(f, "%8lf %8lf %8lf %8lf\n", scenario_get_minimum(sc), scenario_get_mode(sc),
                 scenario_get_maximum(sc), scenario_get_probability(sc));
@@ -496,8 +529,8 @@ write_scenario(void *key, void *value, void *state)
 }
 
 static void
-do_save_distributions(char const *dir, char const *f_pfx, char const *element, GTree *cdfs,
-                      GTree *pdfs, GTree *scenarios)
+do_save_distributions(char const *dir, char const *f_pfx, char const *element, TimeSeries *cdfs,
+                      TimeSeries *pdfs, TimeSeries *scenarios)
 {
     char *sep = "";
     if (f_pfx)
@@ -521,9 +554,9 @@ do_save_distributions(char const *dir, char const *f_pfx, char const *element, G
     FILE *scenario_f = fopen(scenario_path, "w");
     Stopif(!scenario_f, return, "Unable to open scenarios.dat");
 
-    g_tree_foreach(cdfs, write_cdf, cdf_f);
-    g_tree_foreach(pdfs, write_pdf, pdf_f);
-    g_tree_foreach(scenarios, write_scenario, scenario_f);
+    time_series_foreach(cdfs, write_cdf, cdf_f);
+    time_series_foreach(pdfs, write_pdf, pdf_f);
+    time_series_foreach(scenarios, write_scenario, scenario_f);
 
     fclose(cdf_f);
     fclose(pdf_f);
@@ -554,6 +587,56 @@ temp_sum_save(struct TempSum *tsum, char const *directory, char const *file_pref
                           tsum->min_scenarios);
 }
 
+void
+temp_sum_archive(struct TempSum *tsum, DistArchiveWriter *writer)
+{
+    assert(tsum);
+
+    if (!tsum->max_scenarios || !tsum->min_scenarios) {
+        temp_sum_build_scenarios(tsum);
+    }
+
+    dist_archive_add(writer, "max_temperature", tsum->max_cdfs, tsum->max_pdfs,
+                     tsum->max_scenarios);
+    dist_archive_add(writer, "min_temperature", tsum->min_cdfs, tsum->min_pdfs,
+                     tsum->min_scenarios);
+}
+
+void
+temp_sum_prepare(struct TempSum *tsum, bool scenarios)
+{
+    assert(tsum);
+
+    if (!tsum->max_cdfs || !tsum->min_cdfs) {
+        temp_sum_build_cdfs(tsum);
+    }
+
+    if (!scenarios) {
+        return;
+    }
+
+    if (!tsum->max_pdfs || !tsum->min_pdfs) {
+        temp_sum_build_pdfs(tsum);
+    }
+
+    if (!tsum->max_scenarios || !tsum->min_scenarios) {
+        temp_sum_build_scenarios(tsum);
+    }
+}
+
+size_t
+temp_sum_memory_bytes(struct TempSum const *tsum)
+{
+    assert(tsum);
+
+    return sizeof(*tsum) + strlen(tsum->id) + strlen(tsum->name) + 2 +
+           arena_memory_bytes(tsum->arena) + time_series_memory_bytes(tsum->max_cdfs) +
+           time_series_memory_bytes(tsum->max_pdfs) +
+           time_series_memory_bytes(tsum->max_scenarios) +
+           time_series_memory_bytes(tsum->min_cdfs) + time_series_memory_bytes(tsum->min_pdfs) +
+           time_series_memory_bytes(tsum->min_scenarios);
+}
+
 void
 temp_sum_free(struct TempSum **tsum)
 {
@@ -561,25 +644,27 @@ temp_sum_free(struct TempSum **tsum)
     struct TempSum *ptr = *tsum;
 
     if (ptr->max_cdfs) {
-        g_tree_unref(ptr->max_cdfs);
+        time_series_free(&ptr->max_cdfs);
     }
     if (ptr->max_pdfs) {
-        g_tree_unref(ptr->max_pdfs);
+        time_series_free(&ptr->max_pdfs);
     }
     if (ptr->max_scenarios) {
-        g_tree_unref(ptr->max_scenarios);
+        time_series_free(&ptr->max_scenarios);
     }
 
     if (ptr->min_cdfs) {
-        g_tree_unref(ptr->min_cdfs);
+        time_series_free(&ptr->min_cdfs);
     }
     if (ptr->min_pdfs) {
-        g_tree_unref(ptr->min_pdfs);
+        time_series_free(&ptr->min_pdfs);
     }
     if (ptr->min_scenarios) {
-        g_tree_unref(ptr->min_scenarios);
+        time_series_free(&ptr->min_scenarios);
     }
 
+    arena_free(&ptr->arena);
+
     free(ptr->id);
     free(ptr->name);
 
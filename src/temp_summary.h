@@ -1,5 +1,11 @@
 #pragma once
 
+#include <stdbool.h>
+#include <stdio.h>
+
+#include "dist_archive.h"
+#include "records.h"
+
 /** A temperature summary. */
 typedef struct TempSum TempSum;
 
@@ -10,10 +16,19 @@ typedef struct TempSum TempSum;
 TempSum *temp_sum_build(NBMData const *nbm);
 
 /** Print a probabilistic summary. */
-void show_temp_summary(TempSum *tsum);
+void show_temp_summary(TempSum *tsum, FILE *out);
 
 /** Print a summary of temperatures scenarios. */
-void show_temp_scenarios(TempSum *tsum);
+void show_temp_scenarios(TempSum *tsum, FILE *out);
+
+/** Write the summary and/or the scenarios as machine readable records.
+ *
+ * \param tsum is the summary to write.
+ * \param summary is whether to write the max/min temperature quantiles.
+ * \param scenarios is whether to write the max and min temperature scenarios.
+ * \param w is where to write the records.
+ */
+void temp_sum_write_records(TempSum *tsum, bool summary, bool scenarios, RecordWriter *w);
 
 /** Save two files with the CDF and PDF information in them.
  *
@@ -26,5 +41,23 @@ void show_temp_scenarios(TempSum *tsum);
  */
 void temp_sum_save(TempSum *tsum, char const *directory, char const *file_prefix);
 
+/** Add the CDFs, PDFs, and scenarios to a binary archive, building them if needed. */
+void temp_sum_archive(TempSum *tsum, DistArchiveWriter *writer);
+
+/** Build the CDFs, and the PDFs and scenarios if asked, instead of the first time they are used.
+ *
+ * Once they are built, showing, writing, saving, or archiving the summary only reads it, so it can
+ * be done from several threads at once.
+ *
+ * \param scenarios is whether the PDFs and scenarios will be needed.
+ */
+void temp_sum_prepare(TempSum *tsum, bool scenarios);
+
+/** Get the approximate number of bytes of memory used by a \c TempSum.
+ *
+ * This includes the CDFs, PDFs, and scenarios that have been built so far.
+ */
+size_t temp_sum_memory_bytes(TempSum const *tsum);
+
 /** Free the memory associated with a \c TempSum.*/
 void temp_sum_free(TempSum **tsum);
@@ -0,0 +1,164 @@
+#include "time_series.h"
+
+#include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+
+/*-------------------------------------------------------------------------------------------------
+ *                                          TimeSeries
+ *-----------------------------------------------------------------------------------------------*/
+/** Internal implementation of \ref TimeSeries. */
+struct TimeSeries {
+    size_t size;
+    size_t capacity;
+    time_t *times;
+    void **values;
+    void (*free_value)(void *);
+};
+
+TimeSeries *
+time_series_new(size_t capacity, void (*free_value)(void *))
+{
+    if (capacity < 1) {
+        capacity = 1;
+    }
+
+    struct TimeSeries *ts = malloc(sizeof(struct TimeSeries));
+    assert(ts);
+
+    *ts = (struct TimeSeries){.size = 0,
+                              .capacity = capacity,
+                              .times = malloc(capacity * sizeof(time_t)),
+                              .values = malloc(capacity * sizeof(void *)),
+                              .free_value = free_value};
+    assert(ts->times && ts->values);
+
+    return ts;
+}
+
+void
+time_series_free(TimeSeries **ptrptr)
+{
+    struct TimeSeries *ts = *ptrptr;
+
+    if (ts) {
+        if (ts->free_value) {
+            for (size_t i = 0; i < ts->size; i++) {
+                ts->free_value(ts->values[i]);
+            }
+        }
+
+        free(ts->times);
+        free(ts->values);
+        free(ts);
+    }
+
+    *ptrptr = 0;
+}
+
+size_t
+time_series_len(TimeSeries const *ts)
+{
+    return ts->size;
+}
+
+time_t
+time_series_time(TimeSeries const *ts, size_t index)
+{
+    assert(index < ts->size);
+    return ts->times[index];
+}
+
+void *
+time_series_value(TimeSeries const *ts, size_t index)
+{
+    assert(index < ts->size);
+    return ts->values[index];
+}
+
+/** Find the index of the first valid time that is not before \a valid_time. */
+static size_t
+lower_bound(TimeSeries const *ts, time_t valid_time)
+{
+    size_t lo = 0;
+    size_t hi = ts->size;
+
+    while (lo < hi) {
+        size_t mid = lo + (hi - lo) / 2;
+        if (ts->times[mid] < valid_time) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+
+    return lo;
+}
+
+void *
+time_series_lookup(TimeSeries const *ts, time_t valid_time)
+{
+    // Most lookups are for the latest value while the series is being built.
+    if (ts->size > 0 && ts->times[ts->size - 1] == valid_time) {
+        return ts->values[ts->size - 1];
+    }
+
+    size_t i = lower_bound(ts, valid_time);
+    if (i < ts->size && ts->times[i] == valid_time) {
+        return ts->values[i];
+    }
+
+    return 0;
+}
+
+void
+time_series_insert(TimeSeries *ts, time_t valid_time, void *value)
+{
+    size_t i = ts->size;
+    if (ts->size > 0 && ts->times[ts->size - 1] >= valid_time) {
+        i = lower_bound(ts, valid_time);
+
+        // A repeated valid time replaces the value, the same as inserting into a GTree did.
+        if (ts->times[i] == valid_time) {
+            if (ts->free_value) {
+                ts->free_value(ts->values[i]);
+            }
+            ts->values[i] = value;
+            return;
+        }
+    }
+
+    if (ts->size == ts->capacity) {
+        ts->capacity *= 2;
+        ts->times = realloc(ts->times, ts->capacity * sizeof(time_t));
+        ts->values = realloc(ts->values, ts->capacity * sizeof(void *));
+        assert(ts->times && ts->values);
+    }
+
+    memmove(&ts->times[i + 1], &ts->times[i], (ts->size - i) * sizeof(time_t));
+    memmove(&ts->values[i + 1], &ts->values[i], (ts->size - i) * sizeof(void *));
+
+    ts->times[i] = valid_time;
+    ts->values[i] = value;
+    ts->size++;
+}
+
+void
+time_series_foreach(TimeSeries *ts, TimeSeriesFunc func, void *user_data)
+{
+    for (size_t i = 0; i < ts->size; i++) {
+        if (func(&ts->times[i], ts->values[i], user_data)) {
+            break;
+        }
+    }
+}
+
+size_t
+time_series_memory_bytes(TimeSeries const *ts)
+{
+    if (!ts) {
+        return 0;
+    }
+
+    return sizeof(*ts) + ts->capacity * (sizeof(time_t) + sizeof(void *));
+}
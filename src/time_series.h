@@ -0,0 +1,69 @@
+#pragma once
+
+#include <stddef.h>
+#include <time.h>
+
+/*-------------------------------------------------------------------------------------------------
+ *                                          TimeSeries
+ *-----------------------------------------------------------------------------------------------*/
+/** A collection of values ordered by valid time.
+ *
+ * The valid times are kept in one sorted array and the values in a parallel array. The data
+ * usually arrives in order, so adding values is almost always an append, and looking up a time is
+ * a binary search over contiguous memory.
+ */
+typedef struct TimeSeries TimeSeries;
+
+/** Called on each value in a \c TimeSeries.
+ *
+ * \param valid_time points to the \c time_t valid time of the value.
+ * \param value is the value.
+ * \param user_data is the state passed to time_series_foreach().
+ *
+ * \returns non-zero to stop iterating.
+ */
+typedef int (*TimeSeriesFunc)(void *valid_time, void *value, void *user_data);
+
+/** Create a new, empty \c TimeSeries.
+ *
+ * \param capacity is how many values to make room for, it grows as needed.
+ * \param free_value is used to free the values when the series is freed, it may be \c NULL.
+ */
+TimeSeries *time_series_new(size_t capacity, void (*free_value)(void *));
+
+/** Free a \c TimeSeries and all the values in it, and nullify the pointer. */
+void time_series_free(TimeSeries **ts);
+
+/** Get the number of values in the series. */
+size_t time_series_len(TimeSeries const *ts);
+
+/** Get the valid time at an index. */
+time_t time_series_time(TimeSeries const *ts, size_t index);
+
+/** Get the value at an index. */
+void *time_series_value(TimeSeries const *ts, size_t index);
+
+/** Find the value for a valid time.
+ *
+ * \returns the value, or \c NULL if there is no value for \a valid_time.
+ */
+void *time_series_lookup(TimeSeries const *ts, time_t valid_time);
+
+/** Add a value.
+ *
+ * If there is already a value for \a valid_time it is freed and replaced. The series takes
+ * ownership of \a value.
+ */
+void time_series_insert(TimeSeries *ts, time_t valid_time, void *value);
+
+/** Call a function on each value in order of valid time.
+ *
+ * The function may change the valid time as long as it doesn't change the order of the values.
+ */
+void time_series_foreach(TimeSeries *ts, TimeSeriesFunc func, void *user_data);
+
+/** Get the number of bytes of memory used by the series, not counting what the values point to.
+ *
+ * A \c NULL series uses no memory.
+ */
+size_t time_series_memory_bytes(TimeSeries const *ts);
@@ -14,9 +14,10 @@ struct WindSum {
     char *name;
     time_t init_time;
 
-    GTree *cdfs;
-    GTree *pdfs;
-    GTree *scenarios;
+    Arena *arena;
+    TimeSeries *cdfs;
+    TimeSeries *pdfs;
+    TimeSeries *scenarios;
 };
 
 #define NUM_PROB_EXC_VALS 6
@@ -24,8 +25,12 @@ static char const *exc_vals[NUM_PROB_EXC_VALS] = {
     "5", "8", "11", "17", "24", "32",
 };
 
-static GTree *
-build_cdfs(NBMData const *nbm)
+/** The thresholds the probabilities of exceedance are shown for, in mph. */
+static double const summary_exc_vals[] = {15, 20, 25, 30, 35, 40};
+#define NUM_SUMMARY_EXC_VALS (sizeof(summary_exc_vals) / sizeof(summary_exc_vals[0]))
+
+static TimeSeries *
+build_cdfs(Arena *arena, NBMData const *nbm)
 {
     char percentile_format[40] = {0};
     char deterministic_wind_key[32] = {0};
@@ -33,14 +38,13 @@ build_cdfs(NBMData const *nbm)
     sprintf(percentile_format, "WIND24hr_10 m above ground_%%d%%%% level");
     sprintf(deterministic_wind_key, "WIND24hr_10 m above ground");
 
-    GTree *cdfs = extract_cdfs(nbm, percentile_format, deterministic_wind_key, mps_to_mph);
-    Stopif(!cdfs, return 0, "Error extracting CDFs for Wind.");
-
     char prob_exceedence_format[40] = {0};
     sprintf(prob_exceedence_format, "WIND24hr_10 m above ground_prob >%%s");
 
-    cdfs = extract_exceedence_to_cdfs(cdfs, nbm, prob_exceedence_format, NUM_PROB_EXC_VALS,
-                                      exc_vals, mps_to_mph);
+    TimeSeries *cdfs = extract_cdfs(arena, nbm, percentile_format, deterministic_wind_key,
+                                    prob_exceedence_format, NUM_PROB_EXC_VALS, exc_vals,
+                                    mps_to_mph);
+    Stopif(!cdfs, return 0, "Error extracting CDFs for Wind.");
 
     return cdfs;
 }
@@ -55,7 +59,8 @@ wind_sum_build(NBMData const *nbm)
     new->name = strdup(nbm_data_site_name(nbm));
     new->init_time = nbm_data_init_time(nbm);
 
-    new->cdfs = build_cdfs(nbm);
+    new->arena = arena_new();
+    new->cdfs = build_cdfs(new->arena, nbm);
     Stopif(!new->cdfs, goto ERR_RETURN, "Error extracting CDFs for Wind.");
 
     new->pdfs = 0;
@@ -75,7 +80,8 @@ static void
 build_title(struct WindSum const *wsum, Table *tbl, int type)
 {
     char title_buf[256] = {0};
-    struct tm init = *gmtime(&wsum->init_time);
+    struct tm init = {0};
+    gmtime_r(&wsum->init_time, &init);
 
     if (type == SUMMARY) {
         sprintf(title_buf, "24 Hr Probabilistic Max Wind Speed for %s (%s) - ", wsum->name,
@@ -103,21 +109,29 @@ add_row_prob_wind_exceedence_to_table(void *key, void *value, void *state)
 
     double pm_value = round(cumulative_dist_pm_value(dist));
 
-    double p10th = round(cumulative_dist_percentile_value(dist, 10.0));
-    double p25th = round(cumulative_dist_percentile_value(dist, 25.0));
-    double p50th = round(cumulative_dist_percentile_value(dist, 50.0));
-    double p75th = round(cumulative_dist_percentile_value(dist, 75.0));
-    double p90th = round(cumulative_dist_percentile_value(dist, 90.0));
+    static double const pcts[5] = {10.0, 25.0, 50.0, 75.0, 90.0};
+    double pct_vals[5] = {0};
+    cumulative_dist_percentile_values(dist, 5, pcts, pct_vals);
+
+    double p10th = round(pct_vals[0]);
+    double p25th = round(pct_vals[1]);
+    double p50th = round(pct_vals[2]);
+    double p75th = round(pct_vals[3]);
+    double p90th = round(pct_vals[4]);
 
-    double prob_15 = round(interpolate_prob_of_exceedance(dist, 15));
-    double prob_20 = round(interpolate_prob_of_exceedance(dist, 20));
-    double prob_25 = round(interpolate_prob_of_exceedance(dist, 25));
-    double prob_30 = round(interpolate_prob_of_exceedance(dist, 30));
-    double prob_35 = round(interpolate_prob_of_exceedance(dist, 35));
-    double prob_40 = round(interpolate_prob_of_exceedance(dist, 40));
+    double probs[NUM_SUMMARY_EXC_VALS] = {0};
+    interpolate_probs_of_exceedance(dist, NUM_SUMMARY_EXC_VALS, summary_exc_vals, probs);
+
+    double prob_15 = round(probs[0]);
+    double prob_20 = round(probs[1]);
+    double prob_25 = round(probs[2]);
+    double prob_30 = round(probs[3]);
+    double prob_35 = round(probs[4]);
+    double prob_40 = round(probs[5]);
 
     char datebuf[64] = {0};
-    strftime(datebuf, sizeof(datebuf), "%a, %Y-%m-%d %HZ", gmtime(vt));
+    struct tm vt_tm = {0};
+    strftime(datebuf, sizeof(datebuf), "%a, %Y-%m-%d %HZ", gmtime_r(vt, &vt_tm));
 
     table_set_string_value(tbl, 0, row, strlen(datebuf), datebuf);
 
@@ -142,19 +156,19 @@ add_row_prob_wind_exceedence_to_table(void *key, void *value, void *state)
 }
 
 void
-show_wind_summary(struct WindSum const *wsum)
+show_wind_summary(struct WindSum const *wsum, FILE *out)
 {
     assert(wsum);
 
     char left_col_title[32] = {0};
     sprintf(left_col_title, "24 Hrs Ending");
 
-    GTree *cdfs = wsum->cdfs;
+    TimeSeries *cdfs = wsum->cdfs;
     assert(cdfs);
 
-    int num_rows = g_tree_nnodes(cdfs);
+    int num_rows = time_series_len(cdfs);
     if (num_rows == 0) {
-        printf("\n\n     ***** No wind summary. *****\n\n");
+        fprintf(out, "\n\n     ***** No wind summary. *****\n\n");
         return;
     }
 
@@ -188,40 +202,21 @@ show_wind_summary(struct WindSum const *wsum)
     }
 
     struct TableFillerState state = {.row = 0, .tbl = tbl};
-    g_tree_foreach(cdfs, add_row_prob_wind_exceedence_to_table, &state);
+    time_series_foreach(cdfs, add_row_prob_wind_exceedence_to_table, &state);
 
-    table_display(tbl, stdout);
+    table_display(tbl, out);
 
     table_free(&tbl);
 
     return;
 }
 
-static int
-create_pdf_from_cdf_and_add_too_pdf_tree(void *key, void *val, void *data)
-{
-    CumulativeDistribution *cdf = val;
-    GTree *pdfs = data;
-
-    ProbabilityDistribution *pdf = probability_dist_calc(cdf);
-
-    g_tree_insert(pdfs, key, pdf);
-
-    return false;
-}
-
 static void
 wind_sum_build_pdfs(struct WindSum *wsum)
 {
     assert(wsum && wsum->cdfs);
 
-    // Don't free the keys, we'll just point those to the same location as the keys
-    // used in the GTree of CDFs.
-    GTree *pdfs = g_tree_new_full(time_t_compare_func, 0, 0, probability_dist_free);
-
-    g_tree_foreach(wsum->cdfs, create_pdf_from_cdf_and_add_too_pdf_tree, pdfs);
-
-    wsum->pdfs = pdfs;
+    wsum->pdfs = create_pdfs_from_cdfs(wsum->arena, wsum->cdfs);
 }
 
 static void
@@ -229,7 +224,7 @@ wind_sum_build_scenarios(struct WindSum *wsum)
 {
     assert(wsum && wsum->cdfs && wsum->pdfs);
 
-    GTree *scenarios = create_scenarios_from_pdfs(wsum->pdfs, 1.0, 2.0);
+    TimeSeries *scenarios = create_scenarios_from_pdfs(wsum->arena, wsum->pdfs, 1.0, 2.0);
     assert(scenarios);
 
     wsum->scenarios = scenarios;
@@ -239,27 +234,27 @@ static int
 add_row_scenario_to_table(void *key, void *value, void *state)
 {
     time_t *vt = key;
-    GList *scenarios = value;
+    ScenarioList const *scenarios = value;
 
     struct TableFillerState *tbl_state = state;
     Table *tbl = tbl_state->tbl;
     int row = tbl_state->row;
 
     char datebuf[64] = {0};
-    strftime(datebuf, sizeof(datebuf), "%a, %Y-%m-%d %HZ", gmtime(vt));
+    struct tm vt_tm = {0};
+    strftime(datebuf, sizeof(datebuf), "%a, %Y-%m-%d %HZ", gmtime_r(vt, &vt_tm));
 
     table_set_string_value(tbl, 0, row, strlen(datebuf), datebuf);
 
-    size_t scenario_num = 1;
-    for (GList *curr = scenarios; curr && scenario_num <= 4; curr = curr->next, scenario_num++) {
-        struct Scenario *sc = curr->data;
+    for (int i = 0; i < scenario_list_len(scenarios); i++) {
+        Scenario const *sc = scenario_list_get(scenarios, i);
 
         double min = round(scenario_get_minimum(sc));
         double mode = round(scenario_get_mode(sc));
         double max = round(scenario_get_maximum(sc));
         double prob = round(scenario_get_probability(sc) * 100.0);
 
-        table_set_scenario(tbl, scenario_num, row, mode, min, max, prob);
+        table_set_scenario(tbl, i + 1, row, mode, min, max, prob);
     }
 
     tbl_state->row++;
@@ -268,7 +263,7 @@ add_row_scenario_to_table(void *key, void *value, void *state)
 }
 
 void
-show_wind_scenarios(struct WindSum *wsum)
+show_wind_scenarios(struct WindSum *wsum, FILE *out)
 {
     assert(wsum);
     if (!wsum->pdfs) {
@@ -284,12 +279,12 @@ show_wind_scenarios(struct WindSum *wsum)
     char left_col_title[32] = {0};
     sprintf(left_col_title, "24 Hrs Ending");
 
-    GTree *scenarios = wsum->scenarios;
+    TimeSeries *scenarios = wsum->scenarios;
     assert(scenarios);
 
-    int num_rows = g_tree_nnodes(scenarios);
+    int num_rows = time_series_len(scenarios);
     if (num_rows == 0) {
-        printf("\n\n     ***** No wind scenarios. *****\n\n");
+        fprintf(out, "\n\n     ***** No wind scenarios. *****\n\n");
         return;
     }
 
@@ -315,13 +310,35 @@ show_wind_scenarios(struct WindSum *wsum)
     table_set_double_left_border(tbl, 4);
 
     struct TableFillerState state = {.row = 0, .tbl = tbl};
-    g_tree_foreach(scenarios, add_row_scenario_to_table, &state);
+    time_series_foreach(scenarios, add_row_scenario_to_table, &state);
 
-    table_display(tbl, stdout);
+    table_display(tbl, out);
 
     table_free(&tbl);
 }
 
+void
+wind_sum_write_records(WindSum *wsum, bool summary, bool scenarios, RecordWriter *w)
+{
+    assert(wsum && wsum->cdfs);
+
+    if (summary) {
+        records_write_cdfs(w, "wind", wsum->cdfs, NUM_SUMMARY_EXC_VALS, summary_exc_vals);
+    }
+
+    if (scenarios) {
+        if (!wsum->pdfs) {
+            wind_sum_build_pdfs(wsum);
+        }
+
+        if (!wsum->scenarios) {
+            wind_sum_build_scenarios(wsum);
+        }
+
+        records_write_scenarios(w, "wind_scenarios", wsum->scenarios);
+    }
+}
+
 static int
 write_cdf(void *key, void *value, void *state)
 {
@@ -330,7 +347,8 @@ write_cdf(void *key, void *value, void *state)
     FILE *f = state;
 
     char datebuf[64] = {0};
-    strftime(datebuf, sizeof(datebuf), "%a, %Y-%m-%d %HZ", gmtime(vt));
+    struct tm vt_tm = {0};
+    strftime(datebuf, sizeof(datebuf), "%a, %Y-%m-%d %HZ", gmtime_r(vt, &vt_tm));
 
     fprintf(f, "\n\n\"Period ending: %s\"\n", datebuf);
 
@@ -347,7 +365,8 @@ write_pdf(void *key, void *value, void *state)
     FILE *f = state;
 
     char datebuf[64] = {0};
-    strftime(datebuf, sizeof(datebuf), "%a, %Y-%m-%d %HZ", gmtime(vt));
+    struct tm vt_tm = {0};
+    strftime(datebuf, sizeof(datebuf), "%a, %Y-%m-%d %HZ", gmtime_r(vt, &vt_tm));
 
     fprintf(f, "\n\n\"Period ending: %s\"\n", datebuf);
 
@@ -360,16 +379,17 @@ static int
 write_scenario(void *key, void *value, void *state)
 {
     time_t *vt = key;
-    GList *scenarios = value;
+    ScenarioList const *scenarios = value;
     FILE *f = state;
 
     char datebuf[64] = {0};
-    strftime(datebuf, sizeof(datebuf), "%a, %Y-%m-%d %HZ", gmtime(vt));
+    struct tm vt_tm = {0};
+    strftime(datebuf, sizeof(datebuf), "%a, %Y-%m-%d %HZ", gmtime_r(vt, &vt_tm));
 
     fprintf(f, "\n\n\"Period ending: %s\"\n", datebuf);
 
-    for (GList *curr = scenarios; curr; curr = curr->next) {
-        Scenario *sc = curr->data;
+    for (int i = 0; i < scenario_list_len(scenarios); i++) {
+        Scenario const *sc = scenario_list_get(scenarios, i);
 
         fprintf(f, "%8lf %8lf %8lf %8lf\n", scenario_get_minimum(sc), scenario_get_mode(sc),
                 scenario_get_maximum(sc), scenario_get_probability(sc));
@@ -414,15 +434,59 @@ wind_sum_save(struct WindSum *wsum, char const *directory, char const *file_pref
     FILE *scenario_f = fopen(scenario_path, "w");
     Stopif(!scenario_f, return, "Unable to open scenarios.dat");
 
-    g_tree_foreach(wsum->cdfs, write_cdf, cdf_f);
-    g_tree_foreach(wsum->pdfs, write_pdf, pdf_f);
-    g_tree_foreach(wsum->scenarios, write_scenario, scenario_f);
+    time_series_foreach(wsum->cdfs, write_cdf, cdf_f);
+    time_series_foreach(wsum->pdfs, write_pdf, pdf_f);
+    time_series_foreach(wsum->scenarios, write_scenario, scenario_f);
 
     fclose(cdf_f);
     fclose(pdf_f);
     fclose(scenario_f);
 }
 
+void
+wind_sum_archive(WindSum *wsum, DistArchiveWriter *writer)
+{
+    assert(wsum && wsum->cdfs);
+
+    if (!wsum->pdfs) {
+        wind_sum_build_pdfs(wsum);
+    }
+
+    if (!wsum->scenarios) {
+        wind_sum_build_scenarios(wsum);
+    }
+
+    dist_archive_add(writer, "wind", wsum->cdfs, wsum->pdfs, wsum->scenarios);
+}
+
+void
+wind_sum_prepare(struct WindSum *wsum, bool scenarios)
+{
+    assert(wsum && wsum->cdfs);
+
+    if (!scenarios) {
+        return;
+    }
+
+    if (!wsum->pdfs) {
+        wind_sum_build_pdfs(wsum);
+    }
+
+    if (!wsum->scenarios) {
+        wind_sum_build_scenarios(wsum);
+    }
+}
+
+size_t
+wind_sum_memory_bytes(struct WindSum const *wsum)
+{
+    assert(wsum);
+
+    return sizeof(*wsum) + strlen(wsum->id) + strlen(wsum->name) + 2 +
+           arena_memory_bytes(wsum->arena) + time_series_memory_bytes(wsum->cdfs) +
+           time_series_memory_bytes(wsum->pdfs) + time_series_memory_bytes(wsum->scenarios);
+}
+
 void
 wind_sum_free(struct WindSum **wsum)
 {
@@ -435,14 +499,16 @@ wind_sum_free(struct WindSum **wsum)
         free(ptr->name);
 
         if (ptr->scenarios) {
-            g_tree_unref(ptr->scenarios);
+            time_series_free(&ptr->scenarios);
         }
         if (ptr->pdfs) {
-            g_tree_unref(ptr->pdfs);
+            time_series_free(&ptr->pdfs);
         }
         if (ptr->cdfs) {
-            g_tree_unref(ptr->cdfs);
+            time_series_free(&ptr->cdfs);
         }
+
+        arena_free(&ptr->arena);
     }
 
     free(ptr);
@@ -1,6 +1,11 @@
 #pragma once
 
+#include <stdbool.h>
+#include <stdio.h>
+
+#include "dist_archive.h"
 #include "nbm_data.h"
+#include "records.h"
 
 /** A Wind Speed Summary. */
 typedef struct WindSum WindSum;
@@ -12,10 +17,19 @@ typedef struct WindSum WindSum;
 WindSum *wind_sum_build(NBMData const *nbm);
 
 /** Print a probabilistic summary. */
-void show_wind_summary(WindSum const *wsum);
+void show_wind_summary(WindSum const *wsum, FILE *out);
 
 /** Print a summary of the wind scenarios. */
-void show_wind_scenarios(WindSum *wsum);
+void show_wind_scenarios(WindSum *wsum, FILE *out);
+
+/** Write the summary and/or the scenarios as machine readable records.
+ *
+ * \param wsum is the summary to write.
+ * \param summary is whether to write the probabilistic summary.
+ * \param scenarios is whether to write the wind speed scenarios.
+ * \param w is where to write the records.
+ */
+void wind_sum_write_records(WindSum *wsum, bool summary, bool scenarios, RecordWriter *w);
 
 /** Save two files with the CDF and PDF information in them.
  *
@@ -28,5 +42,23 @@ void show_wind_scenarios(WindSum *wsum);
  */
 void wind_sum_save(WindSum *wsum, char const *directory, char const *file_prefix);
 
+/** Add the CDFs, PDFs, and scenarios to a binary archive, building them if needed. */
+void wind_sum_archive(WindSum *wsum, DistArchiveWriter *writer);
+
+/** Build the PDFs and scenarios now instead of the first time they are used.
+ *
+ * Once they are built, showing, writing, saving, or archiving the summary only reads it, so it can
+ * be done from several threads at once.
+ *
+ * \param scenarios is whether the PDFs and scenarios will be needed.
+ */
+void wind_sum_prepare(WindSum *wsum, bool scenarios);
+
+/** Get the approximate number of bytes of memory used by a \c WindSum.
+ *
+ * This includes the CDFs, PDFs, and scenarios that have been built so far.
+ */
+size_t wind_sum_memory_bytes(WindSum const *wsum);
+
 /** Free the memory associated with a \c WindSum.*/
 void wind_sum_free(WindSum **wsum);